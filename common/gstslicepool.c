@@ -0,0 +1,177 @@
+/* GStreamer
+ * Copyright (C) 2018 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Persistent worker pool used to split a frame into horizontal slices. The
+ * calling (streaming) thread always processes the first slice itself, the
+ * remaining slices are handed to exclusive GThreadPool workers, and
+ * gst_slice_pool_run() only returns once every slice is done. Each row
+ * is processed by exactly the same code as in the single-threaded case, so
+ * output is identical regardless of the number of threads. Plugins slicing
+ * frames compile this in, see the misb and sensorfx CMakeLists.txt. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstslicepool.h"
+
+typedef struct
+{
+  GstSlicePool *pool;
+  GstSliceFunc func;
+  gpointer user_data;
+  guint index;
+  gint y_start;
+  gint y_end;
+} GstSlice;
+
+struct _GstSlicePool
+{
+  guint n_threads;
+  GThreadPool *workers;
+  GstSlice *slices;
+
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+};
+
+static void
+gst_slice_pool_worker (gpointer data, gpointer user_data)
+{
+  GstSlice *slice = (GstSlice *) data;
+  GstSlicePool *pool = slice->pool;
+
+  slice->func (slice->user_data, slice->index, slice->y_start,
+      slice->y_end);
+
+  g_mutex_lock (&pool->mutex);
+  if (--pool->pending == 0)
+    g_cond_signal (&pool->cond);
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_slice_pool_new:
+ * @n_threads: total number of threads to process a frame with, including the
+ *   calling thread, or 0 to use the number of processors
+ *
+ * Returns: a new #GstSlicePool, free with gst_slice_pool_free()
+ */
+GstSlicePool *
+gst_slice_pool_new (guint n_threads)
+{
+  GstSlicePool *pool = g_new0 (GstSlicePool, 1);
+  guint i;
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  pool->n_threads = MAX (n_threads, 1);
+  pool->slices = g_new0 (GstSlice, pool->n_threads);
+  for (i = 0; i < pool->n_threads; i++) {
+    pool->slices[i].pool = pool;
+    pool->slices[i].index = i;
+  }
+
+  g_mutex_init (&pool->mutex);
+  g_cond_init (&pool->cond);
+
+  if (pool->n_threads > 1) {
+    GError *error = NULL;
+
+    pool->workers = g_thread_pool_new (gst_slice_pool_worker, pool,
+        pool->n_threads - 1, TRUE, &error);
+    if (!pool->workers) {
+      g_warning ("Failed to create worker threads, falling back to one "
+          "thread: %s", error->message);
+      g_clear_error (&error);
+      pool->n_threads = 1;
+    }
+  }
+
+  return pool;
+}
+
+void
+gst_slice_pool_free (GstSlicePool * pool)
+{
+  if (!pool)
+    return;
+
+  if (pool->workers)
+    g_thread_pool_free (pool->workers, FALSE, TRUE);
+
+  g_mutex_clear (&pool->mutex);
+  g_cond_clear (&pool->cond);
+  g_free (pool->slices);
+  g_free (pool);
+}
+
+guint
+gst_slice_pool_get_n_threads (GstSlicePool * pool)
+{
+  return pool->n_threads;
+}
+
+/**
+ * gst_slice_pool_run:
+ * @pool: a #GstSlicePool
+ * @height: number of rows in the frame
+ * @func: function to call for each slice
+ * @user_data: data to pass to @func
+ *
+ * Splits @height rows into contiguous slices and calls @func for each, in
+ * parallel. Blocks until all slices have completed.
+ */
+void
+gst_slice_pool_run (GstSlicePool * pool, gint height,
+    GstSliceFunc func, gpointer user_data)
+{
+  guint n_slices, i;
+
+  n_slices = MIN (pool->n_threads, (guint) MAX (height, 1));
+  if (n_slices <= 1) {
+    func (user_data, 0, 0, height);
+    return;
+  }
+
+  for (i = 0; i < n_slices; i++) {
+    GstSlice *slice = &pool->slices[i];
+    slice->func = func;
+    slice->user_data = user_data;
+    slice->y_start = (gint) (((gint64) height * i) / n_slices);
+    slice->y_end = (gint) (((gint64) height * (i + 1)) / n_slices);
+  }
+
+  g_mutex_lock (&pool->mutex);
+  pool->pending = n_slices - 1;
+  g_mutex_unlock (&pool->mutex);
+
+  for (i = 1; i < n_slices; i++)
+    g_thread_pool_push (pool->workers, &pool->slices[i], NULL);
+
+  /* the calling thread does its share instead of idling */
+  func (user_data, 0, pool->slices[0].y_start, pool->slices[0].y_end);
+
+  g_mutex_lock (&pool->mutex);
+  while (pool->pending > 0)
+    g_cond_wait (&pool->cond, &pool->mutex);
+  g_mutex_unlock (&pool->mutex);
+}
@@ -0,0 +1,51 @@
+/* GStreamer
+ * Copyright (C) 2018 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_SLICE_POOL_H__
+#define __GST_SLICE_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstSliceFunc:
+ * @user_data: data passed to gst_slice_pool_run()
+ * @slice: index of the slice, less than gst_slice_pool_get_n_threads()
+ * @y_start: first row of the slice
+ * @y_end: one past the last row of the slice
+ *
+ * Processes rows [@y_start, @y_end) of the current frame. Slices run
+ * concurrently, @slice can be used to select per-thread scratch memory.
+ */
+typedef void (*GstSliceFunc) (gpointer user_data, guint slice,
+    gint y_start, gint y_end);
+
+typedef struct _GstSlicePool GstSlicePool;
+
+GstSlicePool *gst_slice_pool_new (guint n_threads);
+void gst_slice_pool_free (GstSlicePool * pool);
+guint gst_slice_pool_get_n_threads (GstSlicePool * pool);
+void gst_slice_pool_run (GstSlicePool * pool, gint height,
+    GstSliceFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GST_SLICE_POOL_H__ */
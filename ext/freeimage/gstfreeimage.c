@@ -25,6 +25,7 @@
 
 #include "gstfreeimagedec.h"
 #include "gstfreeimageenc.h"
+#include "gstmultitiffsink.h"
 
 
 GST_DEBUG_CATEGORY (freeimagedec_debug);
@@ -44,11 +45,16 @@ plugin_init (GstPlugin * plugin)
   if (!gst_freeimageenc_register_plugins (plugin))
     return FALSE;
 
+  if (!gst_element_register (plugin, "multitiffsink", GST_RANK_NONE,
+          GST_TYPE_MULTI_TIFF_SINK))
+    return FALSE;
+
   return TRUE;
 }
 
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
     GST_VERSION_MINOR,
-    "freeimage",
-    "FreeImage plugin library", plugin_init, VERSION, "LGPL", PACKAGE_NAME,
+    freeimage,
+    "FreeImage plugin library",
+    plugin_init, GST_PACKAGE_VERSION, GST_PACKAGE_LICENSE, GST_PACKAGE_NAME,
     GST_PACKAGE_ORIGIN)
@@ -15,19 +15,25 @@
 /**
  * SECTION:element-freeimagedec
  *
- * Decodes image types supported by FreeImage. If there is no framerate set on sink caps, it sends EOS
- * after the first picture.
+ * Decodes image types supported by FreeImage. If there is no framerate set
+ * on sink caps, the whole stream is decoded as a single picture at EOS,
+ * otherwise every input buffer is expected to hold one picture, as produced
+ * by multifilesrc.
  *
- * Due to the nature of FreeImage, these decoders can only be used with
- * filesrc (for a single image) or multifilesrc (for multiple images). This
- * of course means it cannot be used with streaming sources such as HTTP.
+ * The decoded bitmap is pushed downstream without copying. FreeImage stores
+ * rows bottom-up, so when downstream supports #GstVideoMeta the buffer
+ * carries a negative stride starting at the last row in memory. Otherwise
+ * the rows are flipped in place before pushing.
+ *
+ * 16-bit grayscale is output as GRAY16, 16-bit color as ARGB64 and 32-bit
+ * float grayscale as video/x-raw-gray-float, so radiometric images keep
+ * their full precision.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
-#include <stdlib.h>
 #include <string.h>
 
 #include "gstfreeimagedec.h"
@@ -45,127 +51,25 @@ static void gst_freeimagedec_class_init (GstFreeImageDecClass * klass,
     GstFreeImageDecClassData * class_data);
 static void gst_freeimagedec_init (GstFreeImageDec * freeimagedec);
 
-static GstStateChangeReturn gst_freeimagedec_change_state (GstElement * element,
-    GstStateChange transition);
-
-static gboolean gst_freeimagedec_sink_activate_push (GstPad * sinkpad,
-    gboolean active);
-static gboolean gst_freeimagedec_sink_activate_pull (GstPad * sinkpad,
-    gboolean active);
-static gboolean gst_freeimagedec_sink_activate (GstPad * sinkpad);
-static GstFlowReturn gst_freeimagedec_chain (GstPad * pad, GstBuffer * buffer);
-static gboolean gst_freeimagedec_sink_event (GstPad * pad, GstEvent * event);
-static gboolean gst_freeimagedec_sink_setcaps (GstPad * pad, GstCaps * caps);
-
-static void gst_freeimagedec_task (GstPad * pad);
-
-static gboolean gst_freeimagedec_freeimage_init (GstFreeImageDec *
-    freeimagedec);
-static gboolean gst_freeimagedec_freeimage_clear (GstFreeImageDec *
-    freeimagedec);
-static GstFlowReturn gst_freeimagedec_caps_create_and_set (GstFreeImageDec *
-    freeimagedec);
-static GstFlowReturn gst_freeimagedec_push_dib (GstFreeImageDec * freeimagedec);
-
-static GstElementClass *parent_class = NULL;
-
-void DLL_CALLCONV
-gst_freeimagedec_user_error (FREE_IMAGE_FORMAT fif, const char *message)
-{
-  GST_ERROR ("%s", message);
-}
-
-static int DLL_CALLCONV
-gst_freeimagedec_user_seek (fi_handle handle, long offset, int origin)
-{
-  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (handle);
-
-  switch (origin) {
-    case SEEK_SET:
-      freeimagedec->offset = offset;
-      break;
-    case SEEK_CUR:
-      freeimagedec->offset += offset;
-      break;
-    case SEEK_END:
-      freeimagedec->offset = freeimagedec->length + offset;
-      break;
-  }
-  return 0;
-}
-
-static long DLL_CALLCONV
-gst_freeimagedec_user_tell (fi_handle handle)
-{
-  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (handle);
-
-  return freeimagedec->offset;
-}
-
-unsigned DLL_CALLCONV
-gst_freeimagedec_user_read (void *data, unsigned elsize, unsigned elcount,
-    fi_handle handle)
-{
-  GstFreeImageDec *freeimagedec;
-  GstBuffer *buffer;
-  GstFlowReturn ret = GST_FLOW_OK;
-  guint size;
-  guint length = elsize * elcount;
-
-  freeimagedec = GST_FREEIMAGEDEC (handle);
-
-  GST_LOG ("reading %" G_GSIZE_FORMAT " bytes of data at offset %d", length,
-      freeimagedec->offset);
-
-  ret =
-      gst_pad_pull_range (freeimagedec->sinkpad, freeimagedec->offset, length,
-      &buffer);
-  if (ret != GST_FLOW_OK)
-    goto pause;
+static gboolean gst_freeimagedec_start (GstVideoDecoder * decoder);
+static gboolean gst_freeimagedec_stop (GstVideoDecoder * decoder);
+static gboolean gst_freeimagedec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state);
+static GstFlowReturn gst_freeimagedec_parse (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame, GstAdapter * adapter, gboolean at_eos);
+static GstFlowReturn gst_freeimagedec_handle_frame (GstVideoDecoder *
+    decoder, GstVideoCodecFrame * frame);
+static gboolean gst_freeimagedec_decide_allocation (GstVideoDecoder *
+    decoder, GstQuery * query);
 
-  size = GST_BUFFER_SIZE (buffer);
-
-  if (size != length)
-    goto short_buffer;
-
-  memcpy (data, GST_BUFFER_DATA (buffer), size);
-
-  gst_buffer_unref (buffer);
-
-  freeimagedec->offset += length;
-
-  return size;
-
-  /* ERRORS */
-pause:
-  {
-    GST_INFO_OBJECT (freeimagedec, "pausing task, reason %s",
-        gst_flow_get_name (ret));
-    gst_pad_pause_task (freeimagedec->sinkpad);
-    if (GST_FLOW_IS_FATAL (ret) || ret == GST_FLOW_NOT_LINKED) {
-      GST_ELEMENT_ERROR (freeimagedec, STREAM, FAILED,
-          (("Internal data stream error.")),
-          ("stream stopped, reason %s", gst_flow_get_name (ret)));
-      gst_pad_push_event (freeimagedec->srcpad, gst_event_new_eos ());
-    }
-    return 0;
-  }
-short_buffer:
-  {
-    gst_buffer_unref (buffer);
-    GST_ELEMENT_ERROR (freeimagedec, STREAM, FAILED,
-        (("Internal data stream error.")),
-        ("Read %u, needed %" G_GSIZE_FORMAT "bytes", size, length));
-    ret = GST_FLOW_ERROR;
-    goto pause;
-  }
-}
+static GstVideoDecoderClass *parent_class = NULL;
 
 static void
 gst_freeimagedec_class_init (GstFreeImageDecClass * klass,
     GstFreeImageDecClassData * class_data)
 {
   GstElementClass *gstelement_class;
+  GstVideoDecoderClass *gstvideodecoder_class;
   GstCaps *caps;
   GstPadTemplate *templ;
   const gchar *mimetype;
@@ -178,6 +82,7 @@ gst_freeimagedec_class_init (GstFreeImageDecClass * klass,
   klass->fif = class_data->fif;
 
   gstelement_class = (GstElementClass *) klass;
+  gstvideodecoder_class = (GstVideoDecoderClass *) klass;
 
   parent_class = g_type_class_peek_parent (klass);
 
@@ -188,522 +93,399 @@ gst_freeimagedec_class_init (GstFreeImageDecClass * klass,
 
   /* add sink pad template from FIF mimetype */
   if (mimetype)
-    caps = gst_caps_new_simple (mimetype, NULL);
+    caps = gst_caps_new_empty_simple (mimetype);
   else
-    caps = gst_caps_new_simple ("image/freeimage-unknown", NULL);
+    caps = gst_caps_new_empty_simple ("image/freeimage-unknown");
   templ = gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS, caps);
   gst_element_class_add_pad_template (gstelement_class, templ);
+  gst_caps_unref (caps);
 
-  /* add src pad template */
-  caps = gst_freeimageutils_caps_from_freeimage_format (klass->fif);
+  /* add src pad template, unsupported images are converted to one of these */
+  caps =
+      gst_caps_from_string (GST_VIDEO_CAPS_MAKE (GST_FREEIMAGE_VIDEO_FORMATS)
+      "; " GST_FREEIMAGE_GRAY_FLOAT_CAPS);
   templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps);
   gst_element_class_add_pad_template (gstelement_class, templ);
+  gst_caps_unref (caps);
 
   /* set details */
   longname = g_strdup_printf ("FreeImage %s image decoder", format);
   description = g_strdup_printf ("Decode %s (%s) images",
       format_description, extensions);
-  gst_element_class_set_details_simple (gstelement_class, longname,
+  gst_element_class_set_metadata (gstelement_class, longname,
       "Codec/Decoder/Image", description, "Joshua M. Doe <oss@nvl.army.mil>");
   g_free (longname);
   g_free (description);
 
-  gstelement_class->change_state = gst_freeimagedec_change_state;
+  gstvideodecoder_class->start = GST_DEBUG_FUNCPTR (gst_freeimagedec_start);
+  gstvideodecoder_class->stop = GST_DEBUG_FUNCPTR (gst_freeimagedec_stop);
+  gstvideodecoder_class->set_format =
+      GST_DEBUG_FUNCPTR (gst_freeimagedec_set_format);
+  gstvideodecoder_class->parse = GST_DEBUG_FUNCPTR (gst_freeimagedec_parse);
+  gstvideodecoder_class->handle_frame =
+      GST_DEBUG_FUNCPTR (gst_freeimagedec_handle_frame);
+  gstvideodecoder_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_freeimagedec_decide_allocation);
 }
 
 static void
 gst_freeimagedec_init (GstFreeImageDec * freeimagedec)
 {
-  GstElementClass *klass = GST_ELEMENT_GET_CLASS (freeimagedec);
-
-  freeimagedec->sinkpad =
-      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
-          "sink"), "sink");
-
-  gst_pad_set_activate_function (freeimagedec->sinkpad,
-      gst_freeimagedec_sink_activate);
-  gst_pad_set_activatepull_function (freeimagedec->sinkpad,
-      gst_freeimagedec_sink_activate_pull);
-  gst_pad_set_activatepush_function (freeimagedec->sinkpad,
-      gst_freeimagedec_sink_activate_push);
-  gst_pad_set_chain_function (freeimagedec->sinkpad, gst_freeimagedec_chain);
-  gst_pad_set_event_function (freeimagedec->sinkpad,
-      gst_freeimagedec_sink_event);
-  gst_pad_set_setcaps_function (freeimagedec->sinkpad,
-      gst_freeimagedec_sink_setcaps);
-  gst_element_add_pad (GST_ELEMENT (freeimagedec), freeimagedec->sinkpad);
-
-  freeimagedec->srcpad =
-      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
-          "src"), "src");
-  gst_pad_use_fixed_caps (freeimagedec->srcpad);
-  gst_element_add_pad (GST_ELEMENT (freeimagedec), freeimagedec->srcpad);
-
-
-  freeimagedec->setup = FALSE;
-
-  freeimagedec->in_timestamp = GST_CLOCK_TIME_NONE;
-  freeimagedec->in_duration = GST_CLOCK_TIME_NONE;
-  freeimagedec->in_offset = GST_BUFFER_OFFSET_NONE;
-
-  freeimagedec->fps_n = 0;
-  freeimagedec->fps_d = 1;
-
-  gst_segment_init (&freeimagedec->segment, GST_FORMAT_UNDEFINED);
-
-  /* Set user IO functions to FreeImageIO struct */
-  freeimagedec->fiio.read_proc = gst_freeimagedec_user_read;
-  freeimagedec->fiio.write_proc = NULL;
-  freeimagedec->fiio.seek_proc = gst_freeimagedec_user_seek;
-  freeimagedec->fiio.tell_proc = gst_freeimagedec_user_tell;
+  freeimagedec->input_state = NULL;
+  freeimagedec->use_video_meta = FALSE;
+
+  gst_video_decoder_set_packetized (GST_VIDEO_DECODER (freeimagedec), FALSE);
 }
 
-static GstFlowReturn
-gst_freeimagedec_caps_create_and_set (GstFreeImageDec * freeimagedec)
+static gboolean
+gst_freeimagedec_start (GstVideoDecoder * decoder)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstCaps *caps = NULL, *res = NULL;
-  GstPadTemplate *templ = NULL;
-
-  caps = gst_freeimageutils_caps_from_dib (freeimagedec->dib,
-      freeimagedec->fps_n, freeimagedec->fps_d);
-
-  if (caps == NULL) {
-    /* we have an unsupported type, we'll try converting to RGB/RGBA */
-    FIBITMAP *dib;
-    if (FreeImage_IsTransparent (freeimagedec->dib)) {
-      GST_DEBUG_OBJECT (freeimagedec,
-          "Image is non-standard format with transparency, convert to 32-bit RGB");
-      dib = FreeImage_ConvertTo32Bits (freeimagedec->dib);
-    } else {
-      GST_DEBUG_OBJECT (freeimagedec,
-          "Image is non-standard format, convert to 24-bit RGB");
-      dib = FreeImage_ConvertTo24Bits (freeimagedec->dib);
-    }
+  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (decoder);
 
-    caps = gst_freeimageutils_caps_from_dib (freeimagedec->dib,
-        freeimagedec->fps_n, freeimagedec->fps_d);
-    if (caps == NULL) {
-      GST_DEBUG_OBJECT (freeimagedec,
-          "Image could not be converted to RGB/RGBA, try grayscale");
-      if (dib)
-        FreeImage_Unload (dib);
-      dib = FreeImage_ConvertToStandardType (freeimagedec->dib, TRUE);
-
-      caps = gst_freeimageutils_caps_from_dib (freeimagedec->dib,
-          freeimagedec->fps_n, freeimagedec->fps_d);
-
-      if (caps == NULL) {
-        GST_WARNING_OBJECT (freeimagedec, "Failed to convert image");
-        if (dib)
-          FreeImage_Unload (dib);
-        ret = GST_FLOW_NOT_SUPPORTED;
-        goto beach;
-      }
-    }
-
-    /* set the converted dib as our new dib */
-    FreeImage_Unload (freeimagedec->dib);
-    freeimagedec->dib = dib;
-  }
+  freeimagedec->use_video_meta = FALSE;
 
-  GST_DEBUG_OBJECT (caps, "are the caps");
-
-  if (!gst_pad_set_caps (freeimagedec->srcpad, caps))
-    ret = GST_FLOW_NOT_NEGOTIATED;
+  return TRUE;
+}
 
-  gst_caps_unref (caps);
+static gboolean
+gst_freeimagedec_stop (GstVideoDecoder * decoder)
+{
+  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (decoder);
 
-  /* Push a newsegment event */
-  if (freeimagedec->need_newsegment) {
-    gst_pad_push_event (freeimagedec->srcpad,
-        gst_event_new_new_segment (FALSE, 1.0, GST_FORMAT_TIME, 0, -1, 0));
-    freeimagedec->need_newsegment = FALSE;
+  if (freeimagedec->input_state) {
+    gst_video_codec_state_unref (freeimagedec->input_state);
+    freeimagedec->input_state = NULL;
   }
 
-beach:
-  return ret;
+  return TRUE;
 }
 
-static void
-gst_freeimagedec_task (GstPad * pad)
+static gboolean
+gst_freeimagedec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state)
 {
-  GstFreeImageDec *freeimagedec;
-  GstFlowReturn ret = GST_FLOW_OK;
-  FREE_IMAGE_FORMAT imagetype;
-  GstFormat format;
-
-  freeimagedec = GST_FREEIMAGEDEC (GST_OBJECT_PARENT (pad));
-
-  GST_LOG_OBJECT (freeimagedec, "read frame");
-
-  /* Query length of file for use by gst_freeimagedec_user_seek (SEEK_END) */
-  format = GST_FORMAT_BYTES;
-  gst_pad_query_peer_duration (pad, &format, &freeimagedec->length);
-
-  imagetype =
-      FreeImage_GetFileTypeFromHandle (&freeimagedec->fiio, freeimagedec, 0);
-  freeimagedec->dib =
-      FreeImage_LoadFromHandle (imagetype, &freeimagedec->fiio, freeimagedec,
-      0);
-
-  ret = gst_freeimagedec_push_dib (freeimagedec);
-  if (ret != GST_FLOW_OK)
-    goto pause;
+  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (decoder);
+  GstStructure *s;
+  gint num, denom;
 
-  /* And we are done */
-  gst_pad_pause_task (freeimagedec->sinkpad);
-  gst_pad_push_event (freeimagedec->srcpad, gst_event_new_eos ());
-  return;
+  if (freeimagedec->input_state)
+    gst_video_codec_state_unref (freeimagedec->input_state);
+  freeimagedec->input_state = gst_video_codec_state_ref (state);
 
-pause:
-  {
-    GST_INFO_OBJECT (freeimagedec, "pausing task, reason %s",
-        gst_flow_get_name (ret));
-    gst_pad_pause_task (freeimagedec->sinkpad);
-    if (GST_FLOW_IS_FATAL (ret) || ret == GST_FLOW_NOT_LINKED) {
-      GST_ELEMENT_ERROR (freeimagedec, STREAM, FAILED,
-          ("Internal data stream error."),
-          ("stream stopped, reason %s", gst_flow_get_name (ret)));
-      gst_pad_push_event (freeimagedec->srcpad, gst_event_new_eos ());
-    }
+  s = gst_caps_get_structure (state->caps, 0);
+  if (gst_structure_get_fraction (s, "framerate", &num, &denom)) {
+    GST_DEBUG_OBJECT (freeimagedec, "framed input");
+    gst_video_decoder_set_packetized (decoder, TRUE);
+  } else {
+    GST_DEBUG_OBJECT (freeimagedec, "single picture input");
+    gst_video_decoder_set_packetized (decoder, FALSE);
   }
+
+  return TRUE;
 }
 
 static GstFlowReturn
-gst_freeimagedec_chain (GstPad * pad, GstBuffer * buffer)
+gst_freeimagedec_parse (GstVideoDecoder * decoder, GstVideoCodecFrame * frame,
+    GstAdapter * adapter, gboolean at_eos)
 {
-  GstFreeImageDec *freeimagedec;
-  GstFlowReturn ret = GST_FLOW_OK;
-  FIMEMORY *fimem;
-  FREE_IMAGE_FORMAT format;
+  /* FreeImage can't tell where a picture ends, so collect everything */
+  if (!at_eos)
+    return GST_VIDEO_DECODER_FLOW_NEED_DATA;
 
-  freeimagedec = GST_FREEIMAGEDEC (gst_pad_get_parent (pad));
+  gst_video_decoder_add_to_frame (decoder, gst_adapter_available (adapter));
 
-  GST_LOG_OBJECT (freeimagedec, "Got buffer, size=%u",
-      GST_BUFFER_SIZE (buffer));
+  return gst_video_decoder_have_frame (decoder);
+}
 
-  if (G_UNLIKELY (!freeimagedec->setup))
-    goto not_configured;
+/* The video buffer pool can't be configured for non-raw caps. Nothing is
+ * allocated from it for float images anyway, so hand out a plain pool. */
+static gboolean
+gst_freeimagedec_decide_float_allocation (GstFreeImageDec * freeimagedec,
+    GstQuery * query, GstCaps * caps)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  GstBufferPool *pool;
+  GstStructure *config;
+  gint width = 0, height = 0;
+  guint size;
 
-  /* Return if we have bad flow conditions */
-  ret = freeimagedec->ret;
-  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
-    GST_WARNING_OBJECT (freeimagedec, "we have a pending return code of %d",
-        ret);
-    goto beach;
-  }
+  gst_structure_get_int (s, "width", &width);
+  gst_structure_get_int (s, "height", &height);
+  size = width * height * sizeof (gfloat);
 
-  /* Decode image to DIB */
-  fimem =
-      FreeImage_OpenMemory (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer));
-  format = FreeImage_GetFileTypeFromMemory (fimem, 0);
-  GST_LOG ("FreeImage format is %d", format);
-  freeimagedec->dib = FreeImage_LoadFromMemory (format, fimem, 0);
+  freeimagedec->use_video_meta = FALSE;
 
-  if (freeimagedec->dib == NULL)
-    goto invalid_dib;
+  pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, 0, 0);
+  gst_buffer_pool_set_config (pool, config);
 
-  freeimagedec->in_timestamp = GST_BUFFER_TIMESTAMP (buffer);
-  freeimagedec->in_duration = GST_BUFFER_DURATION (buffer);
-
-  ret = gst_freeimagedec_push_dib (freeimagedec);
-  if (ret != GST_FLOW_OK)
-    goto beach;
+  if (gst_query_get_n_allocation_pools (query) > 0)
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, 0, 0);
+  else
+    gst_query_add_allocation_pool (query, pool, size, 0, 0);
+  gst_object_unref (pool);
 
-  if (freeimagedec->framed) {
-    /* Reset ourselves for the next frame */
-    gst_freeimagedec_freeimage_clear (freeimagedec);
-    gst_freeimagedec_freeimage_init (freeimagedec);
-  } else {
-    GST_LOG_OBJECT (freeimagedec, "sending EOS");
-    freeimagedec->ret =
-        gst_pad_push_event (freeimagedec->srcpad, gst_event_new_eos ());
-  }
+  return TRUE;
+}
 
-  /* grab new return code */
-  ret = freeimagedec->ret;
+static gboolean
+gst_freeimagedec_decide_allocation (GstVideoDecoder * decoder,
+    GstQuery * query)
+{
+  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (decoder);
+  GstCaps *caps;
 
-  /* And release the buffer */
-  gst_buffer_unref (buffer);
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (caps && gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          GST_FREEIMAGE_GRAY_FLOAT_MEDIA_TYPE))
+    return gst_freeimagedec_decide_float_allocation (freeimagedec, query,
+        caps);
 
-beach:
-  gst_object_unref (freeimagedec);
+  freeimagedec->use_video_meta =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
 
-  return ret;
+  GST_DEBUG_OBJECT (freeimagedec, "downstream %s GstVideoMeta",
+      freeimagedec->use_video_meta ? "supports" : "doesn't support");
 
-  /* ERRORS */
-not_configured:
-  {
-    GST_LOG_OBJECT (freeimagedec, "we are not configured yet");
-    ret = GST_FLOW_WRONG_STATE;
-    goto beach;
-  }
-invalid_dib:
-  {
-    GST_LOG_OBJECT (freeimagedec, "file is not recognized");
-    ret = GST_FLOW_UNEXPECTED;
-    goto beach;
-  }
+  return parent_class->decide_allocation (decoder, query);
 }
 
-static gboolean
-gst_freeimagedec_sink_setcaps (GstPad * pad, GstCaps * caps)
+/* Convert an unsupported DIB to RGB/RGBA or grayscale, consumes @dib */
+static FIBITMAP *
+gst_freeimagedec_convert_dib (GstFreeImageDec * freeimagedec, FIBITMAP * dib)
 {
-  GstStructure *s;
-  GstFreeImageDec *freeimagedec;
-  gint num, denom;
+  FIBITMAP *converted;
 
-  freeimagedec = GST_FREEIMAGEDEC (gst_pad_get_parent (pad));
+  if (gst_freeimageutils_video_format_from_dib (dib) !=
+      GST_VIDEO_FORMAT_UNKNOWN)
+    return dib;
 
-  s = gst_caps_get_structure (caps, 0);
-  if (gst_structure_get_fraction (s, "framerate", &num, &denom)) {
-    GST_DEBUG_OBJECT (freeimagedec, "framed input");
-    freeimagedec->framed = TRUE;
-    freeimagedec->fps_n = num;
-    freeimagedec->fps_d = denom;
+  /* we have an unsupported type, we'll try converting to RGB/RGBA */
+  if (FreeImage_IsTransparent (dib)) {
+    GST_DEBUG_OBJECT (freeimagedec,
+        "Image is non-standard format with transparency, convert to 32-bit RGB");
+    converted = FreeImage_ConvertTo32Bits (dib);
   } else {
-    GST_DEBUG_OBJECT (freeimagedec, "single picture input");
-    freeimagedec->framed = FALSE;
-    freeimagedec->fps_n = 0;
-    freeimagedec->fps_d = 1;
+    GST_DEBUG_OBJECT (freeimagedec,
+        "Image is non-standard format, convert to 24-bit RGB");
+    converted = FreeImage_ConvertTo24Bits (dib);
   }
 
-  gst_object_unref (freeimagedec);
-  return TRUE;
+  if (gst_freeimageutils_video_format_from_dib (converted) ==
+      GST_VIDEO_FORMAT_UNKNOWN) {
+    GST_DEBUG_OBJECT (freeimagedec,
+        "Image could not be converted to RGB/RGBA, try grayscale");
+    if (converted)
+      FreeImage_Unload (converted);
+    converted = FreeImage_ConvertToStandardType (dib, TRUE);
+
+    if (gst_freeimageutils_video_format_from_dib (converted) ==
+        GST_VIDEO_FORMAT_UNKNOWN) {
+      GST_WARNING_OBJECT (freeimagedec, "Failed to convert image");
+      if (converted)
+        FreeImage_Unload (converted);
+      converted = NULL;
+    }
+  }
+
+  FreeImage_Unload (dib);
+
+  return converted;
 }
 
-static gboolean
-gst_freeimagedec_sink_event (GstPad * pad, GstEvent * event)
+static void
+gst_freeimagedec_dib_unload (gpointer dib)
 {
-  GstFreeImageDec *freeimagedec;
-  gboolean res;
-
-  freeimagedec = GST_FREEIMAGEDEC (gst_pad_get_parent (pad));
+  FreeImage_Unload ((FIBITMAP *) dib);
+}
 
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_NEWSEGMENT:{
-      gdouble rate, arate;
-      gboolean update;
-      gint64 start, stop, position;
-      GstFormat fmt;
+/* Wrap the DIB pixels in a buffer that unloads the DIB when freed */
+static GstBuffer *
+gst_freeimagedec_wrap_dib (GstFreeImageDec * freeimagedec, FIBITMAP * dib,
+    const GstVideoInfo * info)
+{
+  GstBuffer *buffer;
+  guint width = FreeImage_GetWidth (dib);
+  guint height = FreeImage_GetHeight (dib);
+  guint pitch = FreeImage_GetPitch (dib);
+  gsize size = (gsize) pitch * height;
 
-      gst_event_parse_new_segment_full (event, &update, &rate, &arate, &fmt,
-          &start, &stop, &position);
+  gboolean use_video_meta = freeimagedec->use_video_meta &&
+      GST_VIDEO_INFO_FORMAT (info) != GST_VIDEO_FORMAT_ENCODED;
 
-      gst_segment_set_newsegment_full (&freeimagedec->segment, update, rate,
-          arate, fmt, start, stop, position);
+  /* DIB pitch is DWORD aligned, same as the default stride of all the
+   * packed formats we output, so top-down rows need no meta */
+  if (!use_video_meta)
+    FreeImage_FlipVertical (dib);
 
-      GST_LOG_OBJECT (freeimagedec, "NEWSEGMENT (%s)",
-          gst_format_get_name (fmt));
+  buffer = gst_buffer_new_wrapped_full (0, FreeImage_GetBits (dib), size, 0,
+      size, dib, gst_freeimagedec_dib_unload);
 
-      if (fmt == GST_FORMAT_TIME) {
-        freeimagedec->need_newsegment = FALSE;
-        res = gst_pad_push_event (freeimagedec->srcpad, event);
-      } else {
-        gst_event_unref (event);
-        res = TRUE;
-      }
+  if (use_video_meta) {
+    gsize offset[GST_VIDEO_MAX_PLANES] = { 0, };
+    gint stride[GST_VIDEO_MAX_PLANES] = { 0, };
 
-      /* set offset of outgoing buffers */
-      freeimagedec->in_offset = 0;
+    /* first row of the picture is the last one in memory */
+    offset[0] = size - pitch;
+    stride[0] = -(gint) pitch;
 
-      break;
-    }
-    case GST_EVENT_FLUSH_STOP:
-    {
-      gst_freeimagedec_freeimage_clear (freeimagedec);
-      gst_freeimagedec_freeimage_init (freeimagedec);
-      freeimagedec->ret = GST_FLOW_OK;
-
-      gst_segment_init (&freeimagedec->segment, GST_FORMAT_UNDEFINED);
-      res = gst_pad_push_event (freeimagedec->srcpad, event);
-      break;
-    }
-    case GST_EVENT_EOS:
-    {
-      GST_LOG_OBJECT (freeimagedec, "EOS");
-      gst_freeimagedec_freeimage_clear (freeimagedec);
-      freeimagedec->ret = GST_FLOW_UNEXPECTED;
-      res = gst_pad_push_event (freeimagedec->srcpad, event);
-      break;
-    }
-    default:
-      res = gst_pad_push_event (freeimagedec->srcpad, event);
-      break;
+    gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (info), width, height, 1, offset, stride);
   }
 
-  gst_object_unref (freeimagedec);
-  return res;
+  return buffer;
 }
 
-
-/* Clean up the freeimage structures */
-static gboolean
-gst_freeimagedec_freeimage_clear (GstFreeImageDec * freeimagedec)
+/* Reorder 16-bit color into an output frame, consumes @dib */
+static GstFlowReturn
+gst_freeimagedec_convert_rgb16 (GstFreeImageDec * freeimagedec,
+    FIBITMAP * dib, GstVideoCodecFrame * frame, const GstVideoInfo * info)
 {
-  GST_LOG ("cleaning up freeimage structures");
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (freeimagedec);
+  GstFlowReturn ret;
+  GstVideoFrame vframe;
+  gboolean has_alpha = FreeImage_GetImageType (dib) == FIT_RGBA16;
+  gint width = FreeImage_GetWidth (dib);
+  gint height = FreeImage_GetHeight (dib);
+  gint y;
 
-  if (freeimagedec->dib) {
-    FreeImage_Unload (freeimagedec->dib);
-    freeimagedec->dib = NULL;
+  ret = gst_video_decoder_allocate_output_frame (decoder, frame);
+  if (ret != GST_FLOW_OK) {
+    FreeImage_Unload (dib);
+    return ret;
   }
 
-  freeimagedec->in_timestamp = GST_CLOCK_TIME_NONE;
-  freeimagedec->in_duration = GST_CLOCK_TIME_NONE;
-
-  freeimagedec->setup = FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-gst_freeimagedec_freeimage_init (GstFreeImageDec * freeimagedec)
-{
-  if (freeimagedec->setup)
-    return TRUE;
+  if (!gst_video_frame_map (&vframe, info, frame->output_buffer,
+          GST_MAP_WRITE)) {
+    FreeImage_Unload (dib);
+    return GST_FLOW_ERROR;
+  }
 
-  GST_LOG ("init freeimage");
+  /* flip while reordering, DIB rows are stored bottom-up */
+  for (y = 0; y < height; y++) {
+    gst_freeimageutils_argb64_from_dib_line ((guint16 *) (
+            (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&vframe, 0) +
+            y * GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, 0)),
+        (const guint16 *) FreeImage_GetScanLine (dib, height - y - 1), width,
+        has_alpha);
+  }
 
-  freeimagedec->setup = TRUE;
+  gst_video_frame_unmap (&vframe);
+  FreeImage_Unload (dib);
 
-  return TRUE;
+  return GST_FLOW_OK;
 }
 
-static GstStateChangeReturn
-gst_freeimagedec_change_state (GstElement * element, GstStateChange transition)
+static GstFlowReturn
+gst_freeimagedec_handle_frame (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame)
 {
-  GstStateChangeReturn ret;
-  GstFreeImageDec *freeimagedec;
-
-  freeimagedec = GST_FREEIMAGEDEC (element);
-
-  switch (transition) {
-    case GST_STATE_CHANGE_READY_TO_PAUSED:
-      gst_freeimagedec_freeimage_init (freeimagedec);
-      freeimagedec->need_newsegment = TRUE;
-      freeimagedec->framed = FALSE;
-      freeimagedec->ret = GST_FLOW_OK;
-      gst_segment_init (&freeimagedec->segment, GST_FORMAT_UNDEFINED);
-      break;
-    default:
-      break;
-  }
+  GstFreeImageDec *freeimagedec = GST_FREEIMAGEDEC (decoder);
+  GstFreeImageDecClass *klass = GST_FREEIMAGEDEC_GET_CLASS (freeimagedec);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstVideoCodecState *output_state;
+  GstVideoFormat format;
+  GstMapInfo minfo;
+  FIMEMORY *fimem;
+  FREE_IMAGE_FORMAT fif;
+  FIBITMAP *dib;
+  guint width, height;
 
-  ret = parent_class->change_state (element, transition);
-  if (ret != GST_STATE_CHANGE_SUCCESS)
-    return ret;
+  GST_LOG_OBJECT (freeimagedec, "Got buffer, size=%" G_GSIZE_FORMAT,
+      gst_buffer_get_size (frame->input_buffer));
 
-  switch (transition) {
-    case GST_STATE_CHANGE_PAUSED_TO_READY:
-      gst_freeimagedec_freeimage_clear (freeimagedec);
-      break;
-    default:
-      break;
-  }
+  if (!gst_buffer_map (frame->input_buffer, &minfo, GST_MAP_READ))
+    goto map_failed;
 
-  return ret;
-}
+  /* Decode image to DIB */
+  fimem = FreeImage_OpenMemory (minfo.data, (DWORD) minfo.size);
+  fif = FreeImage_GetFileTypeFromMemory (fimem, 0);
+  if (fif == FIF_UNKNOWN)
+    fif = klass->fif;
+  GST_LOG_OBJECT (freeimagedec, "FreeImage format is %d", fif);
+  dib = FreeImage_LoadFromMemory (fif, fimem, 0);
+  FreeImage_CloseMemory (fimem);
 
-/* this function gets called when we activate ourselves in push mode. */
-static gboolean
-gst_freeimagedec_sink_activate_push (GstPad * sinkpad, gboolean active)
-{
-  GstFreeImageDec *freeimagedec;
+  gst_buffer_unmap (frame->input_buffer, &minfo);
 
-  freeimagedec = GST_FREEIMAGEDEC (GST_OBJECT_PARENT (sinkpad));
+  if (dib == NULL)
+    goto invalid_dib;
 
-  freeimagedec->ret = GST_FLOW_OK;
+  dib = gst_freeimagedec_convert_dib (freeimagedec, dib);
+  if (dib == NULL)
+    goto unsupported;
 
-  return TRUE;
-}
+  format = gst_freeimageutils_video_format_from_dib (dib);
+  width = FreeImage_GetWidth (dib);
+  height = FreeImage_GetHeight (dib);
 
-/* this function gets called when we activate ourselves in pull mode.
- * We can perform random access to the resource and we start a task
- * to start reading */
-static gboolean
-gst_freeimagedec_sink_activate_pull (GstPad * sinkpad, gboolean active)
-{
-  if (active) {
-    return gst_pad_start_task (sinkpad, (GstTaskFunction) gst_freeimagedec_task,
-        sinkpad);
-  } else {
-    return gst_pad_stop_task (sinkpad);
+  /* Generate the caps and configure */
+  output_state = gst_video_decoder_get_output_state (decoder);
+  if (output_state == NULL ||
+      GST_VIDEO_INFO_FORMAT (&output_state->info) != format ||
+      GST_VIDEO_INFO_WIDTH (&output_state->info) != width ||
+      GST_VIDEO_INFO_HEIGHT (&output_state->info) != height) {
+    if (output_state)
+      gst_video_codec_state_unref (output_state);
+    output_state = gst_video_decoder_set_output_state (decoder, format,
+        width, height, freeimagedec->input_state);
+
+    if (format == GST_VIDEO_FORMAT_ENCODED) {
+      output_state->caps =
+          gst_caps_new_simple (GST_FREEIMAGE_GRAY_FLOAT_MEDIA_TYPE, "format",
+          G_TYPE_STRING, GST_FREEIMAGE_FORMAT_GRAY32F, "width", G_TYPE_INT,
+          width, "height", G_TYPE_INT, height, "framerate",
+          GST_TYPE_FRACTION, GST_VIDEO_INFO_FPS_N (&output_state->info),
+          GST_VIDEO_INFO_FPS_D (&output_state->info), NULL);
+    }
+
+    if (!gst_video_decoder_negotiate (decoder)) {
+      gst_video_codec_state_unref (output_state);
+      FreeImage_Unload (dib);
+      gst_video_decoder_drop_frame (decoder, frame);
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
   }
-}
 
-/* this function is called when the pad is activated and should start
- * processing data.
- *
- */
-static gboolean
-gst_freeimagedec_sink_activate (GstPad * sinkpad)
-{
-  if (gst_pad_check_pull_range (sinkpad)) {
-    return gst_pad_activate_pull (sinkpad, TRUE);
+  if (format == GST_VIDEO_FORMAT_ARGB64) {
+    ret = gst_freeimagedec_convert_rgb16 (freeimagedec, dib, frame,
+        &output_state->info);
   } else {
-    return gst_pad_activate_push (sinkpad, TRUE);
+    frame->output_buffer =
+        gst_freeimagedec_wrap_dib (freeimagedec, dib, &output_state->info);
   }
-}
+  gst_video_codec_state_unref (output_state);
 
-
-static GstFlowReturn
-gst_freeimagedec_push_dib (GstFreeImageDec * freeimagedec)
-{
-  GstFlowReturn ret;
-  GstBuffer *buffer = NULL;
-  size_t buffer_size = 0;
-  guint pitch, height;
-  gint i;
-
-  if (freeimagedec->dib == NULL)
-    return GST_FLOW_UNEXPECTED;
-
-  /* Generate the caps and configure */
-  ret = gst_freeimagedec_caps_create_and_set (freeimagedec);
   if (ret != GST_FLOW_OK) {
+    gst_video_decoder_drop_frame (decoder, frame);
     return ret;
   }
 
-  /* Allocate output buffer */
-  height = FreeImage_GetHeight (freeimagedec->dib);
-  pitch = FreeImage_GetPitch (freeimagedec->dib);
-  buffer_size = pitch * height;
-
-  GST_LOG ("Buffer size must be %d", buffer_size);
+  return gst_video_decoder_finish_frame (decoder, frame);
 
-  ret = gst_pad_alloc_buffer_and_set_caps (freeimagedec->srcpad,
-      GST_BUFFER_OFFSET_NONE, buffer_size,
-      GST_PAD_CAPS (freeimagedec->srcpad), &buffer);
-  if (ret != GST_FLOW_OK)
+  /* ERRORS */
+map_failed:
+  {
+    GST_ELEMENT_ERROR (freeimagedec, RESOURCE, READ,
+        ("Failed to map input buffer"), (NULL));
+    gst_video_decoder_drop_frame (decoder, frame);
+    return GST_FLOW_ERROR;
+  }
+invalid_dib:
+  {
+    GST_VIDEO_DECODER_ERROR (decoder, 1, STREAM, DECODE, (NULL),
+        ("FreeImage failed to decode image"), ret);
+    gst_video_decoder_drop_frame (decoder, frame);
+    return ret;
+  }
+unsupported:
+  {
+    GST_VIDEO_DECODER_ERROR (decoder, 1, STREAM, FORMAT, (NULL),
+        ("Image could not be converted to a supported format"), ret);
+    gst_video_decoder_drop_frame (decoder, frame);
     return ret;
-
-  /* flip image and copy to buffer */
-  for (i = 0; i < height; i++) {
-    memcpy (GST_BUFFER_DATA (buffer) + i * pitch,
-        FreeImage_GetBits (freeimagedec->dib) + (height - i - 1) * pitch,
-        pitch);
   }
-
-  if (GST_BUFFER_TIMESTAMP_IS_VALID (freeimagedec->in_timestamp))
-    GST_BUFFER_TIMESTAMP (buffer) = freeimagedec->in_timestamp;
-  else if (freeimagedec->fps_d != 0)
-    GST_BUFFER_TIMESTAMP (buffer) =
-        (freeimagedec->in_offset * freeimagedec->fps_n) / freeimagedec->fps_d;
-  if (GST_BUFFER_TIMESTAMP_IS_VALID (freeimagedec->in_duration))
-    GST_BUFFER_DURATION (buffer) = freeimagedec->in_duration;
-  else if (freeimagedec->fps_n != 0)
-    GST_BUFFER_DURATION (buffer) = freeimagedec->fps_d / freeimagedec->fps_n;
-  GST_BUFFER_OFFSET (buffer) = freeimagedec->in_offset;
-  GST_BUFFER_OFFSET_END (buffer) = freeimagedec->in_offset;
-
-  /* Push the raw frame */
-  ret = gst_pad_push (freeimagedec->srcpad, buffer);
-
-  /* increment output buffer offset */
-  freeimagedec->in_offset++;
-
-  return ret;
 }
 
 gboolean
@@ -747,7 +529,7 @@ gst_freeimagedec_register_plugin (GstPlugin * plugin, FREE_IMAGE_FORMAT fif)
   class_data->fif = fif;
   typeinfo.class_data = class_data;
 
-  type = g_type_register_static (GST_TYPE_ELEMENT, type_name, &typeinfo, 0);
+  type = g_type_register_static (GST_TYPE_VIDEO_DECODER, type_name, &typeinfo, 0);
   ret = gst_element_register (plugin, type_name, GST_RANK_NONE, type);
 
   g_free (type_name);
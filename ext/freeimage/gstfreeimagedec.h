@@ -22,6 +22,7 @@
 #define __GST_FREEIMAGEDEC_H__
 
 #include <gst/gst.h>
+#include <gst/video/gstvideodecoder.h>
 #include <FreeImage.h>
 
 G_BEGIN_DECLS
@@ -39,41 +40,17 @@ typedef struct _GstFreeImageDecClass GstFreeImageDecClass;
 
 struct _GstFreeImageDec
 {
-  GstElement element;
+  GstVideoDecoder parent;
 
-  GstPad *sinkpad, *srcpad;
+  GstVideoCodecState *input_state;
 
-  gboolean need_newsegment;
-  
-  /* Pull range */
-  long offset;
-
-
-  guint64 in_timestamp;
-  guint64 in_duration;
-  guint64 in_offset;
-
-  gboolean framed;
-
-  gint ret;
-
-  FIBITMAP *dib;
-
-  gboolean setup;
-
-  gint fps_n;
-  gint fps_d;
-
-  GstSegment segment;
-  gboolean image_ready;
-
-  FreeImageIO fiio;
-  guint64 length;
+  /* downstream handles GstVideoMeta, so bottom-up DIBs can be pushed as is */
+  gboolean use_video_meta;
 };
 
 struct _GstFreeImageDecClass
 {
-  GstElementClass parent_class;
+  GstVideoDecoderClass parent_class;
 
   FREE_IMAGE_FORMAT fif;
 };
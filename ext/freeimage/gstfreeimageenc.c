@@ -17,13 +17,16 @@
  *
  * Encodes image types supported by FreeImage.
  *
+ * Frames are encoded concurrently by #GstFreeImageEnc:n-threads threads and
+ * pushed downstream in their original order, which adds a latency of up to
+ * that many frames. The encoded image is pushed in the memory FreeImage
+ * encoded it to, without copying.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
-#include <stdlib.h>
 #include <string.h>
 
 #include "gstfreeimageenc.h"
@@ -32,72 +35,58 @@
 GST_DEBUG_CATEGORY_EXTERN (freeimageenc_debug);
 #define GST_CAT_DEFAULT freeimageenc_debug
 
+enum
+{
+  PROP_0,
+  PROP_N_THREADS
+};
+
+#define DEFAULT_PROP_N_THREADS 0
+
 typedef struct
 {
   FREE_IMAGE_FORMAT fif;
 } GstFreeImageEncClassData;
 
+/* a frame handed to the encoding threads */
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  FIMEMORY *hmem;
+  gboolean done;
+} GstFreeImageEncJob;
+
 static void gst_freeimageenc_class_init (GstFreeImageEncClass * klass,
     GstFreeImageEncClassData * class_data);
 static void gst_freeimageenc_init (GstFreeImageEnc * freeimageenc);
-
-static gboolean gst_freeimageenc_sink_activate_push (GstPad * sinkpad,
-    gboolean active);
-static gboolean gst_freeimageenc_sink_activate_pull (GstPad * sinkpad,
-    gboolean active);
-static gboolean gst_freeimageenc_sink_activate (GstPad * sinkpad);
-static GstFlowReturn gst_freeimageenc_chain (GstPad * pad, GstBuffer * buffer);
-static gboolean gst_freeimageenc_sink_event (GstPad * pad, GstEvent * event);
-static gboolean gst_freeimageenc_sink_setcaps (GstPad * pad, GstCaps * caps);
-
-static void gst_freeimageenc_task (GstPad * pad);
-
-static gboolean gst_freeimageenc_freeimage_init (GstFreeImageEnc *
-    freeimageenc);
-static gboolean gst_freeimageenc_freeimage_clear (GstFreeImageEnc *
-    freeimageenc);
-static GstFlowReturn gst_freeimageenc_push_dib (GstFreeImageEnc * freeimageenc);
-
-static GstElementClass *parent_class = NULL;
-
-void DLL_CALLCONV
-gst_freeimageenc_user_error (FREE_IMAGE_FORMAT fif, const char *message)
-{
-  GST_ERROR ("%s", message);
-}
-
-static int DLL_CALLCONV
-gst_freeimageenc_user_seek (fi_handle handle, long offset, int origin)
-{
-  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (handle);
-
-  switch (origin) {
-    case SEEK_SET:
-      freeimageenc->offset = offset;
-      break;
-    case SEEK_CUR:
-      freeimageenc->offset += offset;
-      break;
-    case SEEK_END:
-      freeimageenc->offset = freeimageenc->length + offset;
-      break;
-  }
-  return 0;
-}
-
-static long DLL_CALLCONV
-gst_freeimageenc_user_tell (fi_handle handle)
-{
-  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (handle);
-
-  return freeimageenc->offset;
-}
+static void gst_freeimageenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_freeimageenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_freeimageenc_finalize (GObject * object);
+
+static gboolean gst_freeimageenc_start (GstVideoEncoder * encoder);
+static gboolean gst_freeimageenc_stop (GstVideoEncoder * encoder);
+static gboolean gst_freeimageenc_set_format (GstVideoEncoder * encoder,
+    GstVideoCodecState * state);
+static GstFlowReturn gst_freeimageenc_handle_frame (GstVideoEncoder *
+    encoder, GstVideoCodecFrame * frame);
+static GstFlowReturn gst_freeimageenc_finish (GstVideoEncoder * encoder);
+static gboolean gst_freeimageenc_flush (GstVideoEncoder * encoder);
+static gboolean gst_freeimageenc_propose_allocation (GstVideoEncoder *
+    encoder, GstQuery * query);
+
+static void gst_freeimageenc_encode_func (gpointer data, gpointer user_data);
+
+static GstVideoEncoderClass *parent_class = NULL;
 
 static void
 gst_freeimageenc_class_init (GstFreeImageEncClass * klass,
     GstFreeImageEncClassData * class_data)
 {
+  GObjectClass *gobject_class;
   GstElementClass *gstelement_class;
+  GstVideoEncoderClass *gstvideoencoder_class;
   GstCaps *caps;
   GstPadTemplate *templ;
   const gchar *mimetype;
@@ -109,10 +98,23 @@ gst_freeimageenc_class_init (GstFreeImageEncClass * klass,
 
   klass->fif = class_data->fif;
 
+  gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
+  gstvideoencoder_class = (GstVideoEncoderClass *) klass;
 
   parent_class = g_type_class_peek_parent (klass);
 
+  gobject_class->set_property = gst_freeimageenc_set_property;
+  gobject_class->get_property = gst_freeimageenc_get_property;
+  gobject_class->finalize = gst_freeimageenc_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of frames to encode concurrently (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_PROP_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   mimetype = FreeImage_GetFIFMimeType (klass->fif);
   format = FreeImage_GetFormatFromFIF (klass->fif);
   format_description = FreeImage_GetFIFDescription (klass->fif);
@@ -120,214 +122,472 @@ gst_freeimageenc_class_init (GstFreeImageEncClass * klass,
 
   /* add src pad template from FIF mimetype */
   if (mimetype)
-    caps = gst_caps_new_simple (mimetype, NULL);
+    caps = gst_caps_new_empty_simple (mimetype);
   else
-    caps = gst_caps_new_simple ("image/freeimage-unknown", NULL);
+    caps = gst_caps_new_empty_simple ("image/freeimage-unknown");
   templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps);
   gst_element_class_add_pad_template (gstelement_class, templ);
+  gst_caps_unref (caps);
 
   /* add sink pad template */
   caps = gst_freeimageutils_caps_from_freeimage_format (klass->fif);
   templ = gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS, caps);
   gst_element_class_add_pad_template (gstelement_class, templ);
+  gst_caps_unref (caps);
 
   /* set details */
   longname = g_strdup_printf ("FreeImage %s image encoder", format);
   description = g_strdup_printf ("Encode %s (%s) images",
       format_description, extensions);
-  gst_element_class_set_details_simple (gstelement_class, longname,
+  gst_element_class_set_metadata (gstelement_class, longname,
       "Codec/Encoder/Image", description, "Joshua M. Doe <oss@nvl.army.mil>");
   g_free (longname);
   g_free (description);
+
+  gstvideoencoder_class->start = GST_DEBUG_FUNCPTR (gst_freeimageenc_start);
+  gstvideoencoder_class->stop = GST_DEBUG_FUNCPTR (gst_freeimageenc_stop);
+  gstvideoencoder_class->set_format =
+      GST_DEBUG_FUNCPTR (gst_freeimageenc_set_format);
+  gstvideoencoder_class->handle_frame =
+      GST_DEBUG_FUNCPTR (gst_freeimageenc_handle_frame);
+  gstvideoencoder_class->finish = GST_DEBUG_FUNCPTR (gst_freeimageenc_finish);
+  gstvideoencoder_class->flush = GST_DEBUG_FUNCPTR (gst_freeimageenc_flush);
+  gstvideoencoder_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_freeimageenc_propose_allocation);
 }
 
 static void
 gst_freeimageenc_init (GstFreeImageEnc * freeimageenc)
 {
-  GstElementClass *klass = GST_ELEMENT_GET_CLASS (freeimageenc);
-
-  freeimageenc->sinkpad =
-      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
-          "sink"), "sink");
-  gst_pad_set_chain_function (freeimageenc->sinkpad, gst_freeimageenc_chain);
-  gst_pad_set_setcaps_function (freeimageenc->sinkpad,
-      gst_freeimageenc_sink_setcaps);
-  gst_element_add_pad (GST_ELEMENT (freeimageenc), freeimageenc->sinkpad);
-
-  freeimageenc->srcpad =
-      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
-          "src"), "src");
-  gst_pad_use_fixed_caps (freeimageenc->srcpad);
-  gst_element_add_pad (GST_ELEMENT (freeimageenc), freeimageenc->srcpad);
-
-  freeimageenc->setup = FALSE;
-
-  freeimageenc->in_timestamp = GST_CLOCK_TIME_NONE;
-  freeimageenc->in_duration = GST_CLOCK_TIME_NONE;
-
-  freeimageenc->fps_n = 0;
-  freeimageenc->fps_d = 1;
-
-  /* Set user IO functions to FreeImageIO struct */
-  freeimageenc->fiio.read_proc = NULL;
-  freeimageenc->fiio.write_proc = NULL;
-  freeimageenc->fiio.seek_proc = gst_freeimageenc_user_seek;
-  freeimageenc->fiio.tell_proc = gst_freeimageenc_user_tell;
+  freeimageenc->n_threads = DEFAULT_PROP_N_THREADS;
+
+  freeimageenc->input_state = NULL;
+  freeimageenc->pool = NULL;
+  freeimageenc->max_pending = 1;
+
+  g_mutex_init (&freeimageenc->lock);
+  g_cond_init (&freeimageenc->cond);
+  g_queue_init (&freeimageenc->jobs);
+  g_queue_init (&freeimageenc->free_dibs);
 }
 
-static GstFlowReturn
-gst_freeimageenc_chain (GstPad * pad, GstBuffer * buffer)
+static void
+gst_freeimageenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
 {
-  GstFreeImageEnc *freeimageenc;
-  GstFreeImageEncClass *klass;
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBuffer *buffer_out;
-  FIMEMORY *hmem = NULL;
-  gint srcPitch, dstPitch;
-  guint8 *pSrc, *pDst;
-  gint width, height, bpp;
-  size_t y;
-  BYTE *mem_buffer;
-  DWORD size_in_bytes;
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (object);
 
-  freeimageenc = GST_FREEIMAGEENC (gst_pad_get_parent (pad));
-  klass = GST_FREEIMAGEENC_GET_CLASS (freeimageenc);
+  GST_OBJECT_LOCK (freeimageenc);
+  switch (prop_id) {
+    case PROP_N_THREADS:
+      freeimageenc->n_threads = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (freeimageenc);
+}
 
-  GST_LOG_OBJECT (freeimageenc, "Got buffer, size=%u",
-      GST_BUFFER_SIZE (buffer));
+static void
+gst_freeimageenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (object);
 
-  /* convert raw buffer to FIBITMAP */
-  width = FreeImage_GetWidth (freeimageenc->dib);
-  height = FreeImage_GetHeight (freeimageenc->dib);
-  bpp = FreeImage_GetBPP (freeimageenc->dib);
+  GST_OBJECT_LOCK (freeimageenc);
+  switch (prop_id) {
+    case PROP_N_THREADS:
+      g_value_set_uint (value, freeimageenc->n_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (freeimageenc);
+}
 
-  dstPitch = FreeImage_GetPitch (freeimageenc->dib);
-  srcPitch = GST_ROUND_UP_4 (width * bpp / 8);
+static void
+gst_freeimageenc_finalize (GObject * object)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (object);
 
-  /* Copy data, invert scanlines and respect FreeImage pitch */
-  pDst = FreeImage_GetBits (freeimageenc->dib);
-  for (y = 0; y < height; ++y) {
-    pSrc = GST_BUFFER_DATA (buffer) + (height - y - 1) * srcPitch;
-    memcpy (pDst, pSrc, srcPitch);
-    pDst += dstPitch;
+  g_mutex_clear (&freeimageenc->lock);
+  g_cond_clear (&freeimageenc->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_freeimageenc_free_dibs (GstFreeImageEnc * freeimageenc)
+{
+  FIBITMAP *dib;
+
+  while ((dib = g_queue_pop_head (&freeimageenc->free_dibs)))
+    FreeImage_Unload (dib);
+}
+
+/* Wait for all pending frames and drop them, called with the stream lock */
+static void
+gst_freeimageenc_discard_jobs (GstFreeImageEnc * freeimageenc)
+{
+  GstFreeImageEncJob *job;
+
+  g_mutex_lock (&freeimageenc->lock);
+  while ((job = g_queue_pop_head (&freeimageenc->jobs))) {
+    while (!job->done)
+      g_cond_wait (&freeimageenc->cond, &freeimageenc->lock);
+
+    if (job->hmem)
+      FreeImage_CloseMemory (job->hmem);
+    gst_video_codec_frame_unref (job->frame);
+    g_slice_free (GstFreeImageEncJob, job);
   }
+  g_mutex_unlock (&freeimageenc->lock);
+}
 
-  /* open memory stream */
-  hmem = FreeImage_OpenMemory (0, 0);
+static void
+gst_freeimageenc_close_memory (gpointer hmem)
+{
+  FreeImage_CloseMemory ((FIMEMORY *) hmem);
+}
 
-  /* encode raw image to memory */
-  if (!FreeImage_SaveToMemory (klass->fif, freeimageenc->dib, hmem, 0)) {
-    GST_ERROR ("Failed to encode image");
-    FreeImage_CloseMemory (hmem);
-    gst_buffer_unref (buffer);
+/* Push an encoded frame downstream, consumes @job */
+static GstFlowReturn
+gst_freeimageenc_finish_job (GstFreeImageEnc * freeimageenc,
+    GstFreeImageEncJob * job)
+{
+  GstVideoEncoder *encoder = GST_VIDEO_ENCODER (freeimageenc);
+  GstVideoCodecFrame *frame = job->frame;
+  FIMEMORY *hmem = job->hmem;
+  BYTE *mem_buffer;
+  DWORD size_in_bytes;
+
+  g_slice_free (GstFreeImageEncJob, job);
+
+  if (hmem == NULL) {
+    GST_ELEMENT_ERROR (freeimageenc, STREAM, ENCODE,
+        ("Failed to encode image"), (NULL));
+    gst_video_encoder_finish_frame (encoder, frame);
     return GST_FLOW_ERROR;
   }
 
   if (!FreeImage_AcquireMemory (hmem, &mem_buffer, &size_in_bytes)) {
-    GST_ERROR ("Failed to acquire encoded image");
+    GST_ELEMENT_ERROR (freeimageenc, STREAM, ENCODE,
+        ("Failed to acquire encoded image"), (NULL));
     FreeImage_CloseMemory (hmem);
-    gst_buffer_unref (buffer);
+    gst_video_encoder_finish_frame (encoder, frame);
     return GST_FLOW_ERROR;
   }
 
-  buffer_out = gst_buffer_new_and_alloc (size_in_bytes);
+  /* hand the memory stream over to the buffer */
+  frame->output_buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      mem_buffer, size_in_bytes, 0, size_in_bytes, hmem,
+      gst_freeimageenc_close_memory);
+
+  GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+
+  return gst_video_encoder_finish_frame (encoder, frame);
+}
+
+/* Push encoded frames in order until at most @max_pending remain, waiting
+ * for the oldest ones if needed. Called with the stream lock. */
+static GstFlowReturn
+gst_freeimageenc_push_jobs (GstFreeImageEnc * freeimageenc, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstFreeImageEncJob *job;
+
+  g_mutex_lock (&freeimageenc->lock);
+  while (ret == GST_FLOW_OK &&
+      (job = g_queue_peek_head (&freeimageenc->jobs)) != NULL &&
+      (job->done || freeimageenc->jobs.length > max_pending)) {
+    while (!job->done)
+      g_cond_wait (&freeimageenc->cond, &freeimageenc->lock);
+    g_queue_pop_head (&freeimageenc->jobs);
+
+    g_mutex_unlock (&freeimageenc->lock);
+    ret = gst_freeimageenc_finish_job (freeimageenc, job);
+    g_mutex_lock (&freeimageenc->lock);
+  }
+  g_mutex_unlock (&freeimageenc->lock);
+
+  return ret;
+}
+
+static gboolean
+gst_freeimageenc_start (GstVideoEncoder * encoder)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
+  GError *err = NULL;
+  guint n_threads;
+
+  GST_OBJECT_LOCK (freeimageenc);
+  n_threads = freeimageenc->n_threads;
+  GST_OBJECT_UNLOCK (freeimageenc);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  freeimageenc->pool = g_thread_pool_new (gst_freeimageenc_encode_func,
+      freeimageenc, n_threads, TRUE, &err);
+  if (freeimageenc->pool == NULL) {
+    GST_ELEMENT_ERROR (freeimageenc, RESOURCE, FAILED,
+        ("Failed to create encoding threads"), ("%s", err->message));
+    g_error_free (err);
+    return FALSE;
+  }
 
-  /* copy compressed image to buffer */
-  memcpy (GST_BUFFER_DATA (buffer_out), mem_buffer, size_in_bytes);
+  /* keep every thread busy while the streaming thread waits for input */
+  freeimageenc->max_pending = n_threads;
 
-  FreeImage_CloseMemory (hmem);
+  GST_DEBUG_OBJECT (freeimageenc, "encoding with %u threads", n_threads);
 
-  gst_buffer_copy_metadata (buffer_out, buffer, GST_BUFFER_COPY_TIMESTAMPS);
-  gst_buffer_unref (buffer);
-  gst_buffer_set_caps (buffer, GST_PAD_CAPS (freeimageenc->srcpad));
+  return TRUE;
+}
 
-  if ((ret = gst_pad_push (freeimageenc->srcpad, buffer_out)) != GST_FLOW_OK)
-    goto done;
+static gboolean
+gst_freeimageenc_stop (GstVideoEncoder * encoder)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
 
-  //if (pngenc->snapshot) {
-  //  GstEvent *event;
+  GST_LOG_OBJECT (freeimageenc, "cleaning up freeimage structures");
 
-  //  GST_DEBUG_OBJECT (pngenc, "snapshot mode, sending EOS");
-  //  /* send EOS event, since a frame has been pushed out */
-  //  event = gst_event_new_eos ();
+  gst_freeimageenc_discard_jobs (freeimageenc);
 
-  //  gst_pad_push_event (pngenc->srcpad, event);
-  //  ret = GST_FLOW_UNEXPECTED;
-  //}
+  if (freeimageenc->pool) {
+    g_thread_pool_free (freeimageenc->pool, FALSE, TRUE);
+    freeimageenc->pool = NULL;
+  }
 
-done:
-  GST_DEBUG_OBJECT (freeimageenc, "END, ret:%d", ret);
+  gst_freeimageenc_free_dibs (freeimageenc);
 
-  if (buffer_out != NULL) {
-    gst_buffer_unref (buffer_out);
-    buffer_out = NULL;
+  if (freeimageenc->input_state) {
+    gst_video_codec_state_unref (freeimageenc->input_state);
+    freeimageenc->input_state = NULL;
   }
 
-  gst_object_unref (freeimageenc);
-  return ret;
+  return TRUE;
 }
 
 static gboolean
-gst_freeimageenc_sink_setcaps (GstPad * pad, GstCaps * caps)
+gst_freeimageenc_set_format (GstVideoEncoder * encoder,
+    GstVideoCodecState * state)
 {
-  GstFreeImageEnc *freeimageenc;
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
+  GstElementClass *klass = GST_ELEMENT_GET_CLASS (encoder);
+  GstVideoCodecState *output_state;
+  GstCaps *caps;
   FREE_IMAGE_TYPE type;
-  gint width, height, bpp;
-  gint red_mask, green_mask, blue_mask;
+  gint bpp;
+  guint red_mask, green_mask, blue_mask;
 
-  freeimageenc = GST_FREEIMAGEENC (gst_pad_get_parent (pad));
-
-  if (gst_freeimageutils_parse_caps (caps, &type, &width, &height, &bpp,
-          &red_mask, &green_mask, &blue_mask) == FALSE) {
-    GST_DEBUG ("Failed to parse caps");
+  if (!gst_freeimageutils_parse_video_info (&state->info,
+          GST_FREEIMAGEENC_GET_CLASS (freeimageenc)->fif, &type, &bpp,
+          &red_mask, &green_mask, &blue_mask)) {
+    GST_DEBUG_OBJECT (freeimageenc, "Failed to parse caps");
     return FALSE;
   }
 
-  if (freeimageenc->dib) {
-    FreeImage_Unload (freeimageenc->dib);
-    freeimageenc->dib = NULL;
+  /* frames in flight still use the previous format */
+  gst_freeimageenc_push_jobs (freeimageenc, 0);
+  gst_freeimageenc_free_dibs (freeimageenc);
+
+  freeimageenc->dib_type = type;
+  freeimageenc->dib_bpp = bpp;
+  freeimageenc->dib_masks[0] = red_mask;
+  freeimageenc->dib_masks[1] = green_mask;
+  freeimageenc->dib_masks[2] = blue_mask;
+
+  if (freeimageenc->input_state)
+    gst_video_codec_state_unref (freeimageenc->input_state);
+  freeimageenc->input_state = gst_video_codec_state_ref (state);
+
+  if (GST_VIDEO_INFO_FPS_N (&state->info) > 0) {
+    GstClockTime latency = gst_util_uint64_scale (freeimageenc->max_pending,
+        GST_VIDEO_INFO_FPS_D (&state->info) * GST_SECOND,
+        GST_VIDEO_INFO_FPS_N (&state->info));
+    gst_video_encoder_set_latency (encoder, latency, latency);
   }
 
-  freeimageenc->dib = FreeImage_AllocateT (type, width, height, bpp,
-      red_mask, green_mask, blue_mask);
+  caps = gst_pad_template_get_caps (gst_element_class_get_pad_template (klass,
+          "src"));
+  output_state = gst_video_encoder_set_output_state (encoder, caps, state);
+  gst_video_codec_state_unref (output_state);
+
+  return gst_video_encoder_negotiate (encoder);
+}
+
+/* Copy a frame into @dib, inverting scanlines */
+static gboolean
+gst_freeimageenc_fill_dib (GstFreeImageEnc * freeimageenc, FIBITMAP * dib,
+    GstBuffer * buffer)
+{
+  GstVideoInfo *info = &freeimageenc->input_state->info;
+  FREE_IMAGE_TYPE type = FreeImage_GetImageType (dib);
+  guint width = FreeImage_GetWidth (dib);
+  guint height = FreeImage_GetHeight (dib);
+  guint line = FreeImage_GetLine (dib);
+  GstVideoFrame vframe;
+  GstMapInfo minfo;
+  guint8 *src;
+  gint src_stride;
+  guint y;
+
+  if (type == FIT_FLOAT) {
+    /* float images come as non-raw caps with tightly packed rows */
+    if (!gst_buffer_map (buffer, &minfo, GST_MAP_READ))
+      return FALSE;
+
+    if (minfo.size < (gsize) line * height) {
+      gst_buffer_unmap (buffer, &minfo);
+      return FALSE;
+    }
 
-  if (freeimageenc == NULL) {
-    GST_DEBUG ("Failed to allocate memory for DIB");
+    for (y = 0; y < height; ++y) {
+      memcpy (FreeImage_GetScanLine (dib, height - y - 1),
+          minfo.data + y * line, line);
+    }
+
+    gst_buffer_unmap (buffer, &minfo);
+    return TRUE;
+  }
+
+  if (!gst_video_frame_map (&vframe, info, buffer, GST_MAP_READ))
     return FALSE;
+
+  src = GST_VIDEO_FRAME_PLANE_DATA (&vframe, 0);
+  src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&vframe, 0);
+  for (y = 0; y < height; ++y) {
+    BYTE *dst = FreeImage_GetScanLine (dib, height - y - 1);
+
+    if (type == FIT_RGB16 || type == FIT_RGBA16) {
+      gst_freeimageutils_dib_line_from_argb64 ((guint16 *) dst,
+          (const guint16 *) (src + y * src_stride), width,
+          type == FIT_RGBA16);
+    } else {
+      memcpy (dst, src + y * src_stride, line);
+    }
   }
 
-  gst_object_unref (freeimageenc);
+  gst_video_frame_unmap (&vframe);
+
   return TRUE;
 }
 
-/* Clean up the freeimage structures */
-static gboolean
-gst_freeimageenc_freeimage_clear (GstFreeImageEnc * freeimageenc)
+/* Copy and encode one frame, runs on the pool threads */
+static FIMEMORY *
+gst_freeimageenc_encode (GstFreeImageEnc * freeimageenc, GstBuffer * buffer)
 {
-  GST_LOG ("cleaning up freeimage structures");
+  GstFreeImageEncClass *klass = GST_FREEIMAGEENC_GET_CLASS (freeimageenc);
+  GstVideoInfo *info = &freeimageenc->input_state->info;
+  FIMEMORY *hmem = NULL;
+  FIBITMAP *dib;
+
+  g_mutex_lock (&freeimageenc->lock);
+  dib = g_queue_pop_head (&freeimageenc->free_dibs);
+  g_mutex_unlock (&freeimageenc->lock);
+
+  if (dib == NULL) {
+    dib = FreeImage_AllocateT (freeimageenc->dib_type,
+        GST_VIDEO_INFO_WIDTH (info), GST_VIDEO_INFO_HEIGHT (info),
+        freeimageenc->dib_bpp, freeimageenc->dib_masks[0],
+        freeimageenc->dib_masks[1], freeimageenc->dib_masks[2]);
+    if (dib == NULL) {
+      GST_WARNING_OBJECT (freeimageenc, "Failed to allocate memory for DIB");
+      return NULL;
+    }
+  }
+
+  if (!gst_freeimageenc_fill_dib (freeimageenc, dib, buffer)) {
+    GST_WARNING_OBJECT (freeimageenc, "Failed to map input buffer");
+    goto done;
+  }
 
-  if (freeimageenc->dib) {
-    FreeImage_Unload (freeimageenc->dib);
-    freeimageenc->dib = NULL;
+  /* encode raw image to memory */
+  hmem = FreeImage_OpenMemory (0, 0);
+  if (!FreeImage_SaveToMemory (klass->fif, dib, hmem, 0)) {
+    FreeImage_CloseMemory (hmem);
+    hmem = NULL;
   }
 
-  freeimageenc->in_timestamp = GST_CLOCK_TIME_NONE;
-  freeimageenc->in_duration = GST_CLOCK_TIME_NONE;
+done:
+  g_mutex_lock (&freeimageenc->lock);
+  g_queue_push_tail (&freeimageenc->free_dibs, dib);
+  g_mutex_unlock (&freeimageenc->lock);
+
+  return hmem;
+}
+
+static void
+gst_freeimageenc_encode_func (gpointer data, gpointer user_data)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (user_data);
+  GstFreeImageEncJob *job = data;
+  FIMEMORY *hmem;
+
+  hmem = gst_freeimageenc_encode (freeimageenc, job->frame->input_buffer);
+
+  g_mutex_lock (&freeimageenc->lock);
+  job->hmem = hmem;
+  job->done = TRUE;
+  g_cond_broadcast (&freeimageenc->cond);
+  g_mutex_unlock (&freeimageenc->lock);
+}
+
+static GstFlowReturn
+gst_freeimageenc_handle_frame (GstVideoEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
+  GstFreeImageEncJob *job;
+
+  GST_LOG_OBJECT (freeimageenc, "Got buffer, size=%" G_GSIZE_FORMAT,
+      gst_buffer_get_size (frame->input_buffer));
+
+  job = g_slice_new0 (GstFreeImageEncJob);
+  job->frame = frame;
 
-  freeimageenc->setup = FALSE;
+  g_mutex_lock (&freeimageenc->lock);
+  g_queue_push_tail (&freeimageenc->jobs, job);
+  g_mutex_unlock (&freeimageenc->lock);
+
+  g_thread_pool_push (freeimageenc->pool, job, NULL);
+
+  return gst_freeimageenc_push_jobs (freeimageenc, freeimageenc->max_pending);
+}
+
+static GstFlowReturn
+gst_freeimageenc_finish (GstVideoEncoder * encoder)
+{
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
+
+  GST_DEBUG_OBJECT (freeimageenc, "draining %u frames",
+      freeimageenc->jobs.length);
+
+  return gst_freeimageenc_push_jobs (freeimageenc, 0);
+}
+
+static gboolean
+gst_freeimageenc_flush (GstVideoEncoder * encoder)
+{
+  gst_freeimageenc_discard_jobs (GST_FREEIMAGEENC (encoder));
 
   return TRUE;
 }
 
 static gboolean
-gst_freeimageenc_freeimage_init (GstFreeImageEnc * freeimageenc)
+gst_freeimageenc_propose_allocation (GstVideoEncoder * encoder,
+    GstQuery * query)
 {
-  if (freeimageenc->setup)
-    return TRUE;
+  GstFreeImageEnc *freeimageenc = GST_FREEIMAGEENC (encoder);
 
-  GST_LOG ("init freeimage");
+  if (!parent_class->propose_allocation (encoder, query))
+    return FALSE;
 
-  freeimageenc->setup = TRUE;
+  /* the input buffers of the frames being encoded are held until they are
+   * pushed */
+  gst_freeimageutils_query_add_min_buffers (query, freeimageenc->max_pending);
 
   return TRUE;
 }
@@ -373,7 +633,7 @@ gst_freeimageenc_register_plugin (GstPlugin * plugin, FREE_IMAGE_FORMAT fif)
   class_data->fif = fif;
   typeinfo.class_data = class_data;
 
-  type = g_type_register_static (GST_TYPE_ELEMENT, type_name, &typeinfo, 0);
+  type = g_type_register_static (GST_TYPE_VIDEO_ENCODER, type_name, &typeinfo, 0);
   ret = gst_element_register (plugin, type_name, GST_RANK_NONE, type);
 
   g_free (type_name);
@@ -22,6 +22,7 @@
 #define __GST_FREEIMAGEENC_H__
 
 #include <gst/gst.h>
+#include <gst/video/gstvideoencoder.h>
 #include <FreeImage.h>
 
 G_BEGIN_DECLS
@@ -39,39 +40,30 @@ typedef struct _GstFreeImageEncClass GstFreeImageEncClass;
 
 struct _GstFreeImageEnc
 {
-  GstElement element;
+  GstVideoEncoder parent;
 
-  GstPad *sinkpad, *srcpad;
+  /* properties */
+  guint n_threads;
 
-  gboolean need_newsegment;
-  
-  /* Pull range */
-  long offset;
+  GstVideoCodecState *input_state;
 
+  /* layout of the DIBs frames are copied into before encoding */
+  FREE_IMAGE_TYPE dib_type;
+  gint dib_bpp;
+  guint dib_masks[3];
 
-  guint64 in_timestamp;
-  guint64 in_duration;
-
-  gboolean framed;
-
-  gint ret;
-
-  FIBITMAP *dib;
-
-  gboolean setup;
-
-  gint fps_n;
-  gint fps_d;
-
-  gboolean image_ready;
-
-  FreeImageIO fiio;
-  guint64 length;
+  /* frames are encoded by the pool and pushed in input order */
+  GThreadPool *pool;
+  guint max_pending;
+  GMutex lock;
+  GCond cond;
+  GQueue jobs;
+  GQueue free_dibs;
 };
 
 struct _GstFreeImageEncClass
 {
-  GstElementClass parent_class;
+  GstVideoEncoderClass parent_class;
 
   FREE_IMAGE_FORMAT fif;
 };
@@ -1,18 +1,13 @@
-#include <gst/video/video.h>
-
 #include "gstfreeimageutils.h"
 
-GstCaps *
-gst_freeimageutils_caps_from_dib (FIBITMAP * dib, gint fps_n, gint fps_d)
+GstVideoFormat
+gst_freeimageutils_video_format_from_dib (FIBITMAP * dib)
 {
   FREE_IMAGE_TYPE image_type;
   guint width, height, bpp;
-  gint video_format = -1;
-  GstCaps *caps = NULL;
-  gint endianness;
 
   if (dib == NULL)
-    return NULL;
+    return GST_VIDEO_FORMAT_UNKNOWN;
 
   /* Get bits per channel */
   bpp = FreeImage_GetBPP (dib);
@@ -28,176 +23,192 @@ gst_freeimageutils_caps_from_dib (FIBITMAP * dib, gint fps_n, gint fps_d)
 
   switch (image_type) {
     case FIT_BITMAP:
-      if (bpp == 24) {
-        if (FreeImage_GetRedMask (dib) == GST_VIDEO_BYTE1_MASK_24_INT &&
-            FreeImage_GetGreenMask (dib) == GST_VIDEO_BYTE2_MASK_24_INT &&
-            FreeImage_GetBlueMask (dib) == GST_VIDEO_BYTE3_MASK_24_INT) {
-          video_format = GST_VIDEO_FORMAT_RGB;
-        } else if (FreeImage_GetRedMask (dib) == GST_VIDEO_BYTE3_MASK_24_INT &&
-            FreeImage_GetGreenMask (dib) == GST_VIDEO_BYTE2_MASK_24_INT &&
-            FreeImage_GetBlueMask (dib) == GST_VIDEO_BYTE1_MASK_24_INT) {
-          video_format = GST_VIDEO_FORMAT_BGR;
-        } else {
-          return NULL;
+      if (bpp == 8) {
+        /* only a linear grayscale palette can be passed through as is */
+        if (FreeImage_GetColorType (dib) == FIC_MINISBLACK)
+          return GST_VIDEO_FORMAT_GRAY8;
+      } else if (bpp == 24 || bpp == 32) {
+        if (FreeImage_GetRedMask (dib) == FI_RGBA_RED_MASK &&
+            FreeImage_GetGreenMask (dib) == FI_RGBA_GREEN_MASK &&
+            FreeImage_GetBlueMask (dib) == FI_RGBA_BLUE_MASK) {
+          return gst_video_format_from_string (bpp == 24 ?
+              GST_FREEIMAGE_FORMAT_24 : GST_FREEIMAGE_FORMAT_32);
         }
-      } else if (bpp == 32) {
-        if (FreeImage_GetRedMask (dib) == GST_VIDEO_BYTE1_MASK_32_INT &&
-            FreeImage_GetGreenMask (dib) == GST_VIDEO_BYTE2_MASK_32_INT &&
-            FreeImage_GetBlueMask (dib) == GST_VIDEO_BYTE3_MASK_32_INT) {
-          video_format = GST_VIDEO_FORMAT_RGBA;
-        } else if (FreeImage_GetRedMask (dib) == GST_VIDEO_BYTE3_MASK_32_INT &&
-            FreeImage_GetGreenMask (dib) == GST_VIDEO_BYTE2_MASK_32_INT &&
-            FreeImage_GetBlueMask (dib) == GST_VIDEO_BYTE1_MASK_32_INT) {
-          video_format = GST_VIDEO_FORMAT_BGRA;
-        } else {
-          return NULL;
-        }
-      } else {
-        return NULL;
-      }
-
-      /* We could not find a supported format */
-      if (video_format == -1) {
-        caps = NULL;
-      } else {
-        caps = gst_video_format_new_caps (video_format, width, height,
-            fps_n, fps_d, 1, 1);
       }
       break;
     case FIT_UINT16:
-      endianness = G_BYTE_ORDER;
-
-      caps = gst_caps_new_simple ("video/x-raw-gray",
-          "width", G_TYPE_INT, width,
-          "height", G_TYPE_INT, height,
-          "bpp", G_TYPE_INT, 16,
-          "depth", G_TYPE_INT, 16,
-          "endianness", G_TYPE_INT, endianness,
-          "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
-      break;
-    case FIT_INT16:
-      endianness = G_BYTE_ORDER;
-
-      caps = gst_caps_new_simple ("video/x-raw-gray",
-          "width", G_TYPE_INT, width,
-          "height", G_TYPE_INT, height,
-          "bpp", G_TYPE_INT, 16,
-          "depth", G_TYPE_INT, 16,
-          "endianness", G_TYPE_INT, endianness,
-          "framerate", GST_TYPE_FRACTION, fps_n, fps_d,
-          "signed", G_TYPE_BOOLEAN, TRUE, NULL);
-      break;
+      return gst_video_format_from_string (GST_FREEIMAGE_FORMAT_GRAY16);
+    case FIT_RGB16:
+    case FIT_RGBA16:
+      return GST_VIDEO_FORMAT_ARGB64;
+    case FIT_FLOAT:
+      /* see GST_FREEIMAGE_GRAY_FLOAT_CAPS */
+      return GST_VIDEO_FORMAT_ENCODED;
     default:
-      caps = NULL;
+      break;
   }
-  return caps;
+
+  /* We could not find a supported format */
+  return GST_VIDEO_FORMAT_UNKNOWN;
 }
 
 GstCaps *
 gst_freeimageutils_caps_from_freeimage_format (FREE_IMAGE_FORMAT fif)
 {
-  GstCaps *caps = gst_caps_new_empty ();
+  GString *formats = g_string_new (NULL);
+  GstCaps *caps;
+  gchar *str;
 
   if (FreeImage_FIFSupportsExportType (fif, FIT_BITMAP)) {
-    if (FreeImage_FIFSupportsExportBPP (fif, 1) ||
-        FreeImage_FIFSupportsExportBPP (fif, 4) ||
-        FreeImage_FIFSupportsExportBPP (fif, 8) ||
-        FreeImage_FIFSupportsExportBPP (fif, 24)) {
-      if (G_BYTE_ORDER == G_LITTLE_ENDIAN) {
-        gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_BGR));
-      } else {
-        gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGB));
-      }
+    if (FreeImage_FIFSupportsExportBPP (fif, 8))
+      g_string_append (formats, "GRAY8, ");
+    if (FreeImage_FIFSupportsExportBPP (fif, 24))
+      g_string_append (formats, GST_FREEIMAGE_FORMAT_24 ", ");
+    if (FreeImage_FIFSupportsExportBPP (fif, 32))
+      g_string_append (formats, GST_FREEIMAGE_FORMAT_32 ", ");
+  }
+  if (FreeImage_FIFSupportsExportType (fif, FIT_UINT16))
+    g_string_append (formats, GST_FREEIMAGE_FORMAT_GRAY16 ", ");
+  if (FreeImage_FIFSupportsExportType (fif, FIT_RGB16) ||
+      FreeImage_FIFSupportsExportType (fif, FIT_RGBA16))
+    g_string_append (formats, "ARGB64, ");
 
-    }
-    if (FreeImage_FIFSupportsExportBPP (fif, 16)) {
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGB_15));
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGB_16));
-    }
-    if (FreeImage_FIFSupportsExportBPP (fif, 32)) {
-      if (G_BYTE_ORDER == G_LITTLE_ENDIAN) {
-        gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_BGRA));
-      } else {
-        gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGBA));
-      }
+  /* non-standard format, we'll try and convert to RGB */
+  if (formats->len == 0)
+    g_string_append (formats,
+        GST_FREEIMAGE_FORMAT_24 ", " GST_FREEIMAGE_FORMAT_32 ", ");
+
+  /* strip the trailing separator */
+  g_string_truncate (formats, formats->len - 2);
 
+  str = g_strdup_printf (GST_VIDEO_CAPS_MAKE ("{ %s }"), formats->str);
+  caps = gst_caps_from_string (str);
+  g_free (str);
+  g_string_free (formats, TRUE);
+
+  if (FreeImage_FIFSupportsExportType (fif, FIT_FLOAT))
+    gst_caps_append (caps,
+        gst_caps_from_string (GST_FREEIMAGE_GRAY_FLOAT_CAPS));
+
+  return caps;
+}
+
+gboolean
+gst_freeimageutils_parse_video_info (const GstVideoInfo * info,
+    FREE_IMAGE_FORMAT fif, FREE_IMAGE_TYPE * type, gint * bpp,
+    guint * red_mask, guint * green_mask, guint * blue_mask)
+{
+  GstVideoFormat format = GST_VIDEO_INFO_FORMAT (info);
+
+  *type = FIT_BITMAP;
+  *red_mask = *green_mask = *blue_mask = 0;
+
+  if (format == GST_VIDEO_FORMAT_GRAY8) {
+    /* FreeImage gives 8-bit bitmaps a grayscale palette */
+    *bpp = 8;
+  } else if (format == gst_video_format_from_string (GST_FREEIMAGE_FORMAT_24)
+      || format == gst_video_format_from_string (GST_FREEIMAGE_FORMAT_32)) {
+    *bpp = GST_VIDEO_INFO_COMP_PSTRIDE (info, 0) * 8;
+    *red_mask = FI_RGBA_RED_MASK;
+    *green_mask = FI_RGBA_GREEN_MASK;
+    *blue_mask = FI_RGBA_BLUE_MASK;
+  } else if (format ==
+      gst_video_format_from_string (GST_FREEIMAGE_FORMAT_GRAY16)) {
+    *type = FIT_UINT16;
+    *bpp = 16;
+  } else if (format == GST_VIDEO_FORMAT_ARGB64) {
+    /* keep alpha if the format can store it */
+    if (FreeImage_FIFSupportsExportType (fif, FIT_RGBA16)) {
+      *type = FIT_RGBA16;
+      *bpp = 64;
+    } else {
+      *type = FIT_RGB16;
+      *bpp = 48;
     }
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_UINT16)) {
-    if (G_BYTE_ORDER == G_BIG_ENDIAN)
-      gst_caps_append (caps,
-          gst_caps_from_string (GST_VIDEO_CAPS_GRAY16 ("BIG_ENDIAN")));
-    else
-      gst_caps_append (caps,
-          gst_caps_from_string (GST_VIDEO_CAPS_GRAY16 ("LITTLE_ENDIAN")));
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_INT16)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_UINT32)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_INT32)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_FLOAT)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_DOUBLE)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_COMPLEX)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_RGB16)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_RGBA16)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_RGBF)) {
-  }
-  if (FreeImage_FIFSupportsExportType (fif, FIT_RGBAF)) {
+  } else if (format == GST_VIDEO_FORMAT_ENCODED) {
+    /* the only non-raw caps we accept are GST_FREEIMAGE_GRAY_FLOAT_CAPS */
+    *type = FIT_FLOAT;
+    *bpp = 32;
+  } else {
+    return FALSE;
   }
 
-  /* non-standard format, we'll try and convert to RGB */
-  if (gst_caps_get_size (caps) == 0) {
-    if (G_BYTE_ORDER == G_LITTLE_ENDIAN) {
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_BGR));
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_BGRA));
-    } else {
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGB));
-      gst_caps_append (caps, gst_caps_from_string (GST_VIDEO_CAPS_RGBA));
+  return TRUE;
+}
+
+/* FreeImage stores 16-bit color as R, G, B[, A], GStreamer as A, R, G, B */
+void
+gst_freeimageutils_argb64_from_dib_line (guint16 * dst, const guint16 * src,
+    gint width, gboolean has_alpha)
+{
+  gint x;
+
+  if (has_alpha) {
+    for (x = 0; x < width; x++) {
+      dst[4 * x + 0] = src[4 * x + 3];
+      dst[4 * x + 1] = src[4 * x + 0];
+      dst[4 * x + 2] = src[4 * x + 1];
+      dst[4 * x + 3] = src[4 * x + 2];
+    }
+  } else {
+    for (x = 0; x < width; x++) {
+      dst[4 * x + 0] = 0xffff;
+      dst[4 * x + 1] = src[3 * x + 0];
+      dst[4 * x + 2] = src[3 * x + 1];
+      dst[4 * x + 3] = src[3 * x + 2];
     }
   }
+}
 
-  return caps;
+void
+gst_freeimageutils_dib_line_from_argb64 (guint16 * dst, const guint16 * src,
+    gint width, gboolean has_alpha)
+{
+  gint x;
+
+  if (has_alpha) {
+    for (x = 0; x < width; x++) {
+      dst[4 * x + 0] = src[4 * x + 1];
+      dst[4 * x + 1] = src[4 * x + 2];
+      dst[4 * x + 2] = src[4 * x + 3];
+      dst[4 * x + 3] = src[4 * x + 0];
+    }
+  } else {
+    for (x = 0; x < width; x++) {
+      dst[3 * x + 0] = src[4 * x + 1];
+      dst[3 * x + 1] = src[4 * x + 2];
+      dst[3 * x + 2] = src[4 * x + 3];
+    }
+  }
 }
 
-gboolean
-gst_freeimageutils_parse_caps (const GstCaps * caps, FREE_IMAGE_TYPE * type,
-    gint * width, gint * height, gint * bpp, guint32 * red_mask,
-    guint32 * green_mask, guint32 * blue_mask)
+/* Raise the minimum number of buffers of the pools in an allocation query
+ * by @extra, for elements holding on to that many input buffers, so an
+ * upstream pool of fixed size can't run dry while they do */
+void
+gst_freeimageutils_query_add_min_buffers (GstQuery * query, guint extra)
 {
-  GstStructure *s;
-
-  s = gst_caps_get_structure (caps, 0);
-
-  gst_structure_get_int (s, "width", width);
-  gst_structure_get_int (s, "height", height);
-  gst_structure_get_int (s, "bpp", bpp);
-
-  if (g_strcmp0 (gst_structure_get_name (s), "video/x-raw-rgb") == 0) {
-    *type = FIT_BITMAP;
-    gst_structure_get_int (s, "red_mask", red_mask);
-    gst_structure_get_int (s, "green_mask", green_mask);
-    gst_structure_get_int (s, "blue_mask", blue_mask);
-  } else if (g_strcmp0 (gst_structure_get_name (s), "video/x-raw-gray") == 0) {
-    gboolean is_signed;
-    if (!gst_structure_get_boolean (s, "signed", &is_signed))
-      is_signed = FALSE;
-
-    if (*bpp == 8)
-      *type = FIT_BITMAP;       /* need to create palette for this later */
-    else if (*bpp == 16 && is_signed == FALSE)
-      *type = FIT_UINT16;
-    else if (*bpp == 16 && is_signed == TRUE)
-      *type = FIT_INT16;
-    else
-      return FALSE;
+  guint i, n_pools, size, min, max;
+  GstBufferPool *pool;
+
+  n_pools = gst_query_get_n_allocation_pools (query);
+  if (n_pools == 0) {
+    GstCaps *caps;
+    GstVideoInfo info;
+
+    gst_query_parse_allocation (query, &caps, NULL);
+    size = caps && gst_video_info_from_caps (&info, caps) ? info.size : 0;
+    gst_query_add_allocation_pool (query, NULL, size, extra, 0);
+    return;
   }
 
-  return TRUE;
+  for (i = 0; i < n_pools; i++) {
+    gst_query_parse_nth_allocation_pool (query, i, &pool, &size, &min, &max);
+    min += extra;
+    if (max != 0 && max < min)
+      max = min;
+    gst_query_set_nth_allocation_pool (query, i, pool, size, min, max);
+    if (pool)
+      gst_object_unref (pool);
+  }
 }
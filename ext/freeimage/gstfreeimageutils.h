@@ -2,15 +2,54 @@
 #define __GST_FREEIMAGEUTILS_H__
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
 #include <FreeImage.h>
 
-GstCaps * gst_freeimageutils_caps_from_dib (FIBITMAP * dib,
-    gint fps_n, gint fps_d);
+/* formats matching the in-memory layout of FreeImage bitmaps */
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+#define GST_FREEIMAGE_FORMAT_24 "BGR"
+#define GST_FREEIMAGE_FORMAT_32 "BGRA"
+#else
+#define GST_FREEIMAGE_FORMAT_24 "RGB"
+#define GST_FREEIMAGE_FORMAT_32 "RGBA"
+#endif
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define GST_FREEIMAGE_FORMAT_GRAY16 "GRAY16_LE"
+#define GST_FREEIMAGE_FORMAT_GRAY32F "GRAY32F_LE"
+#else
+#define GST_FREEIMAGE_FORMAT_GRAY16 "GRAY16_BE"
+#define GST_FREEIMAGE_FORMAT_GRAY32F "GRAY32F_BE"
+#endif
+
+#define GST_FREEIMAGE_VIDEO_FORMATS "{ " GST_FREEIMAGE_FORMAT_24 ", " \
+    GST_FREEIMAGE_FORMAT_32 ", GRAY8, " GST_FREEIMAGE_FORMAT_GRAY16 \
+    ", ARGB64 }"
+
+/* FIT_FLOAT has no raw video format, so it is carried as its own media
+ * type, which GstVideoInfo parses as GST_VIDEO_FORMAT_ENCODED. Rows are
+ * tightly packed native endian floats. */
+#define GST_FREEIMAGE_GRAY_FLOAT_MEDIA_TYPE "video/x-raw-gray-float"
+#define GST_FREEIMAGE_GRAY_FLOAT_CAPS GST_FREEIMAGE_GRAY_FLOAT_MEDIA_TYPE \
+    ", format = (string) " GST_FREEIMAGE_FORMAT_GRAY32F ", " \
+    "width = " GST_VIDEO_SIZE_RANGE ", " \
+    "height = " GST_VIDEO_SIZE_RANGE ", " \
+    "framerate = " GST_VIDEO_FPS_RANGE
+
+GstVideoFormat gst_freeimageutils_video_format_from_dib (FIBITMAP * dib);
 GstCaps * gst_freeimageutils_caps_from_freeimage_format (
     FREE_IMAGE_FORMAT fif);
 
-gboolean gst_freeimageutils_parse_caps (const GstCaps * caps,
-    FREE_IMAGE_TYPE * type, gint * width, gint * height, gint * bpp,
-    unsigned * red_mask, unsigned * green_mask, unsigned * blue_mask);
- 
-#endif // __GST_FREEIMAGEUTILS_H__
\ No newline at end of file
+gboolean gst_freeimageutils_parse_video_info (const GstVideoInfo * info,
+    FREE_IMAGE_FORMAT fif, FREE_IMAGE_TYPE * type, gint * bpp,
+    guint * red_mask, guint * green_mask, guint * blue_mask);
+
+void gst_freeimageutils_argb64_from_dib_line (guint16 * dst,
+    const guint16 * src, gint width, gboolean has_alpha);
+void gst_freeimageutils_dib_line_from_argb64 (guint16 * dst,
+    const guint16 * src, gint width, gboolean has_alpha);
+
+void gst_freeimageutils_query_add_min_buffers (GstQuery * query,
+    guint extra);
+
+#endif // __GST_FREEIMAGEUTILS_H__
@@ -0,0 +1,1050 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+* SECTION:element-multitiffsink
+*
+* Appends every frame as a page of a single uncompressed multi-page TIFF,
+* for capturing high frame rate bursts to disk.
+*
+* Frames are handed to a dedicated writer thread through a queue of
+* #GstMultiTiffSink:queue-size frames, and written with a single large
+* write each, starting at multiples of #GstMultiTiffSink:alignment bytes.
+* The image file directories (IFDs) indexing the pages are collected and
+* written in batches of #GstMultiTiffSink:ifd-batch, so the file is not
+* revisited for every frame. File space is reserved
+* #GstMultiTiffSink:preallocate bytes at a time, and the file is trimmed
+* to its final size when stopped. BigTIFF is written by default, classic
+* TIFF is limited to 4 GiB.
+*
+* Pages that weren't indexed yet are lost if the application crashes, at
+* most #GstMultiTiffSink:ifd-batch of them.
+*
+* Each page stores its buffer timestamp in nanoseconds as an ASCII string
+* in private tag 65000, and the KLV metadata attached to the buffer, if
+* any, in private tag 65001.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch-1.0 videotestsrc ! video/x-raw,format=GRAY16_LE ! multitiffsink location=burst.tif
+* ]|
+* </refsect2>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#define tiff_lseek _lseeki64
+#define tiff_write(fd, data, size) \
+  _write (fd, data, (unsigned int) MIN (size, G_MAXINT))
+#else
+#include <unistd.h>
+#define tiff_lseek lseek
+#define tiff_write write
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "gstmultitiffsink.h"
+#include "gstfreeimageutils.h"
+
+#ifdef GST_PLUGINS_VISION_ENABLE_KLV
+#include "klv.h"
+#endif
+
+/* TIFF field types */
+#define TIFF_ASCII 2
+#define TIFF_SHORT 3
+#define TIFF_LONG 4
+#define TIFF_UNDEFINED 7
+#define TIFF_LONG8 16
+
+/* private tags */
+#define TIFFTAG_GST_TIMESTAMP 65000
+#define TIFFTAG_GST_KLV 65001
+
+/* tags written for every page, besides the private ones */
+#define N_BASE_ENTRIES 12
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_BIGTIFF,
+  PROP_PREALLOCATE,
+  PROP_IFD_BATCH,
+  PROP_ALIGNMENT,
+  PROP_QUEUE_SIZE,
+  PROP_LAST
+};
+
+#define DEFAULT_PROP_LOCATION NULL
+#define DEFAULT_PROP_BIGTIFF TRUE
+#define DEFAULT_PROP_PREALLOCATE (64 * 1024 * 1024)
+#define DEFAULT_PROP_IFD_BATCH 64
+#define DEFAULT_PROP_ALIGNMENT 4096
+#define DEFAULT_PROP_QUEUE_SIZE 32
+
+/* a frame on its way to the file */
+typedef struct
+{
+  GstBuffer *buffer;
+  GstVideoInfo info;
+  GstClockTime pts;
+  GBytes *klv;
+
+  guint64 strip_offset;
+  guint64 strip_size;
+} GstMultiTiffSinkPage;
+
+/* the capabilities of the inputs and outputs */
+static GstStaticPadTemplate gst_multi_tiff_sink_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, "
+            GST_FREEIMAGE_FORMAT_GRAY16 " }"))
+    );
+
+/* GObject vmethod declarations */
+static void gst_multi_tiff_sink_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_multi_tiff_sink_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
+static void gst_multi_tiff_sink_finalize (GObject * object);
+
+/* GstBaseSink vmethod declarations */
+static gboolean gst_multi_tiff_sink_start (GstBaseSink * basesink);
+static gboolean gst_multi_tiff_sink_stop (GstBaseSink * basesink);
+static gboolean gst_multi_tiff_sink_set_caps (GstBaseSink * basesink,
+    GstCaps * caps);
+static gboolean gst_multi_tiff_sink_event (GstBaseSink * basesink,
+    GstEvent * event);
+static GstFlowReturn gst_multi_tiff_sink_render (GstBaseSink * basesink,
+    GstBuffer * buffer);
+static gboolean gst_multi_tiff_sink_unlock (GstBaseSink * basesink);
+static gboolean gst_multi_tiff_sink_unlock_stop (GstBaseSink * basesink);
+static gboolean gst_multi_tiff_sink_propose_allocation (GstBaseSink *
+    basesink, GstQuery * query);
+
+/* GstMultiTiffSink method declarations */
+static gpointer gst_multi_tiff_sink_writer (gpointer data);
+static GstFlowReturn gst_multi_tiff_sink_write_ifds (GstMultiTiffSink * sink);
+
+/* setup debug */
+GST_DEBUG_CATEGORY_STATIC (multi_tiff_sink_debug);
+#define GST_CAT_DEFAULT multi_tiff_sink_debug
+
+G_DEFINE_TYPE (GstMultiTiffSink, gst_multi_tiff_sink, GST_TYPE_BASE_SINK);
+
+/************************************************************************/
+/* GObject vmethod implementations                                      */
+/************************************************************************/
+
+static void
+gst_multi_tiff_sink_class_init (GstMultiTiffSinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *gstbasesink_class = GST_BASE_SINK_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (multi_tiff_sink_debug, "multitiffsink", 0,
+      "Multi-page TIFF sink");
+
+  /* Register GObject vmethods */
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_finalize);
+  gobject_class->set_property =
+      GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_set_property);
+  gobject_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_get_property);
+
+  /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the TIFF file to write", DEFAULT_PROP_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_BIGTIFF,
+      g_param_spec_boolean ("bigtiff", "BigTIFF",
+          "Write BigTIFF, which isn't limited to 4 GiB", DEFAULT_PROP_BIGTIFF,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_PREALLOCATE,
+      g_param_spec_uint64 ("preallocate", "Preallocate",
+          "Bytes of file space to reserve ahead of the written data "
+          "(0 = disabled)", 0, G_MAXINT64, DEFAULT_PROP_PREALLOCATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_IFD_BATCH,
+      g_param_spec_uint ("ifd-batch", "IFD batch",
+          "Number of pages whose directories are written together", 1,
+          G_MAXINT, DEFAULT_PROP_IFD_BATCH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_ALIGNMENT,
+      g_param_spec_uint ("alignment", "Alignment",
+          "Pixel data of every page starts at a multiple of this many bytes",
+          1, G_MAXINT, DEFAULT_PROP_ALIGNMENT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
+      g_param_spec_uint ("queue-size", "Queue size",
+          "Number of frames that can wait for the writer thread", 1,
+          G_MAXINT, DEFAULT_PROP_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_multi_tiff_sink_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Multi-page TIFF sink", "Sink/File",
+      "Streams frames into a multi-page (Big)TIFF file",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  gstbasesink_class->start = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_start);
+  gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_stop);
+  gstbasesink_class->set_caps =
+      GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_set_caps);
+  gstbasesink_class->event = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_event);
+  gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_render);
+  gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_unlock);
+  gstbasesink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_unlock_stop);
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_multi_tiff_sink_propose_allocation);
+}
+
+static void
+gst_multi_tiff_sink_init (GstMultiTiffSink * sink)
+{
+  sink->location = DEFAULT_PROP_LOCATION;
+  sink->bigtiff = DEFAULT_PROP_BIGTIFF;
+  sink->preallocate = DEFAULT_PROP_PREALLOCATE;
+  sink->ifd_batch = DEFAULT_PROP_IFD_BATCH;
+  sink->alignment = DEFAULT_PROP_ALIGNMENT;
+  sink->queue_size = DEFAULT_PROP_QUEUE_SIZE;
+
+  g_mutex_init (&sink->lock);
+  g_cond_init (&sink->cond);
+  g_queue_init (&sink->queue);
+
+  sink->fd = -1;
+
+  gst_base_sink_set_sync (GST_BASE_SINK (sink), FALSE);
+}
+
+static void
+gst_multi_tiff_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (object);
+
+  GST_OBJECT_LOCK (sink);
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_free (sink->location);
+      sink->location = g_value_dup_string (value);
+      break;
+    case PROP_BIGTIFF:
+      sink->bigtiff = g_value_get_boolean (value);
+      break;
+    case PROP_PREALLOCATE:
+      sink->preallocate = g_value_get_uint64 (value);
+      break;
+    case PROP_IFD_BATCH:
+      sink->ifd_batch = g_value_get_uint (value);
+      break;
+    case PROP_ALIGNMENT:
+      sink->alignment = g_value_get_uint (value);
+      break;
+    case PROP_QUEUE_SIZE:
+      sink->queue_size = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (sink);
+}
+
+static void
+gst_multi_tiff_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (object);
+
+  GST_OBJECT_LOCK (sink);
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, sink->location);
+      break;
+    case PROP_BIGTIFF:
+      g_value_set_boolean (value, sink->bigtiff);
+      break;
+    case PROP_PREALLOCATE:
+      g_value_set_uint64 (value, sink->preallocate);
+      break;
+    case PROP_IFD_BATCH:
+      g_value_set_uint (value, sink->ifd_batch);
+      break;
+    case PROP_ALIGNMENT:
+      g_value_set_uint (value, sink->alignment);
+      break;
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint (value, sink->queue_size);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (sink);
+}
+
+static void
+gst_multi_tiff_sink_finalize (GObject * object)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (object);
+
+  g_free (sink->location);
+  g_mutex_clear (&sink->lock);
+  g_cond_clear (&sink->cond);
+
+  G_OBJECT_CLASS (gst_multi_tiff_sink_parent_class)->finalize (object);
+}
+
+/************************************************************************/
+/* GstMultiTiffSink method implementations                              */
+/************************************************************************/
+
+static void
+gst_multi_tiff_sink_clear_page (GstMultiTiffSinkPage * page)
+{
+  if (page->buffer) {
+    gst_buffer_unref (page->buffer);
+    page->buffer = NULL;
+  }
+  if (page->klv) {
+    g_bytes_unref (page->klv);
+    page->klv = NULL;
+  }
+}
+
+static void
+gst_multi_tiff_sink_free_page (GstMultiTiffSinkPage * page)
+{
+  gst_multi_tiff_sink_clear_page (page);
+  g_slice_free (GstMultiTiffSinkPage, page);
+}
+
+static guint64
+gst_multi_tiff_sink_round_up (guint64 offset, guint alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+static gboolean
+gst_multi_tiff_sink_pwrite (GstMultiTiffSink * sink, guint64 offset,
+    const guint8 * data, gsize size)
+{
+  if (tiff_lseek (sink->fd, offset, SEEK_SET) < 0)
+    return FALSE;
+
+  while (size > 0) {
+    gssize written = tiff_write (sink->fd, data, size);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+
+    data += written;
+    size -= written;
+  }
+
+  return TRUE;
+}
+
+/* Make sure file space is reserved up to @end, plus the preallocation */
+static void
+gst_multi_tiff_sink_reserve (GstMultiTiffSink * sink, guint64 end)
+{
+  guint64 size;
+  gint err;
+
+  if (sink->preallocate == 0 || end <= sink->reserved)
+    return;
+
+  size = end - sink->reserved + sink->preallocate;
+
+#if defined (__linux__)
+  err = posix_fallocate (sink->fd, sink->reserved, size);
+#elif defined (G_OS_WIN32)
+  err = _chsize_s (sink->fd, sink->reserved + size);
+#else
+  err = ftruncate (sink->fd, sink->reserved + size) ? errno : 0;
+#endif
+
+  if (err) {
+    GST_WARNING_OBJECT (sink, "Failed to preallocate file space, disabling: "
+        "%s", g_strerror (err));
+    sink->reserved = G_MAXUINT64;
+    return;
+  }
+
+  sink->reserved += size;
+}
+
+static void
+gst_multi_tiff_sink_put (GByteArray * array, gconstpointer data, gsize size)
+{
+  g_byte_array_append (array, data, size);
+}
+
+static void
+gst_multi_tiff_sink_put_offset (GstMultiTiffSink * sink, GByteArray * array,
+    guint64 value)
+{
+  if (sink->bigtiff) {
+    gst_multi_tiff_sink_put (array, &value, 8);
+  } else {
+    guint32 value32 = (guint32) value;
+    gst_multi_tiff_sink_put (array, &value32, 4);
+  }
+}
+
+/* Append an IFD entry to @ifd, values that don't fit in the entry go to
+ * @extra, which will be written at file offset @extra_offset */
+static void
+gst_multi_tiff_sink_put_entry (GstMultiTiffSink * sink, GByteArray * ifd,
+    GByteArray * extra, guint64 extra_offset, guint16 tag, guint16 type,
+    guint64 count, gconstpointer value, gsize size)
+{
+  gsize slot = sink->bigtiff ? 8 : 4;
+
+  gst_multi_tiff_sink_put (ifd, &tag, 2);
+  gst_multi_tiff_sink_put (ifd, &type, 2);
+  gst_multi_tiff_sink_put_offset (sink, ifd, count);
+
+  if (size <= slot) {
+    /* values are left-justified within the entry */
+    guint8 inline_value[8] = { 0, };
+
+    memcpy (inline_value, value, size);
+    gst_multi_tiff_sink_put (ifd, inline_value, slot);
+  } else {
+    gst_multi_tiff_sink_put_offset (sink, ifd, extra_offset + extra->len);
+    gst_multi_tiff_sink_put (extra, value, size);
+
+    /* values must start on a word boundary */
+    if (extra->len & 1)
+      g_byte_array_set_size (extra, extra->len + 1);
+  }
+}
+
+static void
+gst_multi_tiff_sink_put_short (GstMultiTiffSink * sink, GByteArray * ifd,
+    guint16 tag, guint16 value)
+{
+  gst_multi_tiff_sink_put_entry (sink, ifd, NULL, 0, tag, TIFF_SHORT, 1,
+      &value, sizeof (value));
+}
+
+static void
+gst_multi_tiff_sink_put_long (GstMultiTiffSink * sink, GByteArray * ifd,
+    guint16 tag, guint32 value)
+{
+  gst_multi_tiff_sink_put_entry (sink, ifd, NULL, 0, tag, TIFF_LONG, 1,
+      &value, sizeof (value));
+}
+
+static void
+gst_multi_tiff_sink_put_strip (GstMultiTiffSink * sink, GByteArray * ifd,
+    guint16 tag, guint64 value)
+{
+  if (sink->bigtiff) {
+    gst_multi_tiff_sink_put_entry (sink, ifd, NULL, 0, tag, TIFF_LONG8, 1,
+        &value, sizeof (value));
+  } else {
+    gst_multi_tiff_sink_put_long (sink, ifd, tag, (guint32) value);
+  }
+}
+
+static guint
+gst_multi_tiff_sink_n_entries (GstMultiTiffSinkPage * page)
+{
+  return N_BASE_ENTRIES + (GST_CLOCK_TIME_IS_VALID (page->pts) ? 1 : 0) +
+      (page->klv ? 1 : 0);
+}
+
+static guint64
+gst_multi_tiff_sink_ifd_size (GstMultiTiffSink * sink,
+    GstMultiTiffSinkPage * page)
+{
+  guint n = gst_multi_tiff_sink_n_entries (page);
+
+  if (sink->bigtiff)
+    return 8 + 20 * n + 8;
+  else
+    return 2 + 12 * n + 4;
+}
+
+/* Append the IFD of @page, entries must be sorted by tag */
+static void
+gst_multi_tiff_sink_put_ifd (GstMultiTiffSink * sink, GByteArray * ifd,
+    GByteArray * extra, guint64 extra_offset, GstMultiTiffSinkPage * page,
+    guint64 next_ifd)
+{
+  guint32 width = GST_VIDEO_INFO_WIDTH (&page->info);
+  guint32 height = GST_VIDEO_INFO_HEIGHT (&page->info);
+  guint64 n = gst_multi_tiff_sink_n_entries (page);
+
+  if (sink->bigtiff) {
+    gst_multi_tiff_sink_put (ifd, &n, 8);
+  } else {
+    guint16 n16 = (guint16) n;
+    gst_multi_tiff_sink_put (ifd, &n16, 2);
+  }
+
+  /* NewSubfileType: page of a multi-page image */
+  gst_multi_tiff_sink_put_long (sink, ifd, 254, 2);
+  gst_multi_tiff_sink_put_long (sink, ifd, 256, width);
+  gst_multi_tiff_sink_put_long (sink, ifd, 257, height);
+  gst_multi_tiff_sink_put_short (sink, ifd, 258,
+      GST_VIDEO_INFO_COMP_DEPTH (&page->info, 0));
+  /* Compression: none */
+  gst_multi_tiff_sink_put_short (sink, ifd, 259, 1);
+  /* PhotometricInterpretation: BlackIsZero */
+  gst_multi_tiff_sink_put_short (sink, ifd, 262, 1);
+  gst_multi_tiff_sink_put_strip (sink, ifd, 273, page->strip_offset);
+  gst_multi_tiff_sink_put_short (sink, ifd, 277, 1);
+  gst_multi_tiff_sink_put_long (sink, ifd, 278, height);
+  gst_multi_tiff_sink_put_strip (sink, ifd, 279, page->strip_size);
+  /* PlanarConfiguration: contiguous */
+  gst_multi_tiff_sink_put_short (sink, ifd, 284, 1);
+  /* SampleFormat: unsigned integer */
+  gst_multi_tiff_sink_put_short (sink, ifd, 339, 1);
+
+  if (GST_CLOCK_TIME_IS_VALID (page->pts)) {
+    gchar *str = g_strdup_printf ("%" G_GUINT64_FORMAT, page->pts);
+    gsize len = strlen (str) + 1;
+
+    gst_multi_tiff_sink_put_entry (sink, ifd, extra, extra_offset,
+        TIFFTAG_GST_TIMESTAMP, TIFF_ASCII, len, str, len);
+    g_free (str);
+  }
+
+  if (page->klv) {
+    gsize size;
+    gconstpointer data = g_bytes_get_data (page->klv, &size);
+
+    gst_multi_tiff_sink_put_entry (sink, ifd, extra, extra_offset,
+        TIFFTAG_GST_KLV, TIFF_UNDEFINED, size, data, size);
+  }
+
+  gst_multi_tiff_sink_put_offset (sink, ifd, next_ifd);
+}
+
+/* Write the IFDs of all pages written since the last batch in one go, and
+ * link them to the previous batch */
+static GstFlowReturn
+gst_multi_tiff_sink_write_ifds (GstMultiTiffSink * sink)
+{
+  GByteArray *block, *extra, *link;
+  guint64 base, ifds_size, extra_offset, next_ifd;
+  gboolean linked;
+  guint i;
+
+  if (sink->pages->len == 0)
+    return GST_FLOW_OK;
+
+  base = gst_multi_tiff_sink_round_up (sink->offset, 8);
+
+  ifds_size = 0;
+  for (i = 0; i < sink->pages->len; i++)
+    ifds_size += gst_multi_tiff_sink_ifd_size (sink,
+        &g_array_index (sink->pages, GstMultiTiffSinkPage, i));
+  extra_offset = base + ifds_size;
+
+  block = g_byte_array_sized_new ((guint) ifds_size);
+  extra = g_byte_array_new ();
+
+  next_ifd = base;
+  for (i = 0; i < sink->pages->len; i++) {
+    GstMultiTiffSinkPage *page =
+        &g_array_index (sink->pages, GstMultiTiffSinkPage, i);
+
+    next_ifd += gst_multi_tiff_sink_ifd_size (sink, page);
+    gst_multi_tiff_sink_put_ifd (sink, block, extra, extra_offset, page,
+        i + 1 < sink->pages->len ? next_ifd : 0);
+  }
+  g_byte_array_append (block, extra->data, extra->len);
+  g_byte_array_free (extra, TRUE);
+
+  if (!sink->bigtiff && base + block->len > G_MAXUINT32)
+    goto too_large;
+
+  gst_multi_tiff_sink_reserve (sink, base + block->len);
+  if (!gst_multi_tiff_sink_pwrite (sink, base, block->data, block->len))
+    goto write_failed;
+
+  /* point the previous last IFD, or the header, to the batch */
+  link = g_byte_array_sized_new (8);
+  gst_multi_tiff_sink_put_offset (sink, link, base);
+  linked = gst_multi_tiff_sink_pwrite (sink, sink->next_ifd_pos, link->data,
+      link->len);
+  g_byte_array_free (link, TRUE);
+  if (!linked)
+    goto write_failed;
+
+  GST_LOG_OBJECT (sink, "Wrote %u IFDs at offset %" G_GUINT64_FORMAT,
+      sink->pages->len, base);
+
+  sink->next_ifd_pos = extra_offset - (sink->bigtiff ? 8 : 4);
+  sink->offset = base + block->len;
+  g_byte_array_free (block, TRUE);
+  g_array_set_size (sink->pages, 0);
+
+  return GST_FLOW_OK;
+
+too_large:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT,
+        ("File exceeds the 4 GiB limit of classic TIFF, enable bigtiff."),
+        (NULL));
+    g_byte_array_free (block, TRUE);
+    return GST_FLOW_ERROR;
+  }
+write_failed:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+        ("Error while writing to file \"%s\".", sink->location),
+        ("%s", g_strerror (errno)));
+    g_byte_array_free (block, TRUE);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Write the pixel data of @page as a single strip, consumes @page */
+static GstFlowReturn
+gst_multi_tiff_sink_write_page (GstMultiTiffSink * sink,
+    GstMultiTiffSinkPage * page)
+{
+  GstVideoFrame frame;
+  const guint8 *data;
+  guint8 *plane;
+  gsize row_size, size;
+  gint stride, height, y;
+  guint64 offset;
+
+  if (!gst_video_frame_map (&frame, &page->info, page->buffer, GST_MAP_READ))
+    goto map_failed;
+
+  height = GST_VIDEO_FRAME_HEIGHT (&frame);
+  row_size = GST_VIDEO_FRAME_COMP_WIDTH (&frame, 0) *
+      GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, 0);
+  size = row_size * height;
+  plane = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+
+  if ((gsize) stride == row_size) {
+    data = plane;
+  } else {
+    /* strips have no padding between rows */
+    if (sink->scratch_size < size) {
+      g_free (sink->scratch);
+      sink->scratch = g_malloc (size);
+      sink->scratch_size = size;
+    }
+    for (y = 0; y < height; y++)
+      memcpy (sink->scratch + y * row_size, plane + y * stride, row_size);
+    data = sink->scratch;
+  }
+
+  offset = gst_multi_tiff_sink_round_up (sink->offset, sink->alignment);
+  if (!sink->bigtiff && offset + size > G_MAXUINT32) {
+    gst_video_frame_unmap (&frame);
+    goto too_large;
+  }
+
+  gst_multi_tiff_sink_reserve (sink, offset + size);
+  if (!gst_multi_tiff_sink_pwrite (sink, offset, data, size)) {
+    gst_video_frame_unmap (&frame);
+    goto write_failed;
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  page->strip_offset = offset;
+  page->strip_size = size;
+  sink->offset = offset + size;
+  sink->n_pages++;
+
+  /* only the directory entries are kept until the batch is written */
+  gst_buffer_unref (page->buffer);
+  page->buffer = NULL;
+  g_array_append_val (sink->pages, *page);
+  g_slice_free (GstMultiTiffSinkPage, page);
+
+  if (sink->pages->len >= sink->ifd_batch)
+    return gst_multi_tiff_sink_write_ifds (sink);
+
+  return GST_FLOW_OK;
+
+map_failed:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, READ, ("Failed to map buffer"), (NULL));
+    gst_multi_tiff_sink_free_page (page);
+    return GST_FLOW_ERROR;
+  }
+too_large:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT,
+        ("File exceeds the 4 GiB limit of classic TIFF, enable bigtiff."),
+        (NULL));
+    gst_multi_tiff_sink_free_page (page);
+    return GST_FLOW_ERROR;
+  }
+write_failed:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+        ("Error while writing to file \"%s\".", sink->location),
+        ("%s", g_strerror (errno)));
+    gst_multi_tiff_sink_free_page (page);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static gpointer
+gst_multi_tiff_sink_writer (gpointer data)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (data);
+  GstMultiTiffSinkPage *page;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&sink->lock);
+  while (TRUE) {
+    while (sink->queue.length == 0 && !sink->exiting)
+      g_cond_wait (&sink->cond, &sink->lock);
+
+    /* frames still queued when stopping are written before exiting */
+    page = g_queue_pop_head (&sink->queue);
+    if (page == NULL)
+      break;
+
+    sink->busy = TRUE;
+    ret = sink->write_ret;
+    g_cond_broadcast (&sink->cond);
+    g_mutex_unlock (&sink->lock);
+
+    if (ret == GST_FLOW_OK)
+      ret = gst_multi_tiff_sink_write_page (sink, page);
+    else
+      gst_multi_tiff_sink_free_page (page);
+
+    g_mutex_lock (&sink->lock);
+    sink->busy = FALSE;
+    if (ret != GST_FLOW_OK)
+      sink->write_ret = ret;
+    g_cond_broadcast (&sink->cond);
+  }
+  g_mutex_unlock (&sink->lock);
+
+  return NULL;
+}
+
+#ifdef GST_PLUGINS_VISION_ENABLE_KLV
+static GBytes *
+gst_multi_tiff_sink_get_klv (GstBuffer * buffer)
+{
+  GByteArray *klv = NULL;
+  gpointer state = NULL;
+  GstMeta *meta;
+
+  while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+    const guint8 *data;
+    gsize size;
+
+    if (meta->info->api != GST_KLV_META_API_TYPE)
+      continue;
+
+    data = gst_klv_meta_get_data ((GstKLVMeta *) meta, &size);
+    if (klv == NULL)
+      klv = g_byte_array_new ();
+    g_byte_array_append (klv, data, size);
+  }
+
+  return klv ? g_byte_array_free_to_bytes (klv) : NULL;
+}
+#endif
+
+/************************************************************************/
+/* GstBaseSink vmethod implementations                                  */
+/************************************************************************/
+
+static gboolean
+gst_multi_tiff_sink_start (GstBaseSink * basesink)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+  guint8 header[16] = { 0, };
+  guint16 version;
+  gsize header_size;
+  GError *err = NULL;
+
+  if (sink->location == NULL || sink->location[0] == '\0') {
+    GST_ELEMENT_ERROR (sink, RESOURCE, NOT_FOUND,
+        ("No file name specified for writing."), (NULL));
+    return FALSE;
+  }
+
+  sink->fd = g_open (sink->location, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+      0666);
+  if (sink->fd < 0) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE,
+        ("Could not open file \"%s\" for writing.", sink->location),
+        GST_ERROR_SYSTEM);
+    return FALSE;
+  }
+
+  /* pixel data is written as is, so the file uses the host byte order */
+  header[0] = header[1] = G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'I' : 'M';
+  if (sink->bigtiff) {
+    guint16 offset_size = 8;
+
+    version = 43;
+    memcpy (header + 4, &offset_size, 2);
+    sink->next_ifd_pos = 8;
+    header_size = 16;
+  } else {
+    version = 42;
+    sink->next_ifd_pos = 4;
+    header_size = 8;
+  }
+  memcpy (header + 2, &version, 2);
+
+  sink->reserved = 0;
+  gst_multi_tiff_sink_reserve (sink, header_size);
+  if (!gst_multi_tiff_sink_pwrite (sink, 0, header, header_size)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, WRITE,
+        ("Error while writing to file \"%s\".", sink->location),
+        ("%s", g_strerror (errno)));
+    close (sink->fd);
+    sink->fd = -1;
+    return FALSE;
+  }
+
+  sink->offset = header_size;
+  sink->n_pages = 0;
+  sink->pages = g_array_new (FALSE, FALSE, sizeof (GstMultiTiffSinkPage));
+  g_array_set_clear_func (sink->pages,
+      (GDestroyNotify) gst_multi_tiff_sink_clear_page);
+
+  sink->busy = FALSE;
+  sink->exiting = FALSE;
+  sink->write_ret = GST_FLOW_OK;
+
+  sink->thread = g_thread_try_new ("multitiffsink",
+      gst_multi_tiff_sink_writer, sink, &err);
+  if (sink->thread == NULL) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, FAILED,
+        ("Failed to create writer thread"), ("%s", err->message));
+    g_error_free (err);
+    close (sink->fd);
+    sink->fd = -1;
+    g_array_free (sink->pages, TRUE);
+    sink->pages = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_tiff_sink_stop (GstBaseSink * basesink)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  if (sink->thread) {
+    g_mutex_lock (&sink->lock);
+    sink->exiting = TRUE;
+    g_cond_broadcast (&sink->cond);
+    g_mutex_unlock (&sink->lock);
+
+    g_thread_join (sink->thread);
+    sink->thread = NULL;
+  }
+
+  if (sink->fd >= 0) {
+    if (sink->write_ret == GST_FLOW_OK)
+      gst_multi_tiff_sink_write_ifds (sink);
+
+    /* drop the space reserved past the end */
+    if (sink->reserved > sink->offset) {
+#ifdef G_OS_WIN32
+      _chsize_s (sink->fd, sink->offset);
+#else
+      if (ftruncate (sink->fd, sink->offset) != 0)
+        GST_WARNING_OBJECT (sink, "Failed to truncate file: %s",
+            g_strerror (errno));
+#endif
+    }
+
+    GST_DEBUG_OBJECT (sink, "Wrote %" G_GUINT64_FORMAT " pages, %"
+        G_GUINT64_FORMAT " bytes", sink->n_pages, sink->offset);
+
+    close (sink->fd);
+    sink->fd = -1;
+  }
+
+  if (sink->pages) {
+    g_array_free (sink->pages, TRUE);
+    sink->pages = NULL;
+  }
+
+  g_free (sink->scratch);
+  sink->scratch = NULL;
+  sink->scratch_size = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_tiff_sink_set_caps (GstBaseSink * basesink, GstCaps * caps)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  if (!gst_video_info_from_caps (&sink->info, caps)) {
+    GST_ERROR_OBJECT (sink, "Failed to parse caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_tiff_sink_event (GstBaseSink * basesink, GstEvent * event)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    gboolean idle;
+    GstFlowReturn ret;
+
+    g_mutex_lock (&sink->lock);
+    while ((sink->queue.length > 0 || sink->busy) && !sink->flushing)
+      g_cond_wait (&sink->cond, &sink->lock);
+    idle = sink->queue.length == 0 && !sink->busy;
+    ret = sink->write_ret;
+    g_mutex_unlock (&sink->lock);
+
+    /* the writer is idle and nothing else is queued, so index the last
+     * pages here to have a complete file at EOS */
+    if (idle && ret == GST_FLOW_OK)
+      gst_multi_tiff_sink_write_ifds (sink);
+  }
+
+  return GST_BASE_SINK_CLASS (gst_multi_tiff_sink_parent_class)->event
+      (basesink, event);
+}
+
+static GstFlowReturn
+gst_multi_tiff_sink_render (GstBaseSink * basesink, GstBuffer * buffer)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+  GstMultiTiffSinkPage *page;
+  GstFlowReturn ret;
+
+  page = g_slice_new0 (GstMultiTiffSinkPage);
+  page->buffer = gst_buffer_ref (buffer);
+  page->info = sink->info;
+  page->pts = GST_BUFFER_PTS (buffer);
+#ifdef GST_PLUGINS_VISION_ENABLE_KLV
+  page->klv = gst_multi_tiff_sink_get_klv (buffer);
+#endif
+
+  g_mutex_lock (&sink->lock);
+  while (!sink->flushing && sink->write_ret == GST_FLOW_OK &&
+      sink->queue.length >= sink->queue_size)
+    g_cond_wait (&sink->cond, &sink->lock);
+
+  if (sink->flushing)
+    ret = GST_FLOW_FLUSHING;
+  else
+    ret = sink->write_ret;
+
+  if (ret == GST_FLOW_OK) {
+    g_queue_push_tail (&sink->queue, page);
+    g_cond_broadcast (&sink->cond);
+  }
+  g_mutex_unlock (&sink->lock);
+
+  if (ret != GST_FLOW_OK)
+    gst_multi_tiff_sink_free_page (page);
+
+  return ret;
+}
+
+static gboolean
+gst_multi_tiff_sink_unlock (GstBaseSink * basesink)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  g_mutex_lock (&sink->lock);
+  sink->flushing = TRUE;
+  g_cond_broadcast (&sink->cond);
+  g_mutex_unlock (&sink->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_tiff_sink_unlock_stop (GstBaseSink * basesink)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  g_mutex_lock (&sink->lock);
+  sink->flushing = FALSE;
+  g_mutex_unlock (&sink->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_tiff_sink_propose_allocation (GstBaseSink * basesink,
+    GstQuery * query)
+{
+  GstMultiTiffSink *sink = GST_MULTI_TIFF_SINK (basesink);
+
+  /* queued buffers, and the one being written, are held by the writer */
+  gst_freeimageutils_query_add_min_buffers (query, sink->queue_size + 1);
+
+  return TRUE;
+}
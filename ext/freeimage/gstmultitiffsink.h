@@ -0,0 +1,95 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_MULTI_TIFF_SINK_H__
+#define __GST_MULTI_TIFF_SINK_H__
+
+#include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_MULTI_TIFF_SINK \
+  (gst_multi_tiff_sink_get_type())
+#define GST_MULTI_TIFF_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_MULTI_TIFF_SINK,GstMultiTiffSink))
+#define GST_MULTI_TIFF_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_MULTI_TIFF_SINK,GstMultiTiffSinkClass))
+#define GST_IS_MULTI_TIFF_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_MULTI_TIFF_SINK))
+#define GST_IS_MULTI_TIFF_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_MULTI_TIFF_SINK))
+
+typedef struct _GstMultiTiffSink GstMultiTiffSink;
+typedef struct _GstMultiTiffSinkClass GstMultiTiffSinkClass;
+
+/**
+* GstMultiTiffSink:
+* @element: the parent element.
+*
+*
+* The opaque GstMultiTiffSink data structure.
+*/
+struct _GstMultiTiffSink
+{
+  GstBaseSink element;
+
+  /* properties */
+  gchar *location;
+  gboolean bigtiff;
+  guint64 preallocate;
+  guint ifd_batch;
+  guint alignment;
+  guint queue_size;
+
+  /* format of incoming buffers */
+  GstVideoInfo info;
+
+  /* writer thread and the frames waiting for it, under lock */
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  GQueue queue;
+  gboolean busy;
+  gboolean exiting;
+  gboolean flushing;
+  GstFlowReturn write_ret;
+
+  /* file state, only touched by the writer thread while it runs */
+  gint fd;
+  guint64 offset;
+  guint64 reserved;
+  guint64 next_ifd_pos;
+  GArray *pages;
+  guint8 *scratch;
+  gsize scratch_size;
+  guint64 n_pages;
+};
+
+struct _GstMultiTiffSinkClass
+{
+  GstBaseSinkClass parent_class;
+};
+
+GType gst_multi_tiff_sink_get_type(void);
+
+G_END_DECLS
+
+#endif /* __GST_MULTI_TIFF_SINK_H__ */
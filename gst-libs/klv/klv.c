@@ -39,25 +39,92 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gst/tag/tag.h>
 #include "klv.h"
 
 /* We hide the implementation details, so that we have the option to implement
- * different/more efficient storage in future (unfortunately we can't put the
- * data inline with the meta allocation though since it's registered as fixed
- * size, although that could probably be fixed in a backwards compatible way).
- * GBytes means effectively two allocations, one for the GBytes, one for the
- * data. Plus one for the KLV meta struct.
+ * different/more efficient storage in future. The meta is registered with a
+ * fixed size, so small packets (the common case, e.g. a MISB ST 0601 packet
+ * is typically well under 256 bytes) are stored inline in the meta allocation
+ * itself, making attaching KLV a single allocation that GStreamer already
+ * recycles. Larger packets up to GST_KLV_META_POOL_BLOCK_SIZE are copied into
+ * blocks taken from a lock-free free-list, and anything bigger, or data given
+ * to us as GBytes, is referenced through a GBytes as before. A GBytes for
+ * inline or pooled data is only created if someone asks for one.
  *
  * For now we also assume that KLV data is always self-contained and one single
  * chunk of data, but in future we may have use cases where we might want to
  * relax that requirement. */
+#ifndef GST_KLV_META_INLINE_SIZE
+#define GST_KLV_META_INLINE_SIZE 256
+#endif
+
+#ifndef GST_KLV_META_POOL_BLOCK_SIZE
+#define GST_KLV_META_POOL_BLOCK_SIZE 4096
+#endif
+
+#ifndef GST_KLV_META_POOL_MAX_BLOCKS
+#define GST_KLV_META_POOL_MAX_BLOCKS 64
+#endif
+
 typedef struct
 {
   GstKLVMeta klv_meta;
   GBytes *bytes;
+  const guint8 *data;
+  gsize size;
+  gpointer block;
+  guint8 inline_data[GST_KLV_META_INLINE_SIZE];
 } GstKLVMetaImpl;
 
+/* Free-list of GST_KLV_META_POOL_BLOCK_SIZE blocks for packets that don't fit
+ * inline. The count is only used to bound the pool, so it may briefly be off
+ * by a few while blocks are in flight. */
+static GstAtomicQueue *klv_block_pool;
+static volatile gint klv_block_pool_count;
+
+static void
+gst_klv_block_pool_init (void)
+{
+  static volatile gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    klv_block_pool = gst_atomic_queue_new (GST_KLV_META_POOL_MAX_BLOCKS);
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static gpointer
+gst_klv_block_pool_acquire (void)
+{
+  gpointer block;
+
+  gst_klv_block_pool_init ();
+
+  block = gst_atomic_queue_pop (klv_block_pool);
+  if (block != NULL) {
+    g_atomic_int_add (&klv_block_pool_count, -1);
+    return block;
+  }
+
+  return g_malloc (GST_KLV_META_POOL_BLOCK_SIZE);
+}
+
+static void
+gst_klv_block_pool_release (gpointer block)
+{
+  if (g_atomic_int_add (&klv_block_pool_count, 1) >=
+      GST_KLV_META_POOL_MAX_BLOCKS) {
+    g_atomic_int_add (&klv_block_pool_count, -1);
+    g_free (block);
+    return;
+  }
+
+  gst_atomic_queue_push (klv_block_pool, block);
+}
+
 GType
 gst_klv_meta_api_get_type (void)
 {
@@ -77,6 +144,9 @@ gst_klv_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   GstKLVMetaImpl *impl = (GstKLVMetaImpl *) meta;
 
   impl->bytes = NULL;
+  impl->data = NULL;
+  impl->size = 0;
+  impl->block = NULL;
   return TRUE;
 }
 
@@ -85,8 +155,15 @@ gst_klv_meta_clear (GstMeta * meta, GstBuffer * buffer)
 {
   GstKLVMetaImpl *impl = (GstKLVMetaImpl *) meta;
 
-  if (impl->bytes != NULL)
+  if (impl->bytes != NULL) {
     g_bytes_unref (impl->bytes);
+    impl->bytes = NULL;
+  }
+
+  if (impl->block != NULL) {
+    gst_klv_block_pool_release (impl->block);
+    impl->block = NULL;
+  }
 }
 
 static gboolean
@@ -99,7 +176,12 @@ gst_klv_meta_transform (GstBuffer * dest, GstMeta * meta,
   smeta = (GstKLVMetaImpl *) meta;
 
   if (GST_META_TRANSFORM_IS_COPY (type)) {
-    dmeta = gst_buffer_add_klv_meta_from_bytes (dest, smeta->bytes);
+    /* share the GBytes if there is one, inline data is cheap to copy */
+    if (smeta->bytes != NULL)
+      dmeta = gst_buffer_add_klv_meta_from_bytes (dest, smeta->bytes);
+    else
+      dmeta = gst_buffer_add_klv_meta_from_data (dest, smeta->data,
+          smeta->size);
     if (!dmeta)
       return FALSE;
   } else {
@@ -126,6 +208,19 @@ gst_klv_meta_get_info (void)
 
 /* Add KLV meta data to a buffer */
 
+static gboolean
+gst_klv_meta_check_key (gconstpointer data, gsize size)
+{
+  /* KLV coding shall use and only use a fixed 16-byte SMPTE-administered
+   * Universal Label, according to SMPTE 298M as Key (Rec. ITU R-BT.1653-1) */
+  if (!gst_klv_is_universal_key (data, size)) {
+    GST_ERROR ("Trying to attach a invalid KLV meta data to buffer");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static GstKLVMeta *
 gst_buffer_add_klv_meta_internal (GstBuffer * buffer, GBytes * bytes)
 {
@@ -134,11 +229,8 @@ gst_buffer_add_klv_meta_internal (GstBuffer * buffer, GBytes * bytes)
   gconstpointer data;
   gsize size;
 
-  /* KLV coding shall use and only use a fixed 16-byte SMPTE-administered
-   * Universal Label, according to SMPTE 298M as Key (Rec. ITU R-BT.1653-1) */
   data = g_bytes_get_data (bytes, &size);
-  if (size < 16 || GST_READ_UINT32_BE (data) != 0x060E2B34) {
-    GST_ERROR ("Trying to attach a invalid KLV meta data to buffer");
+  if (!gst_klv_meta_check_key (data, size)) {
     g_bytes_unref (bytes);
     return NULL;
   }
@@ -149,6 +241,39 @@ gst_buffer_add_klv_meta_internal (GstBuffer * buffer, GBytes * bytes)
 
   impl = (GstKLVMetaImpl *) meta;
   impl->bytes = bytes;
+  impl->data = data;
+  impl->size = size;
+
+  return meta;
+}
+
+/* Copies @data into the meta, inline or into a pooled block if it fits;
+ * returns NULL without touching @buffer if it doesn't */
+static GstKLVMeta *
+gst_buffer_add_klv_meta_copy_internal (GstBuffer * buffer,
+    const guint8 * data, gsize size)
+{
+  GstKLVMetaImpl *impl;
+  GstKLVMeta *meta;
+
+  if (size > GST_KLV_META_POOL_BLOCK_SIZE)
+    return NULL;
+
+  meta = (GstKLVMeta *) gst_buffer_add_meta (buffer, GST_KLV_META_INFO, NULL);
+
+  GST_TRACE ("Copying %u bytes of KLV data to buffer %p", (guint) size,
+      buffer);
+
+  impl = (GstKLVMetaImpl *) meta;
+  if (size <= GST_KLV_META_INLINE_SIZE) {
+    memcpy (impl->inline_data, data, size);
+    impl->data = impl->inline_data;
+  } else {
+    impl->block = gst_klv_block_pool_acquire ();
+    memcpy (impl->block, data, size);
+    impl->data = impl->block;
+  }
+  impl->size = size;
 
   return meta;
 }
@@ -171,9 +296,18 @@ GstKLVMeta *
 gst_buffer_add_klv_meta_from_data (GstBuffer * buffer, const guint8 * data,
     gsize size)
 {
+  GstKLVMeta *meta;
+
   g_return_val_if_fail (buffer != NULL, NULL);
   g_return_val_if_fail (data != NULL && size > 16, NULL);
 
+  if (!gst_klv_meta_check_key (data, size))
+    return NULL;
+
+  meta = gst_buffer_add_klv_meta_copy_internal (buffer, data, size);
+  if (meta != NULL)
+    return meta;
+
   return gst_buffer_add_klv_meta_internal (buffer, g_bytes_new (data, size));
 }
 
@@ -198,6 +332,16 @@ gst_buffer_add_klv_meta_take_data (GstBuffer * buffer, guint8 * data,
   g_return_val_if_fail (buffer != NULL, NULL);
   g_return_val_if_fail (data != NULL && size > 16, NULL);
 
+  /* a copy into inline storage is cheaper than allocating a GBytes */
+  if (size <= GST_KLV_META_INLINE_SIZE) {
+    GstKLVMeta *meta = NULL;
+
+    if (gst_klv_meta_check_key (data, size))
+      meta = gst_buffer_add_klv_meta_copy_internal (buffer, data, size);
+    g_free (data);
+    return meta;
+  }
+
   return gst_buffer_add_klv_meta_internal (buffer, g_bytes_new_take (data,
           size));
 }
@@ -279,13 +423,18 @@ gst_klv_meta_get_data (GstKLVMeta * klv_meta, gsize * size)
 
   impl = (GstKLVMetaImpl *) klv_meta;
 
-  return g_bytes_get_data (impl->bytes, size);
+  *size = impl->size;
+  return impl->data;
 }
 
 /**
  * gst_klv_meta_get_bytes:
  * @klv_meta: a #GstKLVMeta
  *
+ * If the data is stored inline in the meta, a #GBytes is created on first
+ * call; prefer gst_klv_meta_get_data() where a #GBytes isn't required. Safe
+ * to call concurrently on a meta of a shared buffer.
+ *
  * Returns: (transfer none): the KLV data as a #GBytes
  *
  * Since: 1.16
@@ -294,12 +443,25 @@ GBytes *
 gst_klv_meta_get_bytes (GstKLVMeta * klv_meta)
 {
   GstKLVMetaImpl *impl;
+  GBytes *bytes;
 
   g_return_val_if_fail (klv_meta != NULL, NULL);
 
   impl = (GstKLVMetaImpl *) klv_meta;
 
-  return impl->bytes;
+  bytes = (GBytes *) g_atomic_pointer_get (&impl->bytes);
+  if (bytes != NULL || impl->data == NULL)
+    return bytes;
+
+  /* the meta may be on a shared buffer, so only publish our GBytes if no
+   * other caller got there first */
+  bytes = g_bytes_new (impl->data, impl->size);
+  if (!g_atomic_pointer_compare_and_exchange (&impl->bytes, NULL, bytes)) {
+    g_bytes_unref (bytes);
+    bytes = (GBytes *) g_atomic_pointer_get (&impl->bytes);
+  }
+
+  return bytes;
 }
 
 /* Boxed type, so bindings can use the API */
@@ -310,8 +472,13 @@ gst_klv_meta_copy_boxed (gpointer boxed)
   GstKLVMetaImpl *impl = boxed;
   GstKLVMetaImpl *copy;
 
-  copy = g_new (GstKLVMetaImpl, 1);
-  copy->bytes = impl->bytes ? g_bytes_ref (impl->bytes) : NULL;
+  copy = g_new0 (GstKLVMetaImpl, 1);
+  if (impl->bytes != NULL)
+    copy->bytes = g_bytes_ref (impl->bytes);
+  else if (impl->data != NULL)
+    copy->bytes = g_bytes_new (impl->data, impl->size);
+  if (copy->bytes != NULL)
+    copy->data = g_bytes_get_data (copy->bytes, &copy->size);
   return copy;
 }
 
@@ -328,3 +495,274 @@ gst_klv_meta_free_boxed (gpointer boxed)
 
 G_DEFINE_BOXED_TYPE (GstKLVMeta, gst_klv_meta, gst_klv_meta_copy_boxed,
     gst_klv_meta_free_boxed);
+
+/* Zero-allocation parsing of KLV data */
+
+/**
+ * gst_klv_is_universal_key:
+ * @data: (array length=size): data to check
+ * @size: size of @data in bytes
+ *
+ * Checks whether @data starts with a 16-byte SMPTE-administered Universal
+ * Label (SMPTE 298M), as required for the key of a KLV packet.
+ *
+ * Returns: %TRUE if @data starts with a universal key
+ */
+gboolean
+gst_klv_is_universal_key (const guint8 * data, gsize size)
+{
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+
+  return size >= GST_KLV_UNIVERSAL_KEY_SIZE
+      && GST_READ_UINT32_BE (data) == 0x060E2B34;
+}
+
+/**
+ * gst_klv_parse_ber_length:
+ * @data: (array length=size): data to parse
+ * @size: size of @data in bytes
+ * @length: (out): the decoded length
+ * @length_size: (out) (optional): number of bytes the length was coded in
+ *
+ * Decodes a BER short or long form length. The indefinite form and lengths
+ * that don't fit in a #gsize are rejected.
+ *
+ * Returns: %TRUE if a valid length was decoded
+ */
+gboolean
+gst_klv_parse_ber_length (const guint8 * data, gsize size, gsize * length,
+    guint * length_size)
+{
+  guint n, i;
+  gsize len;
+
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+  g_return_val_if_fail (length != NULL, FALSE);
+
+  if (size < 1)
+    return FALSE;
+
+  /* short form */
+  if (data[0] < 0x80) {
+    *length = data[0];
+    if (length_size)
+      *length_size = 1;
+    return TRUE;
+  }
+
+  /* long form, 0x80 would be the indefinite form which KLV doesn't allow */
+  n = data[0] & 0x7f;
+  if (n == 0 || n > sizeof (gsize) || n >= size)
+    return FALSE;
+
+  len = 0;
+  for (i = 1; i <= n; i++)
+    len = (len << 8) | data[i];
+
+  *length = len;
+  if (length_size)
+    *length_size = n + 1;
+  return TRUE;
+}
+
+/**
+ * gst_klv_parse_ber_oid:
+ * @data: (array length=size): data to parse
+ * @size: size of @data in bytes
+ * @oid: (out): the decoded value
+ * @oid_size: (out) (optional): number of bytes the value was coded in
+ *
+ * Decodes a BER-OID encoded value, as used for local set tags. Values of
+ * more than four bytes (28 bits) are rejected.
+ *
+ * Returns: %TRUE if a valid value was decoded
+ */
+gboolean
+gst_klv_parse_ber_oid (const guint8 * data, gsize size, guint32 * oid,
+    guint * oid_size)
+{
+  guint32 val = 0;
+  guint i;
+
+  g_return_val_if_fail (data != NULL || size == 0, FALSE);
+  g_return_val_if_fail (oid != NULL, FALSE);
+
+  for (i = 0; i < MIN (size, 4); i++) {
+    val = (val << 7) | (data[i] & 0x7f);
+    if ((data[i] & 0x80) == 0) {
+      *oid = val;
+      if (oid_size)
+        *oid_size = i + 1;
+      return TRUE;
+    }
+  }
+
+  /* truncated, or too long */
+  return FALSE;
+}
+
+/**
+ * gst_klv_reader_init:
+ * @reader: a #GstKLVReader
+ * @data: (array length=size): KLV data to parse
+ * @size: size of @data in bytes
+ *
+ * Initializes @reader to parse @data from the start.
+ */
+void
+gst_klv_reader_init (GstKLVReader * reader, const guint8 * data, gsize size)
+{
+  g_return_if_fail (reader != NULL);
+
+  reader->data = data;
+  reader->size = data ? size : 0;
+  reader->offset = 0;
+}
+
+/**
+ * gst_klv_reader_init_from_meta:
+ * @reader: a #GstKLVReader
+ * @klv_meta: a #GstKLVMeta
+ *
+ * Initializes @reader to parse the packets stored in @klv_meta.
+ */
+void
+gst_klv_reader_init_from_meta (GstKLVReader * reader, GstKLVMeta * klv_meta)
+{
+  const guint8 *data;
+  gsize size = 0;
+
+  g_return_if_fail (reader != NULL);
+  g_return_if_fail (klv_meta != NULL);
+
+  data = gst_klv_meta_get_data (klv_meta, &size);
+  gst_klv_reader_init (reader, data, size);
+}
+
+/**
+ * gst_klv_reader_init_local_set:
+ * @reader: a #GstKLVReader
+ * @packet: a #GstKLVPacket containing a local set
+ *
+ * Initializes @reader to parse the tag/value pairs of the local set in the
+ * value of @packet with gst_klv_reader_next_local_item().
+ */
+void
+gst_klv_reader_init_local_set (GstKLVReader * reader,
+    const GstKLVPacket * packet)
+{
+  g_return_if_fail (packet != NULL);
+
+  gst_klv_reader_init (reader, packet->value, packet->length);
+}
+
+/**
+ * gst_klv_reader_get_remaining:
+ * @reader: a #GstKLVReader
+ *
+ * After gst_klv_reader_next_packet() or gst_klv_reader_next_local_item()
+ * returned %FALSE, a non-zero value means the data was truncated or malformed
+ * rather than fully consumed.
+ *
+ * Returns: the number of bytes not parsed yet
+ */
+gsize
+gst_klv_reader_get_remaining (const GstKLVReader * reader)
+{
+  g_return_val_if_fail (reader != NULL, 0);
+
+  return reader->size - reader->offset;
+}
+
+/**
+ * gst_klv_reader_next_packet:
+ * @reader: a #GstKLVReader
+ * @packet: (out caller-allocates): the next packet
+ *
+ * Parses the next universal key packet. Every length is checked against the
+ * available data before anything is read, and @reader is not advanced if the
+ * packet is invalid.
+ *
+ * Returns: %TRUE if a packet was parsed, %FALSE at the end of the data or if
+ *   the next packet is invalid or truncated
+ */
+gboolean
+gst_klv_reader_next_packet (GstKLVReader * reader, GstKLVPacket * packet)
+{
+  const guint8 *data;
+  gsize remaining, length;
+  guint length_size;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+  g_return_val_if_fail (packet != NULL, FALSE);
+
+  data = reader->data + reader->offset;
+  remaining = reader->size - reader->offset;
+
+  if (!gst_klv_is_universal_key (data, remaining))
+    return FALSE;
+
+  if (!gst_klv_parse_ber_length (data + GST_KLV_UNIVERSAL_KEY_SIZE,
+          remaining - GST_KLV_UNIVERSAL_KEY_SIZE, &length, &length_size))
+    return FALSE;
+
+  remaining -= GST_KLV_UNIVERSAL_KEY_SIZE + length_size;
+  if (length > remaining)
+    return FALSE;
+
+  packet->key = data;
+  packet->value = data + GST_KLV_UNIVERSAL_KEY_SIZE + length_size;
+  packet->length = length;
+  packet->data = data;
+  packet->size = GST_KLV_UNIVERSAL_KEY_SIZE + length_size + length;
+
+  reader->offset += packet->size;
+
+  return TRUE;
+}
+
+/**
+ * gst_klv_reader_next_local_item:
+ * @reader: a #GstKLVReader initialized with gst_klv_reader_init_local_set()
+ * @item: (out caller-allocates): the next tag/value pair
+ *
+ * Parses the next BER-OID tag, BER length and value of a local set. Every
+ * length is checked against the available data before anything is read, and
+ * @reader is not advanced if the item is invalid.
+ *
+ * Returns: %TRUE if an item was parsed, %FALSE at the end of the local set or
+ *   if the next item is invalid or truncated
+ */
+gboolean
+gst_klv_reader_next_local_item (GstKLVReader * reader, GstKLVLocalItem * item)
+{
+  const guint8 *data;
+  gsize remaining, length;
+  guint tag_size, length_size;
+  guint32 tag;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+  g_return_val_if_fail (item != NULL, FALSE);
+
+  data = reader->data + reader->offset;
+  remaining = reader->size - reader->offset;
+
+  if (!gst_klv_parse_ber_oid (data, remaining, &tag, &tag_size))
+    return FALSE;
+
+  if (!gst_klv_parse_ber_length (data + tag_size, remaining - tag_size,
+          &length, &length_size))
+    return FALSE;
+
+  remaining -= tag_size + length_size;
+  if (length > remaining)
+    return FALSE;
+
+  item->tag = tag;
+  item->value = data + tag_size + length_size;
+  item->length = length;
+
+  reader->offset += tag_size + length_size + length;
+
+  return TRUE;
+}
@@ -95,6 +95,96 @@ const guint8      * gst_klv_meta_get_data (GstKLVMeta * klv_meta, gsize * size);
 GST_TAG_API
 GBytes            * gst_klv_meta_get_bytes (GstKLVMeta * klv_meta);
 
+/* Zero-allocation parsing of KLV data */
+
+/**
+ * GST_KLV_UNIVERSAL_KEY_SIZE:
+ *
+ * Size in bytes of a SMPTE 336M Universal Label key.
+ */
+#define GST_KLV_UNIVERSAL_KEY_SIZE 16
+
+/**
+ * GstKLVReader:
+ * @data: (array length=size): data being parsed
+ * @size: size of @data in bytes
+ * @offset: current offset into @data
+ *
+ * A cursor over KLV data, used with gst_klv_reader_next_packet() to walk
+ * universal key packets, or with gst_klv_reader_next_local_item() to walk
+ * the tag/value pairs of a local set. Usually allocated on the stack; it
+ * never allocates and only points into the data it was initialized with,
+ * which must stay valid while the reader is in use.
+ */
+typedef struct {
+  const guint8 *data;
+  gsize size;
+  gsize offset;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+} GstKLVReader;
+
+/**
+ * GstKLVPacket:
+ * @key: (array fixed-size=16): the 16-byte universal key
+ * @value: (array length=length): the value
+ * @length: length of @value in bytes
+ * @data: (array length=size): the whole packet, including key and length
+ * @size: size of the whole packet in bytes
+ *
+ * A universal key packet, pointing into the data being parsed.
+ */
+typedef struct {
+  const guint8 *key;
+  const guint8 *value;
+  gsize length;
+  const guint8 *data;
+  gsize size;
+} GstKLVPacket;
+
+/**
+ * GstKLVLocalItem:
+ * @tag: the BER-OID encoded local tag
+ * @value: (array length=length): the value
+ * @length: length of @value in bytes
+ *
+ * A tag/value pair of a local set (e.g. MISB ST 0601), pointing into the data
+ * being parsed.
+ */
+typedef struct {
+  guint32 tag;
+  const guint8 *value;
+  gsize length;
+} GstKLVLocalItem;
+
+GST_TAG_API
+gboolean            gst_klv_is_universal_key (const guint8 * data, gsize size);
+
+GST_TAG_API
+gboolean            gst_klv_parse_ber_length (const guint8 * data, gsize size, gsize * length, guint * length_size);
+
+GST_TAG_API
+gboolean            gst_klv_parse_ber_oid (const guint8 * data, gsize size, guint32 * oid, guint * oid_size);
+
+GST_TAG_API
+void                gst_klv_reader_init (GstKLVReader * reader, const guint8 * data, gsize size);
+
+GST_TAG_API
+void                gst_klv_reader_init_from_meta (GstKLVReader * reader, GstKLVMeta * klv_meta);
+
+GST_TAG_API
+void                gst_klv_reader_init_local_set (GstKLVReader * reader, const GstKLVPacket * packet);
+
+GST_TAG_API
+gsize               gst_klv_reader_get_remaining (const GstKLVReader * reader);
+
+GST_TAG_API
+gboolean            gst_klv_reader_next_packet (GstKLVReader * reader, GstKLVPacket * packet);
+
+GST_TAG_API
+gboolean            gst_klv_reader_next_local_item (GstKLVReader * reader, GstKLVLocalItem * item);
+
 G_END_DECLS
 
 #endif /* __GST_TAG_KLV_H__ */
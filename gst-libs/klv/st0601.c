@@ -0,0 +1,804 @@
+/* GStreamer KLV Metadata Support Library
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:gstklvst0601
+ * @short_description: MISB ST 0601 UAS Datalink Local Set support
+ * @title: MISB ST 0601 support
+ *
+ * <refsect2>
+ * <para>
+ * Typed access to the items of MISB ST 0601 UAS Datalink Local Set packets.
+ * Integer items are mapped to and from their real-world ranges (degrees,
+ * meters, ...) according to a static table of the standard's tags.
+ * </para>
+ * <para>
+ * #GstKLVST0601Decoder locates items lazily, so a consumer only interested
+ * in a couple of tags never walks past them. #GstKLVST0601Encoder keeps the
+ * encoded packet between frames, so updating a few fixed-size items per frame
+ * only rewrites their bytes and adjusts the running checksum.
+ * </para>
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "st0601.h"
+
+/* UAS Datalink Local Set Universal Label */
+static const guint8 st0601_key[GST_KLV_UNIVERSAL_KEY_SIZE] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01,
+  0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+};
+
+/* maximum length of a single item value we support, so lengths are always
+ * coded in BER short form */
+#define ST0601_MAX_VALUE_SIZE 127
+
+typedef enum
+{
+  ST0601_TYPE_RAW,
+  ST0601_TYPE_UINT,
+  ST0601_TYPE_INT,
+  ST0601_TYPE_STRING
+} GstKLVST0601Type;
+
+/* For integer types, min and max give the real-world range the full integer
+ * range is mapped to; signed types map symmetrically to +/-max, with the most
+ * negative integer reserved as an error indicator. min == max means the
+ * integer is used as is. */
+typedef struct
+{
+  const gchar *name;
+  GstKLVST0601Type type;
+  guint size;
+  gdouble min;
+  gdouble max;
+} GstKLVST0601TagInfo;
+
+#define RAW(name) { name, ST0601_TYPE_RAW, 0, 0, 0 }
+#define STR(name) { name, ST0601_TYPE_STRING, 0, 0, 0 }
+#define UINT(name, size, min, max) { name, ST0601_TYPE_UINT, size, min, max }
+#define INT(name, size, max) { name, ST0601_TYPE_INT, size, -(max), max }
+
+/* indexed by tag */
+static const GstKLVST0601TagInfo st0601_tags[] = {
+  RAW (NULL),
+  UINT ("Checksum", 2, 0, 0),
+  UINT ("Precision Time Stamp", 8, 0, 0),
+  STR ("Mission ID"),
+  STR ("Platform Tail Number"),
+  UINT ("Platform Heading Angle", 2, 0, 360),
+  INT ("Platform Pitch Angle", 2, 20),
+  INT ("Platform Roll Angle", 2, 50),
+  UINT ("Platform True Airspeed", 1, 0, 0),
+  UINT ("Platform Indicated Airspeed", 1, 0, 0),
+  STR ("Platform Designation"),
+  STR ("Image Source Sensor"),
+  STR ("Image Coordinate System"),
+  INT ("Sensor Latitude", 4, 90),
+  INT ("Sensor Longitude", 4, 180),
+  UINT ("Sensor True Altitude", 2, -900, 19000),
+  UINT ("Sensor Horizontal Field of View", 2, 0, 180),
+  UINT ("Sensor Vertical Field of View", 2, 0, 180),
+  UINT ("Sensor Relative Azimuth Angle", 4, 0, 360),
+  INT ("Sensor Relative Elevation Angle", 4, 180),
+  UINT ("Sensor Relative Roll Angle", 4, 0, 360),
+  UINT ("Slant Range", 4, 0, 5000000),
+  UINT ("Target Width", 2, 0, 10000),
+  INT ("Frame Center Latitude", 4, 90),
+  INT ("Frame Center Longitude", 4, 180),
+  UINT ("Frame Center Elevation", 2, -900, 19000),
+  INT ("Offset Corner Latitude Point 1", 2, 0.075),
+  INT ("Offset Corner Longitude Point 1", 2, 0.075),
+  INT ("Offset Corner Latitude Point 2", 2, 0.075),
+  INT ("Offset Corner Longitude Point 2", 2, 0.075),
+  INT ("Offset Corner Latitude Point 3", 2, 0.075),
+  INT ("Offset Corner Longitude Point 3", 2, 0.075),
+  INT ("Offset Corner Latitude Point 4", 2, 0.075),
+  INT ("Offset Corner Longitude Point 4", 2, 0.075),
+  UINT ("Icing Detected", 1, 0, 0),
+  UINT ("Wind Direction", 2, 0, 360),
+  UINT ("Wind Speed", 1, 0, 100),
+  UINT ("Static Pressure", 2, 0, 5000),
+  UINT ("Density Altitude", 2, -900, 19000),
+  INT ("Outside Air Temperature", 1, 0),
+  INT ("Target Location Latitude", 4, 90),
+  INT ("Target Location Longitude", 4, 180),
+  UINT ("Target Location Elevation", 2, -900, 19000),
+  UINT ("Target Track Gate Width", 1, 0, 510),
+  UINT ("Target Track Gate Height", 1, 0, 510),
+  UINT ("Target Error Estimate - CE90", 2, 0, 4095),
+  UINT ("Target Error Estimate - LE90", 2, 0, 4095),
+  UINT ("Generic Flag Data", 1, 0, 0),
+  RAW ("Security Local Set"),
+  UINT ("Differential Pressure", 2, 0, 5000),
+  INT ("Platform Angle of Attack", 2, 20),
+  INT ("Platform Vertical Speed", 2, 180),
+  INT ("Platform Sideslip Angle", 2, 20),
+  UINT ("Airfield Barometric Pressure", 2, 0, 5000),
+  UINT ("Airfield Elevation", 2, -900, 19000),
+  UINT ("Relative Humidity", 1, 0, 100),
+  UINT ("Platform Ground Speed", 1, 0, 0),
+  UINT ("Ground Range", 4, 0, 5000000),
+  UINT ("Platform Fuel Remaining", 2, 0, 10000),
+  STR ("Platform Call Sign"),
+  UINT ("Weapon Load", 2, 0, 0),
+  UINT ("Weapon Fired", 1, 0, 0),
+  UINT ("Laser PRF Code", 2, 0, 0),
+  UINT ("Sensor Field of View Name", 1, 0, 0),
+  UINT ("Platform Magnetic Heading", 2, 0, 360),
+  UINT ("UAS Datalink LS Version Number", 1, 0, 0)
+};
+
+#undef RAW
+#undef STR
+#undef UINT
+#undef INT
+
+static const GstKLVST0601TagInfo *
+gst_klv_st0601_get_tag_info (guint tag)
+{
+  if (tag == 0 || tag >= G_N_ELEMENTS (st0601_tags))
+    return NULL;
+
+  return &st0601_tags[tag];
+}
+
+/**
+ * gst_klv_st0601_tag_get_name:
+ * @tag: an ST 0601 local tag
+ *
+ * Returns: the name of @tag, or %NULL if it is not known
+ */
+const gchar *
+gst_klv_st0601_tag_get_name (guint tag)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+
+  return info ? info->name : NULL;
+}
+
+/**
+ * gst_klv_st0601_is_key:
+ * @data: (array length=size): data to check
+ * @size: size of @data in bytes
+ *
+ * Returns: %TRUE if @data starts with the UAS Datalink Local Set key
+ */
+gboolean
+gst_klv_st0601_is_key (const guint8 * data, gsize size)
+{
+  return size >= GST_KLV_UNIVERSAL_KEY_SIZE
+      && memcmp (data, st0601_key, GST_KLV_UNIVERSAL_KEY_SIZE) == 0;
+}
+
+/**
+ * gst_klv_st0601_checksum:
+ * @data: (array length=size): packet data
+ * @size: number of bytes to include, i.e. up to and including the length
+ *   of the checksum item
+ *
+ * Computes the ST 0601 checksum, a 16-bit running sum over the packet.
+ *
+ * Returns: the checksum
+ */
+guint16
+gst_klv_st0601_checksum (const guint8 * data, gsize size)
+{
+  guint16 bcc = 0;
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    bcc += data[i] << (8 * ((i + 1) % 2));
+
+  return bcc;
+}
+
+/**
+ * gst_klv_st0601_verify_checksum:
+ * @data: (array length=size): a complete ST 0601 packet
+ * @size: size of @data in bytes
+ *
+ * Returns: %TRUE if @data ends with a checksum item matching its content
+ */
+gboolean
+gst_klv_st0601_verify_checksum (const guint8 * data, gsize size)
+{
+  if (size < GST_KLV_UNIVERSAL_KEY_SIZE + 1 + 4)
+    return FALSE;
+
+  if (data[size - 4] != GST_KLV_ST0601_TAG_CHECKSUM || data[size - 3] != 2)
+    return FALSE;
+
+  return GST_READ_UINT16_BE (data + size - 2) ==
+      gst_klv_st0601_checksum (data, size - 2);
+}
+
+static guint64
+gst_klv_st0601_read_uint_be (const guint8 * data, gsize size)
+{
+  guint64 val = 0;
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    val = (val << 8) | data[i];
+
+  return val;
+}
+
+static void
+gst_klv_st0601_write_uint_be (guint8 * data, gsize size, guint64 val)
+{
+  while (size--) {
+    data[size] = (guint8) (val & 0xff);
+    val >>= 8;
+  }
+}
+
+/* Decoding */
+
+/**
+ * gst_klv_st0601_decoder_init:
+ * @decoder: a #GstKLVST0601Decoder
+ * @data: (array length=size): data starting with an ST 0601 packet
+ * @size: size of @data in bytes
+ *
+ * Initializes @decoder for the ST 0601 packet at the start of @data. Only the
+ * key and packet length are checked here; use
+ * gst_klv_st0601_verify_checksum() to also check the checksum.
+ *
+ * Returns: %TRUE if @data starts with a complete ST 0601 packet
+ */
+gboolean
+gst_klv_st0601_decoder_init (GstKLVST0601Decoder * decoder,
+    const guint8 * data, gsize size)
+{
+  GstKLVReader reader;
+  GstKLVPacket packet;
+
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (!gst_klv_st0601_is_key (data, size))
+    return FALSE;
+
+  gst_klv_reader_init (&reader, data, size);
+  if (!gst_klv_reader_next_packet (&reader, &packet))
+    return FALSE;
+
+  decoder->data = packet.data;
+  decoder->size = packet.size;
+  gst_klv_reader_init_local_set (&decoder->reader, &packet);
+  memset (decoder->offsets, 0, sizeof (decoder->offsets));
+  memset (decoder->lengths, 0, sizeof (decoder->lengths));
+
+  return TRUE;
+}
+
+/**
+ * gst_klv_st0601_decoder_init_from_meta:
+ * @decoder: a #GstKLVST0601Decoder
+ * @klv_meta: a #GstKLVMeta
+ *
+ * Initializes @decoder for the first ST 0601 packet in @klv_meta.
+ *
+ * Returns: %TRUE if @klv_meta contains an ST 0601 packet
+ */
+gboolean
+gst_klv_st0601_decoder_init_from_meta (GstKLVST0601Decoder * decoder,
+    GstKLVMeta * klv_meta)
+{
+  GstKLVReader reader;
+  GstKLVPacket packet;
+
+  g_return_val_if_fail (decoder != NULL, FALSE);
+  g_return_val_if_fail (klv_meta != NULL, FALSE);
+
+  gst_klv_reader_init_from_meta (&reader, klv_meta);
+  while (gst_klv_reader_next_packet (&reader, &packet)) {
+    if (gst_klv_st0601_is_key (packet.key, GST_KLV_UNIVERSAL_KEY_SIZE))
+      return gst_klv_st0601_decoder_init (decoder, packet.data, packet.size);
+  }
+
+  return FALSE;
+}
+
+/* locate @tag, indexing every item passed on the way */
+static gboolean
+gst_klv_st0601_decoder_find (GstKLVST0601Decoder * decoder, guint tag)
+{
+  GstKLVLocalItem item;
+
+  if (tag == 0 || tag > GST_KLV_ST0601_MAX_TAG)
+    return FALSE;
+
+  if (decoder->offsets[tag])
+    return TRUE;
+
+  while (gst_klv_reader_next_local_item (&decoder->reader, &item)) {
+    if (item.tag == 0 || item.tag > GST_KLV_ST0601_MAX_TAG
+        || decoder->offsets[item.tag])
+      continue;
+
+    decoder->offsets[item.tag] = (guint32) (item.value - decoder->data);
+    decoder->lengths[item.tag] = (guint32) item.length;
+
+    if (item.tag == tag)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+ * gst_klv_st0601_decoder_get_raw:
+ * @decoder: a #GstKLVST0601Decoder
+ * @tag: local tag
+ * @value: (out) (transfer none) (array length=length): the value bytes
+ * @length: (out): length of @value in bytes
+ *
+ * Returns: %TRUE if the packet contains @tag
+ */
+gboolean
+gst_klv_st0601_decoder_get_raw (GstKLVST0601Decoder * decoder, guint tag,
+    const guint8 ** value, gsize * length)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+  g_return_val_if_fail (value != NULL && length != NULL, FALSE);
+
+  if (!gst_klv_st0601_decoder_find (decoder, tag))
+    return FALSE;
+
+  *value = decoder->data + decoder->offsets[tag];
+  *length = decoder->lengths[tag];
+  return TRUE;
+}
+
+/**
+ * gst_klv_st0601_decoder_get_uint64:
+ * @decoder: a #GstKLVST0601Decoder
+ * @tag: local tag of an integer item
+ * @value: (out): the unmapped integer value
+ *
+ * Gets the integer value of @tag as coded, without mapping it to its
+ * real-world range, e.g. for the precision time stamp.
+ *
+ * Returns: %TRUE if the packet contains a valid integer item @tag
+ */
+gboolean
+gst_klv_st0601_decoder_get_uint64 (GstKLVST0601Decoder * decoder, guint tag,
+    guint64 * value)
+{
+  const guint8 *data;
+  gsize length;
+
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  if (!gst_klv_st0601_decoder_get_raw (decoder, tag, &data, &length))
+    return FALSE;
+
+  if (length == 0 || length > 8)
+    return FALSE;
+
+  *value = gst_klv_st0601_read_uint_be (data, length);
+  return TRUE;
+}
+
+/**
+ * gst_klv_st0601_decoder_get_double:
+ * @decoder: a #GstKLVST0601Decoder
+ * @tag: local tag of a known integer item
+ * @value: (out): the value mapped to its real-world range
+ *
+ * Returns: %TRUE if the packet contains a valid item @tag; %FALSE also for
+ *   signed items holding the error indicator
+ */
+gboolean
+gst_klv_st0601_decoder_get_double (GstKLVST0601Decoder * decoder, guint tag,
+    gdouble * value)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+  const guint8 *data;
+  gsize length;
+  guint64 raw;
+  guint bits;
+
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  if (info == NULL || (info->type != ST0601_TYPE_UINT
+          && info->type != ST0601_TYPE_INT))
+    return FALSE;
+
+  if (!gst_klv_st0601_decoder_get_raw (decoder, tag, &data, &length))
+    return FALSE;
+
+  if (length != info->size)
+    return FALSE;
+
+  raw = gst_klv_st0601_read_uint_be (data, length);
+  bits = 8 * info->size;
+
+  if (info->type == ST0601_TYPE_UINT) {
+    if (info->min == info->max)
+      *value = (gdouble) raw;
+    else
+      *value = info->min + (info->max - info->min) * (gdouble) raw /
+          (gdouble) (G_MAXUINT64 >> (64 - bits));
+  } else {
+    gint64 sraw;
+    gint64 smax = (gint64) (G_MAXUINT64 >> (65 - bits));
+
+    /* sign extend */
+    sraw = (gint64) (raw << (64 - bits)) >> (64 - bits);
+    if (info->min == info->max) {
+      *value = (gdouble) sraw;
+    } else {
+      if (sraw < -smax)
+        return FALSE;
+      *value = info->max * (gdouble) sraw / (gdouble) smax;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+ * gst_klv_st0601_decoder_get_string:
+ * @decoder: a #GstKLVST0601Decoder
+ * @tag: local tag of a string item
+ * @str: (out) (transfer none) (array length=length): the string, which is
+ *   not nul-terminated
+ * @length: (out): length of @str in bytes
+ *
+ * Returns: %TRUE if the packet contains @tag
+ */
+gboolean
+gst_klv_st0601_decoder_get_string (GstKLVST0601Decoder * decoder, guint tag,
+    const gchar ** str, gsize * length)
+{
+  return gst_klv_st0601_decoder_get_raw (decoder, tag, (const guint8 **) str,
+      length);
+}
+
+/* Encoding */
+
+typedef struct
+{
+  gboolean set;
+  guint8 length;
+  /* offset of the value in the encoded packet, 0 if not encoded yet */
+  gsize offset;
+  guint8 value[ST0601_MAX_VALUE_SIZE];
+} GstKLVST0601Slot;
+
+struct _GstKLVST0601Encoder
+{
+  GstKLVST0601Slot slots[GST_KLV_ST0601_MAX_TAG + 1];
+
+  guint8 *packet;
+  gsize size;
+  gsize allocated;
+
+  gsize checksum_offset;
+  guint16 checksum;
+
+  /* layout changed, re-encode on next get_data */
+  gboolean dirty;
+};
+
+/**
+ * gst_klv_st0601_encoder_new:
+ *
+ * Returns: (transfer full): a new #GstKLVST0601Encoder with no items set
+ */
+GstKLVST0601Encoder *
+gst_klv_st0601_encoder_new (void)
+{
+  GstKLVST0601Encoder *encoder = g_new0 (GstKLVST0601Encoder, 1);
+
+  encoder->dirty = TRUE;
+
+  return encoder;
+}
+
+/**
+ * gst_klv_st0601_encoder_free:
+ * @encoder: (transfer full): a #GstKLVST0601Encoder
+ */
+void
+gst_klv_st0601_encoder_free (GstKLVST0601Encoder * encoder)
+{
+  if (encoder == NULL)
+    return;
+
+  g_free (encoder->packet);
+  g_free (encoder);
+}
+
+/**
+ * gst_klv_st0601_encoder_set_raw:
+ * @encoder: a #GstKLVST0601Encoder
+ * @tag: local tag, other than the checksum which is always added
+ * @value: (array length=length): the value bytes
+ * @length: length of @value in bytes, at most 127
+ *
+ * Sets the value of @tag. For known fixed-size items @length must match.
+ *
+ * Returns: %TRUE if the value was set
+ */
+gboolean
+gst_klv_st0601_encoder_set_raw (GstKLVST0601Encoder * encoder, guint tag,
+    const guint8 * value, gsize length)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+  GstKLVST0601Slot *slot;
+
+  g_return_val_if_fail (encoder != NULL, FALSE);
+  g_return_val_if_fail (value != NULL || length == 0, FALSE);
+
+  if (tag == 0 || tag > GST_KLV_ST0601_MAX_TAG
+      || tag == GST_KLV_ST0601_TAG_CHECKSUM || length > ST0601_MAX_VALUE_SIZE)
+    return FALSE;
+
+  if (info && info->size && length != info->size)
+    return FALSE;
+
+  slot = &encoder->slots[tag];
+
+  if (slot->set && slot->length == length) {
+    if (memcmp (slot->value, value, length) == 0)
+      return TRUE;
+
+    if (!encoder->dirty && slot->offset) {
+      guint16 checksum = encoder->checksum;
+      gsize i;
+
+      /* patch in place, adjusting the running sum for every changed byte */
+      for (i = 0; i < length; i++) {
+        gsize pos = slot->offset + i;
+        guint shift = 8 * ((pos + 1) % 2);
+
+        checksum -= (guint16) (encoder->packet[pos] << shift);
+        checksum += (guint16) (value[i] << shift);
+        encoder->packet[pos] = value[i];
+      }
+
+      encoder->checksum = checksum;
+      GST_WRITE_UINT16_BE (encoder->packet + encoder->checksum_offset,
+          checksum);
+    }
+  } else {
+    encoder->dirty = TRUE;
+  }
+
+  memcpy (slot->value, value, length);
+  slot->length = (guint8) length;
+  slot->set = TRUE;
+
+  return TRUE;
+}
+
+/**
+ * gst_klv_st0601_encoder_set_uint64:
+ * @encoder: a #GstKLVST0601Encoder
+ * @tag: local tag of a known integer item
+ * @value: the integer value as coded, not mapped to a real-world range
+ *
+ * Returns: %TRUE if the value was set
+ */
+gboolean
+gst_klv_st0601_encoder_set_uint64 (GstKLVST0601Encoder * encoder, guint tag,
+    guint64 value)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+  guint8 data[8];
+
+  if (info == NULL || (info->type != ST0601_TYPE_UINT
+          && info->type != ST0601_TYPE_INT))
+    return FALSE;
+
+  gst_klv_st0601_write_uint_be (data, info->size, value);
+
+  return gst_klv_st0601_encoder_set_raw (encoder, tag, data, info->size);
+}
+
+/**
+ * gst_klv_st0601_encoder_set_double:
+ * @encoder: a #GstKLVST0601Encoder
+ * @tag: local tag of a known integer item
+ * @value: the real-world value, clamped to the range of @tag
+ *
+ * Returns: %TRUE if the value was set
+ */
+gboolean
+gst_klv_st0601_encoder_set_double (GstKLVST0601Encoder * encoder, guint tag,
+    gdouble value)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+  guint bits;
+  guint64 raw;
+
+  if (info == NULL || (info->type != ST0601_TYPE_UINT
+          && info->type != ST0601_TYPE_INT))
+    return FALSE;
+
+  bits = 8 * info->size;
+
+  if (info->type == ST0601_TYPE_UINT) {
+    gdouble max_raw = (gdouble) (G_MAXUINT64 >> (64 - bits));
+    gdouble r;
+
+    if (info->min == info->max)
+      r = value;
+    else
+      r = (value - info->min) / (info->max - info->min) * max_raw;
+
+    r = CLAMP (floor (r + 0.5), 0, max_raw);
+    raw = (guint64) r;
+  } else {
+    gdouble max_raw = (gdouble) (G_MAXUINT64 >> (65 - bits));
+    gdouble r;
+
+    if (info->min == info->max)
+      r = value;
+    else
+      r = value / info->max * max_raw;
+
+    /* the most negative value is the error indicator, never produce it */
+    r = CLAMP (floor (r + 0.5), -max_raw, max_raw);
+    raw = (guint64) (gint64) r;
+  }
+
+  return gst_klv_st0601_encoder_set_uint64 (encoder, tag, raw);
+}
+
+/**
+ * gst_klv_st0601_encoder_set_string:
+ * @encoder: a #GstKLVST0601Encoder
+ * @tag: local tag of a string item
+ * @str: the string, at most 127 bytes
+ *
+ * Returns: %TRUE if the value was set
+ */
+gboolean
+gst_klv_st0601_encoder_set_string (GstKLVST0601Encoder * encoder, guint tag,
+    const gchar * str)
+{
+  const GstKLVST0601TagInfo *info = gst_klv_st0601_get_tag_info (tag);
+
+  g_return_val_if_fail (str != NULL, FALSE);
+
+  if (info && info->type != ST0601_TYPE_STRING)
+    return FALSE;
+
+  return gst_klv_st0601_encoder_set_raw (encoder, tag, (const guint8 *) str,
+      strlen (str));
+}
+
+/**
+ * gst_klv_st0601_encoder_unset:
+ * @encoder: a #GstKLVST0601Encoder
+ * @tag: local tag
+ *
+ * Removes @tag from the packet.
+ */
+void
+gst_klv_st0601_encoder_unset (GstKLVST0601Encoder * encoder, guint tag)
+{
+  g_return_if_fail (encoder != NULL);
+
+  if (tag == 0 || tag > GST_KLV_ST0601_MAX_TAG || !encoder->slots[tag].set)
+    return;
+
+  encoder->slots[tag].set = FALSE;
+  encoder->dirty = TRUE;
+}
+
+static guint
+gst_klv_st0601_tag_size (guint tag)
+{
+  return tag < 0x80 ? 1 : 2;
+}
+
+static void
+gst_klv_st0601_encoder_encode (GstKLVST0601Encoder * encoder)
+{
+  gsize length, total, pos;
+  guint tag;
+
+  /* the checksum item is always last */
+  length = 1 + 1 + 2;
+  for (tag = 2; tag <= GST_KLV_ST0601_MAX_TAG; tag++) {
+    if (encoder->slots[tag].set)
+      length += gst_klv_st0601_tag_size (tag) + 1 + encoder->slots[tag].length;
+  }
+
+  total = GST_KLV_UNIVERSAL_KEY_SIZE + (length < 0x80 ? 1 : 3) + length;
+  if (total > encoder->allocated) {
+    encoder->packet = g_realloc (encoder->packet, total);
+    encoder->allocated = total;
+  }
+
+  memcpy (encoder->packet, st0601_key, GST_KLV_UNIVERSAL_KEY_SIZE);
+  pos = GST_KLV_UNIVERSAL_KEY_SIZE;
+  if (length < 0x80) {
+    encoder->packet[pos++] = (guint8) length;
+  } else {
+    encoder->packet[pos++] = 0x82;
+    GST_WRITE_UINT16_BE (encoder->packet + pos, length);
+    pos += 2;
+  }
+
+  /* ST 0601 requires the time stamp first, which ascending order gives us */
+  for (tag = 2; tag <= GST_KLV_ST0601_MAX_TAG; tag++) {
+    GstKLVST0601Slot *slot = &encoder->slots[tag];
+
+    if (!slot->set) {
+      slot->offset = 0;
+      continue;
+    }
+
+    if (tag >= 0x80)
+      encoder->packet[pos++] = 0x80 | (tag >> 7);
+    encoder->packet[pos++] = tag & 0x7f;
+    encoder->packet[pos++] = slot->length;
+    slot->offset = pos;
+    memcpy (encoder->packet + pos, slot->value, slot->length);
+    pos += slot->length;
+  }
+
+  encoder->packet[pos++] = GST_KLV_ST0601_TAG_CHECKSUM;
+  encoder->packet[pos++] = 2;
+  encoder->checksum_offset = pos;
+  encoder->checksum = gst_klv_st0601_checksum (encoder->packet, pos);
+  GST_WRITE_UINT16_BE (encoder->packet + pos, encoder->checksum);
+  pos += 2;
+
+  g_assert (pos == total);
+  encoder->size = total;
+  encoder->dirty = FALSE;
+}
+
+/**
+ * gst_klv_st0601_encoder_get_data:
+ * @encoder: a #GstKLVST0601Encoder
+ * @size: (out): size of the packet in bytes
+ *
+ * Gets the encoded packet, including an up to date checksum. The data is
+ * owned by @encoder and only valid until it is next modified.
+ *
+ * Returns: (transfer none) (array length=size): the encoded packet
+ */
+const guint8 *
+gst_klv_st0601_encoder_get_data (GstKLVST0601Encoder * encoder, gsize * size)
+{
+  g_return_val_if_fail (encoder != NULL, NULL);
+  g_return_val_if_fail (size != NULL, NULL);
+
+  if (encoder->dirty)
+    gst_klv_st0601_encoder_encode (encoder);
+
+  *size = encoder->size;
+  return encoder->packet;
+}
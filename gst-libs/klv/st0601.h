@@ -0,0 +1,195 @@
+/* GStreamer KLV Metadata Support Library
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_KLV_ST0601_H__
+#define __GST_KLV_ST0601_H__
+
+#include "klv.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GST_KLV_ST0601_MAX_TAG:
+ *
+ * Highest local tag the ST 0601 decoder and encoder keep track of.
+ */
+#define GST_KLV_ST0601_MAX_TAG 143
+
+/**
+ * GstKLVST0601Tag:
+ *
+ * MISB ST 0601 UAS Datalink Local Set tags with a known encoding. Other tags
+ * up to #GST_KLV_ST0601_MAX_TAG can still be accessed as raw bytes.
+ */
+typedef enum {
+  GST_KLV_ST0601_TAG_CHECKSUM = 1,
+  GST_KLV_ST0601_TAG_PRECISION_TIME_STAMP = 2,
+  GST_KLV_ST0601_TAG_MISSION_ID = 3,
+  GST_KLV_ST0601_TAG_PLATFORM_TAIL_NUMBER = 4,
+  GST_KLV_ST0601_TAG_PLATFORM_HEADING_ANGLE = 5,
+  GST_KLV_ST0601_TAG_PLATFORM_PITCH_ANGLE = 6,
+  GST_KLV_ST0601_TAG_PLATFORM_ROLL_ANGLE = 7,
+  GST_KLV_ST0601_TAG_PLATFORM_TRUE_AIRSPEED = 8,
+  GST_KLV_ST0601_TAG_PLATFORM_INDICATED_AIRSPEED = 9,
+  GST_KLV_ST0601_TAG_PLATFORM_DESIGNATION = 10,
+  GST_KLV_ST0601_TAG_IMAGE_SOURCE_SENSOR = 11,
+  GST_KLV_ST0601_TAG_IMAGE_COORDINATE_SYSTEM = 12,
+  GST_KLV_ST0601_TAG_SENSOR_LATITUDE = 13,
+  GST_KLV_ST0601_TAG_SENSOR_LONGITUDE = 14,
+  GST_KLV_ST0601_TAG_SENSOR_TRUE_ALTITUDE = 15,
+  GST_KLV_ST0601_TAG_SENSOR_HORIZONTAL_FOV = 16,
+  GST_KLV_ST0601_TAG_SENSOR_VERTICAL_FOV = 17,
+  GST_KLV_ST0601_TAG_SENSOR_RELATIVE_AZIMUTH = 18,
+  GST_KLV_ST0601_TAG_SENSOR_RELATIVE_ELEVATION = 19,
+  GST_KLV_ST0601_TAG_SENSOR_RELATIVE_ROLL = 20,
+  GST_KLV_ST0601_TAG_SLANT_RANGE = 21,
+  GST_KLV_ST0601_TAG_TARGET_WIDTH = 22,
+  GST_KLV_ST0601_TAG_FRAME_CENTER_LATITUDE = 23,
+  GST_KLV_ST0601_TAG_FRAME_CENTER_LONGITUDE = 24,
+  GST_KLV_ST0601_TAG_FRAME_CENTER_ELEVATION = 25,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LATITUDE_1 = 26,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LONGITUDE_1 = 27,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LATITUDE_2 = 28,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LONGITUDE_2 = 29,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LATITUDE_3 = 30,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LONGITUDE_3 = 31,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LATITUDE_4 = 32,
+  GST_KLV_ST0601_TAG_OFFSET_CORNER_LONGITUDE_4 = 33,
+  GST_KLV_ST0601_TAG_ICING_DETECTED = 34,
+  GST_KLV_ST0601_TAG_WIND_DIRECTION = 35,
+  GST_KLV_ST0601_TAG_WIND_SPEED = 36,
+  GST_KLV_ST0601_TAG_STATIC_PRESSURE = 37,
+  GST_KLV_ST0601_TAG_DENSITY_ALTITUDE = 38,
+  GST_KLV_ST0601_TAG_OUTSIDE_AIR_TEMPERATURE = 39,
+  GST_KLV_ST0601_TAG_TARGET_LOCATION_LATITUDE = 40,
+  GST_KLV_ST0601_TAG_TARGET_LOCATION_LONGITUDE = 41,
+  GST_KLV_ST0601_TAG_TARGET_LOCATION_ELEVATION = 42,
+  GST_KLV_ST0601_TAG_TARGET_TRACK_GATE_WIDTH = 43,
+  GST_KLV_ST0601_TAG_TARGET_TRACK_GATE_HEIGHT = 44,
+  GST_KLV_ST0601_TAG_TARGET_ERROR_ESTIMATE_CE90 = 45,
+  GST_KLV_ST0601_TAG_TARGET_ERROR_ESTIMATE_LE90 = 46,
+  GST_KLV_ST0601_TAG_GENERIC_FLAG_DATA = 47,
+  GST_KLV_ST0601_TAG_SECURITY_LOCAL_SET = 48,
+  GST_KLV_ST0601_TAG_DIFFERENTIAL_PRESSURE = 49,
+  GST_KLV_ST0601_TAG_PLATFORM_ANGLE_OF_ATTACK = 50,
+  GST_KLV_ST0601_TAG_PLATFORM_VERTICAL_SPEED = 51,
+  GST_KLV_ST0601_TAG_PLATFORM_SIDESLIP_ANGLE = 52,
+  GST_KLV_ST0601_TAG_AIRFIELD_BAROMETRIC_PRESSURE = 53,
+  GST_KLV_ST0601_TAG_AIRFIELD_ELEVATION = 54,
+  GST_KLV_ST0601_TAG_RELATIVE_HUMIDITY = 55,
+  GST_KLV_ST0601_TAG_PLATFORM_GROUND_SPEED = 56,
+  GST_KLV_ST0601_TAG_GROUND_RANGE = 57,
+  GST_KLV_ST0601_TAG_PLATFORM_FUEL_REMAINING = 58,
+  GST_KLV_ST0601_TAG_PLATFORM_CALL_SIGN = 59,
+  GST_KLV_ST0601_TAG_WEAPON_LOAD = 60,
+  GST_KLV_ST0601_TAG_WEAPON_FIRED = 61,
+  GST_KLV_ST0601_TAG_LASER_PRF_CODE = 62,
+  GST_KLV_ST0601_TAG_SENSOR_FOV_NAME = 63,
+  GST_KLV_ST0601_TAG_PLATFORM_MAGNETIC_HEADING = 64,
+  GST_KLV_ST0601_TAG_VERSION_NUMBER = 65
+} GstKLVST0601Tag;
+
+/**
+ * GstKLVST0601Decoder:
+ *
+ * Gives access to the items of an ST 0601 packet without copying it. Items
+ * are only located when first requested, and values only converted when
+ * read. Usually allocated on the stack; the packet data must stay valid
+ * while the decoder is in use.
+ */
+typedef struct {
+  /*< private >*/
+  const guint8 *data;
+  gsize size;
+  GstKLVReader reader;
+  guint32 offsets[GST_KLV_ST0601_MAX_TAG + 1];
+  guint32 lengths[GST_KLV_ST0601_MAX_TAG + 1];
+} GstKLVST0601Decoder;
+
+/**
+ * GstKLVST0601Encoder:
+ *
+ * An opaque encoder keeping an encoded ST 0601 packet up to date. Changing
+ * the value of an item that is already part of the packet, without changing
+ * its size, only rewrites those bytes and adjusts the checksum; anything else
+ * re-encodes the packet on the next gst_klv_st0601_encoder_get_data().
+ */
+typedef struct _GstKLVST0601Encoder GstKLVST0601Encoder;
+
+GST_TAG_API
+const gchar       * gst_klv_st0601_tag_get_name (guint tag);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_is_key (const guint8 * data, gsize size);
+
+GST_TAG_API
+guint16             gst_klv_st0601_checksum (const guint8 * data, gsize size);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_verify_checksum (const guint8 * data, gsize size);
+
+/* Decoding */
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_init (GstKLVST0601Decoder * decoder, const guint8 * data, gsize size);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_init_from_meta (GstKLVST0601Decoder * decoder, GstKLVMeta * klv_meta);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_get_raw (GstKLVST0601Decoder * decoder, guint tag, const guint8 ** value, gsize * length);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_get_uint64 (GstKLVST0601Decoder * decoder, guint tag, guint64 * value);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_get_double (GstKLVST0601Decoder * decoder, guint tag, gdouble * value);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_decoder_get_string (GstKLVST0601Decoder * decoder, guint tag, const gchar ** str, gsize * length);
+
+/* Encoding */
+
+GST_TAG_API
+GstKLVST0601Encoder * gst_klv_st0601_encoder_new (void);
+
+GST_TAG_API
+void                gst_klv_st0601_encoder_free (GstKLVST0601Encoder * encoder);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_encoder_set_raw (GstKLVST0601Encoder * encoder, guint tag, const guint8 * value, gsize length);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_encoder_set_uint64 (GstKLVST0601Encoder * encoder, guint tag, guint64 value);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_encoder_set_double (GstKLVST0601Encoder * encoder, guint tag, gdouble value);
+
+GST_TAG_API
+gboolean            gst_klv_st0601_encoder_set_string (GstKLVST0601Encoder * encoder, guint tag, const gchar * str);
+
+GST_TAG_API
+void                gst_klv_st0601_encoder_unset (GstKLVST0601Encoder * encoder, guint tag);
+
+GST_TAG_API
+const guint8      * gst_klv_st0601_encoder_get_data (GstKLVST0601Encoder * encoder, gsize * size);
+
+G_END_DECLS
+
+#endif /* __GST_KLV_ST0601_H__ */
@@ -0,0 +1,133 @@
+/* GStreamer KLV Metadata Support Library
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures KLV reader throughput over a buffer of typical MISB ST 0601 sized
+ * packets, walking either just the packets or every local set item too.
+ *
+ *   bench-klv [iterations]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include "klv.h"
+
+#define NUM_PACKETS 1000
+#define NUM_ITEMS 30
+#define DEFAULT_ITERATIONS 1000
+
+static const guint8 bench_key[GST_KLV_UNIVERSAL_KEY_SIZE] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01,
+  0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+};
+
+static GByteArray *
+make_packets (void)
+{
+  GByteArray *data = g_byte_array_new ();
+  guint8 set[NUM_ITEMS * (2 + 8)];
+  guint8 hdr[3];
+  guint p, i, len;
+
+  /* a mix of 2, 4 and 8 byte items, like ST 0601 */
+  len = 0;
+  for (i = 0; i < NUM_ITEMS; i++) {
+    guint size = 2 << (i % 3);
+
+    set[len++] = i + 2;
+    set[len++] = size;
+    memset (set + len, i, size);
+    len += size;
+  }
+
+  hdr[0] = 0x82;
+  GST_WRITE_UINT16_BE (hdr + 1, len);
+
+  for (p = 0; p < NUM_PACKETS; p++) {
+    g_byte_array_append (data, bench_key, sizeof (bench_key));
+    g_byte_array_append (data, hdr, sizeof (hdr));
+    g_byte_array_append (data, set, len);
+  }
+
+  return data;
+}
+
+static void
+report (const gchar * name, gint64 elapsed, guint iterations, gsize bytes,
+    guint64 count)
+{
+  gdouble secs = elapsed / (gdouble) G_USEC_PER_SEC;
+
+  g_print ("%-24s %12.0f packets/s %10.1f MB/s (%" G_GUINT64_FORMAT
+      " checksum)\n", name, NUM_PACKETS * (gdouble) iterations / secs,
+      bytes * (gdouble) iterations / secs / 1e6, count);
+}
+
+int
+main (int argc, char **argv)
+{
+  GByteArray *data;
+  GstKLVReader reader;
+  GstKLVPacket packet;
+  GstKLVLocalItem item;
+  guint iterations = DEFAULT_ITERATIONS;
+  guint64 count;
+  gint64 start;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    iterations = MAX (atoi (argv[1]), 1);
+
+  data = make_packets ();
+  g_print ("%u packets of %u bytes, %u iterations\n", NUM_PACKETS,
+      data->len / NUM_PACKETS, iterations);
+
+  /* keep a count of what was parsed so the loops can't be optimized away */
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    gst_klv_reader_init (&reader, data->data, data->len);
+    while (gst_klv_reader_next_packet (&reader, &packet))
+      count += packet.length;
+  }
+  report ("packets", g_get_monotonic_time () - start, iterations, data->len,
+      count);
+
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    gst_klv_reader_init (&reader, data->data, data->len);
+    while (gst_klv_reader_next_packet (&reader, &packet)) {
+      GstKLVReader set_reader;
+
+      gst_klv_reader_init_local_set (&set_reader, &packet);
+      while (gst_klv_reader_next_local_item (&set_reader, &item))
+        count += item.tag + item.length;
+    }
+  }
+  report ("packets and items", g_get_monotonic_time () - start, iterations,
+      data->len, count);
+
+  g_byte_array_free (data, TRUE);
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+/* GStreamer KLV Metadata Support Library
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the ST 0601 codec on a packet like a typical full motion video
+ * platform would send every frame: decoding a few tags, re-encoding after
+ * the per-frame tags changed in place, and fully re-encoding the packet as
+ * happens whenever its layout changes.
+ *
+ *   bench-st0601 [packets]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include "klv.h"
+#include "st0601.h"
+
+#define DEFAULT_PACKETS 1000000
+
+/* tags changing every frame */
+static const guint per_frame_tags[] = {
+  GST_KLV_ST0601_TAG_PLATFORM_HEADING_ANGLE,
+  GST_KLV_ST0601_TAG_SENSOR_LATITUDE,
+  GST_KLV_ST0601_TAG_SENSOR_LONGITUDE,
+  GST_KLV_ST0601_TAG_FRAME_CENTER_LATITUDE,
+  GST_KLV_ST0601_TAG_FRAME_CENTER_LONGITUDE
+};
+
+static GstKLVST0601Encoder *
+make_encoder (void)
+{
+  GstKLVST0601Encoder *encoder = gst_klv_st0601_encoder_new ();
+  guint tag;
+
+  gst_klv_st0601_encoder_set_uint64 (encoder,
+      GST_KLV_ST0601_TAG_PRECISION_TIME_STAMP, 0);
+  gst_klv_st0601_encoder_set_string (encoder, GST_KLV_ST0601_TAG_MISSION_ID,
+      "BENCH");
+  gst_klv_st0601_encoder_set_string (encoder,
+      GST_KLV_ST0601_TAG_PLATFORM_DESIGNATION, "Bench UAS");
+  for (tag = GST_KLV_ST0601_TAG_PLATFORM_HEADING_ANGLE;
+      tag <= GST_KLV_ST0601_TAG_PLATFORM_INDICATED_AIRSPEED; tag++)
+    gst_klv_st0601_encoder_set_double (encoder, tag, 1.0);
+  for (tag = GST_KLV_ST0601_TAG_SENSOR_LATITUDE;
+      tag <= GST_KLV_ST0601_TAG_OFFSET_CORNER_LONGITUDE_4; tag++)
+    gst_klv_st0601_encoder_set_double (encoder, tag, 1.0);
+  gst_klv_st0601_encoder_set_uint64 (encoder,
+      GST_KLV_ST0601_TAG_VERSION_NUMBER, 11);
+
+  return encoder;
+}
+
+static void
+update_frame (GstKLVST0601Encoder * encoder, guint frame)
+{
+  guint i;
+
+  gst_klv_st0601_encoder_set_uint64 (encoder,
+      GST_KLV_ST0601_TAG_PRECISION_TIME_STAMP, frame * G_GUINT64_CONSTANT (33));
+  for (i = 0; i < G_N_ELEMENTS (per_frame_tags); i++)
+    gst_klv_st0601_encoder_set_double (encoder, per_frame_tags[i],
+        (frame % 3600) / 100.0 + i);
+}
+
+static void
+report (const gchar * name, gint64 elapsed, guint packets, guint64 count)
+{
+  gdouble secs = elapsed / (gdouble) G_USEC_PER_SEC;
+
+  g_print ("%-24s %12.0f packets/s %8.3f us/packet (%" G_GUINT64_FORMAT
+      " checksum)\n", name, packets / secs, elapsed / (gdouble) packets,
+      count);
+}
+
+int
+main (int argc, char **argv)
+{
+  GstKLVST0601Encoder *encoder;
+  GstKLVST0601Decoder decoder;
+  const guint8 *data;
+  guint8 *packet;
+  gsize size;
+  guint packets = DEFAULT_PACKETS;
+  guint64 count;
+  gint64 start;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    packets = MAX (atoi (argv[1]), 1);
+
+  encoder = make_encoder ();
+  data = gst_klv_st0601_encoder_get_data (encoder, &size);
+  packet = g_malloc (size);
+  memcpy (packet, data, size);
+  g_print ("%u packets of %u bytes\n", packets, (guint) size);
+
+  /* keep a count of the results so the loops can't be optimized away */
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < packets; i++) {
+    gdouble lat = 0, lon = 0;
+    guint64 ts = 0;
+
+    gst_klv_st0601_decoder_init (&decoder, packet, size);
+    gst_klv_st0601_decoder_get_uint64 (&decoder,
+        GST_KLV_ST0601_TAG_PRECISION_TIME_STAMP, &ts);
+    gst_klv_st0601_decoder_get_double (&decoder,
+        GST_KLV_ST0601_TAG_FRAME_CENTER_LATITUDE, &lat);
+    gst_klv_st0601_decoder_get_double (&decoder,
+        GST_KLV_ST0601_TAG_FRAME_CENTER_LONGITUDE, &lon);
+    count += ts + (guint64) (lat + lon);
+  }
+  report ("decode 3 tags", g_get_monotonic_time () - start, packets, count);
+
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < packets; i++)
+    count += gst_klv_st0601_verify_checksum (packet, size);
+  report ("verify checksum", g_get_monotonic_time () - start, packets, count);
+
+  /* same layout every frame, so only the changed bytes are patched */
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < packets; i++) {
+    update_frame (encoder, i);
+    data = gst_klv_st0601_encoder_get_data (encoder, &size);
+    count += data[size - 1];
+  }
+  report ("incremental re-encode", g_get_monotonic_time () - start, packets,
+      count);
+
+  /* unsetting a tag changes the layout, forcing the whole packet to be
+   * encoded again */
+  count = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < packets; i++) {
+    gst_klv_st0601_encoder_unset (encoder, GST_KLV_ST0601_TAG_VERSION_NUMBER);
+    gst_klv_st0601_encoder_set_uint64 (encoder,
+        GST_KLV_ST0601_TAG_VERSION_NUMBER, 11);
+    update_frame (encoder, i);
+    data = gst_klv_st0601_encoder_get_data (encoder, &size);
+    count += data[size - 1];
+  }
+  report ("full re-encode", g_get_monotonic_time () - start, packets, count);
+
+  g_free (packet);
+  gst_klv_st0601_encoder_free (encoder);
+
+  return 0;
+}
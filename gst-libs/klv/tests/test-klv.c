@@ -0,0 +1,435 @@
+/* GStreamer KLV Metadata Support Library
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Checks the KLV reader against truncated, oversized and randomly mutated
+ * input. Every buffer handed to the parser is allocated at exactly its size,
+ * so running under valgrind or AddressSanitizer also catches reads past the
+ * end. Run with -m thorough for many more iterations. */
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include "klv.h"
+
+#define FUZZ_ITERATIONS 20000
+#define FUZZ_ITERATIONS_THOROUGH 1000000
+
+static const guint8 test_key[GST_KLV_UNIVERSAL_KEY_SIZE] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01,
+  0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+};
+
+static guint
+fuzz_iterations (void)
+{
+  return g_test_thorough ()? FUZZ_ITERATIONS_THOROUGH : FUZZ_ITERATIONS;
+}
+
+/* copy into an allocation of exactly @size bytes, so overreads are caught */
+static guint8 *
+exact_copy (const guint8 * data, gsize size)
+{
+  guint8 *copy = g_malloc (MAX (size, 1));
+
+  if (size)
+    memcpy (copy, data, size);
+
+  return copy;
+}
+
+static guint
+write_ber_length (guint8 * data, gsize length)
+{
+  guint n = 0, i;
+  gsize l;
+
+  if (length < 0x80) {
+    data[0] = (guint8) length;
+    return 1;
+  }
+
+  for (l = length; l; l >>= 8)
+    n++;
+
+  data[0] = 0x80 | n;
+  for (i = 0; i < n; i++)
+    data[1 + i] = (guint8) (length >> (8 * (n - 1 - i)));
+
+  return n + 1;
+}
+
+static guint
+write_ber_oid (guint8 * data, guint32 oid)
+{
+  guint n = 1, i;
+
+  while (n < 4 && (oid >> (7 * n)))
+    n++;
+
+  for (i = 0; i < n; i++) {
+    data[i] = (oid >> (7 * (n - 1 - i))) & 0x7f;
+    if (i < n - 1)
+      data[i] |= 0x80;
+  }
+
+  return n;
+}
+
+/* a stream of a few local set packets with a mix of tag and length forms */
+static GByteArray *
+make_stream (GRand * rand)
+{
+  GByteArray *stream = g_byte_array_new ();
+  guint p, num_packets = g_rand_int_range (rand, 1, 4);
+
+  for (p = 0; p < num_packets; p++) {
+    GByteArray *set = g_byte_array_new ();
+    guint8 hdr[16];
+    guint i, n, num_items = g_rand_int_range (rand, 0, 12);
+
+    for (i = 0; i < num_items; i++) {
+      guint32 tag = g_rand_boolean (rand) ? g_rand_int_range (rand, 1, 128) :
+          g_rand_int_range (rand, 128, 1 << 21);
+      gsize length = g_rand_boolean (rand) ? g_rand_int_range (rand, 0, 16) :
+          g_rand_int_range (rand, 128, 300);
+      guint8 *value = g_malloc0 (MAX (length, 1));
+
+      n = write_ber_oid (hdr, tag);
+      n += write_ber_length (hdr + n, length);
+      g_byte_array_append (set, hdr, n);
+      g_byte_array_append (set, value, length);
+      g_free (value);
+    }
+
+    g_byte_array_append (stream, test_key, sizeof (test_key));
+    n = write_ber_length (hdr, set->len);
+    g_byte_array_append (stream, hdr, n);
+    g_byte_array_append (stream, set->data, set->len);
+    g_byte_array_free (set, TRUE);
+  }
+
+  return stream;
+}
+
+/* Walk everything the reader accepts, checking that it never hands out
+ * anything outside the data and that parsed and remaining bytes add up. */
+static void
+check_reader (const guint8 * data, gsize size)
+{
+  GstKLVReader reader;
+  GstKLVPacket packet;
+  gsize consumed = 0;
+
+  gst_klv_reader_init (&reader, data, size);
+  while (gst_klv_reader_next_packet (&reader, &packet)) {
+    GstKLVReader set_reader;
+    GstKLVLocalItem item;
+    gsize set_consumed = 0;
+
+    g_assert (packet.data == data + consumed);
+    g_assert (packet.key == packet.data);
+    g_assert_cmpuint (packet.size, <=, size - consumed);
+    g_assert (packet.value > packet.data);
+    g_assert (packet.value + packet.length == packet.data + packet.size);
+    consumed += packet.size;
+
+    gst_klv_reader_init_local_set (&set_reader, &packet);
+    while (gst_klv_reader_next_local_item (&set_reader, &item)) {
+      g_assert (item.value >= packet.value + set_consumed);
+      g_assert_cmpuint (item.length, <=,
+          (gsize) (packet.value + packet.length - item.value));
+      set_consumed = item.value + item.length - packet.value;
+    }
+    g_assert_cmpuint (set_consumed, ==, set_reader.offset);
+    g_assert_cmpuint (gst_klv_reader_get_remaining (&set_reader), ==,
+        packet.length - set_consumed);
+  }
+
+  g_assert_cmpuint (consumed, ==, reader.offset);
+  g_assert_cmpuint (gst_klv_reader_get_remaining (&reader), ==,
+      size - consumed);
+}
+
+static void
+test_ber_length (void)
+{
+  guint8 data[16];
+  gsize length;
+  guint length_size;
+  guint8 *copy;
+
+  /* short and long forms */
+  data[0] = 0x7f;
+  g_assert (gst_klv_parse_ber_length (data, 1, &length, &length_size));
+  g_assert_cmpuint (length, ==, 0x7f);
+  g_assert_cmpuint (length_size, ==, 1);
+
+  data[0] = 0x82;
+  data[1] = 0x01;
+  data[2] = 0x00;
+  g_assert (gst_klv_parse_ber_length (data, 3, &length, &length_size));
+  g_assert_cmpuint (length, ==, 0x100);
+  g_assert_cmpuint (length_size, ==, 3);
+
+  /* indefinite form */
+  data[0] = 0x80;
+  g_assert (!gst_klv_parse_ber_length (data, 16, &length, NULL));
+
+  /* empty and truncated */
+  g_assert (!gst_klv_parse_ber_length (data, 0, &length, NULL));
+  data[0] = 0x84;
+  copy = exact_copy (data, 4);
+  g_assert (!gst_klv_parse_ber_length (copy, 4, &length, NULL));
+  g_free (copy);
+
+  /* more bytes than fit in a gsize */
+  memset (data, 0xff, sizeof (data));
+  data[0] = 0x80 | (sizeof (gsize) + 1);
+  g_assert (!gst_klv_parse_ber_length (data, sizeof (data), &length, NULL));
+
+  /* the largest gsize is accepted, but never more than the data */
+  data[0] = 0x80 | sizeof (gsize);
+  g_assert (gst_klv_parse_ber_length (data, sizeof (data), &length,
+          &length_size));
+  g_assert_cmpuint (length, ==, G_MAXSIZE);
+  g_assert_cmpuint (length_size, ==, sizeof (gsize) + 1);
+}
+
+static void
+test_ber_oid (void)
+{
+  guint8 data[8];
+  guint32 oid, value;
+  guint oid_size, n;
+  guint8 *copy;
+
+  /* round trip at the boundaries of every size */
+  for (value = 0; value < (1 << 28); value = value * 2 + 1) {
+    n = write_ber_oid (data, value);
+    g_assert (gst_klv_parse_ber_oid (data, n, &oid, &oid_size));
+    g_assert_cmpuint (oid, ==, value);
+    g_assert_cmpuint (oid_size, ==, n);
+
+    /* every truncation is rejected */
+    while (--n > 0) {
+      copy = exact_copy (data, n);
+      g_assert (!gst_klv_parse_ber_oid (copy, n, &oid, NULL));
+      g_free (copy);
+    }
+  }
+
+  /* more than four bytes */
+  memset (data, 0x81, sizeof (data));
+  data[4] = 0x01;
+  g_assert (!gst_klv_parse_ber_oid (data, sizeof (data), &oid, NULL));
+
+  g_assert (!gst_klv_parse_ber_oid (data, 0, &oid, NULL));
+}
+
+static void
+test_oversized_lengths (void)
+{
+  guint8 data[GST_KLV_UNIVERSAL_KEY_SIZE + 16];
+  GstKLVReader reader;
+  GstKLVPacket packet;
+  GstKLVLocalItem item;
+  guint i, n;
+
+  /* packet lengths from just past the end up to the largest gsize */
+  for (i = 1; i <= sizeof (gsize); i++) {
+    memcpy (data, test_key, sizeof (test_key));
+    memset (data + sizeof (test_key), 0xff, sizeof (data) - sizeof (test_key));
+    data[sizeof (test_key)] = 0x80 | i;
+
+    gst_klv_reader_init (&reader, data, sizeof (data));
+    g_assert (!gst_klv_reader_next_packet (&reader, &packet));
+    g_assert_cmpuint (gst_klv_reader_get_remaining (&reader), ==,
+        sizeof (data));
+  }
+
+  n = sizeof (test_key);
+  memcpy (data, test_key, n);
+  n += write_ber_length (data + n, sizeof (data) - n);
+  gst_klv_reader_init (&reader, data, sizeof (data));
+  g_assert (!gst_klv_reader_next_packet (&reader, &packet));
+
+  /* local item lengths past the end of the set */
+  for (i = 1; i <= sizeof (gsize); i++) {
+    memset (data, 0xff, sizeof (data));
+    data[0] = 0x05;
+    data[1] = 0x80 | i;
+
+    gst_klv_reader_init (&reader, data, sizeof (data));
+    g_assert (!gst_klv_reader_next_local_item (&reader, &item));
+    g_assert_cmpuint (reader.offset, ==, 0);
+  }
+}
+
+static void
+test_truncation (void)
+{
+  GRand *rand = g_rand_new_with_seed (0x4b4c56);
+  guint i, iterations = fuzz_iterations () / 100;
+
+  for (i = 0; i < iterations; i++) {
+    GByteArray *stream = make_stream (rand);
+    gsize size;
+
+    for (size = 0; size <= stream->len; size++) {
+      guint8 *copy = exact_copy (stream->data, size);
+
+      check_reader (copy, size);
+      g_free (copy);
+    }
+
+    g_byte_array_free (stream, TRUE);
+  }
+
+  g_rand_free (rand);
+}
+
+static void
+test_mutation (void)
+{
+  GRand *rand = g_rand_new_with_seed (0x4b4c56);
+  guint i, j, iterations = fuzz_iterations ();
+
+  for (i = 0; i < iterations; i++) {
+    GByteArray *stream = make_stream (rand);
+    guint mutations = g_rand_int_range (rand, 1, 8);
+    guint8 *copy;
+    gsize size;
+
+    for (j = 0; j < mutations; j++) {
+      gsize pos = g_rand_int_range (rand, 0, stream->len);
+
+      switch (g_rand_int_range (rand, 0, 3)) {
+        case 0:
+          stream->data[pos] = g_rand_int_range (rand, 0, 256);
+          break;
+        case 1:
+          stream->data[pos] ^= 1 << g_rand_int_range (rand, 0, 8);
+          break;
+        default:
+          /* set the long form bit, which is where lengths go wrong */
+          stream->data[pos] |= 0x80;
+          break;
+      }
+    }
+
+    size = g_rand_int_range (rand, 0, stream->len + 1);
+    copy = exact_copy (stream->data, size);
+    check_reader (copy, size);
+    g_free (copy);
+
+    g_byte_array_free (stream, TRUE);
+  }
+
+  g_rand_free (rand);
+}
+
+static void
+test_random (void)
+{
+  GRand *rand = g_rand_new_with_seed (0x4b4c56);
+  guint8 data[64];
+  guint i, j, iterations = fuzz_iterations ();
+
+  for (i = 0; i < iterations; i++) {
+    gsize size = g_rand_int_range (rand, 0, sizeof (data) + 1);
+    GstKLVReader reader;
+    GstKLVLocalItem item;
+    gsize length;
+    guint32 oid;
+    guint n;
+    guint8 *copy;
+
+    for (j = 0; j < size; j++)
+      data[j] = g_rand_int_range (rand, 0, 256);
+    /* make packets likely to start */
+    if (size >= 4 && g_rand_boolean (rand))
+      memcpy (data, test_key, MIN (size, sizeof (test_key)));
+
+    copy = exact_copy (data, size);
+
+    if (gst_klv_parse_ber_length (copy, size, &length, &n))
+      g_assert_cmpuint (n, <=, size);
+    if (gst_klv_parse_ber_oid (copy, size, &oid, &n)) {
+      g_assert_cmpuint (n, <=, MIN (size, 4));
+      g_assert_cmpuint (oid, <, 1 << 28);
+    }
+
+    check_reader (copy, size);
+
+    /* the same bytes as a bare local set */
+    gst_klv_reader_init (&reader, copy, size);
+    while (gst_klv_reader_next_local_item (&reader, &item))
+      g_assert (item.value + item.length <= copy + size);
+
+    g_free (copy);
+  }
+
+  g_rand_free (rand);
+}
+
+static void
+test_meta (void)
+{
+  GRand *rand = g_rand_new_with_seed (0x4b4c56);
+  guint i;
+
+  /* inline, pooled and GBytes backed storage all parse the same */
+  for (i = 0; i < 100; i++) {
+    GByteArray *stream = make_stream (rand);
+    GstBuffer *buf = gst_buffer_new ();
+    GstKLVMeta *meta;
+    GstKLVReader reader;
+    GstKLVPacket packet;
+
+    meta = gst_buffer_add_klv_meta_from_data (buf, stream->data, stream->len);
+    g_assert (meta != NULL);
+
+    gst_klv_reader_init_from_meta (&reader, meta);
+    while (gst_klv_reader_next_packet (&reader, &packet));
+    g_assert_cmpuint (gst_klv_reader_get_remaining (&reader), ==, 0);
+    g_assert_cmpuint (reader.offset, ==, stream->len);
+
+    gst_buffer_unref (buf);
+    g_byte_array_free (stream, TRUE);
+  }
+
+  g_rand_free (rand);
+}
+
+int
+main (int argc, char **argv)
+{
+  gst_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/klv/ber-length", test_ber_length);
+  g_test_add_func ("/klv/ber-oid", test_ber_oid);
+  g_test_add_func ("/klv/oversized-lengths", test_oversized_lengths);
+  g_test_add_func ("/klv/fuzz/truncation", test_truncation);
+  g_test_add_func ("/klv/fuzz/mutation", test_mutation);
+  g_test_add_func ("/klv/fuzz/random", test_random);
+  g_test_add_func ("/klv/meta", test_meta);
+
+  return g_test_run ();
+}
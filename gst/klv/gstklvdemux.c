@@ -0,0 +1,318 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:element-gstklvdemux
+ *
+ * The klvdemux element splits the KLV metadata attached to buffers off into
+ * a separate meta/x-klv stream, e.g. for muxing into MPEG-TS or Matroska.
+ *
+ * Buffers are passed through unchanged on the src pad. For each buffer with
+ * KLV metadata a buffer with the same timestamps is pushed on the klv_src
+ * pad, holding one memory per #GstKLVMeta that shares the meta's #GBytes, so
+ * the input buffer isn't held by the KLV stream. For buffers without KLV
+ * metadata a gap event is pushed instead, so downstream muxers don't wait on
+ * the KLV stream.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch -v videotestsrc ! klvinject ! klvdemux name=d d.src ! queue ! x264enc ! mpegtsmux name=m ! filesink location=out.ts d.klv_src ! queue ! m.
+ * ]|
+ * Records video along with the injected KLV as a separate stream.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include "gstklvdemux.h"
+#include "klv.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_klvdemux_debug_category);
+#define GST_CAT_DEFAULT gst_klvdemux_debug_category
+
+/* prototypes */
+static void gst_klvdemux_finalize (GObject * object);
+static GstStateChangeReturn gst_klvdemux_change_state (GstElement * element,
+    GstStateChange transition);
+static GstFlowReturn gst_klvdemux_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_klvdemux_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static gboolean gst_klvdemux_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+static gboolean gst_klvdemux_klv_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
+/* pad templates */
+
+#define KLV_CAPS "meta/x-klv, parsed = (boolean) true"
+
+static GstStaticPadTemplate gst_klvdemux_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_klvdemux_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_klvdemux_klv_src_template =
+GST_STATIC_PAD_TEMPLATE ("klv_src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (KLV_CAPS));
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstKlvDemux, gst_klvdemux, GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (gst_klvdemux_debug_category, "klvdemux", 0,
+        "debug category for klvdemux element"));
+
+static void
+gst_klvdemux_class_init (GstKlvDemuxClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = gst_klvdemux_finalize;
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_klvdemux_change_state);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvdemux_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvdemux_src_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvdemux_klv_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "KLV demuxer", "Demuxer/Metadata",
+      "Splits KLV metadata off into a separate stream",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+}
+
+static void
+gst_klvdemux_init (GstKlvDemux * filt)
+{
+  filt->sinkpad =
+      gst_pad_new_from_static_template (&gst_klvdemux_sink_template, "sink");
+  gst_pad_set_chain_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvdemux_chain));
+  gst_pad_set_event_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvdemux_sink_event));
+  gst_pad_set_query_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvdemux_sink_query));
+  gst_element_add_pad (GST_ELEMENT (filt), filt->sinkpad);
+
+  filt->srcpad =
+      gst_pad_new_from_static_template (&gst_klvdemux_src_template, "src");
+  gst_element_add_pad (GST_ELEMENT (filt), filt->srcpad);
+
+  filt->klvsrcpad =
+      gst_pad_new_from_static_template (&gst_klvdemux_klv_src_template,
+      "klv_src");
+  gst_pad_set_query_function (filt->klvsrcpad,
+      GST_DEBUG_FUNCPTR (gst_klvdemux_klv_src_query));
+  gst_pad_use_fixed_caps (filt->klvsrcpad);
+  gst_element_add_pad (GST_ELEMENT (filt), filt->klvsrcpad);
+
+  filt->flow_combiner = gst_flow_combiner_new ();
+  gst_flow_combiner_add_pad (filt->flow_combiner, filt->srcpad);
+  gst_flow_combiner_add_pad (filt->flow_combiner, filt->klvsrcpad);
+}
+
+static void
+gst_klvdemux_finalize (GObject * object)
+{
+  GstKlvDemux *filt = GST_KLVDEMUX (object);
+
+  gst_flow_combiner_free (filt->flow_combiner);
+
+  G_OBJECT_CLASS (gst_klvdemux_parent_class)->finalize (object);
+}
+
+static GstStateChangeReturn
+gst_klvdemux_change_state (GstElement * element, GstStateChange transition)
+{
+  GstKlvDemux *filt = GST_KLVDEMUX (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (gst_klvdemux_parent_class)->change_state (element,
+      transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    gst_flow_combiner_reset (filt->flow_combiner);
+
+  return ret;
+}
+
+static gboolean
+gst_klvdemux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstKlvDemux *filt = GST_KLVDEMUX (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:
+    {
+      GstEvent *klv_event;
+      gchar *stream_id;
+      guint group_id;
+
+      /* the KLV stream needs a stream-id of its own */
+      stream_id = gst_pad_create_stream_id (filt->klvsrcpad,
+          GST_ELEMENT (filt), "klv");
+      klv_event = gst_event_new_stream_start (stream_id);
+      if (gst_event_parse_group_id (event, &group_id))
+        gst_event_set_group_id (klv_event, group_id);
+      g_free (stream_id);
+
+      gst_pad_push_event (filt->klvsrcpad, klv_event);
+      return gst_pad_push_event (filt->srcpad, event);
+    }
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *klv_caps;
+
+      if (!gst_pad_has_current_caps (filt->klvsrcpad)) {
+        klv_caps = gst_static_pad_template_get_caps
+            (&gst_klvdemux_klv_src_template);
+        gst_pad_push_event (filt->klvsrcpad, gst_event_new_caps (klv_caps));
+        gst_caps_unref (klv_caps);
+      }
+
+      return gst_pad_push_event (filt->srcpad, event);
+    }
+    case GST_EVENT_FLUSH_STOP:
+      gst_flow_combiner_reset (filt->flow_combiner);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_klvdemux_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstKlvDemux *filt = GST_KLVDEMUX (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    case GST_QUERY_ACCEPT_CAPS:
+    case GST_QUERY_ALLOCATION:
+      /* the input caps and allocation only concern the passthrough stream */
+      return gst_pad_peer_query (filt->srcpad, query);
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static gboolean
+gst_klvdemux_klv_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    {
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *tmp = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = tmp;
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static GstFlowReturn
+gst_klvdemux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstKlvDemux *filt = GST_KLVDEMUX (parent);
+  GstBuffer *klv_buf = NULL;
+  GstKLVMeta *klv_meta;
+  gpointer iter = NULL;
+  GstFlowReturn ret;
+
+  while ((klv_meta = (GstKLVMeta *) gst_buffer_iterate_meta_filtered (buf,
+              &iter, GST_KLV_META_API_TYPE))) {
+    GBytes *bytes;
+    gconstpointer data;
+    gsize size;
+
+    bytes = gst_klv_meta_get_bytes (klv_meta);
+    if (bytes == NULL)
+      continue;
+
+    if (klv_buf == NULL) {
+      klv_buf = gst_buffer_new ();
+      GST_BUFFER_PTS (klv_buf) = GST_BUFFER_PTS (buf);
+      GST_BUFFER_DTS (klv_buf) = GST_BUFFER_DTS (buf);
+      GST_BUFFER_DURATION (klv_buf) = GST_BUFFER_DURATION (buf);
+    }
+
+    /* share the meta's own storage, so the packets don't keep the video
+     * frame alive, or make it unwritable, for as long as they are held */
+    data = g_bytes_get_data (bytes, &size);
+    gst_buffer_append_memory (klv_buf,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, (gpointer) data,
+            size, 0, size, g_bytes_ref (bytes),
+            (GDestroyNotify) g_bytes_unref));
+  }
+
+  if (klv_buf) {
+    GST_LOG_OBJECT (filt, "Pushing %u KLV packets, %" G_GSIZE_FORMAT
+        " bytes", gst_buffer_n_memory (klv_buf), gst_buffer_get_size (klv_buf));
+    ret = gst_pad_push (filt->klvsrcpad, klv_buf);
+  } else {
+    GstClockTime ts = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+        GST_BUFFER_DTS (buf);
+
+    if (GST_CLOCK_TIME_IS_VALID (ts))
+      gst_pad_push_event (filt->klvsrcpad, gst_event_new_gap (ts,
+              GST_BUFFER_DURATION (buf)));
+    ret = GST_FLOW_OK;
+  }
+
+  ret = gst_flow_combiner_update_pad_flow (filt->flow_combiner,
+      filt->klvsrcpad, ret);
+  if (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED) {
+    gst_buffer_unref (buf);
+    return ret;
+  }
+
+  ret = gst_pad_push (filt->srcpad, buf);
+
+  return gst_flow_combiner_update_pad_flow (filt->flow_combiner, filt->srcpad,
+      ret);
+}
@@ -21,12 +21,20 @@
  *
  * The klvinject element injects KLV metadata on passing buffers.
  *
+ * The KLV is taken from a template, given either as a file of raw KLV bytes
+ * (#GstKlvInject:location) or as a hex string (#GstKlvInject:template), or a
+ * built-in MISB EG 0902 test packet if neither is set. The template is parsed
+ * once on start; for each buffer only the Unix timestamp and optional counter
+ * local set items of the first packet are patched into a copy, and an ST 0601
+ * checksum item, if present, is updated. If there is nothing to patch, all
+ * buffers share the same template bytes.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch -v fakesrc ! klvinject ! fakesink
+ * gst-launch -v videotestsrc ! klvinject location=template.klv ! klvinspect ! fakesink
  * ]|
- * FIXME Describe what the pipeline does.
+ * Attaches the KLV in template.klv to each buffer, with the current time.
  * </refsect2>
  */
 
@@ -34,24 +42,43 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 #include <gst/base/gstbytewriter.h>
 #include "gstklvinject.h"
 #include "klv.h"
+#include "st0601.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_klvinject_debug_category);
 #define GST_CAT_DEFAULT gst_klvinject_debug_category
 
 /* prototypes */
+static void gst_klvinject_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_klvinject_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_klvinject_finalize (GObject * object);
+static gboolean gst_klvinject_start (GstBaseTransform * trans);
+static gboolean gst_klvinject_stop (GstBaseTransform * trans);
 static GstFlowReturn gst_klvinject_transform_ip (GstBaseTransform * trans,
     GstBuffer * buf);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_LOCATION,
+  PROP_TEMPLATE,
+  PROP_TIMESTAMP_TAG,
+  PROP_COUNTER_TAG
 };
 
+#define DEFAULT_PROP_LOCATION NULL
+#define DEFAULT_PROP_TEMPLATE NULL
+#define DEFAULT_PROP_TIMESTAMP_TAG 2
+#define DEFAULT_PROP_COUNTER_TAG 0
+
 /* pad templates */
 
 #define SRC_CAPS "ANY"
@@ -67,9 +94,39 @@ G_DEFINE_TYPE_WITH_CODE (GstKlvInject, gst_klvinject, GST_TYPE_BASE_TRANSFORM,
 static void
 gst_klvinject_class_init (GstKlvInjectClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
 
+  gobject_class->set_property = gst_klvinject_set_property;
+  gobject_class->get_property = gst_klvinject_get_property;
+  gobject_class->finalize = gst_klvinject_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Template location",
+          "File containing raw KLV bytes to use as template",
+          DEFAULT_PROP_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_TEMPLATE,
+      g_param_spec_string ("template", "Template",
+          "KLV bytes to use as template, as a hex string (ignored if location "
+          "is set)", DEFAULT_PROP_TEMPLATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_TIMESTAMP_TAG,
+      g_param_spec_uint ("timestamp-tag", "Timestamp tag",
+          "Local tag of the Unix timestamp (microseconds) to update for each "
+          "buffer (0 = none)", 0, G_MAXUINT32, DEFAULT_PROP_TIMESTAMP_TAG,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_COUNTER_TAG,
+      g_param_spec_uint ("counter-tag", "Counter tag",
+          "Local tag of a counter to increment for each buffer (0 = none)", 0,
+          G_MAXUINT32, DEFAULT_PROP_COUNTER_TAG,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   /* Setting up pads and setting metadata should be moved to
      base_class_init if you intend to subclass this class. */
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -83,6 +140,8 @@ gst_klvinject_class_init (GstKlvInjectClass * klass)
       "Inject KLV", "Filter", "Inject KLV metadata",
       "Joshua M. Doe <oss@nvl.army.mil>");
 
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_klvinject_start);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_klvinject_stop);
   base_transform_class->transform_ip =
       GST_DEBUG_FUNCPTR (gst_klvinject_transform_ip);
 
@@ -93,44 +152,90 @@ gst_klvinject_class_init (GstKlvInjectClass * klass)
 static void
 gst_klvinject_init (GstKlvInject * filt)
 {
+  filt->location = DEFAULT_PROP_LOCATION;
+  filt->template_hex = DEFAULT_PROP_TEMPLATE;
+  filt->timestamp_tag = DEFAULT_PROP_TIMESTAMP_TAG;
+  filt->counter_tag = DEFAULT_PROP_COUNTER_TAG;
 }
 
 static void
-gst_klvinject_dispose (GstKlvInject * filt)
+gst_klvinject_finalize (GObject * object)
 {
+  GstKlvInject *filt = GST_KLVINJECT (object);
+
+  g_free (filt->location);
+  g_free (filt->template_hex);
+  g_free (filt->scratch);
+  if (filt->template_bytes)
+    g_bytes_unref (filt->template_bytes);
+
+  G_OBJECT_CLASS (gst_klvinject_parent_class)->finalize (object);
 }
 
-static GstStaticCaps unix_reference = GST_STATIC_CAPS ("timestamp/x-unix");
+static void
+gst_klvinject_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstKlvInject *filt = GST_KLVINJECT (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_free (filt->location);
+      filt->location = g_value_dup_string (value);
+      break;
+    case PROP_TEMPLATE:
+      g_free (filt->template_hex);
+      filt->template_hex = g_value_dup_string (value);
+      break;
+    case PROP_TIMESTAMP_TAG:
+      filt->timestamp_tag = g_value_get_uint (value);
+      break;
+    case PROP_COUNTER_TAG:
+      filt->counter_tag = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
 
 static void
-gst_klvinject_add_test_meta (GstKlvInject * filt, GstBuffer * buf)
+gst_klvinject_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstKlvInject *filt = GST_KLVINJECT (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, filt->location);
+      break;
+    case PROP_TEMPLATE:
+      g_value_set_string (value, filt->template_hex);
+      break;
+    case PROP_TIMESTAMP_TAG:
+      g_value_set_uint (value, filt->timestamp_tag);
+      break;
+    case PROP_COUNTER_TAG:
+      g_value_set_uint (value, filt->counter_tag);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static GstStaticCaps unix_reference = GST_STATIC_CAPS ("timestamp/x-unix");
+
+static GBytes *
+gst_klvinject_create_test_template (void)
 {
-/* Add KLV meta for testing, here: Motion Imagery Standards Board (MISB)
+/* KLV meta for testing, here: Motion Imagery Standards Board (MISB)
  * Engineering Guideline MISB EG 0902 - MISB Minimum Metadata Set.
  * Also see: SMPTE S336M for KLV specification, also ITU-R BT.1563-1 */
   const guint8 klv_header[16] = { 0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01,
     0x01, 0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
   };
   GstByteWriter bw;
-  /* NOTE: MISB defines MISP time, which is NOT UTC, but use UTC for now */
-  gint64 utc_us = -1;
-
-#if GST_CHECK_VERSION(1,14,0)
-  GstReferenceTimestampMeta *time_meta;
-  time_meta =
-      gst_buffer_get_reference_timestamp_meta (buf,
-      gst_static_caps_get (&unix_reference));
-  if (time_meta) {
-    utc_us = time_meta->timestamp / 1000;
-  }
-#endif
-
-  if (utc_us == -1) {
-    GDateTime *dt = g_date_time_new_now_utc ();
-    utc_us = g_date_time_to_unix (dt) * 1000000;        /* microseconds */
-    utc_us += g_date_time_get_microsecond (dt);
-    g_date_time_unref (dt);
-  }
 
   gst_byte_writer_init (&bw);
 
@@ -141,10 +246,10 @@ gst_klvinject_add_test_meta (GstKlvInject * filt, GstBuffer * buf)
   gst_byte_writer_put_uint8 (&bw,
       (1 + 1 + 8) + (1 + 1 + 14) + (1 + 1 + 4) + (1 + 1 + 4) + (1 + 1 + 2));
 
-  /* Tag 1: unix timestamp */
+  /* Tag 1: unix timestamp, patched for each buffer */
   gst_byte_writer_put_uint8 (&bw, 2);   /* local tag: unix timestamp    */
   gst_byte_writer_put_uint8 (&bw, 8);   /* data length (BER short form) */
-  gst_byte_writer_put_uint64_be (&bw, utc_us);
+  gst_byte_writer_put_uint64_be (&bw, 0);
 
   /* Tag 2: Image Coordinate System */
   gst_byte_writer_put_uint8 (&bw, 12);  /* local tag: unix timestamp    */
@@ -181,12 +286,207 @@ gst_klvinject_add_test_meta (GstKlvInject * filt, GstBuffer * buf)
     gst_byte_writer_put_int16_be (&bw, val);
   }
 
-  {
-    gsize klv_size = gst_byte_writer_get_size (&bw);
-    guint8 *klv_data = gst_byte_writer_reset_and_get_data (&bw);
+  return gst_byte_writer_reset_and_get_bytes (&bw);
+}
+
+static GBytes *
+gst_klvinject_parse_hex (const gchar * hex)
+{
+  GByteArray *array = g_byte_array_new ();
+  const gchar *p = hex;
+
+  while (*p) {
+    gint hi, lo;
+    guint8 val;
+
+    if (g_ascii_isspace (*p)) {
+      p++;
+      continue;
+    }
+
+    hi = g_ascii_xdigit_value (p[0]);
+    lo = p[1] ? g_ascii_xdigit_value (p[1]) : -1;
+    if (hi < 0 || lo < 0) {
+      g_byte_array_unref (array);
+      return NULL;
+    }
+
+    val = (guint8) ((hi << 4) | lo);
+    g_byte_array_append (array, &val, 1);
+    p += 2;
+  }
+
+  return g_byte_array_free_to_bytes (array);
+}
 
-    gst_buffer_add_klv_meta_take_data (buf, klv_data, klv_size);
+static gboolean
+gst_klvinject_load_template (GstKlvInject * filt)
+{
+  GstKLVReader reader, local_set;
+  GstKLVPacket packet;
+  GstKLVLocalItem item;
+  const guint8 *data;
+  gsize size;
+
+  if (filt->location) {
+    gchar *contents;
+    GError *err = NULL;
+
+    if (!g_file_get_contents (filt->location, &contents, &size, &err)) {
+      GST_ELEMENT_ERROR (filt, RESOURCE, OPEN_READ,
+          ("Failed to read KLV template"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    filt->template_bytes = g_bytes_new_take (contents, size);
+  } else if (filt->template_hex) {
+    filt->template_bytes = gst_klvinject_parse_hex (filt->template_hex);
+    if (!filt->template_bytes) {
+      GST_ELEMENT_ERROR (filt, LIBRARY, SETTINGS,
+          ("Invalid KLV template"), ("Template is not a valid hex string"));
+      return FALSE;
+    }
+  } else {
+    filt->template_bytes = gst_klvinject_create_test_template ();
+  }
+
+  data = g_bytes_get_data (filt->template_bytes, &size);
+
+  gst_klv_reader_init (&reader, data, size);
+  if (!gst_klv_reader_next_packet (&reader, &packet)) {
+    GST_ELEMENT_ERROR (filt, LIBRARY, SETTINGS,
+        ("Invalid KLV template"), ("Template doesn't start with a KLV packet"));
+    return FALSE;
+  }
+
+  /* find the dynamic fields in the local set of the first packet */
+  filt->timestamp_offset = filt->counter_offset = filt->checksum_offset = 0;
+  gst_klv_reader_init_local_set (&local_set, &packet);
+  while (gst_klv_reader_next_local_item (&local_set, &item)) {
+    gsize offset = item.value - data;
+
+    if (item.length == 0 || item.length > 8)
+      continue;
+
+    if (filt->timestamp_tag && item.tag == filt->timestamp_tag
+        && !filt->timestamp_offset) {
+      filt->timestamp_offset = offset;
+      filt->timestamp_size = item.length;
+    } else if (filt->counter_tag && item.tag == filt->counter_tag
+        && !filt->counter_offset) {
+      filt->counter_offset = offset;
+      filt->counter_size = item.length;
+    } else if (item.tag == GST_KLV_ST0601_TAG_CHECKSUM && item.length == 2
+        && item.value + item.length == packet.value + packet.length) {
+      /* the checksum must be the last item of the packet */
+      filt->checksum_offset = offset;
+    }
   }
+
+  if (filt->timestamp_tag && !filt->timestamp_offset)
+    GST_WARNING_OBJECT (filt, "Timestamp tag %u not found in KLV template",
+        filt->timestamp_tag);
+  if (filt->counter_tag && !filt->counter_offset)
+    GST_WARNING_OBJECT (filt, "Counter tag %u not found in KLV template",
+        filt->counter_tag);
+
+  if (filt->timestamp_offset || filt->counter_offset) {
+    filt->scratch = (guint8 *) g_malloc (size);
+    memcpy (filt->scratch, data, size);
+  }
+
+  GST_DEBUG_OBJECT (filt, "Loaded %u byte KLV template, patching%s%s",
+      (guint) size, filt->timestamp_offset ? " timestamp" : "",
+      filt->counter_offset ? " counter" : "");
+
+  return TRUE;
+}
+
+static gboolean
+gst_klvinject_start (GstBaseTransform * trans)
+{
+  GstKlvInject *filt = GST_KLVINJECT (trans);
+
+  /* in case a previous start failed half way */
+  gst_klvinject_stop (trans);
+
+  filt->counter = 0;
+
+  return gst_klvinject_load_template (filt);
+}
+
+static gboolean
+gst_klvinject_stop (GstBaseTransform * trans)
+{
+  GstKlvInject *filt = GST_KLVINJECT (trans);
+
+  g_free (filt->scratch);
+  filt->scratch = NULL;
+  if (filt->template_bytes) {
+    g_bytes_unref (filt->template_bytes);
+    filt->template_bytes = NULL;
+  }
+
+  return TRUE;
+}
+
+/* write the low @size bytes of @val big-endian */
+static void
+gst_klvinject_write_uint_be (guint8 * data, gsize size, guint64 val)
+{
+  while (size--) {
+    data[size] = (guint8) (val & 0xff);
+    val >>= 8;
+  }
+}
+
+static void
+gst_klvinject_add_meta (GstKlvInject * filt, GstBuffer * buf)
+{
+  gsize size;
+
+  if (!filt->scratch) {
+    /* nothing changes, share the template */
+    gst_buffer_add_klv_meta_from_bytes (buf, filt->template_bytes);
+    return;
+  }
+
+  size = g_bytes_get_size (filt->template_bytes);
+
+  if (filt->timestamp_offset) {
+    /* NOTE: MISB defines MISP time, which is NOT UTC, but use UTC for now */
+    gint64 utc_us = -1;
+
+#if GST_CHECK_VERSION(1,14,0)
+    GstReferenceTimestampMeta *time_meta;
+    GstCaps *reference = gst_static_caps_get (&unix_reference);
+    time_meta = gst_buffer_get_reference_timestamp_meta (buf, reference);
+    gst_caps_unref (reference);
+    if (time_meta) {
+      utc_us = time_meta->timestamp / 1000;
+    }
+#endif
+
+    if (utc_us == -1)
+      utc_us = g_get_real_time ();
+
+    gst_klvinject_write_uint_be (filt->scratch + filt->timestamp_offset,
+        filt->timestamp_size, (guint64) utc_us);
+  }
+
+  if (filt->counter_offset) {
+    gst_klvinject_write_uint_be (filt->scratch + filt->counter_offset,
+        filt->counter_size, filt->counter);
+  }
+
+  if (filt->checksum_offset) {
+    GST_WRITE_UINT16_BE (filt->scratch + filt->checksum_offset,
+        gst_klv_st0601_checksum (filt->scratch, filt->checksum_offset));
+  }
+
+  /* small packets are copied inline into the meta, larger into pooled
+   * storage, so this doesn't allocate per buffer */
+  gst_buffer_add_klv_meta_from_data (buf, filt->scratch, size);
 }
 
 static GstFlowReturn
@@ -194,8 +494,9 @@ gst_klvinject_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
 {
   GstKlvInject *filt = GST_KLVINJECT (trans);
 
-  GST_LOG_OBJECT (filt, "Injecting test KLV metadata");
-  gst_klvinject_add_test_meta (filt, buf);
+  GST_LOG_OBJECT (filt, "Injecting KLV metadata");
+  gst_klvinject_add_meta (filt, buf);
+  filt->counter++;
 
   return GST_FLOW_OK;
 }
@@ -36,6 +36,26 @@ typedef struct _GstKlvInjectClass GstKlvInjectClass;
 struct _GstKlvInject
 {
   GstBaseTransform base_klvinject;
+
+  /* properties */
+  gchar *location;
+  gchar *template_hex;
+  guint timestamp_tag;
+  guint counter_tag;
+
+  /* template encoded once at start, shared as-is when nothing is patched */
+  GBytes *template_bytes;
+
+  /* per-buffer copy of the template the dynamic fields are patched into,
+   * offsets of the fields within it, 0 if not present */
+  guint8 *scratch;
+  gsize timestamp_offset;
+  gsize timestamp_size;
+  gsize counter_offset;
+  gsize counter_size;
+  gsize checksum_offset;
+
+  guint64 counter;
 };
 
 struct _GstKlvInjectClass
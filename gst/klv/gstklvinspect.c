@@ -21,12 +21,19 @@
  *
  * The klvinspect element inspects KLV metadata on passing buffers.
  *
+ * In dump mode each KLV packet is dumped to the debug log at MEMDUMP level.
+ * In stats mode only keys and lengths are decoded, and per-key packet rates,
+ * size distributions, buffers without KLV and the drift of the MISB ST 0601
+ * precision time stamp against the buffer timestamps are accumulated. Every
+ * #GstKlvInspect:interval of stream time, and on EOS, they are posted as a
+ * "klvinspect-stats" element message. Nothing is allocated per buffer.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch -v fakesrc ! klvinspect ! fakesink
+ * gst-launch -v -m videotestsrc ! klvinject ! klvinspect mode=stats ! fakesink
  * ]|
- * FIXME Describe what the pipeline does.
+ * Posts KLV statistics every second.
  * </refsect2>
  */
 
@@ -34,23 +41,56 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 #include "gstklvinspect.h"
 #include "klv.h"
+#include "st0601.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_klvinspect_debug_category);
 #define GST_CAT_DEFAULT gst_klvinspect_debug_category
 
 /* prototypes */
+static void gst_klvinspect_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_klvinspect_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static gboolean gst_klvinspect_start (GstBaseTransform * trans);
+static gboolean gst_klvinspect_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
 static GstFlowReturn gst_klvinspect_transform_ip (GstBaseTransform * trans,
     GstBuffer * buf);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_MODE,
+  PROP_INTERVAL
 };
 
+#define DEFAULT_PROP_MODE GST_KLVINSPECT_MODE_DUMP
+#define DEFAULT_PROP_INTERVAL GST_SECOND
+
+#define GST_TYPE_KLVINSPECT_MODE (gst_klvinspect_mode_get_type())
+static GType
+gst_klvinspect_mode_get_type (void)
+{
+  static GType klvinspect_mode_type = 0;
+  static const GEnumValue klvinspect_mode[] = {
+    {GST_KLVINSPECT_MODE_DUMP, "Dump packets to the debug log", "dump"},
+    {GST_KLVINSPECT_MODE_STATS, "Post statistics messages", "stats"},
+    {0, NULL, NULL},
+  };
+
+  if (!klvinspect_mode_type) {
+    klvinspect_mode_type =
+        g_enum_register_static ("GstKlvInspectMode", klvinspect_mode);
+  }
+  return klvinspect_mode_type;
+}
+
 /* pad templates */
 
 #define SRC_CAPS "ANY"
@@ -66,9 +106,25 @@ G_DEFINE_TYPE_WITH_CODE (GstKlvInspect, gst_klvinspect, GST_TYPE_BASE_TRANSFORM,
 static void
 gst_klvinspect_class_init (GstKlvInspectClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
 
+  gobject_class->set_property = gst_klvinspect_set_property;
+  gobject_class->get_property = gst_klvinspect_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode", "What to do with KLV packets",
+          GST_TYPE_KLVINSPECT_MODE, DEFAULT_PROP_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint64 ("interval", "Interval",
+          "Stream time between statistics messages (in ns, 0 = only on EOS)",
+          0, G_MAXUINT64, DEFAULT_PROP_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   /* Setting up pads and setting metadata should be moved to
      base_class_init if you intend to subclass this class. */
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -82,6 +138,9 @@ gst_klvinspect_class_init (GstKlvInspectClass * klass)
       "Inspect KLV", "Filter", "Inspect KLV metadata",
       "Joshua M. Doe <oss@nvl.army.mil>");
 
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_klvinspect_start);
+  base_transform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_klvinspect_sink_event);
   base_transform_class->transform_ip =
       GST_DEBUG_FUNCPTR (gst_klvinspect_transform_ip);
 
@@ -92,11 +151,271 @@ gst_klvinspect_class_init (GstKlvInspectClass * klass)
 static void
 gst_klvinspect_init (GstKlvInspect * filt)
 {
+  filt->mode = DEFAULT_PROP_MODE;
+  filt->interval = DEFAULT_PROP_INTERVAL;
+}
+
+static void
+gst_klvinspect_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstKlvInspect *filt = GST_KLVINSPECT (object);
+
+  switch (prop_id) {
+    case PROP_MODE:
+      filt->mode = g_value_get_enum (value);
+      break;
+    case PROP_INTERVAL:
+      filt->interval = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_klvinspect_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstKlvInspect *filt = GST_KLVINSPECT (object);
+
+  switch (prop_id) {
+    case PROP_MODE:
+      g_value_set_enum (value, filt->mode);
+      break;
+    case PROP_INTERVAL:
+      g_value_set_uint64 (value, filt->interval);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 static void
-gst_klvinspect_dispose (GstKlvInspect * filt)
+gst_klvinspect_reset_interval (GstKlvInspect * filt, GstClockTime start)
 {
+  filt->interval_start = start;
+  filt->n_keys = 0;
+  filt->other_packets = 0;
+  filt->buffers = 0;
+  filt->gap_buffers = 0;
+  filt->max_gap = 0;
+  filt->skew_count = 0;
+  filt->skew_min = G_MAXINT64;
+  filt->skew_max = G_MININT64;
+  filt->skew_sum = 0;
+}
+
+static gboolean
+gst_klvinspect_start (GstBaseTransform * trans)
+{
+  GstKlvInspect *filt = GST_KLVINSPECT (trans);
+
+  gst_klvinspect_reset_interval (filt, GST_CLOCK_TIME_NONE);
+  filt->gap = 0;
+  filt->have_skew_offset = FALSE;
+  filt->skew_offset = 0;
+
+  return TRUE;
+}
+
+static void
+gst_klvinspect_post_stats (GstKlvInspect * filt, GstClockTime end)
+{
+  GstStructure *s;
+  GValue keys = G_VALUE_INIT;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  guint i, j;
+
+  if (GST_CLOCK_TIME_IS_VALID (filt->interval_start)
+      && GST_CLOCK_TIME_IS_VALID (end) && end > filt->interval_start)
+    duration = end - filt->interval_start;
+
+  g_value_init (&keys, GST_TYPE_ARRAY);
+  for (i = 0; i < filt->n_keys; i++) {
+    GstKlvInspectKeyStats *stats = &filt->keys[i];
+    GValue val = G_VALUE_INIT;
+    GValue bins = G_VALUE_INIT;
+    gchar key[2 * 16 + 1];
+    GstStructure *ks;
+
+    for (j = 0; j < 16; j++)
+      g_snprintf (key + 2 * j, 3, "%02x", stats->key[j]);
+
+    g_value_init (&bins, GST_TYPE_ARRAY);
+    for (j = 0; j < GST_KLVINSPECT_SIZE_BINS; j++) {
+      GValue bin = G_VALUE_INIT;
+
+      g_value_init (&bin, G_TYPE_UINT64);
+      g_value_set_uint64 (&bin, stats->size_bins[j]);
+      gst_value_array_append_and_take_value (&bins, &bin);
+    }
+
+    ks = gst_structure_new ("klv-key",
+        "key", G_TYPE_STRING, key,
+        "packets", G_TYPE_UINT64, stats->packets,
+        "rate", G_TYPE_DOUBLE, GST_CLOCK_TIME_IS_VALID (duration) ?
+        (gdouble) stats->packets * GST_SECOND / duration : 0.0,
+        "bytes", G_TYPE_UINT64, stats->bytes,
+        "min-size", G_TYPE_UINT64, stats->min_size,
+        "max-size", G_TYPE_UINT64, stats->max_size, NULL);
+    gst_structure_take_value (ks, "size-histogram", &bins);
+
+    g_value_init (&val, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&val, ks);
+    gst_value_array_append_and_take_value (&keys, &val);
+  }
+
+  s = gst_structure_new ("klvinspect-stats",
+      "duration", GST_TYPE_CLOCK_TIME, duration,
+      "buffers", G_TYPE_UINT64, filt->buffers,
+      "gap-buffers", G_TYPE_UINT64, filt->gap_buffers,
+      "max-gap", G_TYPE_UINT, filt->max_gap,
+      "other-packets", G_TYPE_UINT64, filt->other_packets, NULL);
+  gst_structure_take_value (s, "keys", &keys);
+  if (filt->skew_count > 0)
+    gst_structure_set (s,
+        "timestamp-skew-min", G_TYPE_INT64, filt->skew_min,
+        "timestamp-skew-max", G_TYPE_INT64, filt->skew_max,
+        "timestamp-skew-mean", G_TYPE_INT64,
+        filt->skew_sum / (gint64) filt->skew_count, NULL);
+
+  GST_INFO_OBJECT (filt, "%" GST_PTR_FORMAT, s);
+
+  gst_element_post_message (GST_ELEMENT (filt),
+      gst_message_new_element (GST_OBJECT (filt), s));
+}
+
+static gboolean
+gst_klvinspect_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstKlvInspect *filt = GST_KLVINSPECT (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS
+      && filt->mode == GST_KLVINSPECT_MODE_STATS && filt->buffers > 0) {
+    gst_klvinspect_post_stats (filt, trans->segment.position);
+    gst_klvinspect_reset_interval (filt, GST_CLOCK_TIME_NONE);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_klvinspect_parent_class)->sink_event
+      (trans, event);
+}
+
+static GstKlvInspectKeyStats *
+gst_klvinspect_get_key_stats (GstKlvInspect * filt, const guint8 * key)
+{
+  GstKlvInspectKeyStats *stats;
+  guint i;
+
+  for (i = 0; i < filt->n_keys; i++) {
+    if (memcmp (filt->keys[i].key, key, 16) == 0)
+      return &filt->keys[i];
+  }
+
+  if (filt->n_keys == GST_KLVINSPECT_MAX_KEYS)
+    return NULL;
+
+  stats = &filt->keys[filt->n_keys++];
+  memset (stats, 0, sizeof (*stats));
+  memcpy (stats->key, key, 16);
+  stats->min_size = G_MAXUINT64;
+
+  return stats;
+}
+
+static void
+gst_klvinspect_add_skew (GstKlvInspect * filt, const GstKLVPacket * packet,
+    GstClockTime pts)
+{
+  GstKLVST0601Decoder decoder;
+  guint64 timestamp;
+  gint64 offset, skew;
+
+  if (!gst_klv_st0601_decoder_init (&decoder, packet->data, packet->size)
+      || !gst_klv_st0601_decoder_get_uint64 (&decoder,
+          GST_KLV_ST0601_TAG_PRECISION_TIME_STAMP, &timestamp))
+    return;
+
+  /* precision time stamp is in microseconds, the drift against the buffer
+   * timestamps since the first packet is what matters */
+  offset = (gint64) (timestamp * GST_USECOND) - (gint64) pts;
+  if (!filt->have_skew_offset) {
+    filt->skew_offset = offset;
+    filt->have_skew_offset = TRUE;
+  }
+  skew = offset - filt->skew_offset;
+
+  filt->skew_min = MIN (filt->skew_min, skew);
+  filt->skew_max = MAX (filt->skew_max, skew);
+  filt->skew_sum += skew;
+  filt->skew_count++;
+}
+
+static void
+gst_klvinspect_update_stats (GstKlvInspect * filt, GstBuffer * buf)
+{
+  GstKLVMeta *klv_meta;
+  gpointer iter = NULL;
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+  gboolean found = FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (pts) && filt->interval > 0) {
+    if (!GST_CLOCK_TIME_IS_VALID (filt->interval_start)
+        || pts < filt->interval_start) {
+      filt->interval_start = pts;
+    } else if (pts >= filt->interval_start + filt->interval) {
+      gst_klvinspect_post_stats (filt, pts);
+      gst_klvinspect_reset_interval (filt, pts);
+    }
+  }
+
+  filt->buffers++;
+
+  while ((klv_meta = (GstKLVMeta *) gst_buffer_iterate_meta_filtered (buf,
+              &iter, GST_KLV_META_API_TYPE))) {
+    GstKLVReader reader;
+    GstKLVPacket packet;
+
+    gst_klv_reader_init_from_meta (&reader, klv_meta);
+    while (gst_klv_reader_next_packet (&reader, &packet)) {
+      GstKlvInspectKeyStats *stats;
+      guint bin;
+
+      found = TRUE;
+
+      stats = gst_klvinspect_get_key_stats (filt, packet.key);
+      if (stats == NULL) {
+        filt->other_packets++;
+        continue;
+      }
+
+      bin = packet.size > 64 ? g_bit_storage (packet.size - 1) - 6 : 0;
+      bin = MIN (bin, GST_KLVINSPECT_SIZE_BINS - 1);
+
+      stats->packets++;
+      stats->bytes += packet.size;
+      stats->min_size = MIN (stats->min_size, packet.size);
+      stats->max_size = MAX (stats->max_size, packet.size);
+      stats->size_bins[bin]++;
+
+      if (GST_CLOCK_TIME_IS_VALID (pts))
+        gst_klvinspect_add_skew (filt, &packet, pts);
+    }
+
+    if (gst_klv_reader_get_remaining (&reader) > 0)
+      GST_DEBUG_OBJECT (filt, "%" G_GSIZE_FORMAT " trailing bytes in KLV meta",
+          gst_klv_reader_get_remaining (&reader));
+  }
+
+  if (found) {
+    filt->gap = 0;
+  } else {
+    filt->gap_buffers++;
+    filt->gap++;
+    filt->max_gap = MAX (filt->max_gap, filt->gap);
+  }
 }
 
 static GstFlowReturn
@@ -107,6 +426,11 @@ gst_klvinspect_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
   gpointer iter = NULL;
   gint n_klv_meta_found = 0;
 
+  if (filt->mode == GST_KLVINSPECT_MODE_STATS) {
+    gst_klvinspect_update_stats (filt, buf);
+    return GST_FLOW_OK;
+  }
+
   while ((klv_meta = (GstKLVMeta *) gst_buffer_iterate_meta_filtered (buf,
               &iter, GST_KLV_META_API_TYPE))) {
     gsize klv_size;
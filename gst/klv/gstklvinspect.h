@@ -33,9 +33,53 @@ G_BEGIN_DECLS
 typedef struct _GstKlvInspect GstKlvInspect;
 typedef struct _GstKlvInspectClass GstKlvInspectClass;
 
+typedef enum
+{
+  GST_KLVINSPECT_MODE_DUMP,
+  GST_KLVINSPECT_MODE_STATS
+} GstKlvInspectMode;
+
+/* number of distinct keys tracked per interval */
+#define GST_KLVINSPECT_MAX_KEYS 16
+
+/* packet size histogram bins: <= 64, 128, ... 4096 bytes, and larger */
+#define GST_KLVINSPECT_SIZE_BINS 8
+
+typedef struct
+{
+  guint8 key[16];
+  guint64 packets;
+  guint64 bytes;
+  guint64 min_size;
+  guint64 max_size;
+  guint64 size_bins[GST_KLVINSPECT_SIZE_BINS];
+} GstKlvInspectKeyStats;
+
 struct _GstKlvInspect
 {
   GstBaseTransform base_klvinspect;
+
+  /* properties */
+  GstKlvInspectMode mode;
+  GstClockTime interval;
+
+  /* statistics of the current interval */
+  GstClockTime interval_start;
+  GstKlvInspectKeyStats keys[GST_KLVINSPECT_MAX_KEYS];
+  guint n_keys;
+  guint64 other_packets;
+  guint64 buffers;
+  guint64 gap_buffers;
+  guint max_gap;
+  guint64 skew_count;
+  gint64 skew_min;
+  gint64 skew_max;
+  gint64 skew_sum;
+
+  /* state kept across intervals */
+  guint gap;
+  gboolean have_skew_offset;
+  gint64 skew_offset;
 };
 
 struct _GstKlvInspectClass
@@ -0,0 +1,742 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:element-gstklvmux
+ *
+ * The klvmux element attaches a meta/x-klv stream to buffers of another
+ * stream as #GstKLVMeta, the reverse of klvdemux.
+ *
+ * KLV buffers are queued in a ring of up to #GstKlvMux:max-buffers entries.
+ * For each buffer on the sink pad the KLV buffer nearest in running time is
+ * found by binary search and attached if within #GstKlvMux:tolerance, along
+ * with any earlier queued KLV buffers still within tolerance, so no packet
+ * is attached twice. Before attaching, the element waits until the KLV
+ * stream has advanced past the buffer's running time plus the tolerance,
+ * either by a KLV buffer or a gap event, or until the ring is full.
+ *
+ * The wait is bounded by #GstKlvMux:timeout, so a sparse or live KLV stream
+ * that doesn't send gap events can't stall the other stream. Once the KLV
+ * stream missed the timeout, buffers pass without waiting until it delivers
+ * data again. Nothing waits while the klv_sink pad is unlinked or at EOS.
+ *
+ * The KLV data is wrapped, not copied.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch -v filesrc location=in.ts ! tsdemux name=d d. ! queue ! h264parse ! avdec_h264 ! klvmux name=m ! klvinspect ! fakesink d. ! queue ! m.klv_sink
+ * ]|
+ * Decodes video and reattaches the KLV stream recorded along with it.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include "gstklvmux.h"
+#include "klv.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_klvmux_debug_category);
+#define GST_CAT_DEFAULT gst_klvmux_debug_category
+
+/* prototypes */
+static void gst_klvmux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_klvmux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_klvmux_finalize (GObject * object);
+static GstStateChangeReturn gst_klvmux_change_state (GstElement * element,
+    GstStateChange transition);
+static GstFlowReturn gst_klvmux_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_klvmux_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static GstFlowReturn gst_klvmux_klv_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_klvmux_klv_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static gboolean gst_klvmux_klv_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+static gboolean gst_klvmux_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
+enum
+{
+  PROP_0,
+  PROP_TOLERANCE,
+  PROP_MAX_BUFFERS,
+  PROP_TIMEOUT
+};
+
+#define DEFAULT_PROP_TOLERANCE (40 * GST_MSECOND)
+#define DEFAULT_PROP_MAX_BUFFERS 32
+#define DEFAULT_PROP_TIMEOUT (100 * GST_MSECOND)
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_klvmux_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_klvmux_klv_sink_template =
+GST_STATIC_PAD_TEMPLATE ("klv_sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("meta/x-klv"));
+
+static GstStaticPadTemplate gst_klvmux_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstKlvMux, gst_klvmux, GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (gst_klvmux_debug_category, "klvmux", 0,
+        "debug category for klvmux element"));
+
+static void
+gst_klvmux_class_init (GstKlvMuxClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->set_property = gst_klvmux_set_property;
+  gobject_class->get_property = gst_klvmux_get_property;
+  gobject_class->finalize = gst_klvmux_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_TOLERANCE,
+      g_param_spec_uint64 ("tolerance", "Tolerance",
+          "Maximum running time difference between a buffer and the KLV "
+          "attached to it (in ns)", 0, 10 * GST_SECOND, DEFAULT_PROP_TOLERANCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_MAX_BUFFERS,
+      g_param_spec_uint ("max-buffers", "Max buffers",
+          "Maximum number of KLV buffers to queue", 1, G_MAXUINT16,
+          DEFAULT_PROP_MAX_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_TIMEOUT,
+      g_param_spec_uint64 ("timeout", "Timeout",
+          "Maximum time to wait for the KLV stream to catch up with a buffer "
+          "(in ns)", 0, 3600 * GST_SECOND, DEFAULT_PROP_TIMEOUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_klvmux_change_state);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvmux_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvmux_klv_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_klvmux_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "KLV muxer", "Muxer/Metadata",
+      "Attaches a KLV stream to buffers as metadata",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+}
+
+static void
+gst_klvmux_init (GstKlvMux * filt)
+{
+  filt->sinkpad =
+      gst_pad_new_from_static_template (&gst_klvmux_sink_template, "sink");
+  gst_pad_set_chain_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_chain));
+  gst_pad_set_event_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_sink_event));
+  GST_PAD_SET_PROXY_ALLOCATION (filt->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (filt), filt->sinkpad);
+
+  filt->klvsinkpad =
+      gst_pad_new_from_static_template (&gst_klvmux_klv_sink_template,
+      "klv_sink");
+  gst_pad_set_chain_function (filt->klvsinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_klv_chain));
+  gst_pad_set_event_function (filt->klvsinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_klv_sink_event));
+  gst_pad_set_query_function (filt->klvsinkpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_klv_sink_query));
+  GST_PAD_SET_ACCEPT_TEMPLATE (filt->klvsinkpad);
+  gst_element_add_pad (GST_ELEMENT (filt), filt->klvsinkpad);
+
+  filt->srcpad =
+      gst_pad_new_from_static_template (&gst_klvmux_src_template, "src");
+  gst_pad_set_query_function (filt->srcpad,
+      GST_DEBUG_FUNCPTR (gst_klvmux_src_query));
+  gst_element_add_pad (GST_ELEMENT (filt), filt->srcpad);
+
+  filt->tolerance = DEFAULT_PROP_TOLERANCE;
+  filt->max_buffers = DEFAULT_PROP_MAX_BUFFERS;
+  filt->timeout = DEFAULT_PROP_TIMEOUT;
+
+  g_mutex_init (&filt->lock);
+  g_cond_init (&filt->cond);
+
+  filt->klv_position = GST_CLOCK_TIME_NONE;
+  filt->video_flow = GST_FLOW_OK;
+  gst_segment_init (&filt->segment, GST_FORMAT_TIME);
+  gst_segment_init (&filt->klv_segment, GST_FORMAT_TIME);
+}
+
+static void
+gst_klvmux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstKlvMux *filt = GST_KLVMUX (object);
+
+  switch (prop_id) {
+    case PROP_TOLERANCE:
+      filt->tolerance = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_BUFFERS:
+      filt->max_buffers = g_value_get_uint (value);
+      break;
+    case PROP_TIMEOUT:
+      filt->timeout = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_klvmux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstKlvMux *filt = GST_KLVMUX (object);
+
+  switch (prop_id) {
+    case PROP_TOLERANCE:
+      g_value_set_uint64 (value, filt->tolerance);
+      break;
+    case PROP_MAX_BUFFERS:
+      g_value_set_uint (value, filt->max_buffers);
+      break;
+    case PROP_TIMEOUT:
+      g_value_set_uint64 (value, filt->timeout);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* ring helpers, all called with the lock held */
+
+static GstKlvMuxEntry *
+gst_klvmux_ring_get (GstKlvMux * filt, guint i)
+{
+  return &filt->ring[(filt->ring_head + i) % filt->ring_size];
+}
+
+/* drops the first @n entries */
+static void
+gst_klvmux_ring_pop (GstKlvMux * filt, guint n)
+{
+  while (n-- > 0) {
+    GstKlvMuxEntry *entry = gst_klvmux_ring_get (filt, 0);
+
+    gst_buffer_unref (entry->buffer);
+    entry->buffer = NULL;
+    filt->ring_head = (filt->ring_head + 1) % filt->ring_size;
+    filt->ring_count--;
+  }
+}
+
+static void
+gst_klvmux_ring_clear (GstKlvMux * filt)
+{
+  gst_klvmux_ring_pop (filt, filt->ring_count);
+  filt->ring_head = 0;
+}
+
+/* index of the first entry with running time >= @running_time, or
+ * ring_count if there is none */
+static guint
+gst_klvmux_ring_lower_bound (GstKlvMux * filt, GstClockTime running_time)
+{
+  guint lo = 0, hi = filt->ring_count;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (gst_klvmux_ring_get (filt, mid)->running_time < running_time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* drops entries too old for a buffer at @running_time or any later one */
+static void
+gst_klvmux_drop_stale (GstKlvMux * filt, GstClockTime running_time)
+{
+  guint stale = 0;
+
+  if (running_time > filt->tolerance)
+    stale = gst_klvmux_ring_lower_bound (filt, running_time - filt->tolerance);
+  if (stale) {
+    GST_DEBUG_OBJECT (filt, "Dropping %u stale KLV buffers", stale);
+    gst_klvmux_ring_pop (filt, stale);
+    g_cond_broadcast (&filt->cond);
+  }
+}
+
+static GstClockTime
+gst_klvmux_abs_diff (GstClockTime a, GstClockTime b)
+{
+  return a > b ? a - b : b - a;
+}
+
+static void
+gst_klvmux_finalize (GObject * object)
+{
+  GstKlvMux *filt = GST_KLVMUX (object);
+
+  if (filt->ring) {
+    gst_klvmux_ring_clear (filt);
+    g_free (filt->ring);
+  }
+  g_mutex_clear (&filt->lock);
+  g_cond_clear (&filt->cond);
+
+  G_OBJECT_CLASS (gst_klvmux_parent_class)->finalize (object);
+}
+
+static void
+gst_klvmux_reset (GstKlvMux * filt)
+{
+  gst_klvmux_ring_clear (filt);
+  filt->klv_position = GST_CLOCK_TIME_NONE;
+  filt->klv_eos = FALSE;
+  filt->klv_stalled = FALSE;
+  filt->video_eos = FALSE;
+  filt->video_flow = GST_FLOW_OK;
+  gst_segment_init (&filt->segment, GST_FORMAT_TIME);
+  gst_segment_init (&filt->klv_segment, GST_FORMAT_TIME);
+}
+
+static GstStateChangeReturn
+gst_klvmux_change_state (GstElement * element, GstStateChange transition)
+{
+  GstKlvMux *filt = GST_KLVMUX (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      g_mutex_lock (&filt->lock);
+      g_free (filt->ring);
+      filt->ring_size = filt->max_buffers;
+      filt->ring = g_new0 (GstKlvMuxEntry, filt->ring_size);
+      filt->ring_head = filt->ring_count = 0;
+      filt->klv_flushing = filt->video_flushing = FALSE;
+      gst_klvmux_reset (filt);
+      g_mutex_unlock (&filt->lock);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* unblock both streaming threads before the pads are deactivated */
+      g_mutex_lock (&filt->lock);
+      filt->klv_flushing = filt->video_flushing = TRUE;
+      g_cond_broadcast (&filt->cond);
+      g_mutex_unlock (&filt->lock);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_klvmux_parent_class)->change_state (element,
+      transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    g_mutex_lock (&filt->lock);
+    gst_klvmux_reset (filt);
+    g_mutex_unlock (&filt->lock);
+  }
+
+  return ret;
+}
+
+static void
+gst_klvmux_unmap_memory (gpointer data)
+{
+  GstMapInfo *map = data;
+  GstMemory *mem = map->memory;
+
+  gst_memory_unmap (mem, map);
+  gst_memory_unref (mem);
+  g_slice_free (GstMapInfo, map);
+}
+
+/* wraps each memory of @klv_buf as a GstKLVMeta on @buf */
+static void
+gst_klvmux_attach (GstKlvMux * filt, GstBuffer * buf, GstBuffer * klv_buf)
+{
+  guint i, n = gst_buffer_n_memory (klv_buf);
+
+  for (i = 0; i < n; i++) {
+    GstMemory *mem = gst_buffer_get_memory (klv_buf, i);
+    GstMapInfo *map = g_slice_new (GstMapInfo);
+    GBytes *bytes;
+
+    if (!gst_memory_map (mem, map, GST_MAP_READ)) {
+      GST_WARNING_OBJECT (filt, "Failed to map KLV memory");
+      gst_memory_unref (mem);
+      g_slice_free (GstMapInfo, map);
+      continue;
+    }
+
+    bytes = g_bytes_new_with_free_func (map->data, map->size,
+        gst_klvmux_unmap_memory, map);
+    if (!gst_buffer_add_klv_meta_take_bytes (buf, bytes))
+      GST_WARNING_OBJECT (filt, "Dropping invalid KLV packet");
+  }
+}
+
+static GstFlowReturn
+gst_klvmux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstKlvMux *filt = GST_KLVMUX (parent);
+  GQueue klv_bufs = G_QUEUE_INIT;
+  GstBuffer *klv_buf;
+  guint i;
+  GstClockTime ts, running_time;
+  GstFlowReturn ret;
+  gint64 end_time;
+
+  ts = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      GST_BUFFER_DTS (buf);
+  running_time = gst_segment_to_running_time (&filt->segment,
+      GST_FORMAT_TIME, ts);
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time)) {
+    GST_DEBUG_OBJECT (filt, "Buffer without valid timestamp, not muxing KLV");
+    goto push;
+  }
+
+  g_mutex_lock (&filt->lock);
+
+  end_time = g_get_monotonic_time () + filt->timeout / GST_USECOND;
+
+  /* wait until no later KLV can be within tolerance, dropping what is too
+   * old for this or any later buffer */
+  while (!filt->video_flushing && !filt->klv_eos && !filt->klv_stalled
+      && gst_pad_is_linked (filt->klvsinkpad)
+      && (!GST_CLOCK_TIME_IS_VALID (filt->klv_position)
+          || filt->klv_position < running_time + filt->tolerance)) {
+    gst_klvmux_drop_stale (filt, running_time);
+
+    if (filt->ring_count == filt->ring_size) {
+      GST_DEBUG_OBJECT (filt, "KLV queue full, not waiting");
+      break;
+    }
+
+    if (!g_cond_wait_until (&filt->cond, &filt->lock, end_time)) {
+      GST_DEBUG_OBJECT (filt, "KLV stream didn't advance within timeout, "
+          "not waiting for it until it does");
+      filt->klv_stalled = TRUE;
+      break;
+    }
+  }
+
+  if (filt->video_flushing) {
+    g_mutex_unlock (&filt->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+
+  /* also when not waiting, so a blocked KLV stream can make progress */
+  gst_klvmux_drop_stale (filt, running_time);
+
+  if (filt->ring_count > 0) {
+    guint nearest = gst_klvmux_ring_lower_bound (filt, running_time);
+    GstKlvMuxEntry *entry;
+
+    if (nearest == filt->ring_count || (nearest > 0
+            && running_time - gst_klvmux_ring_get (filt,
+                nearest - 1)->running_time <=
+            gst_klvmux_ring_get (filt, nearest)->running_time -
+            running_time))
+      nearest--;
+
+    entry = gst_klvmux_ring_get (filt, nearest);
+    if (gst_klvmux_abs_diff (entry->running_time,
+            running_time) <= filt->tolerance) {
+      /* also attach earlier entries still within tolerance, so KLV at a
+       * higher rate isn't lost, and drop anything older */
+      for (i = 0; i <= nearest; i++) {
+        entry = gst_klvmux_ring_get (filt, i);
+        if (gst_klvmux_abs_diff (entry->running_time,
+                running_time) > filt->tolerance)
+          continue;
+
+        g_queue_push_tail (&klv_bufs, gst_buffer_ref (entry->buffer));
+      }
+      gst_klvmux_ring_pop (filt, nearest + 1);
+      g_cond_broadcast (&filt->cond);
+    }
+  }
+
+  g_mutex_unlock (&filt->lock);
+
+  if (!g_queue_is_empty (&klv_bufs)) {
+    buf = gst_buffer_make_writable (buf);
+    while ((klv_buf = (GstBuffer *) g_queue_pop_head (&klv_bufs))) {
+      gst_klvmux_attach (filt, buf, klv_buf);
+      gst_buffer_unref (klv_buf);
+    }
+  }
+
+push:
+  ret = gst_pad_push (filt->srcpad, buf);
+
+  g_mutex_lock (&filt->lock);
+  filt->video_flow = ret;
+  g_mutex_unlock (&filt->lock);
+
+  return ret;
+}
+
+static gboolean
+gst_klvmux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstKlvMux *filt = GST_KLVMUX (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &filt->segment);
+      if (filt->segment.format != GST_FORMAT_TIME) {
+        GST_ELEMENT_ERROR (filt, STREAM, FORMAT, (NULL),
+            ("Only time segments are supported"));
+        gst_event_unref (event);
+        return FALSE;
+      }
+      break;
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&filt->lock);
+      filt->video_flushing = TRUE;
+      g_cond_broadcast (&filt->cond);
+      g_mutex_unlock (&filt->lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&filt->lock);
+      filt->video_flushing = FALSE;
+      filt->video_eos = FALSE;
+      filt->video_flow = GST_FLOW_OK;
+      g_mutex_unlock (&filt->lock);
+      gst_segment_init (&filt->segment, GST_FORMAT_TIME);
+      break;
+    case GST_EVENT_EOS:
+      g_mutex_lock (&filt->lock);
+      filt->video_eos = TRUE;
+      g_cond_broadcast (&filt->cond);
+      g_mutex_unlock (&filt->lock);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_push_event (filt->srcpad, event);
+}
+
+static GstFlowReturn
+gst_klvmux_klv_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstKlvMux *filt = GST_KLVMUX (parent);
+  GstClockTime ts, running_time;
+  GstKlvMuxEntry *entry;
+  GstFlowReturn ret;
+
+  ts = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      GST_BUFFER_DTS (buf);
+  running_time = gst_segment_to_running_time (&filt->klv_segment,
+      GST_FORMAT_TIME, ts);
+
+  g_mutex_lock (&filt->lock);
+
+  /* untimed KLV goes with whatever came before it */
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    running_time = filt->klv_position;
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time)) {
+    GST_DEBUG_OBJECT (filt, "Dropping KLV buffer without valid timestamp");
+    goto done;
+  }
+
+  while (!filt->klv_flushing && !filt->video_eos
+      && filt->ring_count == filt->ring_size)
+    g_cond_wait (&filt->cond, &filt->lock);
+
+  if (filt->klv_flushing) {
+    g_mutex_unlock (&filt->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+
+  if (filt->video_eos)
+    goto done;
+
+  /* keep the ring sorted, KLV going back in time replaces what is queued */
+  if (filt->ring_count > 0
+      && gst_klvmux_ring_get (filt,
+          filt->ring_count - 1)->running_time > running_time) {
+    GST_WARNING_OBJECT (filt, "KLV running time went backwards, flushing");
+    gst_klvmux_ring_clear (filt);
+  }
+
+  entry = gst_klvmux_ring_get (filt, filt->ring_count++);
+  entry->buffer = buf;
+  entry->running_time = running_time;
+  buf = NULL;
+
+  if (GST_CLOCK_TIME_IS_VALID (GST_BUFFER_DURATION (entry->buffer)))
+    running_time += GST_BUFFER_DURATION (entry->buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (filt->klv_position)
+      || running_time > filt->klv_position)
+    filt->klv_position = running_time;
+  filt->klv_stalled = FALSE;
+
+  g_cond_broadcast (&filt->cond);
+
+done:
+  /* report errors downstream of the video stream upstream, but keep the KLV
+   * stream flowing otherwise */
+  ret = filt->video_flow < GST_FLOW_OK && filt->video_flow != GST_FLOW_EOS ?
+      filt->video_flow : GST_FLOW_OK;
+  g_mutex_unlock (&filt->lock);
+
+  if (buf)
+    gst_buffer_unref (buf);
+
+  return ret;
+}
+
+static gboolean
+gst_klvmux_klv_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstKlvMux *filt = GST_KLVMUX (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &filt->klv_segment);
+      if (filt->klv_segment.format != GST_FORMAT_TIME) {
+        GST_ELEMENT_ERROR (filt, STREAM, FORMAT, (NULL),
+            ("Only time segments are supported"));
+        gst_event_unref (event);
+        return FALSE;
+      }
+      break;
+    case GST_EVENT_GAP:
+    {
+      GstClockTime ts, duration, running_time;
+
+      gst_event_parse_gap (event, &ts, &duration);
+      if (GST_CLOCK_TIME_IS_VALID (duration))
+        ts += duration;
+      running_time = gst_segment_to_running_time (&filt->klv_segment,
+          GST_FORMAT_TIME, ts);
+
+      g_mutex_lock (&filt->lock);
+      if (GST_CLOCK_TIME_IS_VALID (running_time)
+          && (!GST_CLOCK_TIME_IS_VALID (filt->klv_position)
+              || running_time > filt->klv_position)) {
+        filt->klv_position = running_time;
+        filt->klv_stalled = FALSE;
+        g_cond_broadcast (&filt->cond);
+      }
+      g_mutex_unlock (&filt->lock);
+      break;
+    }
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&filt->lock);
+      filt->klv_flushing = TRUE;
+      g_cond_broadcast (&filt->cond);
+      g_mutex_unlock (&filt->lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&filt->lock);
+      filt->klv_flushing = FALSE;
+      filt->klv_eos = FALSE;
+      filt->klv_stalled = FALSE;
+      filt->klv_position = GST_CLOCK_TIME_NONE;
+      gst_klvmux_ring_clear (filt);
+      g_mutex_unlock (&filt->lock);
+      gst_segment_init (&filt->klv_segment, GST_FORMAT_TIME);
+      break;
+    case GST_EVENT_EOS:
+      g_mutex_lock (&filt->lock);
+      filt->klv_eos = TRUE;
+      g_cond_broadcast (&filt->cond);
+      g_mutex_unlock (&filt->lock);
+      break;
+    default:
+      break;
+  }
+
+  /* the KLV stream ends here */
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static gboolean
+gst_klvmux_klv_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    {
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *tmp = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = tmp;
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    case GST_QUERY_ACCEPT_CAPS:
+      return gst_pad_query_default (pad, parent, query);
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_klvmux_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstKlvMux *filt = GST_KLVMUX (parent);
+
+  /* queries concern the stream the KLV is attached to */
+  return gst_pad_peer_query (filt->sinkpad, query);
+}
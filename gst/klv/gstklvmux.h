@@ -0,0 +1,87 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_KLVMUX_H_
+#define _GST_KLVMUX_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_KLVMUX   (gst_klvmux_get_type())
+#define GST_KLVMUX(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_KLVMUX,GstKlvMux))
+#define GST_KLVMUX_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_KLVMUX,GstKlvMuxClass))
+#define GST_IS_KLVMUX(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_KLVMUX))
+#define GST_IS_KLVMUX_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_KLVMUX))
+
+typedef struct _GstKlvMux GstKlvMux;
+typedef struct _GstKlvMuxClass GstKlvMuxClass;
+
+typedef struct
+{
+  GstBuffer *buffer;
+  GstClockTime running_time;
+} GstKlvMuxEntry;
+
+struct _GstKlvMux
+{
+  GstElement element;
+
+  GstPad *sinkpad;
+  GstPad *klvsinkpad;
+  GstPad *srcpad;
+
+  /* properties */
+  GstClockTime tolerance;
+  guint max_buffers;
+  GstClockTime timeout;
+
+  /* pending KLV buffers in running time order, protected by lock */
+  GMutex lock;
+  GCond cond;
+  GstKlvMuxEntry *ring;
+  guint ring_size;
+  guint ring_head;
+  guint ring_count;
+
+  /* running time up to which the KLV stream is known */
+  GstClockTime klv_position;
+  gboolean klv_eos;
+  /* the KLV stream didn't advance within timeout, don't wait on it again
+   * until it does */
+  gboolean klv_stalled;
+  gboolean klv_flushing;
+  gboolean video_eos;
+  gboolean video_flushing;
+  GstFlowReturn video_flow;
+
+  GstSegment segment;
+  GstSegment klv_segment;
+};
+
+struct _GstKlvMuxClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_klvmux_get_type (void);
+
+G_END_DECLS
+
+#endif /* _GST_KLVMUX_H_ */
@@ -27,6 +27,7 @@
 
 #include "gstmisbirpack.h"
 #include "gstmisbirunpack.h"
+#include "gstmisbirlevels.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -48,6 +49,12 @@ plugin_init (GstPlugin * plugin)
     return FALSE;
   }
 
+  GST_CAT_INFO (GST_CAT_DEFAULT, "registering misbirlevels element");
+  if (!gst_element_register (plugin, "misbirlevels", GST_RANK_NONE,
+          GST_TYPE_MISB_IR_LEVELS)) {
+    return FALSE;
+  }
+
   return TRUE;
 }
 
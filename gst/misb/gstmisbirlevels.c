@@ -0,0 +1,691 @@
+/* GStreamer
+ * Copyright (C) 2018 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+* SECTION:element-misbirlevels
+*
+* Unpack MISB IR packed video and convert it to GRAY8 through a levels lookup
+* table in a single pass. This is equivalent to misbirunpack ! videolevels,
+* but never writes the intermediate GRAY16 frame to memory. When auto
+* adjustment is enabled the histogram is built while unpacking, so the levels
+* computed from one frame are applied starting with the next frame.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch videotestsrc ! misbirpack ! misbirlevels auto=continuous ! autovideosink
+* ]|
+* </refsect2>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstmisbirlevels.h"
+
+#include <gst/video/video.h>
+
+/* GstMisbIrLevels signals and args */
+enum
+{
+  /* FILL ME */
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_OFFSET,
+  PROP_SHIFT,
+  PROP_SWAP,
+  PROP_LUMA_MASK,
+  PROP_CHROMA_MASK,
+  PROP_LOWIN,
+  PROP_HIGHIN,
+  PROP_LOWOUT,
+  PROP_HIGHOUT,
+  PROP_AUTO,
+  PROP_INTERVAL,
+  PROP_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+
+#define DEFAULT_PROP_OFFSET -64
+#define DEFAULT_PROP_SHIFT 8
+#define DEFAULT_PROP_SWAP FALSE
+#define DEFAULT_PROP_LUMA_MASK 0xff
+#define DEFAULT_PROP_CHROMA_MASK 0xff
+#define DEFAULT_PROP_LOWIN  0
+#define DEFAULT_PROP_HIGHIN  65535
+#define DEFAULT_PROP_LOWOUT  0
+#define DEFAULT_PROP_HIGHOUT  255
+#define DEFAULT_PROP_AUTO GST_MISB_IR_LEVELS_AUTO_OFF
+#define DEFAULT_PROP_INTERVAL (GST_SECOND / 2)
+
+/* 4096 histogram bins over the 16-bit unpacked range */
+#define HISTOGRAM_SHIFT 4
+#define HISTOGRAM_NBINS (65536 >> HISTOGRAM_SHIFT)
+
+/* the capabilities of the inputs and outputs */
+static GstStaticPadTemplate gst_misb_ir_levels_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ v210, UYVY }"))
+    );
+
+static GstStaticPadTemplate gst_misb_ir_levels_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("GRAY8"))
+    );
+
+#define GST_TYPE_MISB_IR_LEVELS_AUTO (gst_misb_ir_levels_auto_get_type())
+static GType
+gst_misb_ir_levels_auto_get_type (void)
+{
+  static GType misb_ir_levels_auto_type = 0;
+  static const GEnumValue misb_ir_levels_auto[] = {
+    {GST_MISB_IR_LEVELS_AUTO_OFF, "off", "off"},
+    {GST_MISB_IR_LEVELS_AUTO_SINGLE, "single", "single"},
+    {GST_MISB_IR_LEVELS_AUTO_CONTINUOUS, "continuous", "continuous"},
+    {0, NULL, NULL},
+  };
+
+  if (!misb_ir_levels_auto_type) {
+    misb_ir_levels_auto_type =
+        g_enum_register_static ("GstMisbIrLevelsAuto", misb_ir_levels_auto);
+  }
+  return misb_ir_levels_auto_type;
+}
+
+/* GObject vmethod declarations */
+static void gst_misb_ir_levels_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_misb_ir_levels_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_misb_ir_levels_dispose (GObject * object);
+
+/* GstBaseTransform vmethod declarations */
+static GstCaps *gst_misb_ir_levels_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter_caps);
+
+/* GstVideoFilter vmethod declarations */
+static gboolean gst_misb_ir_levels_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_misb_ir_levels_transform_frame (GstVideoFilter *
+    filter, GstVideoFrame * in_frame, GstVideoFrame * out_frame);
+
+/* GstMisbIrLevels method declarations */
+static void gst_misb_ir_levels_reset (GstMisbIrLevels * filter);
+static void gst_misb_ir_levels_calculate_lut (GstMisbIrLevels * filt);
+static void gst_misb_ir_levels_auto_adjust (GstMisbIrLevels * filt,
+    gint npixels);
+
+/* setup debug */
+GST_DEBUG_CATEGORY_STATIC (misb_ir_levels_debug);
+#define GST_CAT_DEFAULT misb_ir_levels_debug
+
+G_DEFINE_TYPE (GstMisbIrLevels, gst_misb_ir_levels, GST_TYPE_VIDEO_FILTER);
+
+/************************************************************************/
+/* GObject vmethod implementations                                      */
+/************************************************************************/
+
+/**
+ * gst_misb_ir_levels_dispose:
+ * @object: #GObject.
+ *
+ */
+static void
+gst_misb_ir_levels_dispose (GObject * object)
+{
+  GstMisbIrLevels *misb_ir_levels = GST_MISB_IR_LEVELS (object);
+
+  GST_DEBUG ("dispose");
+
+  gst_misb_ir_levels_reset (misb_ir_levels);
+
+  g_free (misb_ir_levels->lookup_table);
+  misb_ir_levels->lookup_table = NULL;
+  g_free (misb_ir_levels->histogram);
+  misb_ir_levels->histogram = NULL;
+
+  /* chain up to the parent class */
+  G_OBJECT_CLASS (gst_misb_ir_levels_parent_class)->dispose (object);
+}
+
+/**
+ * gst_misb_ir_levels_class_init:
+ * @object: #GstMisbIrLevelsClass.
+ *
+ */
+static void
+gst_misb_ir_levels_class_init (GstMisbIrLevelsClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *gstbasetransform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *gstvideofilter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (misb_ir_levels_debug, "misbirlevels", 0,
+      "MISB IR unpack and levels filter");
+
+  GST_DEBUG ("class init");
+
+  /* Register GObject vmethods */
+  gobject_class->dispose = GST_DEBUG_FUNCPTR (gst_misb_ir_levels_dispose);
+  gobject_class->set_property =
+      GST_DEBUG_FUNCPTR (gst_misb_ir_levels_set_property);
+  gobject_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_misb_ir_levels_get_property);
+
+  /* Install GObject properties */
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_OFFSET, g_param_spec_int ("offset",
+          "Offset value",
+          "Offset value to apply during unpacking", -0xffff, 0xffff,
+          DEFAULT_PROP_OFFSET, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_SHIFT, g_param_spec_uint ("shift",
+          "Shift value",
+          "Bits to left shift luminance component during unpacking", 0, 15,
+          DEFAULT_PROP_SHIFT, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_SWAP, g_param_spec_boolean ("swap", "Swap luma and chroma",
+          "Whether to swap luminance and chrominance components",
+          DEFAULT_PROP_SWAP, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_LUMA_MASK, g_param_spec_uint ("luma-mask",
+          "Luma mask",
+          "Mask to bitwise AND with luma after applying offset", 0, 0xffff,
+          DEFAULT_PROP_LUMA_MASK, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CHROMA_MASK, g_param_spec_uint ("chroma-mask",
+          "Chroma mask",
+          "Mask to bitwise AND with chroma after applying offset", 0, 0xffff,
+          DEFAULT_PROP_CHROMA_MASK,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+
+  properties[PROP_LOWIN] =
+      g_param_spec_int ("lower-input-level", "Lower Input Level",
+      "Lower Input Level", 0, DEFAULT_PROP_HIGHIN, DEFAULT_PROP_LOWIN,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_HIGHIN] =
+      g_param_spec_int ("upper-input-level", "Upper Input Level",
+      "Upper Input Level", 0, DEFAULT_PROP_HIGHIN, DEFAULT_PROP_HIGHIN,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_LOWOUT] =
+      g_param_spec_int ("lower-output-level", "Lower Output Level",
+      "Lower Output Level", 0, DEFAULT_PROP_HIGHOUT, DEFAULT_PROP_LOWOUT,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_HIGHOUT] =
+      g_param_spec_int ("upper-output-level", "Upper Output Level",
+      "Upper Output Level", 0, DEFAULT_PROP_HIGHOUT, DEFAULT_PROP_HIGHOUT,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  properties[PROP_AUTO] =
+      g_param_spec_enum ("auto", "Auto Adjust", "Auto adjust contrast",
+      GST_TYPE_MISB_IR_LEVELS_AUTO, DEFAULT_PROP_AUTO,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (gobject_class, PROP_LOWIN,
+      properties[PROP_LOWIN]);
+  g_object_class_install_property (gobject_class, PROP_HIGHIN,
+      properties[PROP_HIGHIN]);
+  g_object_class_install_property (gobject_class, PROP_LOWOUT,
+      properties[PROP_LOWOUT]);
+  g_object_class_install_property (gobject_class, PROP_HIGHOUT,
+      properties[PROP_HIGHOUT]);
+  g_object_class_install_property (gobject_class, PROP_AUTO,
+      properties[PROP_AUTO]);
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint64 ("interval", "Interval",
+          "Interval of time between adjustments (in nanoseconds)", 1,
+          G_MAXUINT64, DEFAULT_PROP_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_misb_ir_levels_sink_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_misb_ir_levels_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Unpack MISB IR video with levels", "Filter/Effect/Video",
+      "Unpack MISB IR video according to ST 0402.2 Method 2 and adjust "
+      "levels to GRAY8 in a single pass",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  /* Register GstBaseTransform vmethods */
+  gstbasetransform_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_misb_ir_levels_transform_caps);
+
+  gstvideofilter_class->set_info =
+      GST_DEBUG_FUNCPTR (gst_misb_ir_levels_set_info);
+  gstvideofilter_class->transform_frame =
+      GST_DEBUG_FUNCPTR (gst_misb_ir_levels_transform_frame);
+}
+
+static void
+gst_misb_ir_levels_init (GstMisbIrLevels * filt)
+{
+  GST_DEBUG_OBJECT (filt, "init class instance");
+
+  filt->offset_value = DEFAULT_PROP_OFFSET;
+  filt->shift_value = DEFAULT_PROP_SHIFT;
+  filt->swap = DEFAULT_PROP_SWAP;
+  filt->luma_mask = DEFAULT_PROP_LUMA_MASK;
+  filt->chroma_mask = DEFAULT_PROP_CHROMA_MASK;
+
+  filt->lower_input = DEFAULT_PROP_LOWIN;
+  filt->upper_input = DEFAULT_PROP_HIGHIN;
+  filt->lower_output = DEFAULT_PROP_LOWOUT;
+  filt->upper_output = DEFAULT_PROP_HIGHOUT;
+  filt->auto_adjust = DEFAULT_PROP_AUTO;
+  filt->interval = DEFAULT_PROP_INTERVAL;
+  filt->lower_pix_sat = 0.01f;
+  filt->upper_pix_sat = 0.01f;
+
+  filt->lookup_table = g_new (guint8, G_MAXUINT16 + 1);
+  filt->histogram = g_new (guint, HISTOGRAM_NBINS);
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filt), FALSE);
+
+  gst_misb_ir_levels_reset (filt);
+  gst_misb_ir_levels_calculate_lut (filt);
+}
+
+static void
+gst_misb_ir_levels_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMisbIrLevels *filt = GST_MISB_IR_LEVELS (object);
+
+  GST_DEBUG_OBJECT (filt, "setting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_OFFSET:
+      filt->offset_value = g_value_get_int (value);
+      break;
+    case PROP_SHIFT:
+      filt->shift_value = g_value_get_uint (value);
+      break;
+    case PROP_SWAP:
+      filt->swap = g_value_get_boolean (value);
+      break;
+    case PROP_LUMA_MASK:
+      filt->luma_mask = g_value_get_uint (value);
+      break;
+    case PROP_CHROMA_MASK:
+      filt->chroma_mask = g_value_get_uint (value);
+      break;
+    case PROP_LOWIN:
+      filt->lower_input = g_value_get_int (value);
+      gst_misb_ir_levels_calculate_lut (filt);
+      break;
+    case PROP_HIGHIN:
+      filt->upper_input = g_value_get_int (value);
+      gst_misb_ir_levels_calculate_lut (filt);
+      break;
+    case PROP_LOWOUT:
+      filt->lower_output = g_value_get_int (value);
+      gst_misb_ir_levels_calculate_lut (filt);
+      break;
+    case PROP_HIGHOUT:
+      filt->upper_output = g_value_get_int (value);
+      gst_misb_ir_levels_calculate_lut (filt);
+      break;
+    case PROP_AUTO:
+      filt->auto_adjust = g_value_get_enum (value);
+      break;
+    case PROP_INTERVAL:
+      filt->interval = g_value_get_uint64 (value);
+      filt->last_auto_timestamp = GST_CLOCK_TIME_NONE;
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_misb_ir_levels_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMisbIrLevels *filt = GST_MISB_IR_LEVELS (object);
+
+  GST_DEBUG_OBJECT (filt, "getting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_OFFSET:
+      g_value_set_int (value, filt->offset_value);
+      break;
+    case PROP_SHIFT:
+      g_value_set_uint (value, filt->shift_value);
+      break;
+    case PROP_SWAP:
+      g_value_set_boolean (value, filt->swap);
+      break;
+    case PROP_LUMA_MASK:
+      g_value_set_uint (value, filt->luma_mask);
+      break;
+    case PROP_CHROMA_MASK:
+      g_value_set_uint (value, filt->chroma_mask);
+      break;
+    case PROP_LOWIN:
+      g_value_set_int (value, filt->lower_input);
+      break;
+    case PROP_HIGHIN:
+      g_value_set_int (value, filt->upper_input);
+      break;
+    case PROP_LOWOUT:
+      g_value_set_int (value, filt->lower_output);
+      break;
+    case PROP_HIGHOUT:
+      g_value_set_int (value, filt->upper_output);
+      break;
+    case PROP_AUTO:
+      g_value_set_enum (value, filt->auto_adjust);
+      break;
+    case PROP_INTERVAL:
+      g_value_set_uint64 (value, filt->interval);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+GstCaps *
+gst_misb_ir_levels_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter_caps)
+{
+  GstMisbIrLevels *filt = GST_MISB_IR_LEVELS (trans);
+  GstStructure *structure, *newstruct;
+  GstCaps *newcaps;
+  guint i, n;
+
+  GST_LOG_OBJECT (filt, "transforming caps from %" GST_PTR_FORMAT, caps);
+
+  newcaps = gst_caps_new_empty ();
+  n = gst_caps_get_size (caps);
+  for (i = 0; i < n; ++i) {
+    structure = gst_caps_get_structure (caps, i);
+    if (direction == GST_PAD_SINK) {
+      newstruct = gst_structure_new_from_string ("video/x-raw,format=GRAY8");
+    } else {
+      newstruct =
+          gst_structure_new_from_string ("video/x-raw,format={v210,UYVY}");
+    }
+
+    gst_structure_set_value (newstruct, "width",
+        gst_structure_get_value (structure, "width"));
+    gst_structure_set_value (newstruct, "height",
+        gst_structure_get_value (structure, "height"));
+    gst_structure_set_value (newstruct, "framerate",
+        gst_structure_get_value (structure, "framerate"));
+
+    gst_caps_append_structure (newcaps, newstruct);
+  }
+
+
+  if (!gst_caps_is_empty (newcaps) && filter_caps) {
+    GstCaps *tmp = gst_caps_intersect_full (filter_caps, newcaps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_replace (&newcaps, tmp);
+    gst_caps_unref (tmp);
+  }
+
+  GST_LOG_OBJECT (filt, "transformed caps to %" GST_PTR_FORMAT, newcaps);
+
+  return newcaps;
+}
+
+static gboolean
+gst_misb_ir_levels_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstMisbIrLevels *filt = GST_MISB_IR_LEVELS (filter);
+  gboolean res = TRUE;
+
+  GST_DEBUG_OBJECT (filt,
+      "set_caps: in %" GST_PTR_FORMAT " out %" GST_PTR_FORMAT, incaps, outcaps);
+
+  memcpy (&filt->info_in, in_info, sizeof (GstVideoInfo));
+  memcpy (&filt->info_out, out_info, sizeof (GstVideoInfo));
+
+  filt->last_auto_timestamp = GST_CLOCK_TIME_NONE;
+
+  return res;
+}
+
+/* unpack a single pixel exactly as misbirunpack does, then histogram it (if
+ * requested) and map it through the lookup table */
+#define UNPACK_PIXEL(chroma, luma) \
+  G_STMT_START { \
+    guint16 _val; \
+    if (swap) { \
+      _val = ((luma + offset) & chroma_mask) | \
+          (((chroma + offset) & luma_mask) << shift); \
+    } else { \
+      _val = ((chroma + offset) & chroma_mask) | \
+          (((luma + offset) & luma_mask) << shift); \
+    } \
+    if (hist) \
+      hist[_val >> HISTOGRAM_SHIFT]++; \
+    dst[x++] = lut[_val]; \
+  } G_STMT_END
+
+static void
+gst_misb_ir_levels_process (GstMisbIrLevels * filt, GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint * hist)
+{
+  const gint16 offset = filt->offset_value;
+  const guint shift = filt->shift_value;
+  const gboolean swap = filt->swap;
+  const guint luma_mask = filt->luma_mask;
+  const guint chroma_mask = filt->chroma_mask;
+  const guint8 *lut = filt->lookup_table;
+  const gint width = GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0);
+  const gint height = GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0);
+  gint x, y;
+  guint8 *dst;
+
+  if (filt->info_in.finfo->format == GST_VIDEO_FORMAT_v210) {
+    for (y = 0; y < height; y++) {
+      guint32 *src = (guint32 *) (GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0));
+      dst = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (out_frame, 0) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0);
+
+      /* three pixels per pair of 32-bit words */
+      for (x = 0; x + 2 < width;) {
+        guint32 word0 = *src++;
+        guint32 word1 = *src++;
+
+        UNPACK_PIXEL (word0 & 0x3ff, (word0 & 0xffc00) >> 10);
+        UNPACK_PIXEL ((word0 & 0x3ff00000) >> 20, word1 & 0x3ff);
+        UNPACK_PIXEL ((word1 & 0xffc00) >> 10, (word1 & 0x3ff00000) >> 20);
+      }
+
+      /* handle the last one or two pixels if they exist */
+      if (x < width) {
+        guint32 word0 = *src++;
+        guint32 word1 = *src++;
+
+        UNPACK_PIXEL (word0 & 0x3ff, (word0 & 0xffc00) >> 10);
+        if (x < width)
+          UNPACK_PIXEL ((word0 & 0x3ff00000) >> 20, word1 & 0x3ff);
+      }
+    }
+  } else if (filt->info_in.finfo->format == GST_VIDEO_FORMAT_UYVY) {
+    for (y = 0; y < height; y++) {
+      guint8 *src = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0);
+      dst = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (out_frame, 0) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0);
+
+      for (x = 0; x < width;) {
+        guint8 chroma = src[0];
+        guint8 luma = src[1];
+        src += 2;
+
+        UNPACK_PIXEL (chroma, luma);
+      }
+    }
+  }
+}
+
+#undef UNPACK_PIXEL
+
+static GstFlowReturn
+gst_misb_ir_levels_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+{
+  GstMisbIrLevels *filt = GST_MISB_IR_LEVELS (filter);
+  GstClockTime timestamp = GST_BUFFER_TIMESTAMP (in_frame->buffer);
+  gboolean collect = FALSE;
+
+  GST_LOG_OBJECT (filt, "Performing non-inplace transform");
+
+  if (filt->auto_adjust == GST_MISB_IR_LEVELS_AUTO_SINGLE) {
+    collect = TRUE;
+  } else if (filt->auto_adjust == GST_MISB_IR_LEVELS_AUTO_CONTINUOUS) {
+    GstClockTimeDiff elapsed =
+        GST_CLOCK_DIFF (filt->last_auto_timestamp, timestamp);
+    if (filt->last_auto_timestamp == GST_CLOCK_TIME_NONE
+        || elapsed >= (GstClockTimeDiff) filt->interval || elapsed < 0) {
+      collect = TRUE;
+    }
+  }
+
+  if (collect)
+    memset (filt->histogram, 0, sizeof (guint) * HISTOGRAM_NBINS);
+
+  gst_misb_ir_levels_process (filt, in_frame, out_frame,
+      collect ? filt->histogram : NULL);
+
+  if (collect) {
+    /* the new levels apply from the next frame on */
+    gst_misb_ir_levels_auto_adjust (filt,
+        GST_VIDEO_FRAME_WIDTH (in_frame) * GST_VIDEO_FRAME_HEIGHT (in_frame));
+
+    if (filt->auto_adjust == GST_MISB_IR_LEVELS_AUTO_SINGLE) {
+      GST_DEBUG_OBJECT (filt, "Auto adjusted levels (once)");
+      filt->auto_adjust = GST_MISB_IR_LEVELS_AUTO_OFF;
+      g_object_notify_by_pspec (G_OBJECT (filt), properties[PROP_AUTO]);
+    } else {
+      filt->last_auto_timestamp = timestamp;
+    }
+  }
+
+  return GST_FLOW_OK;
+}
+
+/************************************************************************/
+/* GstMisbIrLevels method implementations                               */
+/************************************************************************/
+
+#define GUINT8_CLAMP(x, low, high) ((guint8)(CLAMP((x),(low),(high))))
+
+static void
+gst_misb_ir_levels_calculate_lut (GstMisbIrLevels * filt)
+{
+  gint i;
+  gdouble m;
+  gdouble b;
+  guint8 *lut = filt->lookup_table;
+  const gint low_in = filt->lower_input;
+  const gint high_in = filt->upper_input;
+  const guint8 low_out = filt->lower_output;
+  const guint8 high_out = filt->upper_output;
+
+  GST_LOG_OBJECT (filt, "Make linear LUT mapping (%d, %d) -> (%d, %d)",
+      low_in, high_in, low_out, high_out);
+
+  if (low_in == high_in)
+    m = 0.0;
+  else
+    m = (high_out - low_out) / (gdouble) (high_in - low_in);
+
+  b = low_out - m * low_in;
+
+  for (i = 0; i <= G_MAXUINT16; i++)
+    lut[i] = GUINT8_CLAMP (m * i + b, low_out, high_out);
+}
+
+/**
+* gst_misb_ir_levels_auto_adjust
+* @filt: #GstMisbIrLevels
+* @npixels: number of pixels accumulated in the histogram
+*
+* Calculate lower and upper levels from the histogram gathered during the
+* last unpack, and update the lookup table.
+*/
+static void
+gst_misb_ir_levels_auto_adjust (GstMisbIrLevels * filt, gint npixels)
+{
+  guint npixsat;
+  guint sum;
+  gint i;
+
+  /* pixels to saturate on low end */
+  npixsat = (guint) (filt->lower_pix_sat * npixels);
+  sum = 0;
+  for (i = 0; i < HISTOGRAM_NBINS; i++) {
+    sum += filt->histogram[i];
+    if (sum > npixsat) {
+      filt->lower_input = i << HISTOGRAM_SHIFT;
+      break;
+    }
+  }
+
+  /* pixels to saturate on high end */
+  npixsat = (guint) (filt->upper_pix_sat * npixels);
+  sum = 0;
+  for (i = HISTOGRAM_NBINS - 1; i >= 0; i--) {
+    sum += filt->histogram[i];
+    if (sum > npixsat) {
+      filt->upper_input = ((i + 1) << HISTOGRAM_SHIFT) - 1;
+      break;
+    }
+  }
+
+  gst_misb_ir_levels_calculate_lut (filt);
+
+  GST_LOG_OBJECT (filt, "Contrast stretch with npixsat=%d, (%d, %d)",
+      npixsat, filt->lower_input, filt->upper_input);
+
+  g_object_notify_by_pspec (G_OBJECT (filt), properties[PROP_LOWIN]);
+  g_object_notify_by_pspec (G_OBJECT (filt), properties[PROP_HIGHIN]);
+}
+
+static void
+gst_misb_ir_levels_reset (GstMisbIrLevels * misb_ir_levels)
+{
+  gst_video_info_init (&misb_ir_levels->info_in);
+  gst_video_info_init (&misb_ir_levels->info_out);
+
+  misb_ir_levels->last_auto_timestamp = GST_CLOCK_TIME_NONE;
+}
@@ -0,0 +1,106 @@
+/* GStreamer
+ * Copyright (C) 2018 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_MISB_IR_LEVELS_H__
+#define __GST_MISB_IR_LEVELS_H__
+
+#include <gst/video/gstvideofilter.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_MISB_IR_LEVELS \
+  (gst_misb_ir_levels_get_type())
+#define GST_MISB_IR_LEVELS(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_MISB_IR_LEVELS,GstMisbIrLevels))
+#define GST_MISB_IR_LEVELS_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_MISB_IR_LEVELS,GstMisbIrLevelsClass))
+#define GST_IS_MISB_IR_LEVELS(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_MISB_IR_LEVELS))
+#define GST_IS_MISB_IR_LEVELS_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_MISB_IR_LEVELS))
+
+typedef struct _GstMisbIrLevels GstMisbIrLevels;
+typedef struct _GstMisbIrLevelsClass GstMisbIrLevelsClass;
+
+/**
+* GstMisbIrLevelsAuto:
+* @GST_MISB_IR_LEVELS_AUTO_OFF: don't perform auto adjustment
+* @GST_MISB_IR_LEVELS_AUTO_SINGLE: perform auto adjustment once
+* @GST_MISB_IR_LEVELS_AUTO_CONTINUOUS: perform auto adjustment continuously (defined by "interval" property)
+*
+* Auto adjustment mode, same semantics as videolevels.
+*/
+typedef enum {
+  GST_MISB_IR_LEVELS_AUTO_OFF,
+  GST_MISB_IR_LEVELS_AUTO_SINGLE,
+  GST_MISB_IR_LEVELS_AUTO_CONTINUOUS
+} GstMisbIrLevelsAuto;
+
+/**
+* GstMisbIrLevels:
+* @element: the parent element.
+*
+*
+* The opaque GstMisbIrLevels data structure.
+*/
+struct _GstMisbIrLevels
+{
+  GstVideoFilter element;
+
+  /* format */
+  GstVideoInfo info_in;
+  GstVideoInfo info_out;
+
+  /* unpack properties */
+  gint offset_value;
+  guint shift_value;
+  gboolean swap;
+  guint luma_mask;
+  guint chroma_mask;
+
+  /* levels properties */
+  gint lower_input;
+  gint upper_input;
+  gint lower_output;
+  gint upper_output;
+
+  GstMisbIrLevelsAuto auto_adjust;
+  guint64 interval;
+  gfloat lower_pix_sat;
+  gfloat upper_pix_sat;
+
+  /* tables */
+  guint8 *lookup_table;
+  guint *histogram;
+
+  GstClockTime last_auto_timestamp;
+};
+
+struct _GstMisbIrLevelsClass
+{
+  GstVideoFilterClass parent_class;
+};
+
+GType gst_misb_ir_levels_get_type(void);
+
+G_END_DECLS
+
+#endif /* __GST_MISB_IR_LEVELS_H__ */
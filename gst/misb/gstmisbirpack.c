@@ -55,10 +55,12 @@ enum
 {
   PROP_0,
   PROP_OFFSET,
+  PROP_N_THREADS,
   PROP_LAST
 };
 
 #define DEFAULT_PROP_OFFSET 64
+#define DEFAULT_PROP_N_THREADS 1
 
 /* the capabilities of the inputs and outputs */
 static GstStaticPadTemplate gst_misb_ir_pack_sink_template =
@@ -121,6 +123,9 @@ gst_misb_ir_pack_dispose (GObject * object)
 
   gst_misb_ir_pack_reset (misb_ir_pack);
 
+  gst_slice_pool_free (misb_ir_pack->slice_pool);
+  misb_ir_pack->slice_pool = NULL;
+
   /* chain up to the parent class */
   G_OBJECT_CLASS (gst_misb_ir_pack_parent_class)->dispose (object);
 }
@@ -154,6 +159,12 @@ gst_misb_ir_pack_class_init (GstMisbIrPackClass * klass)
           "Offset value",
           "Offset value to apply during packing", 0, 1023,
           DEFAULT_PROP_OFFSET, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_N_THREADS, g_param_spec_uint ("n-threads",
+          "Number of threads",
+          "Number of threads to split each frame across (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_PROP_N_THREADS,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_misb_ir_pack_sink_template));
@@ -181,6 +192,7 @@ gst_misb_ir_pack_init (GstMisbIrPack * filt)
   GST_DEBUG_OBJECT (filt, "init class instance");
 
   filt->offset_value = DEFAULT_PROP_OFFSET;
+  filt->n_threads = DEFAULT_PROP_N_THREADS;
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filt), FALSE);
 
   gst_misb_ir_pack_reset (filt);
@@ -198,6 +210,11 @@ gst_misb_ir_pack_set_property (GObject * object, guint prop_id,
     case PROP_OFFSET:
       filt->offset_value = g_value_get_int (value);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filt);
+      filt->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filt);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -216,6 +233,9 @@ gst_misb_ir_pack_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_OFFSET:
       g_value_set_int (value, filt->offset_value);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, filt->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -283,13 +303,21 @@ gst_misb_ir_pack_set_info (GstVideoFilter * filter, GstCaps * incaps,
   return res;
 }
 
-static GstFlowReturn
-gst_misb_ir_pack_transform_frame (GstVideoFilter * filter,
-    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+typedef struct
 {
-  GstMisbIrPack *filt = GST_MISB_IR_PACK (filter);
-  GTimer *timer = NULL;
-  guint offset = filt->offset_value;
+  GstMisbIrPack *filt;
+  GstVideoFrame *in_frame;
+  GstVideoFrame *out_frame;
+} GstMisbIrPackSlice;
+
+static void
+gst_misb_ir_pack_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstMisbIrPackSlice *slice = (GstMisbIrPackSlice *) user_data;
+  GstVideoFrame *in_frame = slice->in_frame;
+  GstVideoFrame *out_frame = slice->out_frame;
+  guint offset = slice->filt->offset_value;
   gint y;
   guint16 *src, *src_end;
   guint32 *dst;
@@ -297,13 +325,7 @@ gst_misb_ir_pack_transform_frame (GstVideoFilter * filter,
   guint32 word1;
   guint16 luma0, chroma0, luma1, chroma1, luma2, chroma2;
 
-  GST_LOG_OBJECT (filt, "Performing non-inplace transform");
-
-#if 0
-  timer = g_timer_new ();
-#endif
-
-  for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0); y++) {
+  for (y = y_start; y < y_end; y++) {
     src = (guint16 *) (GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) +
         y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0));
     src_end = src + GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0);
@@ -348,36 +370,41 @@ gst_misb_ir_pack_transform_frame (GstVideoFilter * filter,
       *dst++ = word1;
     }
   }
+}
+
+static GstFlowReturn
+gst_misb_ir_pack_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+{
+  GstMisbIrPack *filt = GST_MISB_IR_PACK (filter);
+  GstMisbIrPackSlice slice;
+  GTimer *timer = NULL;
+  guint n_threads;
+
+  GST_LOG_OBJECT (filt, "Performing non-inplace transform");
+
+#if 0
+  timer = g_timer_new ();
+#endif
+
+  GST_OBJECT_LOCK (filt);
+  n_threads = filt->n_threads;
+  GST_OBJECT_UNLOCK (filt);
+
+  if (filt->slice_pool == NULL || filt->slice_pool_n_threads != n_threads) {
+    gst_slice_pool_free (filt->slice_pool);
+    filt->slice_pool = gst_slice_pool_new (n_threads);
+    filt->slice_pool_n_threads = n_threads;
+    GST_DEBUG_OBJECT (filt, "Using %d threads",
+        gst_slice_pool_get_n_threads (filt->slice_pool));
+  }
 
-  //for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0); y++) {
-  //    src = (guint16 *) (GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) + 
-  //        y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0));
-  //    dst = (guint32 *) (GST_VIDEO_FRAME_COMP_DATA (out_frame, 0) + 
-  //        y * GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0));
-  //    for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0); ) {
-  //        guint32 word0;
-  //        guint32 word1;
-  //        guint16 luma0, chroma0, luma1, chroma1, luma2, chroma2;
-
-  //        chroma0 = *src & 0xff + offset;
-  //        luma0 = (*src & 0xff00) >> 8 + offset;
-  //        src++;
-  //        chroma1 = *src & 0xff + offset;
-  //        luma1 = (*src & 0xff00) >> 8 + offset;
-  //        src++;
-  //        chroma2 = *src & 0xff + offset;
-  //        luma2 = (*src & 0xff00) >> 8 + offset;
-  //        src++;
-
-  //        word0 = 0;
-  //        word0 = chroma0 | luma0 << 10 | chroma1 << 20;
-  //        word1 = 0;
-  //        word1 = luma1 | chroma2 << 10 | luma2 << 20;
-
-  //        dst[x++] = word0;
-  //        dst[x++] = word1;
-  //    }
-  //}
+  slice.filt = filt;
+  slice.in_frame = in_frame;
+  slice.out_frame = out_frame;
+  gst_slice_pool_run (filt->slice_pool,
+      GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0), gst_misb_ir_pack_lines,
+      &slice);
 
 #if 0
   GST_LOG_OBJECT (filt, "Processing took %.3f ms", g_timer_elapsed (timer,
@@ -28,6 +28,8 @@
 #include <gst/video/gstvideofilter.h>
 #include <gst/video/video.h>
 
+#include "gstslicepool.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_MISB_IR_PACK \
@@ -61,6 +63,11 @@ struct _GstMisbIrPack
 
   /* properties */
   guint offset_value;
+  guint n_threads;
+
+  /* row slice workers */
+  GstSlicePool *slice_pool;
+  guint slice_pool_n_threads;
 };
 
 struct _GstMisbIrPackClass
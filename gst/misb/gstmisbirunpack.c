@@ -59,6 +59,7 @@ enum
   PROP_SWAP,
   PROP_LUMA_MASK,
   PROP_CHROMA_MASK,
+  PROP_N_THREADS,
   PROP_LAST
 };
 
@@ -67,6 +68,7 @@ enum
 #define DEFAULT_PROP_SWAP FALSE
 #define DEFAULT_PROP_LUMA_MASK 0xff
 #define DEFAULT_PROP_CHROMA_MASK 0xff
+#define DEFAULT_PROP_N_THREADS 1
 
 /* the capabilities of the inputs and outputs */
 static GstStaticPadTemplate gst_misb_ir_unpack_sink_template =
@@ -129,6 +131,9 @@ gst_misb_ir_unpack_dispose (GObject * object)
 
   gst_misb_ir_unpack_reset (misb_ir_unpack);
 
+  gst_slice_pool_free (misb_ir_unpack->slice_pool);
+  misb_ir_unpack->slice_pool = NULL;
+
   /* chain up to the parent class */
   G_OBJECT_CLASS (gst_misb_ir_unpack_parent_class)->dispose (object);
 }
@@ -181,6 +186,12 @@ gst_misb_ir_unpack_class_init (GstMisbIrUnpackClass * klass)
           "Chroma mask",
           "Mask to bitwise AND with chroma after applying offset", 0, 0xffff,
           DEFAULT_PROP_LUMA_MASK, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_N_THREADS, g_param_spec_uint ("n-threads",
+          "Number of threads",
+          "Number of threads to split each frame across (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_PROP_N_THREADS,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_misb_ir_unpack_sink_template));
@@ -212,6 +223,7 @@ gst_misb_ir_unpack_init (GstMisbIrUnpack * filt)
   filt->swap = DEFAULT_PROP_SWAP;
   filt->luma_mask = DEFAULT_PROP_LUMA_MASK;
   filt->chroma_mask = DEFAULT_PROP_CHROMA_MASK;
+  filt->n_threads = DEFAULT_PROP_N_THREADS;
 
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filt), FALSE);
 
@@ -242,6 +254,11 @@ gst_misb_ir_unpack_set_property (GObject * object, guint prop_id,
     case PROP_CHROMA_MASK:
       filt->chroma_mask = g_value_get_uint (value);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filt);
+      filt->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filt);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -272,6 +289,9 @@ gst_misb_ir_unpack_get_property (GObject * object, guint prop_id,
     case PROP_CHROMA_MASK:
       g_value_set_uint (value, filt->chroma_mask);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, filt->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -340,30 +360,34 @@ gst_misb_ir_unpack_set_info (GstVideoFilter * filter, GstCaps * incaps,
   return res;
 }
 
-static GstFlowReturn
-gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
-    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+typedef struct
 {
-  GstMisbIrUnpack *filt = GST_MISB_IR_UNPACK (filter);
-  GTimer *timer = NULL;
+  GstMisbIrUnpack *filt;
+  GstVideoFrame *in_frame;
+  GstVideoFrame *out_frame;
+} GstMisbIrUnpackSlice;
+
+static void
+gst_misb_ir_unpack_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstMisbIrUnpackSlice *slice = (GstMisbIrUnpackSlice *) user_data;
+  GstMisbIrUnpack *filt = slice->filt;
+  GstVideoFrame *in_frame = slice->in_frame;
+  GstVideoFrame *out_frame = slice->out_frame;
   gint16 offset = filt->offset_value;
   guint shift = filt->shift_value;
+  gint width = GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0);
   gint x, y;
   guint16 *dst;
 
-  GST_LOG_OBJECT (filt, "Performing non-inplace transform");
-
-#if 0
-  timer = g_timer_new ();
-#endif
-
   if (filt->info_in.finfo->format == GST_VIDEO_FORMAT_v210) {
-    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0); y++) {
+    for (y = y_start; y < y_end; y++) {
       guint32 *src = (guint32 *) (GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) +
           y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0));
       dst = (guint16 *) (GST_VIDEO_FRAME_COMP_DATA (out_frame, 0) +
           y * GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0));
-      for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0);) {
+      for (x = 0; x < width;) {
         guint32 word0 = *src++;
         guint32 word1 = *src++;
         guint16 luma, chroma, temp;
@@ -379,6 +403,10 @@ gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
             ((chroma + offset) & filt->chroma_mask) | (((luma +
                     offset) & filt->luma_mask) << shift);
 
+        /* don't spill into the next row, which may belong to another slice */
+        if (x == width)
+          break;
+
         chroma = (word0 & 0x3ff00000) >> 20;
         luma = word1 & 0x3ff;
         if (filt->swap) {
@@ -390,6 +418,9 @@ gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
             (chroma + offset) & filt->chroma_mask | ((luma +
                 offset) & filt->luma_mask) << shift;
 
+        if (x == width)
+          break;
+
         chroma = (word1 & 0xffc00) >> 10;
         luma = (word1 & 0x3ff00000) >> 20;
         if (filt->swap) {
@@ -403,12 +434,12 @@ gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
       }
     }
   } else if (filt->info_in.finfo->format == GST_VIDEO_FORMAT_UYVY) {
-    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0); y++) {
+    for (y = y_start; y < y_end; y++) {
       guint8 *src = (guint8 *) (GST_VIDEO_FRAME_COMP_DATA (in_frame, 0) +
           y * GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0));
       dst = (guint16 *) (GST_VIDEO_FRAME_COMP_DATA (out_frame, 0) +
           y * GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0));
-      for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (in_frame, 0);) {
+      for (x = 0; x < width;) {
         guint8 chroma = *src++;
         guint8 luma = *src++;
         guint8 temp;
@@ -424,6 +455,42 @@ gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
       }
     }
   }
+}
+
+static GstFlowReturn
+gst_misb_ir_unpack_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+{
+  GstMisbIrUnpack *filt = GST_MISB_IR_UNPACK (filter);
+  GstMisbIrUnpackSlice slice;
+  GTimer *timer = NULL;
+  guint n_threads;
+
+  GST_LOG_OBJECT (filt, "Performing non-inplace transform");
+
+#if 0
+  timer = g_timer_new ();
+#endif
+
+  GST_OBJECT_LOCK (filt);
+  n_threads = filt->n_threads;
+  GST_OBJECT_UNLOCK (filt);
+
+  if (filt->slice_pool == NULL || filt->slice_pool_n_threads != n_threads) {
+    gst_slice_pool_free (filt->slice_pool);
+    filt->slice_pool = gst_slice_pool_new (n_threads);
+    filt->slice_pool_n_threads = n_threads;
+    GST_DEBUG_OBJECT (filt, "Using %d threads",
+        gst_slice_pool_get_n_threads (filt->slice_pool));
+  }
+
+  slice.filt = filt;
+  slice.in_frame = in_frame;
+  slice.out_frame = out_frame;
+  gst_slice_pool_run (filt->slice_pool,
+      GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, 0), gst_misb_ir_unpack_lines,
+      &slice);
+
 #if 0
   GST_LOG_OBJECT (filt, "Processing took %.3f ms", g_timer_elapsed (timer,
           NULL) * 1000);
@@ -28,6 +28,8 @@
 #include <gst/video/gstvideofilter.h>
 #include <gst/video/video.h>
 
+#include "gstslicepool.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_MISB_IR_UNPACK \
@@ -65,6 +67,11 @@ struct _GstMisbIrUnpack
   gboolean swap;
   guint luma_mask;
   guint chroma_mask;
+  guint n_threads;
+
+  /* row slice workers */
+  GstSlicePool *slice_pool;
+  guint slice_pool_n_threads;
 };
 
 struct _GstMisbIrUnpackClass
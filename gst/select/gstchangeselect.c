@@ -0,0 +1,569 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+* SECTION:element-changeselect
+*
+* Passes only frames that changed, e.g. to avoid encoding and recording
+* frames of a static scene.
+*
+* Every #GstChangeSelect:row-step th row of each frame is compared to the
+* same rows of the last passed frame by sum of absolute differences. A frame
+* passes if the mean absolute difference per sampled pixel is at least
+* #GstChangeSelect:threshold, or if #GstChangeSelect:keep-alive has elapsed
+* since the last passed frame. The first frame always passes. Passed frames
+* carry the score as #GstChangeSelectMeta.
+*
+* Works on 8- and 16-bit grayscale and Bayer video; Bayer data is compared as
+* is, since the same mosaic positions are compared.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch videotestsrc pattern=ball ! videoconvert ! video/x-raw,format=GRAY8 ! changeselect threshold=0.5 ! videoconvert ! autovideosink
+* ]|
+* </refsect2>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstchangeselect.h"
+
+#include <gst/video/video.h>
+
+enum
+{
+  PROP_0,
+  PROP_THRESHOLD,
+  PROP_KEEP_ALIVE,
+  PROP_ROW_STEP,
+  PROP_LAST
+};
+
+#define DEFAULT_PROP_THRESHOLD 1.0
+#define DEFAULT_PROP_KEEP_ALIVE GST_SECOND
+#define DEFAULT_PROP_ROW_STEP 4
+
+#define VIDEO_CAPS_MAKE_BAYER8(format)                     \
+    "video/x-bayer, "                                        \
+    "format = (string) " format ", "                         \
+    "width = " GST_VIDEO_SIZE_RANGE ", "                     \
+    "height = " GST_VIDEO_SIZE_RANGE ", "                    \
+    "framerate = " GST_VIDEO_FPS_RANGE
+
+#define VIDEO_CAPS_MAKE_BAYER16(format)                    \
+    "video/x-bayer, "                                        \
+    "format = (string) " format ", "                         \
+    "endianness = (int) { 1234, 4321 }, "                    \
+    "bpp = (int) {16, 14, 12, 10}, "                         \
+    "width = " GST_VIDEO_SIZE_RANGE ", "                     \
+    "height = " GST_VIDEO_SIZE_RANGE ", "                    \
+    "framerate = " GST_VIDEO_FPS_RANGE
+
+#define CHANGE_SELECT_CAPS \
+    GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }") ";" \
+    VIDEO_CAPS_MAKE_BAYER8 ("{ bggr, grbg, gbrg, rggb }") ";" \
+    VIDEO_CAPS_MAKE_BAYER16 ("{ bggr16, grbg16, gbrg16, rggb16 }")
+
+/* the capabilities of the inputs and outputs */
+static GstStaticPadTemplate gst_change_select_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (CHANGE_SELECT_CAPS)
+    );
+
+static GstStaticPadTemplate gst_change_select_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (CHANGE_SELECT_CAPS)
+    );
+
+
+/* GObject vmethod declarations */
+static void gst_change_select_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_change_select_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_change_select_finalize (GObject * object);
+
+/* GstBaseTransform vmethod declarations */
+static gboolean gst_change_select_set_caps (GstBaseTransform * trans,
+    GstCaps * incaps, GstCaps * outcaps);
+static gboolean gst_change_select_start (GstBaseTransform * trans);
+static gboolean gst_change_select_stop (GstBaseTransform * trans);
+static gboolean gst_change_select_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static GstFlowReturn gst_change_select_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+
+/* setup debug */
+GST_DEBUG_CATEGORY_STATIC (change_select_debug);
+#define GST_CAT_DEFAULT change_select_debug
+
+G_DEFINE_TYPE (GstChangeSelect, gst_change_select, GST_TYPE_BASE_TRANSFORM);
+
+/************************************************************************/
+/* GstChangeSelectMeta                                                  */
+/************************************************************************/
+
+GType
+gst_change_select_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstChangeSelectMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_change_select_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  ((GstChangeSelectMeta *) meta)->score = 0.0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_change_select_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstChangeSelectMeta *dmeta;
+
+  /* the score only holds for the unmodified frame */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  dmeta = (GstChangeSelectMeta *) gst_buffer_add_meta (dest,
+      meta->info, NULL);
+  if (!dmeta)
+    return FALSE;
+
+  dmeta->score = ((GstChangeSelectMeta *) meta)->score;
+
+  return TRUE;
+}
+
+static const GstMetaInfo *
+gst_change_select_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi =
+        gst_meta_register (GST_CHANGE_SELECT_META_API_TYPE,
+        "GstChangeSelectMeta", sizeof (GstChangeSelectMeta),
+        gst_change_select_meta_init, NULL, gst_change_select_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+/************************************************************************/
+/* GObject vmethod implementations                                      */
+/************************************************************************/
+
+static void
+gst_change_select_class_init (GstChangeSelectClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *gstbasetransform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (change_select_debug, "changeselect", 0,
+      "Change detection frame selection");
+
+  /* Register GObject vmethods */
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_change_select_finalize);
+  gobject_class->set_property =
+      GST_DEBUG_FUNCPTR (gst_change_select_set_property);
+  gobject_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_change_select_get_property);
+
+  /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_THRESHOLD,
+      g_param_spec_double ("threshold", "Threshold",
+          "Mean absolute difference per sampled pixel, in pixel values, for "
+          "a frame to pass", 0, G_MAXDOUBLE, DEFAULT_PROP_THRESHOLD,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (gobject_class, PROP_KEEP_ALIVE,
+      g_param_spec_uint64 ("keep-alive", "Keep alive",
+          "Pass a frame at least this often, regardless of change (in ns, "
+          "0 = never)", 0, G_MAXUINT64, DEFAULT_PROP_KEEP_ALIVE,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (gobject_class, PROP_ROW_STEP,
+      g_param_spec_uint ("row-step", "Row step",
+          "Compare every row-step th row", 1, G_MAXUINT16,
+          DEFAULT_PROP_ROW_STEP,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_change_select_sink_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_change_select_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Change detection buffer filter", "Filter/Video",
+      "Passes only frames that changed from the last passed frame",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  /* Register GstBaseTransform vmethods */
+  gstbasetransform_class->set_caps =
+      GST_DEBUG_FUNCPTR (gst_change_select_set_caps);
+  gstbasetransform_class->start = GST_DEBUG_FUNCPTR (gst_change_select_start);
+  gstbasetransform_class->stop = GST_DEBUG_FUNCPTR (gst_change_select_stop);
+  gstbasetransform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_change_select_sink_event);
+  gstbasetransform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_change_select_transform_ip);
+}
+
+static void
+gst_change_select_init (GstChangeSelect * filt)
+{
+  filt->threshold = DEFAULT_PROP_THRESHOLD;
+  filt->keep_alive = DEFAULT_PROP_KEEP_ALIVE;
+  filt->row_step = DEFAULT_PROP_ROW_STEP;
+  filt->sample_step = DEFAULT_PROP_ROW_STEP;
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filt), TRUE);
+}
+
+static void
+gst_change_select_finalize (GObject * object)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (object);
+
+  g_free (filt->reference);
+
+  G_OBJECT_CLASS (gst_change_select_parent_class)->finalize (object);
+}
+
+static void
+gst_change_select_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (object);
+
+  GST_DEBUG_OBJECT (filt, "setting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_THRESHOLD:
+      filt->threshold = g_value_get_double (value);
+      break;
+    case PROP_KEEP_ALIVE:
+      filt->keep_alive = g_value_get_uint64 (value);
+      break;
+    case PROP_ROW_STEP:
+      GST_OBJECT_LOCK (filt);
+      filt->row_step = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filt);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_change_select_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (object);
+
+  GST_DEBUG_OBJECT (filt, "getting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_THRESHOLD:
+      g_value_set_double (value, filt->threshold);
+      break;
+    case PROP_KEEP_ALIVE:
+      g_value_set_uint64 (value, filt->keep_alive);
+      break;
+    case PROP_ROW_STEP:
+      g_value_set_uint (value, filt->row_step);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/************************************************************************/
+/* GstBaseTransform vmethod implementations                             */
+/************************************************************************/
+
+static gboolean
+gst_change_select_set_caps (GstBaseTransform * trans, GstCaps * incaps,
+    GstCaps * outcaps)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (trans);
+  GstStructure *st = gst_caps_get_structure (incaps, 0);
+  gint endianness = G_BYTE_ORDER;
+  gsize size;
+
+  GST_DEBUG_OBJECT (filt, "set_caps: in %" GST_PTR_FORMAT, incaps);
+
+  if (!gst_structure_get_int (st, "width", &filt->width) ||
+      !gst_structure_get_int (st, "height", &filt->height))
+    return FALSE;
+
+  if (gst_structure_has_name (st, "video/x-bayer")) {
+    const gchar *format = gst_structure_get_string (st, "format");
+
+    /* GstVideoInfo treats Bayer as encoded, so work out the layout here */
+    if (format && g_str_has_suffix (format, "16")) {
+      gst_structure_get_int (st, "endianness", &endianness);
+      filt->bytes_per_pixel = 2;
+    } else {
+      filt->bytes_per_pixel = 1;
+    }
+    filt->stride = GST_ROUND_UP_4 (filt->width * filt->bytes_per_pixel);
+  } else {
+    GstVideoInfo info;
+
+    if (!gst_video_info_from_caps (&info, incaps))
+      return FALSE;
+
+    filt->stride = GST_VIDEO_INFO_COMP_STRIDE (&info, 0);
+    switch (GST_VIDEO_INFO_FORMAT (&info)) {
+      case GST_VIDEO_FORMAT_GRAY16_LE:
+        endianness = G_LITTLE_ENDIAN;
+        filt->bytes_per_pixel = 2;
+        break;
+      case GST_VIDEO_FORMAT_GRAY16_BE:
+        endianness = G_BIG_ENDIAN;
+        filt->bytes_per_pixel = 2;
+        break;
+      default:
+        filt->bytes_per_pixel = 1;
+        break;
+    }
+  }
+
+  filt->swap = filt->bytes_per_pixel == 2 && endianness != G_BYTE_ORDER;
+
+  /* the reference is sized for this step, so a row-step set while streaming
+   * only takes effect with the next caps */
+  GST_OBJECT_LOCK (filt);
+  filt->sample_step = filt->row_step;
+  GST_OBJECT_UNLOCK (filt);
+
+  size = (gsize) ((filt->height + filt->sample_step - 1) /
+      filt->sample_step) * filt->width * filt->bytes_per_pixel;
+  if (size != filt->reference_size) {
+    g_free (filt->reference);
+    filt->reference = g_malloc (size);
+    filt->reference_size = size;
+  }
+  filt->have_reference = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_change_select_start (GstBaseTransform * trans)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (trans);
+
+  filt->have_reference = FALSE;
+  filt->last_pass_ts = GST_CLOCK_TIME_NONE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_change_select_stop (GstBaseTransform * trans)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (trans);
+
+  g_free (filt->reference);
+  filt->reference = NULL;
+  filt->reference_size = 0;
+  filt->have_reference = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_change_select_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (trans);
+
+  /* don't compare against, or time keep-alive from, the old position */
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_SEGMENT:
+      filt->have_reference = FALSE;
+      filt->last_pass_ts = GST_CLOCK_TIME_NONE;
+      break;
+    default:
+      break;
+  }
+
+  return
+      GST_BASE_TRANSFORM_CLASS (gst_change_select_parent_class)->sink_event
+      (trans, event);
+}
+
+/* The SAD loops are kept simple so compilers vectorize them (e.g. to
+ * psadbw on x86); per-row sums can't overflow 32 bits for 8-bit data. */
+
+static guint64
+gst_change_select_sad_row_8 (const guint8 * a, const guint8 * b, gint n)
+{
+  guint32 sum = 0;
+  gint i;
+
+  for (i = 0; i < n; i++)
+    sum += (guint32) ABS ((gint) a[i] - (gint) b[i]);
+
+  return sum;
+}
+
+static guint64
+gst_change_select_sad_row_16 (const guint16 * a, const guint16 * b, gint n)
+{
+  guint64 sum = 0;
+  gint i;
+
+  for (i = 0; i < n; i++)
+    sum += (guint32) ABS ((gint) a[i] - (gint) b[i]);
+
+  return sum;
+}
+
+static guint64
+gst_change_select_sad_row_16_swap (const guint16 * a, const guint16 * b,
+    gint n)
+{
+  guint64 sum = 0;
+  gint i;
+
+  for (i = 0; i < n; i++)
+    sum += (guint32) ABS ((gint) GUINT16_SWAP_LE_BE (a[i]) -
+        (gint) GUINT16_SWAP_LE_BE (b[i]));
+
+  return sum;
+}
+
+static GstFlowReturn
+gst_change_select_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstChangeSelect *filt = GST_CHANGE_SELECT (trans);
+  GstClockTime ts = GST_BUFFER_PTS (buf);
+  gsize row_bytes = (gsize) filt->width * filt->bytes_per_pixel;
+  gdouble score = 0.0;
+  gboolean pass;
+  GstMapInfo map;
+  guint8 *ref;
+  gint y;
+
+  if (filt->reference == NULL) {
+    GST_ELEMENT_ERROR (filt, CORE, NEGOTIATION, (NULL),
+        ("Format not negotiated"));
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (filt, RESOURCE, READ, (NULL),
+        ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  if (map.size < (gsize) filt->stride * (filt->height - 1) + row_bytes) {
+    gst_buffer_unmap (buf, &map);
+    GST_ELEMENT_ERROR (filt, STREAM, FORMAT, (NULL),
+        ("Buffer too small for negotiated format"));
+    return GST_FLOW_ERROR;
+  }
+
+  if (!filt->have_reference) {
+    pass = TRUE;
+  } else {
+    guint64 sad = 0;
+    guint64 n = 0;
+
+    ref = filt->reference;
+    for (y = 0; y < filt->height; y += filt->sample_step) {
+      const guint8 *row = map.data + (gsize) y * filt->stride;
+
+      if (filt->bytes_per_pixel == 1)
+        sad += gst_change_select_sad_row_8 (row, ref, filt->width);
+      else if (filt->swap)
+        sad += gst_change_select_sad_row_16_swap ((const guint16 *) row,
+            (const guint16 *) ref, filt->width);
+      else
+        sad += gst_change_select_sad_row_16 ((const guint16 *) row,
+            (const guint16 *) ref, filt->width);
+
+      ref += row_bytes;
+      n += filt->width;
+    }
+
+    score = n ? (gdouble) sad / n : 0.0;
+    pass = score >= filt->threshold;
+
+    if (!pass && filt->keep_alive && GST_CLOCK_TIME_IS_VALID (ts)
+        && GST_CLOCK_TIME_IS_VALID (filt->last_pass_ts)
+        && ts >= filt->last_pass_ts + filt->keep_alive) {
+      GST_LOG_OBJECT (filt, "Keep-alive expired");
+      pass = TRUE;
+    }
+  }
+
+  if (pass) {
+    ref = filt->reference;
+    for (y = 0; y < filt->height; y += filt->sample_step) {
+      memcpy (ref, map.data + (gsize) y * filt->stride, row_bytes);
+      ref += row_bytes;
+    }
+    filt->have_reference = TRUE;
+    filt->last_pass_ts = ts;
+  }
+
+  gst_buffer_unmap (buf, &map);
+
+  if (!pass) {
+    GST_LOG_OBJECT (filt, "Dropping frame with score %f", score);
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  GST_LOG_OBJECT (filt, "Passing frame with score %f", score);
+
+  ((GstChangeSelectMeta *) gst_buffer_add_meta (buf,
+          gst_change_select_meta_get_info (), NULL))->score = score;
+
+  return GST_FLOW_OK;
+}
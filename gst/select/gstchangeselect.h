@@ -0,0 +1,105 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_CHANGE_SELECT_H__
+#define __GST_CHANGE_SELECT_H__
+
+#include <gst/base/gstbasetransform.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_CHANGE_SELECT \
+  (gst_change_select_get_type())
+#define GST_CHANGE_SELECT(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_CHANGE_SELECT,GstChangeSelect))
+#define GST_CHANGE_SELECT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_CHANGE_SELECT,GstChangeSelectClass))
+#define GST_IS_CHANGE_SELECT(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_CHANGE_SELECT))
+#define GST_IS_CHANGE_SELECT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_CHANGE_SELECT))
+
+typedef struct _GstChangeSelect GstChangeSelect;
+typedef struct _GstChangeSelectClass GstChangeSelectClass;
+typedef struct _GstChangeSelectMeta GstChangeSelectMeta;
+
+/**
+* GstChangeSelect:
+* @element: the parent element.
+*
+*
+* The opaque GstChangeSelect data structure.
+*/
+struct _GstChangeSelect
+{
+  GstBaseTransform element;
+
+  /* properties */
+  gdouble threshold;
+  GstClockTime keep_alive;
+  guint row_step;
+
+  /* format */
+  gint width;
+  gint height;
+  gint stride;
+  gint bytes_per_pixel;
+  gboolean swap;
+
+  /* row-step in effect, latched when the reference is sized */
+  guint sample_step;
+
+  /* sampled rows of the last passed frame */
+  guint8 *reference;
+  gsize reference_size;
+  gboolean have_reference;
+  GstClockTime last_pass_ts;
+};
+
+struct _GstChangeSelectClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+/**
+ * GstChangeSelectMeta:
+ * @meta: parent #GstMeta
+ * @score: mean absolute difference per sampled pixel to the previously
+ *   passed frame, in pixel values, or 0 for the first frame
+ *
+ * Change score attached to the buffers passed by changeselect.
+ * Applications can look up the API type by the name
+ * "GstChangeSelectMetaAPI".
+ */
+struct _GstChangeSelectMeta
+{
+  GstMeta meta;
+
+  gdouble score;
+};
+
+GType gst_change_select_get_type(void);
+
+GType gst_change_select_meta_api_get_type (void);
+#define GST_CHANGE_SELECT_META_API_TYPE (gst_change_select_meta_api_get_type())
+
+G_END_DECLS
+
+#endif /* __GST_CHANGE_SELECT_H__ */
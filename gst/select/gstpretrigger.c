@@ -0,0 +1,570 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+* SECTION:element-pretrigger
+*
+* Passes the buffers around a trigger, e.g. for event capture from high-speed
+* cameras without recording everything.
+*
+* While idle, references to the last #GstPreTrigger:pre-buffers buffers are
+* kept, limited to #GstPreTrigger:max-bytes if set, and older buffers are
+* dropped. Buffers are never copied, and the source is never blocked. When
+* triggered, the kept buffers are pushed downstream followed by the next
+* #GstPreTrigger:post-buffers buffers; a trigger during that time extends it.
+* As the kept buffers are pushed in a burst, a queue downstream is
+* recommended. The allocation query is amended so upstream buffer pools
+* account for the kept buffers.
+*
+* A trigger is either the "trigger" action signal, or a custom event named
+* "trigger" sent upstream from downstream or downstream from upstream. The
+* kept buffers are discarded on caps or segment changes.
+*
+* While idle, gap events cover the time up to the oldest kept buffer, so
+* downstream can preroll and muxers don't wait on the stream. As kept
+* buffers may still be pushed, the gaps never cover them.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch videotestsrc ! pretrigger pre-buffers=60 post-buffers=60 ! queue ! matroskamux ! filesink location=event.mkv
+* ]|
+* </refsect2>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstpretrigger.h"
+
+enum
+{
+  PROP_0,
+  PROP_PRE_BUFFERS,
+  PROP_MAX_BYTES,
+  PROP_POST_BUFFERS,
+  PROP_LAST
+};
+
+enum
+{
+  SIGNAL_TRIGGER,
+  LAST_SIGNAL
+};
+
+#define DEFAULT_PROP_PRE_BUFFERS 30
+#define DEFAULT_PROP_MAX_BYTES 0
+#define DEFAULT_PROP_POST_BUFFERS 30
+
+/* name of the custom event structure that triggers */
+#define TRIGGER_EVENT_NAME "trigger"
+
+static guint gst_pre_trigger_signals[LAST_SIGNAL] = { 0 };
+
+/* the capabilities of the inputs and outputs */
+static GstStaticPadTemplate gst_pre_trigger_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+static GstStaticPadTemplate gst_pre_trigger_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+
+/* GObject vmethod declarations */
+static void gst_pre_trigger_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_pre_trigger_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_pre_trigger_finalize (GObject * object);
+
+/* GstElement vmethod declarations */
+static GstStateChangeReturn gst_pre_trigger_change_state (GstElement *
+    element, GstStateChange transition);
+
+/* GstPreTrigger method declarations */
+static void gst_pre_trigger_trigger (GstPreTrigger * filt);
+static GstFlowReturn gst_pre_trigger_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static gboolean gst_pre_trigger_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static gboolean gst_pre_trigger_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+static gboolean gst_pre_trigger_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static void gst_pre_trigger_clear (GstPreTrigger * filt);
+
+/* setup debug */
+GST_DEBUG_CATEGORY_STATIC (pre_trigger_debug);
+#define GST_CAT_DEFAULT pre_trigger_debug
+
+G_DEFINE_TYPE (GstPreTrigger, gst_pre_trigger, GST_TYPE_ELEMENT);
+
+/************************************************************************/
+/* GObject vmethod implementations                                      */
+/************************************************************************/
+
+static void
+gst_pre_trigger_class_init (GstPreTriggerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (pre_trigger_debug, "pretrigger", 0,
+      "Pre-trigger buffer");
+
+  /* Register GObject vmethods */
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_pre_trigger_finalize);
+  gobject_class->set_property =
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_set_property);
+  gobject_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_get_property);
+
+  /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_PRE_BUFFERS,
+      g_param_spec_uint ("pre-buffers", "Pre-trigger buffers",
+          "Number of buffers before the trigger to keep", 1, G_MAXUINT16,
+          DEFAULT_PROP_PRE_BUFFERS,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_MAX_BYTES,
+      g_param_spec_uint64 ("max-bytes", "Maximum bytes",
+          "Maximum total size of the buffers kept before the trigger "
+          "(0 = unlimited)", 0, G_MAXUINT64, DEFAULT_PROP_MAX_BYTES,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject_class, PROP_POST_BUFFERS,
+      g_param_spec_uint ("post-buffers", "Post-trigger buffers",
+          "Number of buffers to pass after the trigger, including the first "
+          "one received after it", 0, G_MAXUINT, DEFAULT_PROP_POST_BUFFERS,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * GstPreTrigger::trigger:
+   * @pretrigger: the #GstPreTrigger
+   *
+   * Action signal to push the kept buffers and the following post-buffers
+   * buffers downstream. Can be emitted from any thread.
+   */
+  gst_pre_trigger_signals[SIGNAL_TRIGGER] =
+      g_signal_new ("trigger", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstPreTriggerClass, trigger), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_NONE, 0);
+
+  klass->trigger = gst_pre_trigger_trigger;
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_change_state);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_pre_trigger_sink_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_pre_trigger_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Pre-trigger buffer", "Filter",
+      "Passes the buffers before and after a trigger",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+}
+
+static void
+gst_pre_trigger_init (GstPreTrigger * filt)
+{
+  filt->sinkpad =
+      gst_pad_new_from_static_template (&gst_pre_trigger_sink_template,
+      "sink");
+  gst_pad_set_chain_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_chain));
+  gst_pad_set_event_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_sink_event));
+  gst_pad_set_query_function (filt->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_sink_query));
+  GST_PAD_SET_PROXY_CAPS (filt->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (filt), filt->sinkpad);
+
+  filt->srcpad =
+      gst_pad_new_from_static_template (&gst_pre_trigger_src_template, "src");
+  gst_pad_set_event_function (filt->srcpad,
+      GST_DEBUG_FUNCPTR (gst_pre_trigger_src_event));
+  GST_PAD_SET_PROXY_CAPS (filt->srcpad);
+  gst_element_add_pad (GST_ELEMENT (filt), filt->srcpad);
+
+  filt->pre_buffers = DEFAULT_PROP_PRE_BUFFERS;
+  filt->max_bytes = DEFAULT_PROP_MAX_BYTES;
+  filt->post_buffers = DEFAULT_PROP_POST_BUFFERS;
+  filt->gap_position = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_pre_trigger_finalize (GObject * object)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (object);
+
+  gst_pre_trigger_clear (filt);
+  g_free (filt->ring);
+
+  G_OBJECT_CLASS (gst_pre_trigger_parent_class)->finalize (object);
+}
+
+static void
+gst_pre_trigger_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (object);
+
+  GST_DEBUG_OBJECT (filt, "setting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_PRE_BUFFERS:
+      filt->pre_buffers = g_value_get_uint (value);
+      break;
+    case PROP_MAX_BYTES:
+      filt->max_bytes = g_value_get_uint64 (value);
+      break;
+    case PROP_POST_BUFFERS:
+      GST_OBJECT_LOCK (filt);
+      filt->post_buffers = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filt);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_pre_trigger_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (object);
+
+  GST_DEBUG_OBJECT (filt, "getting property %s", pspec->name);
+
+  switch (prop_id) {
+    case PROP_PRE_BUFFERS:
+      g_value_set_uint (value, filt->pre_buffers);
+      break;
+    case PROP_MAX_BYTES:
+      g_value_set_uint64 (value, filt->max_bytes);
+      break;
+    case PROP_POST_BUFFERS:
+      GST_OBJECT_LOCK (filt);
+      g_value_set_uint (value, filt->post_buffers);
+      GST_OBJECT_UNLOCK (filt);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static GstStateChangeReturn
+gst_pre_trigger_change_state (GstElement * element, GstStateChange transition)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    gst_pre_trigger_clear (filt);
+    g_free (filt->ring);
+    filt->ring_size = filt->pre_buffers;
+    filt->ring = g_new0 (GstBuffer *, filt->ring_size);
+    filt->post_remaining = 0;
+    filt->gap_position = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_LOCK (filt);
+    filt->triggered = FALSE;
+    GST_OBJECT_UNLOCK (filt);
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_pre_trigger_parent_class)->change_state
+      (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    gst_pre_trigger_clear (filt);
+
+  return ret;
+}
+
+/************************************************************************/
+/* GstPreTrigger method implementations                                 */
+/************************************************************************/
+
+static void
+gst_pre_trigger_trigger (GstPreTrigger * filt)
+{
+  GST_DEBUG_OBJECT (filt, "Triggered");
+
+  GST_OBJECT_LOCK (filt);
+  filt->triggered = TRUE;
+  GST_OBJECT_UNLOCK (filt);
+}
+
+static GstBuffer *
+gst_pre_trigger_pop (GstPreTrigger * filt)
+{
+  GstBuffer *buf = filt->ring[filt->ring_head];
+
+  filt->ring[filt->ring_head] = NULL;
+  filt->ring_head = (filt->ring_head + 1) % filt->ring_size;
+  filt->ring_count--;
+  filt->ring_bytes -= gst_buffer_get_size (buf);
+
+  return buf;
+}
+
+static void
+gst_pre_trigger_clear (GstPreTrigger * filt)
+{
+  while (filt->ring_count > 0)
+    gst_buffer_unref (gst_pre_trigger_pop (filt));
+  filt->ring_head = 0;
+}
+
+static void
+gst_pre_trigger_keep (GstPreTrigger * filt, GstBuffer * buf)
+{
+  gsize size = gst_buffer_get_size (buf);
+
+  while (filt->ring_count > 0 && (filt->ring_count == filt->ring_size
+          || (filt->max_bytes && filt->ring_bytes + size > filt->max_bytes)))
+    gst_buffer_unref (gst_pre_trigger_pop (filt));
+
+  if (filt->max_bytes && size > filt->max_bytes) {
+    GST_LOG_OBJECT (filt, "Buffer larger than max-bytes, not keeping it");
+    gst_buffer_unref (buf);
+    return;
+  }
+
+  filt->ring[(filt->ring_head + filt->ring_count) % filt->ring_size] = buf;
+  filt->ring_count++;
+  filt->ring_bytes += size;
+}
+
+static GstClockTime
+gst_pre_trigger_get_timestamp (GstBuffer * buf)
+{
+  return GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      GST_BUFFER_DTS (buf);
+}
+
+static GstFlowReturn
+gst_pre_trigger_push (GstPreTrigger * filt, GstBuffer * buf)
+{
+  GstClockTime ts = gst_pre_trigger_get_timestamp (buf);
+
+  if (GST_CLOCK_TIME_IS_VALID (ts)) {
+    if (GST_BUFFER_DURATION_IS_VALID (buf))
+      ts += GST_BUFFER_DURATION (buf);
+    if (!GST_CLOCK_TIME_IS_VALID (filt->gap_position)
+        || ts > filt->gap_position)
+      filt->gap_position = ts;
+  }
+
+  return gst_pad_push (filt->srcpad, buf);
+}
+
+/* covers the time up to @position with a gap event, the first one being
+ * empty, just so downstream can preroll */
+static void
+gst_pre_trigger_push_gap (GstPreTrigger * filt, GstClockTime position)
+{
+  GstEvent *gap;
+
+  if (!GST_CLOCK_TIME_IS_VALID (position))
+    return;
+
+  if (!GST_CLOCK_TIME_IS_VALID (filt->gap_position))
+    gap = gst_event_new_gap (position, 0);
+  else if (position > filt->gap_position)
+    gap = gst_event_new_gap (filt->gap_position,
+        position - filt->gap_position);
+  else
+    return;
+
+  filt->gap_position = position;
+  gst_pad_push_event (filt->srcpad, gap);
+}
+
+static GstFlowReturn
+gst_pre_trigger_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (parent);
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean triggered;
+  guint post_buffers;
+  GstClockTime position;
+
+  GST_OBJECT_LOCK (filt);
+  triggered = filt->triggered;
+  filt->triggered = FALSE;
+  post_buffers = filt->post_buffers;
+  GST_OBJECT_UNLOCK (filt);
+
+  if (triggered) {
+    gboolean discont = filt->post_remaining == 0;
+
+    GST_DEBUG_OBJECT (filt, "Pushing %u buffers from before the trigger",
+        filt->ring_count);
+
+    while (filt->ring_count > 0 && ret == GST_FLOW_OK) {
+      GstBuffer *kept = gst_pre_trigger_pop (filt);
+
+      if (discont) {
+        kept = gst_buffer_make_writable (kept);
+        GST_BUFFER_FLAG_SET (kept, GST_BUFFER_FLAG_DISCONT);
+        discont = FALSE;
+      }
+      ret = gst_pre_trigger_push (filt, kept);
+    }
+    gst_pre_trigger_clear (filt);
+
+    filt->post_remaining = post_buffers;
+
+    if (discont && filt->post_remaining > 0) {
+      buf = gst_buffer_make_writable (buf);
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    }
+
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (buf);
+      return ret;
+    }
+  }
+
+  if (filt->post_remaining > 0) {
+    filt->post_remaining--;
+    if (filt->post_remaining == 0)
+      GST_DEBUG_OBJECT (filt, "Done passing buffers after the trigger");
+    return gst_pre_trigger_push (filt, buf);
+  }
+
+  position = gst_pre_trigger_get_timestamp (buf);
+  if (GST_CLOCK_TIME_IS_VALID (position)
+      && GST_BUFFER_DURATION_IS_VALID (buf))
+    position += GST_BUFFER_DURATION (buf);
+
+  gst_pre_trigger_keep (filt, buf);
+
+  /* everything before the oldest kept buffer won't be pushed anymore */
+  if (filt->ring_count > 0)
+    position = gst_pre_trigger_get_timestamp (filt->ring[filt->ring_head]);
+  gst_pre_trigger_push_gap (filt, position);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_pre_trigger_is_trigger_event (GstEvent * event)
+{
+  return gst_event_has_name (event, TRIGGER_EVENT_NAME);
+}
+
+static gboolean
+gst_pre_trigger_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CUSTOM_DOWNSTREAM:
+    case GST_EVENT_CUSTOM_DOWNSTREAM_OOB:
+      if (gst_pre_trigger_is_trigger_event (event)) {
+        gst_pre_trigger_trigger (filt);
+        gst_event_unref (event);
+        return TRUE;
+      }
+      break;
+    case GST_EVENT_CAPS:
+    case GST_EVENT_SEGMENT:
+      /* kept buffers would be pushed after the new caps or segment */
+      if (filt->ring_count > 0) {
+        GST_DEBUG_OBJECT (filt, "Discarding %u kept buffers on %s",
+            filt->ring_count, GST_EVENT_TYPE_NAME (event));
+        gst_pre_trigger_clear (filt);
+      }
+      if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+        filt->gap_position = GST_CLOCK_TIME_NONE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_pre_trigger_clear (filt);
+      filt->post_remaining = 0;
+      filt->gap_position = GST_CLOCK_TIME_NONE;
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_pre_trigger_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (parent);
+
+  if ((GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM
+          || GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_BOTH
+          || GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_BOTH_OOB)
+      && gst_pre_trigger_is_trigger_event (event)) {
+    gst_pre_trigger_trigger (filt);
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_pre_trigger_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstPreTrigger *filt = GST_PRE_TRIGGER (parent);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_ALLOCATION) {
+    guint i;
+
+    if (!gst_pad_peer_query (filt->srcpad, query))
+      return FALSE;
+
+    /* upstream pools need room for the buffers we keep */
+    for (i = 0; i < gst_query_get_n_allocation_pools (query); i++) {
+      GstBufferPool *pool;
+      guint size, min, max;
+
+      gst_query_parse_nth_allocation_pool (query, i, &pool, &size, &min, &max);
+      min += filt->pre_buffers;
+      if (max != 0)
+        max = MAX (max + filt->pre_buffers, min);
+      gst_query_set_nth_allocation_pool (query, i, pool, size, min, max);
+      if (pool)
+        gst_object_unref (pool);
+    }
+
+    return TRUE;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
@@ -0,0 +1,90 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_PRE_TRIGGER_H__
+#define __GST_PRE_TRIGGER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PRE_TRIGGER \
+  (gst_pre_trigger_get_type())
+#define GST_PRE_TRIGGER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PRE_TRIGGER,GstPreTrigger))
+#define GST_PRE_TRIGGER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PRE_TRIGGER,GstPreTriggerClass))
+#define GST_IS_PRE_TRIGGER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PRE_TRIGGER))
+#define GST_IS_PRE_TRIGGER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PRE_TRIGGER))
+
+typedef struct _GstPreTrigger GstPreTrigger;
+typedef struct _GstPreTriggerClass GstPreTriggerClass;
+
+/**
+* GstPreTrigger:
+* @element: the parent element.
+*
+*
+* The opaque GstPreTrigger data structure.
+*/
+struct _GstPreTrigger
+{
+  GstElement element;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* properties */
+  guint pre_buffers;
+  guint64 max_bytes;
+  guint post_buffers;
+
+  /* buffers before the trigger, oldest at ring_head */
+  GstBuffer **ring;
+  guint ring_size;
+  guint ring_head;
+  guint ring_count;
+  guint64 ring_bytes;
+
+  /* set by a trigger from any thread, protected by the object lock */
+  gboolean triggered;
+
+  /* buffers left to pass after the trigger */
+  guint post_remaining;
+
+  /* end of the time already covered downstream, by buffers or gap events */
+  GstClockTime gap_position;
+};
+
+struct _GstPreTriggerClass
+{
+  GstElementClass parent_class;
+
+  /* actions */
+  void (*trigger) (GstPreTrigger * filt);
+};
+
+GType gst_pre_trigger_get_type(void);
+
+G_END_DECLS
+
+#endif /* __GST_PRE_TRIGGER_H__ */
@@ -24,13 +24,25 @@
 /**
 * SECTION:element-select
 *
-* Selects buffers from offset and skip.
+* Selects buffers to pass.
+*
+* In offset mode, buffers are selected by their offset and
+* #GstSelect:skip. Many sources don't set buffer offsets though, in which
+* case max-rate mode passes at most #GstSelect:max-rate buffers per second
+* by their timestamp spacing. In qos mode the fraction of buffers dropped
+* adapts to QoS events from downstream: it rises quickly while downstream
+* reports buffers arriving late and falls slowly once it catches up, so a
+* slow branch sheds load early instead of queueing stale buffers. The
+* buffers passed are spread evenly.
 *
 * <refsect2>
 * <title>Example launch line</title>
 * |[
 * gst-launch videotestsrc ! select ! autovideosink
 * ]|
+* |[
+* gst-launch videotestsrc ! select mode=max-rate max-rate=5 ! autovideosink
+* ]|
 * </refsect2>
 */
 
@@ -39,17 +51,48 @@
 #endif
 
 #include "gstselect.h"
+#include "gstchangeselect.h"
+#include "gstpretrigger.h"
 
 enum
 {
   PROP_0,
+  PROP_MODE,
   PROP_OFFSET,
   PROP_SKIP,
+  PROP_MAX_RATE,
   PROP_LAST
 };
 
+#define DEFAULT_PROP_MODE GST_SELECT_MODE_OFFSET
 #define DEFAULT_PROP_OFFSET 0
 #define DEFAULT_PROP_SKIP 0
+#define DEFAULT_PROP_MAX_RATE 0.0
+
+/* qos mode: never drop everything, so QoS events keep coming */
+#define QOS_MAX_DROP_RATIO 0.95
+/* fraction of the remaining buffers additionally dropped on lateness */
+#define QOS_DROP_INCREASE 0.25
+/* drop ratio decrease while downstream keeps up */
+#define QOS_DROP_DECREASE 0.02
+
+#define GST_TYPE_SELECT_MODE (gst_select_mode_get_type())
+static GType
+gst_select_mode_get_type (void)
+{
+  static GType select_mode_type = 0;
+  static const GEnumValue select_mode[] = {
+    {GST_SELECT_MODE_OFFSET, "Select by buffer offset", "offset"},
+    {GST_SELECT_MODE_MAX_RATE, "Limit rate by buffer timestamps", "max-rate"},
+    {GST_SELECT_MODE_QOS, "Adapt to downstream QoS", "qos"},
+    {0, NULL, NULL},
+  };
+
+  if (!select_mode_type) {
+    select_mode_type = g_enum_register_static ("GstSelectMode", select_mode);
+  }
+  return select_mode_type;
+}
 
 /* the capabilities of the inputs and outputs */
 static GstStaticPadTemplate gst_select_sink_template =
@@ -75,6 +118,11 @@ static void gst_select_get_property (GObject * object, guint prop_id,
 static void gst_select_dispose (GObject * object);
 
 /* GstBaseTransform vmethod declarations */
+static gboolean gst_select_start (GstBaseTransform * trans);
+static gboolean gst_select_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_select_src_event (GstBaseTransform * trans,
+    GstEvent * event);
 static GstFlowReturn gst_select_transform_ip (GstBaseTransform * trans,
     GstBuffer * buf);
 
@@ -132,6 +180,11 @@ gst_select_class_init (GstSelectClass * klass)
   gobject_class->get_property = GST_DEBUG_FUNCPTR (gst_select_get_property);
 
   /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode", "How to select buffers",
+          GST_TYPE_SELECT_MODE, DEFAULT_PROP_MODE,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_PLAYING));
   g_object_class_install_property (gobject_class, PROP_OFFSET,
       g_param_spec_int ("offset", "Buffer offset",
           "First buffer offset to pass", 0, G_MAXINT, DEFAULT_PROP_OFFSET,
@@ -142,6 +195,12 @@ gst_select_class_init (GstSelectClass * klass)
           0, G_MAXINT, DEFAULT_PROP_OFFSET,
           G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
           GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (gobject_class, PROP_MAX_RATE,
+      g_param_spec_double ("max-rate", "Maximum rate",
+          "Maximum buffers per second to pass in max-rate mode (0 = all)",
+          0, G_MAXDOUBLE, DEFAULT_PROP_MAX_RATE,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+          GST_PARAM_MUTABLE_PLAYING));
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_select_sink_template));
@@ -150,10 +209,14 @@ gst_select_class_init (GstSelectClass * klass)
 
   gst_element_class_set_static_metadata (gstelement_class,
       "Select buffer filter", "Filter/Effect",
-      "Selects buffers based on buffer offset",
+      "Selects buffers based on buffer offset, rate or downstream QoS",
       "Joshua M. Doe <oss@nvl.army.mil>");
 
   /* Register GstBaseTransform vmethods */
+  gstbasetransform_class->start = GST_DEBUG_FUNCPTR (gst_select_start);
+  gstbasetransform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_select_sink_event);
+  gstbasetransform_class->src_event = GST_DEBUG_FUNCPTR (gst_select_src_event);
   gstbasetransform_class->transform_ip =
       GST_DEBUG_FUNCPTR (gst_select_transform_ip);
 }
@@ -163,8 +226,10 @@ gst_select_init (GstSelect * trans)
 {
   GST_DEBUG_OBJECT (trans, "init class instance");
 
+  trans->mode = DEFAULT_PROP_MODE;
   trans->offset = DEFAULT_PROP_OFFSET;
   trans->skip = DEFAULT_PROP_SKIP;
+  trans->max_rate = DEFAULT_PROP_MAX_RATE;
 
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (trans), TRUE);
 
@@ -180,12 +245,18 @@ gst_select_set_property (GObject * object, guint prop_id,
   GST_DEBUG_OBJECT (filt, "setting property %s", pspec->name);
 
   switch (prop_id) {
+    case PROP_MODE:
+      filt->mode = g_value_get_enum (value);
+      break;
     case PROP_OFFSET:
       filt->offset = g_value_get_int (value);
       break;
     case PROP_SKIP:
       filt->skip = g_value_get_int (value);
       break;
+    case PROP_MAX_RATE:
+      filt->max_rate = g_value_get_double (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -201,22 +272,82 @@ gst_select_get_property (GObject * object, guint prop_id, GValue * value,
   GST_DEBUG_OBJECT (filt, "getting property %s", pspec->name);
 
   switch (prop_id) {
+    case PROP_MODE:
+      g_value_set_enum (value, filt->mode);
+      break;
     case PROP_OFFSET:
       g_value_set_int (value, filt->offset);
       break;
     case PROP_SKIP:
       g_value_set_int (value, filt->skip);
       break;
+    case PROP_MAX_RATE:
+      g_value_set_double (value, filt->max_rate);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
-static GstFlowReturn
-gst_select_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+static gboolean
+gst_select_start (GstBaseTransform * trans)
+{
+  gst_select_reset (GST_SELECT (trans));
+
+  return TRUE;
+}
+
+static gboolean
+gst_select_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstSelect *filt = GST_SELECT (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_SEGMENT:
+      filt->next_ts = GST_CLOCK_TIME_NONE;
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_select_parent_class)->sink_event (trans,
+      event);
+}
+
+static gboolean
+gst_select_src_event (GstBaseTransform * trans, GstEvent * event)
 {
   GstSelect *filt = GST_SELECT (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS) {
+    GstQOSType type;
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+
+    gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+
+    GST_OBJECT_LOCK (filt);
+    if (diff > 0) {
+      filt->drop_ratio += (1.0 - filt->drop_ratio) * QOS_DROP_INCREASE;
+      filt->drop_ratio = MIN (filt->drop_ratio, QOS_MAX_DROP_RATIO);
+    } else {
+      filt->drop_ratio = MAX (filt->drop_ratio - QOS_DROP_DECREASE, 0.0);
+    }
+    GST_LOG_OBJECT (filt, "QoS proportion %f, diff %" G_GINT64_FORMAT
+        ", drop ratio now %f", proportion, diff, filt->drop_ratio);
+    GST_OBJECT_UNLOCK (filt);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_select_parent_class)->src_event (trans,
+      event);
+}
+
+static GstFlowReturn
+gst_select_transform_offset (GstSelect * filt, GstBuffer * buf)
+{
   guint64 buf_offset = GST_BUFFER_OFFSET (buf);
 
   if (buf_offset < filt->offset) {
@@ -235,10 +366,82 @@ gst_select_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
   return GST_FLOW_OK;
 }
 
+static GstFlowReturn
+gst_select_transform_max_rate (GstSelect * filt, GstBuffer * buf)
+{
+  GstClockTime ts = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      GST_BUFFER_DTS (buf);
+  GstClockTime period;
+
+  if (filt->max_rate <= 0 || !GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_FLOW_OK;
+
+  period = (GstClockTime) (GST_SECOND / filt->max_rate);
+
+  if (GST_CLOCK_TIME_IS_VALID (filt->next_ts) && ts < filt->next_ts) {
+    GST_LOG_OBJECT (filt, "Dropping buffer %" GST_TIME_FORMAT
+        ", next at %" GST_TIME_FORMAT, GST_TIME_ARGS (ts),
+        GST_TIME_ARGS (filt->next_ts));
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  /* step from the previous slot so the average rate doesn't drift, unless
+   * the stream fell more than a period behind, e.g. after a gap */
+  if (GST_CLOCK_TIME_IS_VALID (filt->next_ts)
+      && ts - filt->next_ts < period)
+    filt->next_ts += period;
+  else
+    filt->next_ts = ts + period;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_select_transform_qos (GstSelect * filt, GstBuffer * buf)
+{
+  gdouble drop_ratio;
+
+  GST_OBJECT_LOCK (filt);
+  drop_ratio = filt->drop_ratio;
+  GST_OBJECT_UNLOCK (filt);
+
+  filt->keep_accum += 1.0 - drop_ratio;
+  if (filt->keep_accum < 1.0) {
+    GST_LOG_OBJECT (filt, "Dropping buffer, drop ratio %f", drop_ratio);
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  filt->keep_accum -= 1.0;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_select_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstSelect *filt = GST_SELECT (trans);
+
+  switch (filt->mode) {
+    case GST_SELECT_MODE_MAX_RATE:
+      return gst_select_transform_max_rate (filt, buf);
+    case GST_SELECT_MODE_QOS:
+      return gst_select_transform_qos (filt, buf);
+    case GST_SELECT_MODE_OFFSET:
+    default:
+      return gst_select_transform_offset (filt, buf);
+  }
+}
+
 
 static void
 gst_select_reset (GstSelect * filt)
 {
+  filt->next_ts = GST_CLOCK_TIME_NONE;
+  filt->keep_accum = 0.0;
+
+  GST_OBJECT_LOCK (filt);
+  filt->drop_ratio = 0.0;
+  GST_OBJECT_UNLOCK (filt);
 }
 
 static gboolean
@@ -254,6 +457,16 @@ plugin_init (GstPlugin * plugin)
     return FALSE;
   }
 
+  if (!gst_element_register (plugin, "pretrigger", GST_RANK_NONE,
+          GST_TYPE_PRE_TRIGGER)) {
+    return FALSE;
+  }
+
+  if (!gst_element_register (plugin, "changeselect", GST_RANK_NONE,
+          GST_TYPE_CHANGE_SELECT)) {
+    return FALSE;
+  }
+
   return TRUE;
 }
 
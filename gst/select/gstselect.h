@@ -43,6 +43,13 @@ G_BEGIN_DECLS
 typedef struct _GstSelect GstSelect;
 typedef struct _GstSelectClass GstSelectClass;
 
+typedef enum
+{
+  GST_SELECT_MODE_OFFSET,
+  GST_SELECT_MODE_MAX_RATE,
+  GST_SELECT_MODE_QOS
+} GstSelectMode;
+
 /**
 * GstSelect:
 * @element: the parent element.
@@ -55,8 +62,19 @@ struct _GstSelect
   GstBaseTransform element;
 
   /* properties */
+  GstSelectMode mode;
   gint offset;
   gint skip;
+  gdouble max_rate;
+
+  /* max-rate mode, earliest timestamp of the next buffer to pass */
+  GstClockTime next_ts;
+
+  /* qos mode, fraction of buffers to drop as adapted to downstream QoS
+   * events, protected by the object lock, and error accumulator spreading
+   * the passed buffers evenly */
+  gdouble drop_ratio;
+  gdouble keep_accum;
 };
 
 struct _GstSelectClass
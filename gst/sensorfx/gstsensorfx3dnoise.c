@@ -1,6 +1,7 @@
 /*
  * GStreamer
  * Copyright (C) 2010 Thiago Santos <thiago.sousa.santos@collabora.co.uk>
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
  * 
  * Permission is hereby granted, free of charge, to any person obtaining a
  * copy of this software and associated documentation files (the "Software"),
@@ -41,20 +42,41 @@
  * Boston, MA 02111-1307, USA.
  */
 
+/**
+* SECTION:element-sfx3dnoise
+*
+* Adds noise to GRAY16 video according to the 3D noise model, which splits
+* sensor noise into temporal (t), vertical (v) and horizontal (h) components
+* and their combinations. Each sigma is a standard deviation relative to the
+* full 16-bit range. Fixed pattern components (v, h, vh) are generated once
+* and reused, temporal components are generated for every frame.
+*
+* All noise derives from the seed property and the frame number since
+* start, so a given seed always produces the same noise. Every pixel's
+* noise is addressed directly in the random stream, so frames can be split
+* across threads and the output stays bit-identical for any n-threads.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch-1.0 videotestsrc ! video/x-raw,format=GRAY16_LE ! sfx3dnoise sigma-tvh=0.01 sigma-v=0.005 ! videoconvert ! autovideosink
+* ]|
+* </refsect2>
+*/
+
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
 
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/video/video.h>
 
-#include "gstopencvutils.h"
 #include "gstsensorfx3dnoise.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_sfx3dnoise_debug);
 #define GST_CAT_DEFAULT gst_sfx3dnoise_debug
-#define DEBUG_INIT(bla) \
-  GST_DEBUG_CATEGORY_INIT (gst_sfx3dnoise_debug, "sfx3dnoise", 0, "ARF 3D-noise sensor effects");
 
 /* Filter signals and args */
 enum
@@ -71,7 +93,9 @@ enum
   PROP_SIGMA_TV,
   PROP_SIGMA_TH,
   PROP_SIGMA_VH,
-  PROP_SIGMA_TVH
+  PROP_SIGMA_TVH,
+  PROP_SEED,
+  PROP_N_THREADS
 };
 
 #define DEFAULT_SIGMA_T 0.0
@@ -81,31 +105,45 @@ enum
 #define DEFAULT_SIGMA_TH 0.0
 #define DEFAULT_SIGMA_VH 0.0
 #define DEFAULT_SIGMA_TVH 0.0
-
-GST_BOILERPLATE_FULL (GstSfx3DNoise, gst_sfx3dnoise, GstOpencvBaseTransform,
-    GST_TYPE_OPENCV_BASE_TRANSFORM, DEBUG_INIT);
+#define DEFAULT_SEED 0
+#define DEFAULT_N_THREADS 0
+
+/* columns processed at once, so the per-pixel noise stays in L1 cache */
+#define BLOCK_WIDTH 256
+
+static GstStaticPadTemplate gst_sfx3dnoise_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY16_LE, GRAY16_BE }"))
+    );
+
+static GstStaticPadTemplate gst_sfx3dnoise_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY16_LE, GRAY16_BE }"))
+    );
 
 static void gst_sfx3dnoise_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_sfx3dnoise_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
-static GstFlowReturn gst_sfx3dnoise_cv_transform (GstOpencvBaseTransform *
-    filter, GstBuffer * buf, IplImage * img, GstBuffer * outbuf,
-    IplImage * outimg);
-static gboolean gst_sfx3dnoise_cv_set_caps (GstOpencvBaseTransform * trans,
-    gint in_width, gint in_height, gint in_depth, gint in_channels,
-    gint out_width, gint out_height, gint out_depth, gint out_channels);
-
-void gst_sfx3dnoise_create_fixed_noise (GstSfx3DNoise * filter, CvMat * arr);
-void gst_sfx3dnoise_add_sigma_t (GstSfx3DNoise * filter, CvMat * arr,
-    double sigma);
-void gst_sfx3dnoise_add_sigma_tv (GstSfx3DNoise * filter, CvMat * arr,
-    double sigma);
-void gst_sfx3dnoise_add_sigma_th (GstSfx3DNoise * filter, CvMat * arr,
-    double sigma);
-void gst_sfx3dnoise_add_sigma_tvh (GstSfx3DNoise * filter, CvMat * arr,
-    double sigma);
+static gboolean gst_sfx3dnoise_start (GstBaseTransform * trans);
+static gboolean gst_sfx3dnoise_stop (GstBaseTransform * trans);
+
+static gboolean gst_sfx3dnoise_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_sfx3dnoise_transform_frame_ip (GstVideoFilter *
+    filter, GstVideoFrame * frame);
+
+static void gst_sfx3dnoise_free_planes (GstSfx3DNoise * filter);
+static void gst_sfx3dnoise_fixed_lines (gpointer user_data, guint index,
+    gint y_start, gint y_end);
+
+G_DEFINE_TYPE (GstSfx3DNoise, gst_sfx3dnoise, GST_TYPE_VIDEO_FILTER);
 
 /* Clean up */
 static void
@@ -113,124 +151,134 @@ gst_sfx3dnoise_finalize (GObject * obj)
 {
   GstSfx3DNoise *filter = GST_SFX3DNOISE (obj);
 
-  if (filter->fixed_noise)
-    cvReleaseMat (&filter->fixed_noise);
-  filter->fixed_noise = NULL;
-
-  if (filter->intermediary)
-    cvReleaseMat (&filter->intermediary);
-  filter->intermediary = NULL;
+  gst_sfx3dnoise_free_planes (filter);
 
-  G_OBJECT_CLASS (parent_class)->finalize (obj);
+  G_OBJECT_CLASS (gst_sfx3dnoise_parent_class)->finalize (obj);
 }
 
 /* GObject vmethod implementations */
 
-static void
-gst_sfx3dnoise_base_init (gpointer gclass)
-{
-  GstElementClass *element_class = GST_ELEMENT_CLASS (gclass);
-  GstCaps *caps;
-  GstPadTemplate *templ;
-
-  /* add sink and source pad templates */
-  caps = gst_caps_from_string (GST_VIDEO_CAPS_GRAY16 ("1234"));
-  templ = gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
-      gst_caps_ref (caps));
-  gst_element_class_add_pad_template (element_class, templ);
-  templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps);
-  gst_element_class_add_pad_template (element_class, templ);
-
-  gst_element_class_set_details_simple (element_class,
-      "sfx3dnoise",
-      "Transform/Effect/Video",
-      "Add 3D noise to video", "Joshua M. Doe <oss@nvl.army.mil>");
-}
-
 static void
 gst_sfx3dnoise_class_init (GstSfx3DNoiseClass * klass)
 {
-  GObjectClass *gobject_class;
-  GstBaseTransformClass *gstbasetransform_class;
-  GstOpencvBaseTransformClass *gstopencvbasefilter_class;
-  GstElementClass *gstelement_class;
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *gstbasetransform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *gstvideofilter_class = GST_VIDEO_FILTER_CLASS (klass);
 
-  gobject_class = (GObjectClass *) klass;
-  gstelement_class = (GstElementClass *) klass;
-  gstbasetransform_class = (GstBaseTransformClass *) klass;
-  gstopencvbasefilter_class = (GstOpencvBaseTransformClass *) klass;
-
-  parent_class = g_type_class_peek_parent (klass);
+  GST_DEBUG_CATEGORY_INIT (gst_sfx3dnoise_debug, "sfx3dnoise", 0,
+      "ARF 3D-noise sensor effects");
 
   gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_sfx3dnoise_finalize);
   gobject_class->set_property = gst_sfx3dnoise_set_property;
   gobject_class->get_property = gst_sfx3dnoise_get_property;
 
-  gstopencvbasefilter_class->cv_trans_func = gst_sfx3dnoise_cv_transform;
-  gstopencvbasefilter_class->cv_set_caps = gst_sfx3dnoise_cv_set_caps;
-
   g_object_class_install_property (gobject_class, PROP_SIGMA_T,
       g_param_spec_double ("sigma-t", "sigma-t",
-          "Adds	frame to frame noise or bounce (flicker)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          "Adds frame to frame noise or bounce (flicker)",
+          0.0, 1.0, DEFAULT_SIGMA_T,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_V,
       g_param_spec_double ("sigma-v", "sigma-v",
           "Adds fixed row noise (horizontal lines)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_V,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_H,
       g_param_spec_double ("sigma-h", "sigma-h",
           "Adds fixed column noise (vertical lines)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_H,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_TV,
       g_param_spec_double ("sigma-tv", "sigma-tv",
           "Adds temporal row bounce (random horizontal lines)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_TV,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_TH,
       g_param_spec_double ("sigma-th", "sigma-th",
           "Adds temporal column bounce (random vertical lines)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_TH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_VH,
       g_param_spec_double ("sigma-vh", "sigma-vh",
           "Adds random time-independent spatial noise (fixed pattern noise)",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_VH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 
   g_object_class_install_property (gobject_class, PROP_SIGMA_TVH,
       g_param_spec_double ("sigma-tvh", "sigma-tvh",
           "Adds random spatio-temporal noise",
-          0.0, 1.0, DEFAULT_SIGMA_T, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
-      );
+          0.0, 1.0, DEFAULT_SIGMA_TVH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint64 ("seed", "Seed",
+          "Seed of all fixed pattern and temporal noise", 0, G_MAXUINT64,
+          DEFAULT_SEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to split each frame across (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_sfx3dnoise_sink_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_sfx3dnoise_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "3D noise sensor effect", "Filter/Effect/Video",
+      "Add 3D noise to video", "Joshua M. Doe <oss@nvl.army.mil>");
+
+  gstbasetransform_class->start = GST_DEBUG_FUNCPTR (gst_sfx3dnoise_start);
+  gstbasetransform_class->stop = GST_DEBUG_FUNCPTR (gst_sfx3dnoise_stop);
+
+  gstvideofilter_class->set_info = GST_DEBUG_FUNCPTR (gst_sfx3dnoise_set_info);
+  gstvideofilter_class->transform_frame_ip =
+      GST_DEBUG_FUNCPTR (gst_sfx3dnoise_transform_frame_ip);
 }
 
 static void
-gst_sfx3dnoise_init (GstSfx3DNoise * filter, GstSfx3DNoiseClass * gclass)
+gst_sfx3dnoise_init (GstSfx3DNoise * filter)
 {
   GST_DEBUG ("Initializing");
 
   filter->sigma_t = DEFAULT_SIGMA_T;
-  filter->sigma_v = filter->sigma_v_old = DEFAULT_SIGMA_V;
-  filter->sigma_h = filter->sigma_h_old = DEFAULT_SIGMA_H;
+  filter->sigma_v = DEFAULT_SIGMA_V;
+  filter->sigma_h = DEFAULT_SIGMA_H;
   filter->sigma_tv = DEFAULT_SIGMA_TV;
   filter->sigma_th = DEFAULT_SIGMA_TH;
-  filter->sigma_vh = filter->sigma_vh_old = DEFAULT_SIGMA_VH;
+  filter->sigma_vh = DEFAULT_SIGMA_VH;
   filter->sigma_tvh = DEFAULT_SIGMA_TVH;
+  filter->seed = DEFAULT_SEED;
+  filter->n_threads = DEFAULT_N_THREADS;
 
-  filter->rng = cvRNG (-1);
+  gst_sfx_rng_init (&filter->rng, filter->seed);
+  filter->frame_count = 0;
+
+  filter->fixed_dirty = TRUE;
   filter->fixed_noise = NULL;
-  filter->intermediary = NULL;
+  filter->slice_pool = NULL;
+  filter->slice_pool_n_threads = 0;
 
   filter->width = 0;
   filter->height = 0;
+  filter->swap = FALSE;
 
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
 }
@@ -241,15 +289,18 @@ gst_sfx3dnoise_set_property (GObject * object, guint prop_id,
 {
   GstSfx3DNoise *filter = GST_SFX3DNOISE (object);
 
+  GST_OBJECT_LOCK (filter);
   switch (prop_id) {
     case PROP_SIGMA_T:
       filter->sigma_t = g_value_get_double (value);
       break;
     case PROP_SIGMA_V:
       filter->sigma_v = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
       break;
     case PROP_SIGMA_H:
       filter->sigma_h = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
       break;
     case PROP_SIGMA_TV:
       filter->sigma_tv = g_value_get_double (value);
@@ -259,14 +310,23 @@ gst_sfx3dnoise_set_property (GObject * object, guint prop_id,
       break;
     case PROP_SIGMA_VH:
       filter->sigma_vh = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
       break;
     case PROP_SIGMA_TVH:
       filter->sigma_tvh = g_value_get_double (value);
       break;
+    case PROP_SEED:
+      filter->seed = g_value_get_uint64 (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_N_THREADS:
+      filter->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (filter);
 }
 
 static void
@@ -275,6 +335,7 @@ gst_sfx3dnoise_get_property (GObject * object, guint prop_id,
 {
   GstSfx3DNoise *filter = GST_SFX3DNOISE (object);
 
+  GST_OBJECT_LOCK (filter);
   switch (prop_id) {
     case PROP_SIGMA_T:
       g_value_set_double (value, filter->sigma_t);
@@ -297,200 +358,223 @@ gst_sfx3dnoise_get_property (GObject * object, guint prop_id,
     case PROP_SIGMA_TVH:
       g_value_set_double (value, filter->sigma_tvh);
       break;
+    case PROP_SEED:
+      g_value_set_uint64 (value, filter->seed);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, filter->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (filter);
 }
 
-static GstFlowReturn
-gst_sfx3dnoise_cv_transform (GstOpencvBaseTransform * base, GstBuffer * buf,
-    IplImage * img, GstBuffer * outbuf, IplImage * outimg)
+static gboolean
+gst_sfx3dnoise_start (GstBaseTransform * trans)
 {
-  GstSfx3DNoise *filter = GST_SFX3DNOISE (base);
-
-  GST_DEBUG ("Transforming");
-
-  cvConvert (img, filter->intermediary);
-
-  if (filter->sigma_h != filter->sigma_h_old ||
-      filter->sigma_v != filter->sigma_v_old ||
-      filter->sigma_vh != filter->sigma_vh_old) {
-    GST_DEBUG ("Creating new fixed pattern noise image");
-    gst_sfx3dnoise_create_fixed_noise (filter, filter->fixed_noise);
-
-    filter->sigma_h_old = filter->sigma_h;
-    filter->sigma_v_old = filter->sigma_v;
-    filter->sigma_vh_old = filter->sigma_vh;
-  }
-
-  if (filter->sigma_h != 0.0 || filter->sigma_v != 0.0
-      || filter->sigma_vh != 0.0) {
-    cvAdd (filter->intermediary, filter->fixed_noise, filter->intermediary, 0);
-  }
-
-  if (filter->sigma_tvh > 0.0) {
-    gst_sfx3dnoise_add_sigma_tvh (filter, filter->intermediary,
-        filter->sigma_tvh);
-  }
-
-  if (filter->sigma_tv > 0.0) {
-    gst_sfx3dnoise_add_sigma_tv (filter, filter->intermediary,
-        filter->sigma_tv);
-  }
-
-  if (filter->sigma_th > 0.0) {
-    gst_sfx3dnoise_add_sigma_th (filter, filter->intermediary,
-        filter->sigma_th);
-  }
-
-  if (filter->sigma_t > 0.0) {
-    gst_sfx3dnoise_add_sigma_t (filter, filter->intermediary, filter->sigma_t);
-  }
+  GstSfx3DNoise *filter = GST_SFX3DNOISE (trans);
 
-  cvConvert (filter->intermediary, outimg);
+  filter->frame_count = 0;
 
-  return GST_FLOW_OK;
+  return TRUE;
 }
 
 static gboolean
-gst_sfx3dnoise_cv_set_caps (GstOpencvBaseTransform * trans, gint in_width,
-    gint in_height, gint in_depth, gint in_channels, gint out_width,
-    gint out_height, gint out_depth, gint out_channels)
+gst_sfx3dnoise_stop (GstBaseTransform * trans)
 {
   GstSfx3DNoise *filter = GST_SFX3DNOISE (trans);
 
-  GST_DEBUG ("Caps have been set");
+  gst_sfx3dnoise_free_planes (filter);
 
-  filter->width = in_width;
-  filter->height = in_height;
-
-  if (filter->intermediary) {
-    cvReleaseMat (&filter->intermediary);
-    filter->intermediary = NULL;
-  }
+  return TRUE;
+}
 
-  if (out_depth != IPL_DEPTH_32F) {
-    filter->intermediary = cvCreateMat (out_height, out_width, CV_32FC1);
-  }
+static gboolean
+gst_sfx3dnoise_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstSfx3DNoise *filter = GST_SFX3DNOISE (vfilter);
 
-  if (filter->fixed_noise) {
-    cvReleaseMat (&filter->fixed_noise);
-    filter->fixed_noise = NULL;
-  }
-  filter->fixed_noise = cvCreateMat (out_height, out_width, CV_32FC1);
-  gst_sfx3dnoise_create_fixed_noise (filter, filter->fixed_noise);
+  GST_DEBUG_OBJECT (filter, "Caps have been set");
 
+  filter->width = GST_VIDEO_INFO_WIDTH (in_info);
+  filter->height = GST_VIDEO_INFO_HEIGHT (in_info);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  filter->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_BE;
+#else
+  filter->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_LE;
+#endif
 
+  /* all noise is generated into these, so no allocations happen per frame */
+  gst_sfx3dnoise_free_planes (filter);
+  filter->fixed_noise = g_new (gfloat, filter->width * filter->height);
+  gst_sfx_noise_init (&filter->noise, filter->width, filter->height);
 
-  /* TODO create fixed noise here */
+  GST_OBJECT_LOCK (filter);
+  filter->fixed_dirty = TRUE;
+  GST_OBJECT_UNLOCK (filter);
 
   return TRUE;
 }
 
-gboolean
-gst_sfx3dnoise_plugin_init (GstPlugin * plugin)
+/* add the noise to a row of pixels in place, rounding and saturating to the
+ * 16-bit range; the conditions are loop invariant and the loop has no
+ * dependencies between pixels, so it is vectorized by the compiler */
+static inline void
+gst_sfx3dnoise_add_row (guint16 * data, gint width, gfloat row_offset,
+    const gfloat * noise, const gfloat * fixed, gboolean swap)
 {
-  GST_DEBUG ("Initializing plugin sfx3dnoise");
+  gint x;
 
-  return gst_element_register (plugin, "sfx3dnoise", GST_RANK_NONE,
-      GST_TYPE_SFX3DNOISE);
-}
+  for (x = 0; x < width; x++) {
+    guint16 in = swap ? GUINT16_SWAP_LE_BE (data[x]) : data[x];
+    gfloat val = in + row_offset + noise[x];
+    guint16 out;
 
-void
-gst_sfx3dnoise_create_fixed_noise (GstSfx3DNoise * filter, CvMat * arr)
-{
-  cvZero (arr);
-  gst_sfx3dnoise_add_sigma_tvh (filter, arr, filter->sigma_vh);
-  gst_sfx3dnoise_add_sigma_th (filter, arr, filter->sigma_h);
-  gst_sfx3dnoise_add_sigma_tv (filter, arr, filter->sigma_v);
+    if (fixed)
+      val += fixed[x];
+
+    out = (guint16) CLAMP (val + 0.5f, 0.0f, 65535.0f);
+    data[x] = swap ? GUINT16_SWAP_LE_BE (out) : out;
+  }
 }
 
-/* Add sigma-vh or sigma-tvh noise, which adds random noise to every pixel */
-void
-gst_sfx3dnoise_add_sigma_tvh (GstSfx3DNoise * filter, CvMat * arr, double sigma)
+/* parameters of a frame, shared by all slices */
+typedef struct
 {
-  CvMat *noise = cvCreateMat (filter->height, filter->width, CV_32F);
-
-  /* TODO move scaling of sigma somewhere else? */
-  cvRandArr (&filter->rng, noise, CV_RAND_NORMAL, cvScalarAll (0),
-      cvScalarAll (sigma * (G_MAXUINT16 - 1)));
-
-  cvAdd (arr, noise, arr, 0);
+  GstSfx3DNoise *filter;
+  GstVideoFrame *frame;
+  guint64 frame_num;
+  gboolean have_fixed;
+  gfloat sigma_vh;
+  gfloat sigma_tvh;
+} GstSfx3DNoiseParams;
 
-  cvReleaseMat (&noise);
+static void
+gst_sfx3dnoise_process_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstSfx3DNoiseParams *params = (GstSfx3DNoiseParams *) user_data;
+  GstSfx3DNoise *filter = params->filter;
+  const gint width = filter->width;
+  guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (params->frame, 0);
+  const gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (params->frame, 0);
+  gfloat noise[BLOCK_WIDTH];
+  gint x0, y;
+
+  for (y = y_start; y < y_end; y++) {
+    const guint32 row = (guint32) y * width;
+    const gfloat row_offset = filter->noise.offset_t +
+        filter->noise.row_noise[y];
+    guint16 *line = (guint16 *) (data + y * stride);
+
+    for (x0 = 0; x0 < width; x0 += BLOCK_WIDTH) {
+      const gint n = MIN (BLOCK_WIDTH, width - x0);
+
+      gst_sfx_noise_temporal_block (&filter->noise, &filter->rng,
+          params->frame_num, params->sigma_tvh, y, x0, noise, n);
+
+      gst_sfx3dnoise_add_row (line + x0, n, row_offset, noise,
+          params->have_fixed ? filter->fixed_noise + row + x0 : NULL,
+          filter->swap);
+    }
+  }
 }
 
-
-/* Add sigma-v or sigma-tv noise, which adds random horizontal lines */
-void
-gst_sfx3dnoise_add_sigma_tv (GstSfx3DNoise * filter, CvMat * arr, double sigma)
+static GstFlowReturn
+gst_sfx3dnoise_transform_frame_ip (GstVideoFilter * vfilter,
+    GstVideoFrame * frame)
 {
-  CvMat *noise = cvCreateMat (1, filter->height, CV_32F);
-  gfloat *data;
-  gfloat *noisedata;
-  int step, x, y;
+  GstSfx3DNoise *filter = GST_SFX3DNOISE (vfilter);
+  const gint height = filter->height;
+  GstSfx3DNoiseParams params;
+  gfloat sigma_t, sigma_v, sigma_h, sigma_tv, sigma_th;
+  gboolean fixed_dirty;
+  guint64 seed;
+  guint n_threads;
+
+  params.filter = filter;
+  params.frame = frame;
+  params.frame_num = filter->frame_count++;
+
+  GST_OBJECT_LOCK (filter);
+  sigma_t = filter->sigma_t * G_MAXUINT16;
+  sigma_v = filter->sigma_v * G_MAXUINT16;
+  sigma_h = filter->sigma_h * G_MAXUINT16;
+  sigma_tv = filter->sigma_tv * G_MAXUINT16;
+  sigma_th = filter->sigma_th * G_MAXUINT16;
+  params.sigma_vh = filter->sigma_vh * G_MAXUINT16;
+  params.sigma_tvh = filter->sigma_tvh * G_MAXUINT16;
+  seed = filter->seed;
+  n_threads = filter->n_threads;
+  fixed_dirty = filter->fixed_dirty;
+  filter->fixed_dirty = FALSE;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (filter->slice_pool == NULL || filter->slice_pool_n_threads != n_threads) {
+    gst_slice_pool_free (filter->slice_pool);
+    filter->slice_pool = gst_slice_pool_new (n_threads);
+    filter->slice_pool_n_threads = n_threads;
+    GST_DEBUG_OBJECT (filter, "Using %d threads",
+        gst_slice_pool_get_n_threads (filter->slice_pool));
+  }
 
-  /* TODO move scaling of sigma somewhere else? */
-  cvRandArr (&filter->rng, noise, CV_RAND_NORMAL, cvScalarAll (0),
-      cvScalarAll (sigma * (G_MAXUINT16 - 1)));
+  params.have_fixed = sigma_v > 0.0f || sigma_h > 0.0f ||
+      params.sigma_vh > 0.0f;
 
-  cvGetRawData (arr, (uchar **) & data, &step, NULL);
-  cvGetRawData (noise, (uchar **) & noisedata, NULL, NULL);
+  if (fixed_dirty) {
+    gst_sfx_rng_init (&filter->rng, seed);
 
-  step /= sizeof (gfloat);
+    if (params.have_fixed) {
+      GST_DEBUG_OBJECT (filter, "Creating new fixed pattern noise image");
 
-  for (y = 0; y < filter->height; y++) {
-    for (x = 0; x < filter->width; x++) {
-      data[y * step + x] += noisedata[y];
+      gst_sfx_noise_begin_fixed (&filter->noise, &filter->rng, sigma_v,
+          sigma_h);
+      gst_slice_pool_run (filter->slice_pool, height,
+          gst_sfx3dnoise_fixed_lines, &params);
     }
   }
 
-  cvReleaseMat (&noise);
-}
-
+  if (!params.have_fixed && sigma_t == 0.0f && sigma_tv == 0.0f &&
+      sigma_th == 0.0f && params.sigma_tvh == 0.0f)
+    return GST_FLOW_OK;
 
-/* Add sigma-h and sigma-th noise, which adds random vertical lines */
-void
-gst_sfx3dnoise_add_sigma_th (GstSfx3DNoise * filter, CvMat * arr, double sigma)
-{
-  CvMat *noise = cvCreateMat (1, filter->width, CV_32F);
-  gfloat *data;
-  gfloat *noisedata;
-  int step, x, y;
+  GST_LOG_OBJECT (filter, "Adding noise to frame %" G_GUINT64_FORMAT,
+      params.frame_num);
 
-  /* TODO move scaling of sigma somewhere else? */
-  cvRandArr (&filter->rng, noise, CV_RAND_NORMAL, cvScalarAll (0),
-      cvScalarAll (sigma * (G_MAXUINT16 - 1)));
+  gst_sfx_noise_begin_frame (&filter->noise, &filter->rng, params.frame_num,
+      sigma_t, sigma_tv, sigma_th);
 
-  cvGetRawData (arr, (uchar **) & data, &step, NULL);
-  cvGetRawData (noise, (uchar **) & noisedata, NULL, NULL);
+  gst_slice_pool_run (filter->slice_pool, height,
+      gst_sfx3dnoise_process_lines, &params);
 
-  step /= sizeof (gfloat);
-
-  for (y = 0; y < filter->height; y++) {
-    for (x = 0; x < filter->width; x++) {
-      data[y * step + x] += noisedata[x];
-    }
-  }
-
-  cvReleaseMat (&noise);
+  return GST_FLOW_OK;
 }
 
-/* Add Sigma_T noise, which creates a flashing effect */
-void
-gst_sfx3dnoise_add_sigma_t (GstSfx3DNoise * filter, CvMat * arr, double sigma)
+static void
+gst_sfx3dnoise_free_planes (GstSfx3DNoise * filter)
 {
-  CvMat *noise = cvCreateMat (1, 1, CV_32F);
-  float *data;
-
-  /* TODO move scaling of sigma somewhere else? */
-  cvRandArr (&filter->rng, noise, CV_RAND_NORMAL, cvScalarAll (0),
-      cvScalarAll (sigma * (G_MAXUINT16 - 1)));
+  g_free (filter->fixed_noise);
+  filter->fixed_noise = NULL;
+  gst_sfx_noise_clear (&filter->noise);
 
-  cvGetRawData (noise, (uchar **) & data, NULL, NULL);
+  gst_slice_pool_free (filter->slice_pool);
+  filter->slice_pool = NULL;
+  filter->slice_pool_n_threads = 0;
+}
 
-  cvAddS (arr, cvScalarAll (*data), arr, 0);
+/* the fixed pattern image, for rows [y_start, y_end) */
+static void
+gst_sfx3dnoise_fixed_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstSfx3DNoiseParams *params = (GstSfx3DNoiseParams *) user_data;
+  GstSfx3DNoise *filter = params->filter;
+  gint y;
 
-  cvReleaseMat (&noise);
+  for (y = y_start; y < y_end; y++)
+    gst_sfx_noise_fixed_row (&filter->noise, &filter->rng, params->sigma_vh,
+        y, filter->fixed_noise + (gsize) y * filter->width);
 }
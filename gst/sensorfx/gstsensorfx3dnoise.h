@@ -1,6 +1,7 @@
 /*
  * GStreamer
  * Copyright (C) 2010 Thiago Santos <thiago.sousa.santos@collabora.co.uk>
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
  * 
  * Permission is hereby granted, free of charge, to any person obtaining a
  * copy of this software and associated documentation files (the "Software"),
@@ -44,9 +45,11 @@
 #ifndef __GST_SFX3DNOISE_H__
 #define __GST_SFX3DNOISE_H__
 
-#include <gst/gst.h>
-#include <cv.h>
-#include <gstopencvbasetrans.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "gstsensorfxnoise.h"
+#include "gstsensorfxrng.h"
+#include "gstslicepool.h"
 
 G_BEGIN_DECLS
 
@@ -67,8 +70,9 @@ typedef struct _GstSfx3DNoiseClass GstSfx3DNoiseClass;
 
 struct _GstSfx3DNoise
 {
-  GstOpencvBaseTransform element;
+  GstVideoFilter element;
 
+  /* properties */
   gdouble sigma_t;
   gdouble sigma_v;
   gdouble sigma_h;
@@ -76,28 +80,34 @@ struct _GstSfx3DNoise
   gdouble sigma_th;
   gdouble sigma_vh;
   gdouble sigma_tvh;
+  guint64 seed;
+  guint n_threads;
 
-  gdouble sigma_v_old;
-  gdouble sigma_h_old;
-  gdouble sigma_vh_old;
-
+  /* format */
   gint width;
   gint height;
+  gboolean swap;
+
+  GstSfxRng rng;
+  guint64 frame_count;
 
-  CvRNG rng;
-  CvMat * fixed_noise;
-  CvMat * intermediary;
+  /* noise planes, allocated once per caps */
+  gboolean fixed_dirty;
+  gfloat *fixed_noise;
+  GstSfxNoise noise;
+
+  /* row slice workers */
+  GstSlicePool *slice_pool;
+  guint slice_pool_n_threads;
 };
 
 struct _GstSfx3DNoiseClass 
 {
-  GstOpencvBaseTransformClass parent_class;
+  GstVideoFilterClass parent_class;
 };
 
 GType gst_sfx3dnoise_get_type (void);
 
-gboolean gst_sfx3dnoise_plugin_init (GstPlugin * plugin);
-
 G_END_DECLS
 
 #endif /* __GST_SFX3DNOISE_H__ */
@@ -24,12 +24,16 @@
 /**
 * SECTION:element-sfxblur
 *
-* Convert grayscale video from one bpp/depth combination to another.
+* Blur grayscale video with a separable point spread function, to simulate
+* optics degradation. The PSF is either a Gaussian of the given sigma, or a
+* user-supplied one-dimensional kernel that is applied both horizontally and
+* vertically. Pixels beyond the frame edges are replicated from the edges.
 *
 * <refsect2>
 * <title>Example launch line</title>
 * |[
-* gst-launch videotestsrc ! sfxblur ! ffmpegcolorspace ! autovideosink
+* gst-launch-1.0 videotestsrc ! video/x-raw,format=GRAY16_LE ! sfxblur sigma=2.3 kernel-size=15 ! videoconvert ! autovideosink
+* gst-launch-1.0 videotestsrc ! video/x-raw,format=GRAY8 ! sfxblur kernel="1,4,6,4,1" ! videoconvert ! autovideosink
 * ]|
 * </refsect2>
 */
@@ -43,9 +47,6 @@
 
 #include <gst/video/video.h>
 
-#include <cv.h>
-
-#include "gstopencvutils.h"
 #include "gstsensorfxblur.h"
 
 /* GstSensorFxBlur signals and args */
@@ -58,56 +59,36 @@ enum
 enum
 {
   PROP_0,
-  PROP_LOWIN,
+  PROP_SIGMA,
+  PROP_KERNEL_SIZE,
+  PROP_KERNEL,
+  PROP_N_THREADS
 };
 
-#define DEFAULT_PROP_LOWIN  0.0
+#define DEFAULT_PROP_SIGMA 1.0
+#define DEFAULT_PROP_KERNEL_SIZE 0
+#define DEFAULT_PROP_KERNEL NULL
+#define DEFAULT_PROP_N_THREADS 0
+
+#define MAX_KERNEL_SIZE 255
 
-static const GstElementDetails sfxblur_details =
-GST_ELEMENT_DETAILS ("Blurs video",
-    "Filter/Effect/Video",
-    "Applies a blur kernel to video",
-    "Joshua Doe <oss@nvl.army.mil");
+/* columns processed at once, sized so the accumulators and the source row
+ * segments of a 15-tap kernel stay in L1 cache */
+#define BLOCK_WIDTH 256
 
 /* the capabilities of the inputs and outputs */
-static GstStaticPadTemplate gst_sfxblur_src_template =
-    GST_STATIC_PAD_TEMPLATE ("sink",
+static GstStaticPadTemplate gst_sfxblur_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("video/x-raw-gray, "
-        "bpp = (int) 16, "
-        "depth = (int) 16, "
-        "endianness = (int) BYTE_ORDER, "
-        "width = " GST_VIDEO_SIZE_RANGE ", "
-        "height = " GST_VIDEO_SIZE_RANGE ", "
-        "framerate = " GST_VIDEO_FPS_RANGE ";"
-        "video/x-raw-gray-float, "
-        "bpp = (int) 32, "
-        "depth = (int) 32, "
-        "endianness = (int) BYTE_ORDER, "
-        "width = " GST_VIDEO_SIZE_RANGE ", "
-        "height = " GST_VIDEO_SIZE_RANGE ", "
-        "framerate = " GST_VIDEO_FPS_RANGE)
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }"))
     );
 
-static GstStaticPadTemplate gst_sfxblur_sink_template =
-    GST_STATIC_PAD_TEMPLATE ("src",
+static GstStaticPadTemplate gst_sfxblur_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("video/x-raw-gray, "
-        "bpp = (int) 16, "
-        "depth = (int) 16, "
-        "endianness = (int) BYTE_ORDER, "
-        "width = " GST_VIDEO_SIZE_RANGE ", "
-        "height = " GST_VIDEO_SIZE_RANGE ", "
-        "framerate = " GST_VIDEO_FPS_RANGE ";"
-        "video/x-raw-gray-float, "
-        "bpp = (int) 32, "
-        "depth = (int) 32, "
-        "endianness = (int) BYTE_ORDER, "
-        "width = " GST_VIDEO_SIZE_RANGE ", "
-        "height = " GST_VIDEO_SIZE_RANGE ", "
-        "framerate = " GST_VIDEO_FPS_RANGE)
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }"))
     );
 
 /* GObject vmethod declarations */
@@ -118,49 +99,30 @@ static void gst_sfxblur_get_property (GObject * object, guint prop_id,
 static void gst_sfxblur_finalize (GObject * object);
 
 /* GstBaseTransform vmethod declarations */
-static gboolean gst_sfxblur_set_caps (GstBaseTransform * base,
-    GstCaps * incaps, GstCaps * outcaps);
-static GstFlowReturn gst_sfxblur_transform_ip (GstBaseTransform * base,
-    GstBuffer * buf);
+static gboolean gst_sfxblur_stop (GstBaseTransform * trans);
+
+/* GstVideoFilter vmethod declarations */
+static gboolean gst_sfxblur_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_sfxblur_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame);
 
 /* GstSensorFxBlur method declarations */
 static void gst_sfxblur_reset (GstSensorFxBlur * filter);
+static void gst_sfxblur_update_kernel (GstSensorFxBlur * filter);
 
 /* setup debug */
 GST_DEBUG_CATEGORY_STATIC (sfxblur_debug);
 #define GST_CAT_DEFAULT sfxblur_debug
-#define DEBUG_INIT(bla) \
-    GST_DEBUG_CATEGORY_INIT (sfxblur_debug, "sfxblur", 0, \
-    "sfxblur");
 
-GST_BOILERPLATE_FULL (GstSensorFxBlur, gst_sfxblur, GstVideoFilter,
-    GST_TYPE_VIDEO_FILTER, DEBUG_INIT);
+G_DEFINE_TYPE (GstSensorFxBlur, gst_sfxblur, GST_TYPE_VIDEO_FILTER);
 
 
 /************************************************************************/
 /* GObject vmethod implementations                                      */
 /************************************************************************/
 
-/**
- * gst_sfxblur_base_init:
- * @klass: #GstElementClass.
- *
- */
-static void
-gst_sfxblur_base_init (gpointer klass)
-{
-  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
-
-  GST_DEBUG ("base init");
-
-  gst_element_class_set_details (element_class, &sfxblur_details);
-
-  gst_element_class_add_pad_template (element_class,
-      gst_static_pad_template_get (&gst_sfxblur_sink_template));
-  gst_element_class_add_pad_template (element_class,
-      gst_static_pad_template_get (&gst_sfxblur_src_template));
-}
-
 /**
  * gst_sfxblur_finalize:
  * @object: #GObject.
@@ -175,8 +137,12 @@ gst_sfxblur_finalize (GObject * object)
 
   gst_sfxblur_reset (sfxblur);
 
+  g_free (sfxblur->kernel_string);
+  g_free (sfxblur->user_kernel);
+  g_free (sfxblur->kernel);
+
   /* chain up to the parent class */
-  G_OBJECT_CLASS (parent_class)->finalize (object);
+  G_OBJECT_CLASS (gst_sfxblur_parent_class)->finalize (object);
 }
 
 /**
@@ -188,10 +154,13 @@ static void
 gst_sfxblur_class_init (GstSensorFxBlurClass * object)
 {
   GObjectClass *obj_class = G_OBJECT_CLASS (object);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (object);
   GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (object);
+  GstVideoFilterClass *vfilter_class = GST_VIDEO_FILTER_CLASS (object);
 
-  GST_DEBUG ("class init");
+  GST_DEBUG_CATEGORY_INIT (sfxblur_debug, "sfxblur", 0, "sfxblur");
 
+  GST_DEBUG ("class init");
 
   /* Register GObject vmethods */
   obj_class->finalize = GST_DEBUG_FUNCPTR (gst_sfxblur_finalize);
@@ -199,30 +168,103 @@ gst_sfxblur_class_init (GstSensorFxBlurClass * object)
   obj_class->get_property = GST_DEBUG_FUNCPTR (gst_sfxblur_get_property);
 
   /* Install GObject properties */
-  g_object_class_install_property (obj_class, PROP_LOWIN,
-      g_param_spec_double ("lower-input-level", "Lower Input Level",
-          "Lower Input Level", 0.0, 1.0, DEFAULT_PROP_LOWIN,
-          G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_SIGMA,
+      g_param_spec_double ("sigma", "Sigma",
+          "Standard deviation of the Gaussian PSF in pixels (0 = no blur)",
+          0.0, MAX_KERNEL_SIZE / 6.0, DEFAULT_PROP_SIGMA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_KERNEL_SIZE,
+      g_param_spec_uint ("kernel-size", "Kernel size",
+          "Number of taps of the Gaussian PSF, rounded up to an odd number "
+          "(0 = 2 * ceil (3 * sigma) + 1)", 0, MAX_KERNEL_SIZE,
+          DEFAULT_PROP_KERNEL_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_KERNEL,
+      g_param_spec_string ("kernel", "Kernel",
+          "Separable PSF as an odd number of comma-separated taps, applied "
+          "horizontally and vertically and normalized to unit sum, overrides "
+          "the Gaussian PSF (NULL = Gaussian)", DEFAULT_PROP_KERNEL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to split each frame across (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_PROP_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_sfxblur_sink_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_sfxblur_src_template));
+
+  gst_element_class_set_static_metadata (element_class, "Blurs video",
+      "Filter/Effect/Video", "Applies a separable blur kernel to video",
+      "Joshua M. Doe <oss@nvl.army.mil>");
 
   /* Register GstBaseTransform vmethods */
-  trans_class->set_caps = GST_DEBUG_FUNCPTR (gst_sfxblur_set_caps);
-  trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_sfxblur_transform_ip);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_sfxblur_stop);
+
+  vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_sfxblur_set_info);
+  vfilter_class->transform_frame =
+      GST_DEBUG_FUNCPTR (gst_sfxblur_transform_frame);
 }
 
 /**
 * gst_sfxblur_init:
 * @sfxblur: GstSensorFxBlur
-* @g_class: GstSensorFxBlurClass
 *
 * Initialize the new element
 */
 static void
-gst_sfxblur_init (GstSensorFxBlur * sfxblur, GstSensorFxBlurClass * g_class)
+gst_sfxblur_init (GstSensorFxBlur * sfxblur)
 {
   GST_DEBUG_OBJECT (sfxblur, "init class instance");
 
+  sfxblur->sigma = DEFAULT_PROP_SIGMA;
+  sfxblur->kernel_size = DEFAULT_PROP_KERNEL_SIZE;
+  sfxblur->kernel_string = DEFAULT_PROP_KERNEL;
+  sfxblur->n_threads = DEFAULT_PROP_N_THREADS;
+  sfxblur->kernel_dirty = TRUE;
+
   gst_sfxblur_reset (sfxblur);
+}
+
+/* parse comma-separated taps, returns NULL if the kernel is unusable */
+static gfloat *
+gst_sfxblur_parse_kernel (const gchar * str, gint * taps)
+{
+  gchar **tokens;
+  gfloat *kernel;
+  gint i, n = 0;
+
+  tokens = g_strsplit_set (str, ", ;", -1);
+  kernel = g_new (gfloat, g_strv_length (tokens));
 
+  for (i = 0; tokens[i]; i++) {
+    gchar *end;
+    gdouble val;
+
+    if (tokens[i][0] == '\0')
+      continue;
+
+    val = g_ascii_strtod (tokens[i], &end);
+    if (*end != '\0') {
+      n = 0;
+      break;
+    }
+    kernel[n++] = (gfloat) val;
+  }
+  g_strfreev (tokens);
+
+  if (n == 0 || n % 2 == 0 || n > MAX_KERNEL_SIZE) {
+    g_free (kernel);
+    return NULL;
+  }
+
+  *taps = n;
+  return kernel;
 }
 
 /**
@@ -241,11 +283,47 @@ gst_sfxblur_set_property (GObject * object, guint prop_id,
 
   GST_DEBUG ("setting property %s", pspec->name);
 
+  GST_OBJECT_LOCK (sfxblur);
   switch (prop_id) {
+    case PROP_SIGMA:
+      sfxblur->sigma = g_value_get_double (value);
+      sfxblur->kernel_dirty = TRUE;
+      break;
+    case PROP_KERNEL_SIZE:
+      sfxblur->kernel_size = g_value_get_uint (value);
+      sfxblur->kernel_dirty = TRUE;
+      break;
+    case PROP_KERNEL:
+    {
+      const gchar *str = g_value_get_string (value);
+      gfloat *kernel = NULL;
+      gint taps = 0;
+
+      if (str && str[0] != '\0') {
+        kernel = gst_sfxblur_parse_kernel (str, &taps);
+        if (!kernel) {
+          GST_WARNING_OBJECT (sfxblur, "Ignoring invalid kernel '%s', need "
+              "an odd number of at most %d taps", str, MAX_KERNEL_SIZE);
+          break;
+        }
+      }
+
+      g_free (sfxblur->kernel_string);
+      sfxblur->kernel_string = kernel ? g_strdup (str) : NULL;
+      g_free (sfxblur->user_kernel);
+      sfxblur->user_kernel = kernel;
+      sfxblur->user_kernel_taps = taps;
+      sfxblur->kernel_dirty = TRUE;
+      break;
+    }
+    case PROP_N_THREADS:
+      sfxblur->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (sfxblur);
 }
 
 /**
@@ -264,67 +342,225 @@ gst_sfxblur_get_property (GObject * object, guint prop_id, GValue * value,
 
   GST_DEBUG ("getting property %s", pspec->name);
 
+  GST_OBJECT_LOCK (sfxblur);
   switch (prop_id) {
+    case PROP_SIGMA:
+      g_value_set_double (value, sfxblur->sigma);
+      break;
+    case PROP_KERNEL_SIZE:
+      g_value_set_uint (value, sfxblur->kernel_size);
+      break;
+    case PROP_KERNEL:
+      g_value_set_string (value, sfxblur->kernel_string);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, sfxblur->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (sfxblur);
 }
 
 /************************************************************************/
 /* GstBaseTransform vmethod implementations                             */
 /************************************************************************/
 
-/**
- * gst_sfxblur_set_caps:
- * base: #GstBaseTransform
- * incaps: #GstCaps
- * outcaps: #GstCaps
- * 
- * Notification of the actual caps set.
- *
- * Returns: TRUE on acceptance of caps
- */
 static gboolean
-gst_sfxblur_set_caps (GstBaseTransform * base, GstCaps * incaps,
-    GstCaps * outcaps)
+gst_sfxblur_stop (GstBaseTransform * trans)
 {
-  GstSensorFxBlur *levels;
-  GstStructure *structure;
-  gboolean res;
+  GstSensorFxBlur *sfxblur = GST_SENSORFXBLUR (trans);
 
-  levels = GST_SENSORFXBLUR (base);
+  gst_sfxblur_reset (sfxblur);
 
-  GST_DEBUG_OBJECT (levels,
-      "set_caps: in %" GST_PTR_FORMAT " out %" GST_PTR_FORMAT, incaps, outcaps);
+  return TRUE;
+}
 
-  GST_DEBUG_OBJECT (incaps, "incaps");
-  GST_DEBUG_OBJECT (outcaps, "outcaps");
+/************************************************************************/
+/* GstVideoFilter vmethod implementations                               */
+/************************************************************************/
 
-  /* retrieve input caps info */
-  structure = gst_caps_get_structure (incaps, 0);
+static gboolean
+gst_sfxblur_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstSensorFxBlur *sfxblur = GST_SENSORFXBLUR (filter);
+
+  GST_DEBUG_OBJECT (sfxblur,
+      "set_caps: in %" GST_PTR_FORMAT " out %" GST_PTR_FORMAT, incaps, outcaps);
 
-  //mime = gst_structure_get_name (structure);
-  //if (g_strcmp0 ("video/x-raw-gray", mime) == 0)
-  //  levels->
+  sfxblur->width = GST_VIDEO_INFO_WIDTH (in_info);
+  sfxblur->height = GST_VIDEO_INFO_HEIGHT (in_info);
+  sfxblur->bytes_per_pixel = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  sfxblur->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_BE;
+#else
+  sfxblur->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_LE;
+#endif
 
-  res = gst_structure_get (structure,
-      "width", G_TYPE_INT, &levels->width,
-      "height", G_TYPE_INT, &levels->height,
-      "bpp", G_TYPE_INT, &levels->bpp,
-      "depth", G_TYPE_INT, &levels->depth,
-      "endianness", G_TYPE_INT, &levels->endianness, NULL);
-  if (!res)
-    return FALSE;
+  return TRUE;
+}
+
+typedef struct
+{
+  GstSensorFxBlur *filter;
+  GstVideoFrame *in_frame;
+  GstVideoFrame *out_frame;
+} GstSensorFxBlurSlice;
+
+/* accumulate one weighted source row into the vertical pass accumulators;
+ * the format conditions are loop invariant so each variant vectorizes */
+static inline void
+gst_sfxblur_accumulate (gfloat * acc, const guint8 * src, gint n, gfloat w,
+    gint bytes_per_pixel, gboolean swap)
+{
+  gint i;
+
+  if (bytes_per_pixel == 1) {
+    for (i = 0; i < n; i++)
+      acc[i] += w * src[i];
+  } else if (swap) {
+    const guint16 *src16 = (const guint16 *) src;
+    for (i = 0; i < n; i++)
+      acc[i] += w * GUINT16_SWAP_LE_BE (src16[i]);
+  } else {
+    const guint16 *src16 = (const guint16 *) src;
+    for (i = 0; i < n; i++)
+      acc[i] += w * src16[i];
+  }
+}
 
-  levels->stride = GST_ROUND_UP_4 (levels->width * levels->depth / 8);
+static inline void
+gst_sfxblur_store (guint8 * dst, const gfloat * acc, gint n,
+    gint bytes_per_pixel, gboolean swap)
+{
+  gint i;
+
+  if (bytes_per_pixel == 1) {
+    for (i = 0; i < n; i++)
+      dst[i] = (guint8) CLAMP (acc[i] + 0.5f, 0.0f, 255.0f);
+  } else if (swap) {
+    guint16 *dst16 = (guint16 *) dst;
+    for (i = 0; i < n; i++) {
+      guint16 val = (guint16) CLAMP (acc[i] + 0.5f, 0.0f, 65535.0f);
+      dst16[i] = GUINT16_SWAP_LE_BE (val);
+    }
+  } else {
+    guint16 *dst16 = (guint16 *) dst;
+    for (i = 0; i < n; i++)
+      dst16[i] = (guint16) CLAMP (acc[i] + 0.5f, 0.0f, 65535.0f);
+  }
+}
 
-  return res;
+/* Blur rows [y_start, y_end). For each output row the vertical pass
+ * accumulates the source rows within the kernel radius into a padded float
+ * row, one block of columns at a time, then the horizontal pass convolves
+ * that row block by block. Both passes are tap-outer/pixel-inner so the
+ * inner loops are plain multiply-adds over contiguous memory. */
+static void
+gst_sfxblur_process_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstSensorFxBlurSlice *slice = (GstSensorFxBlurSlice *) user_data;
+  GstSensorFxBlur *filter = slice->filter;
+  const gint width = filter->width;
+  const gint height = filter->height;
+  const gint bpp = filter->bytes_per_pixel;
+  const gboolean swap = filter->swap;
+  const gint radius = filter->radius;
+  const gint taps = 2 * radius + 1;
+  const gfloat *kernel = filter->kernel;
+  const guint8 *in_data = GST_VIDEO_FRAME_PLANE_DATA (slice->in_frame, 0);
+  const gint in_stride = GST_VIDEO_FRAME_PLANE_STRIDE (slice->in_frame, 0);
+  guint8 *out_data = GST_VIDEO_FRAME_PLANE_DATA (slice->out_frame, 0);
+  const gint out_stride = GST_VIDEO_FRAME_PLANE_STRIDE (slice->out_frame, 0);
+  gfloat *row = filter->scratch + index * filter->scratch_stride;
+  gfloat *center = row + radius;
+  gfloat acc[BLOCK_WIDTH];
+  gint x0, y, t, i;
+
+  for (y = y_start; y < y_end; y++) {
+    guint8 *dst = out_data + y * out_stride;
+
+    /* vertical pass */
+    for (x0 = 0; x0 < width; x0 += BLOCK_WIDTH) {
+      const gint n = MIN (BLOCK_WIDTH, width - x0);
+      gfloat *block = center + x0;
+
+      memset (block, 0, n * sizeof (gfloat));
+      for (t = 0; t < taps; t++) {
+        const gint sy = CLAMP (y + t - radius, 0, height - 1);
+        gst_sfxblur_accumulate (block, in_data + sy * in_stride + x0 * bpp,
+            n, kernel[t], bpp, swap);
+      }
+    }
+
+    /* replicate the edges for the horizontal pass */
+    for (i = 1; i <= radius; i++) {
+      center[-i] = center[0];
+      center[width - 1 + i] = center[width - 1];
+    }
+
+    /* horizontal pass */
+    for (x0 = 0; x0 < width; x0 += BLOCK_WIDTH) {
+      const gint n = MIN (BLOCK_WIDTH, width - x0);
+
+      memset (acc, 0, n * sizeof (gfloat));
+      for (t = 0; t < taps; t++) {
+        const gfloat w = kernel[t];
+        const gfloat *src = row + x0 + t;
+        for (i = 0; i < n; i++)
+          acc[i] += w * src[i];
+      }
+
+      gst_sfxblur_store (dst + x0 * bpp, acc, n, bpp, swap);
+    }
+  }
 }
 
-GstFlowReturn
-gst_sfxblur_transform_ip (GstBaseTransform * base, GstBuffer * buf)
+static GstFlowReturn
+gst_sfxblur_transform_frame (GstVideoFilter * filter,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
 {
+  GstSensorFxBlur *sfxblur = GST_SENSORFXBLUR (filter);
+  GstSensorFxBlurSlice slice;
+  guint n_threads;
+  gsize scratch_size;
+
+  GST_LOG_OBJECT (sfxblur, "Performing non-inplace transform");
+
+  GST_OBJECT_LOCK (sfxblur);
+  n_threads = sfxblur->n_threads;
+  if (sfxblur->kernel_dirty) {
+    gst_sfxblur_update_kernel (sfxblur);
+    sfxblur->kernel_dirty = FALSE;
+  }
+  GST_OBJECT_UNLOCK (sfxblur);
+
+  if (sfxblur->slice_pool == NULL || sfxblur->slice_pool_n_threads != n_threads) {
+    gst_slice_pool_free (sfxblur->slice_pool);
+    sfxblur->slice_pool = gst_slice_pool_new (n_threads);
+    sfxblur->slice_pool_n_threads = n_threads;
+    GST_DEBUG_OBJECT (sfxblur, "Using %d threads",
+        gst_slice_pool_get_n_threads (sfxblur->slice_pool));
+  }
+
+  /* only reallocated when the size, kernel or number of threads change */
+  sfxblur->scratch_stride = sfxblur->width + 2 * sfxblur->radius;
+  scratch_size = (gsize) sfxblur->scratch_stride *
+      gst_slice_pool_get_n_threads (sfxblur->slice_pool);
+  if (scratch_size != sfxblur->scratch_size) {
+    g_free (sfxblur->scratch);
+    sfxblur->scratch = g_new (gfloat, scratch_size);
+    sfxblur->scratch_size = scratch_size;
+  }
+
+  slice.filter = sfxblur;
+  slice.in_frame = in_frame;
+  slice.out_frame = out_frame;
+  gst_slice_pool_run (sfxblur->slice_pool, sfxblur->height,
+      gst_sfxblur_process_lines, &slice);
 
   return GST_FLOW_OK;
 }
@@ -344,15 +580,67 @@ gst_sfxblur_reset (GstSensorFxBlur * sfxblur)
 {
   sfxblur->width = 0;
   sfxblur->height = 0;
-  sfxblur->stride = 0;
-  sfxblur->bpp = 0;
-  sfxblur->depth = 0;
-  sfxblur->endianness = 0;
+  sfxblur->bytes_per_pixel = 0;
+  sfxblur->swap = FALSE;
+
+  gst_slice_pool_free (sfxblur->slice_pool);
+  sfxblur->slice_pool = NULL;
+  sfxblur->slice_pool_n_threads = 0;
+
+  g_free (sfxblur->scratch);
+  sfxblur->scratch = NULL;
+  sfxblur->scratch_stride = 0;
+  sfxblur->scratch_size = 0;
 }
 
-gboolean
-gst_sfxblur_plugin_init (GstPlugin * plugin)
+/**
+ * gst_sfxblur_update_kernel:
+ * @sfxblur: #GstSensorFxBlur
+ *
+ * Build the normalized kernel from the user PSF or the Gaussian properties.
+ * Must be called with the object lock held.
+ */
+static void
+gst_sfxblur_update_kernel (GstSensorFxBlur * sfxblur)
 {
-  return gst_element_register (plugin, "sfxblur", GST_RANK_NONE,
-      GST_TYPE_SENSORFXBLUR);
+  gint taps, i;
+  gdouble sum = 0.0;
+
+  if (sfxblur->user_kernel) {
+    taps = sfxblur->user_kernel_taps;
+    g_free (sfxblur->kernel);
+    sfxblur->kernel = g_new (gfloat, taps);
+    memcpy (sfxblur->kernel, sfxblur->user_kernel, taps * sizeof (gfloat));
+  } else {
+    const gdouble sigma = sfxblur->sigma;
+    gint radius;
+
+    if (sfxblur->kernel_size > 0)
+      radius = sfxblur->kernel_size / 2;
+    else
+      radius = (gint) ceil (3.0 * sigma);
+    if (sigma == 0.0)
+      radius = 0;
+
+    taps = 2 * radius + 1;
+    g_free (sfxblur->kernel);
+    sfxblur->kernel = g_new (gfloat, taps);
+    for (i = 0; i < taps; i++) {
+      const gdouble d = i - radius;
+      sfxblur->kernel[i] =
+          radius ? (gfloat) exp (-(d * d) / (2.0 * sigma * sigma)) : 1.0f;
+    }
+  }
+
+  for (i = 0; i < taps; i++)
+    sum += sfxblur->kernel[i];
+  if (sum != 0.0) {
+    for (i = 0; i < taps; i++)
+      sfxblur->kernel[i] = (gfloat) (sfxblur->kernel[i] / sum);
+  }
+
+  sfxblur->radius = taps / 2;
+
+  GST_DEBUG_OBJECT (sfxblur, "Using %s kernel with %d taps",
+      sfxblur->user_kernel ? "user" : "Gaussian", taps);
 }
@@ -27,6 +27,8 @@
 
 #include <gst/video/gstvideofilter.h>
 
+#include "gstslicepool.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_SENSORFXBLUR \
@@ -57,13 +59,30 @@ struct _GstSensorFxBlur
   /* format */
   gint width;
   gint height;
-  guint stride;
-  gint bpp;
-  gint depth;
-  gint endianness;
+  gint bytes_per_pixel;
+  gboolean swap;
 
   /* properties */
+  gdouble sigma;
+  guint kernel_size;
+  gchar *kernel_string;
+  guint n_threads;
+
+  /* user PSF parsed from kernel_string, NULL for Gaussian */
+  gfloat *user_kernel;
+  gint user_kernel_taps;
 
+  /* normalized kernel of 2 * radius + 1 taps, applied in both directions */
+  gboolean kernel_dirty;
+  gfloat *kernel;
+  gint radius;
+
+  /* row slice workers, each with a padded row of scratch */
+  GstSlicePool *slice_pool;
+  guint slice_pool_n_threads;
+  gfloat *scratch;
+  gint scratch_stride;
+  gsize scratch_size;
 };
 
 struct _GstSensorFxBlurClass
@@ -73,8 +92,6 @@ struct _GstSensorFxBlurClass
 
 GType gst_sfxblur_get_type(void);
 
-gboolean gst_sfxblur_plugin_init (GstPlugin * plugin);
-
 G_END_DECLS
 
 #endif /* __GST_SENSORFXBLUR_H__ */
@@ -0,0 +1,133 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* The 3D noise model shared by sfx3dnoise and sfxsensor. Every component
+ * draws from its own random stream, addressed by frame and pixel, so any
+ * rows can be generated from any thread with identical results. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstsensorfxnoise.h"
+
+/* the planes are allocated once per caps, so nothing is allocated per frame */
+void
+gst_sfx_noise_init (GstSfxNoise * noise, gint width, gint height)
+{
+  noise->width = width;
+  noise->height = height;
+  noise->offset_t = 0.0f;
+  noise->row_noise = g_new0 (gfloat, height);
+  noise->col_noise = g_new0 (gfloat, width);
+}
+
+void
+gst_sfx_noise_clear (GstSfxNoise * noise)
+{
+  g_free (noise->row_noise);
+  noise->row_noise = NULL;
+  g_free (noise->col_noise);
+  noise->col_noise = NULL;
+  noise->width = 0;
+  noise->height = 0;
+}
+
+static void
+gst_sfx_noise_line (const GstSfxRng * rng, guint32 stream, guint64 frame,
+    gfloat sigma, gfloat * dst, gint n)
+{
+  if (sigma > 0.0f)
+    gst_sfx_rng_normal (rng, stream, frame, 0, sigma, dst, n);
+  else
+    memset (dst, 0, n * sizeof (gfloat));
+}
+
+/* generate the fixed row (v) and column (h) noise, which
+ * gst_sfx_noise_fixed_row() folds into the fixed pattern; the planes are
+ * scratch until gst_sfx_noise_begin_frame() */
+void
+gst_sfx_noise_begin_fixed (GstSfxNoise * noise, const GstSfxRng * rng,
+    gfloat sigma_v, gfloat sigma_h)
+{
+  gst_sfx_noise_line (rng, GST_SFX_NOISE_STREAM_V, 0, sigma_v,
+      noise->row_noise, noise->height);
+  gst_sfx_noise_line (rng, GST_SFX_NOISE_STREAM_H, 0, sigma_h,
+      noise->col_noise, noise->width);
+}
+
+/* combine vh (random noise on every pixel) with the v and h lines into row y
+ * of the fixed pattern */
+void
+gst_sfx_noise_fixed_row (const GstSfxNoise * noise, const GstSfxRng * rng,
+    gfloat sigma_vh, gint y, gfloat * dst)
+{
+  const gint width = noise->width;
+  const gfloat row_noise = noise->row_noise[y];
+  gint x;
+
+  if (sigma_vh > 0.0f)
+    gst_sfx_rng_normal (rng, GST_SFX_NOISE_STREAM_VH, 0, (guint32) y * width,
+        sigma_vh, dst, width);
+  else
+    memset (dst, 0, width * sizeof (gfloat));
+
+  for (x = 0; x < width; x++)
+    dst[x] += row_noise + noise->col_noise[x];
+}
+
+/* generate the temporal components shared by the whole frame (t), a row (tv)
+ * or a column (th) */
+void
+gst_sfx_noise_begin_frame (GstSfxNoise * noise, const GstSfxRng * rng,
+    guint64 frame, gfloat sigma_t, gfloat sigma_tv, gfloat sigma_th)
+{
+  noise->offset_t = 0.0f;
+  if (sigma_t > 0.0f)
+    gst_sfx_rng_normal (rng, GST_SFX_NOISE_STREAM_T, frame, 0, sigma_t,
+        &noise->offset_t, 1);
+
+  gst_sfx_noise_line (rng, GST_SFX_NOISE_STREAM_TV, frame, sigma_tv,
+      noise->row_noise, noise->height);
+  gst_sfx_noise_line (rng, GST_SFX_NOISE_STREAM_TH, frame, sigma_th,
+      noise->col_noise, noise->width);
+}
+
+/* the per-pixel temporal noise (tvh) plus the column noise (th) of n pixels
+ * of row y starting at x0; the row noise is left to the caller, as it is the
+ * same for the whole row */
+void
+gst_sfx_noise_temporal_block (const GstSfxNoise * noise,
+    const GstSfxRng * rng, guint64 frame, gfloat sigma_tvh, gint y, gint x0,
+    gfloat * dst, gint n)
+{
+  const gfloat *col_noise = noise->col_noise + x0;
+  gint i;
+
+  if (sigma_tvh > 0.0f) {
+    gst_sfx_rng_normal (rng, GST_SFX_NOISE_STREAM_TVH, frame,
+        (guint32) y * noise->width + x0, sigma_tvh, dst, n);
+    for (i = 0; i < n; i++)
+      dst[i] += col_noise[i];
+  } else {
+    memcpy (dst, col_noise, n * sizeof (gfloat));
+  }
+}
@@ -0,0 +1,86 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_SFX_NOISE_H__
+#define __GST_SFX_NOISE_H__
+
+#include <glib.h>
+
+#include "gstsensorfxrng.h"
+
+G_BEGIN_DECLS
+
+/* random streams of the 3D noise model components, elements adding random
+ * components of their own use streams from GST_SFX_NOISE_STREAM_LAST on */
+enum
+{
+  GST_SFX_NOISE_STREAM_VH,
+  GST_SFX_NOISE_STREAM_V,
+  GST_SFX_NOISE_STREAM_H,
+  GST_SFX_NOISE_STREAM_T,
+  GST_SFX_NOISE_STREAM_TV,
+  GST_SFX_NOISE_STREAM_TH,
+  GST_SFX_NOISE_STREAM_TVH,
+  GST_SFX_NOISE_STREAM_LAST
+};
+
+/**
+ * GstSfxNoise:
+ * @width: width of the frames
+ * @height: height of the frames
+ * @offset_t: temporal noise of the whole current frame
+ * @row_noise: noise of each row, fixed while building the fixed pattern and
+ *   temporal of the current frame afterwards
+ * @col_noise: noise of each column, likewise
+ *
+ * Generates the components of the 3D noise model, which splits sensor noise
+ * into temporal (t), vertical (v) and horizontal (h) components and their
+ * combinations. The fixed pattern (v, h and vh) is generated row by row into
+ * a plane owned by the caller, the temporal components frame by frame.
+ */
+typedef struct _GstSfxNoise GstSfxNoise;
+
+struct _GstSfxNoise
+{
+  gint width;
+  gint height;
+
+  gfloat offset_t;
+  gfloat *row_noise;
+  gfloat *col_noise;
+};
+
+void gst_sfx_noise_init (GstSfxNoise * noise, gint width, gint height);
+void gst_sfx_noise_clear (GstSfxNoise * noise);
+
+void gst_sfx_noise_begin_fixed (GstSfxNoise * noise, const GstSfxRng * rng,
+    gfloat sigma_v, gfloat sigma_h);
+void gst_sfx_noise_fixed_row (const GstSfxNoise * noise,
+    const GstSfxRng * rng, gfloat sigma_vh, gint y, gfloat * dst);
+
+void gst_sfx_noise_begin_frame (GstSfxNoise * noise, const GstSfxRng * rng,
+    guint64 frame, gfloat sigma_t, gfloat sigma_tv, gfloat sigma_th);
+void gst_sfx_noise_temporal_block (const GstSfxNoise * noise,
+    const GstSfxRng * rng, guint64 frame, gfloat sigma_tvh, gint y, gint x0,
+    gfloat * dst, gint n);
+
+G_END_DECLS
+
+#endif /* __GST_SFX_NOISE_H__ */
@@ -0,0 +1,181 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+ * numbers: as easy as 1, 2, 3", SC11). Each 128-bit counter is encrypted
+ * with the key into four independent 32-bit outputs. The counter is made of
+ * the block index within the frame, the frame number and the stream, so
+ * generating numbers needs no shared state. The loops below have no
+ * dependencies between blocks, so compilers vectorize them. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "gstsensorfxrng.h"
+
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9
+#define PHILOX_W1 0xBB67AE85
+
+/* number of 4-word blocks generated per batch */
+#define RNG_BATCH 64
+
+static inline void
+philox4x32_10 (guint32 c0, guint32 c1, guint32 c2, guint32 c3, guint32 k0,
+    guint32 k1, guint32 * out)
+{
+  gint i;
+
+  for (i = 0; i < 10; i++) {
+    guint64 p0 = (guint64) PHILOX_M0 * c0;
+    guint64 p1 = (guint64) PHILOX_M1 * c2;
+    guint32 n0 = (guint32) (p1 >> 32) ^ c1 ^ k0;
+    guint32 n2 = (guint32) (p0 >> 32) ^ c3 ^ k1;
+
+    c1 = (guint32) p1;
+    c3 = (guint32) p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/**
+ * gst_sfx_rng_init:
+ * @rng: a #GstSfxRng
+ * @seed: seed to derive the key from
+ */
+void
+gst_sfx_rng_init (GstSfxRng * rng, guint64 seed)
+{
+  rng->key[0] = (guint32) seed;
+  rng->key[1] = (guint32) (seed >> 32);
+}
+
+/**
+ * gst_sfx_rng_normal:
+ * @rng: a #GstSfxRng
+ * @stream: independent stream of numbers, e.g. one per noise component
+ * @frame: frame number within the stream
+ * @offset: index of the first number to generate within the frame
+ * @sigma: standard deviation
+ * @dst: (out caller-allocates) (array length=n): destination
+ * @n: number of values to generate
+ *
+ * Fills @dst with normally distributed values with zero mean, using the
+ * Box-Muller transform. Value i of a frame is always the same, no matter
+ * how the frame is split into calls, so slices of a frame can be generated
+ * in parallel with identical results.
+ */
+void
+gst_sfx_rng_normal (const GstSfxRng * rng, guint32 stream, guint64 frame,
+    guint32 offset, gfloat sigma, gfloat * dst, guint n)
+{
+  guint32 raw[RNG_BATCH * 4];
+  gfloat values[RNG_BATCH * 4];
+  const guint32 f0 = (guint32) frame;
+  const guint32 f1 = (guint32) (frame >> 32);
+  const guint32 k0 = rng->key[0];
+  const guint32 k1 = rng->key[1];
+  guint32 block = offset / 4;
+  guint skip = offset % 4;
+
+  while (n > 0) {
+    guint nblocks = MIN (RNG_BATCH, (skip + n + 3) / 4);
+    guint ncopy = MIN (nblocks * 4 - skip, n);
+    guint i;
+
+    for (i = 0; i < nblocks; i++)
+      philox4x32_10 (block + i, f0, f1, stream, k0, k1, &raw[i * 4]);
+
+    /* use the upper 24 bits so the conversions to float are exact, u1 is
+     * offset by half a step to keep it out of zero */
+    for (i = 0; i < nblocks * 2; i++) {
+      gfloat u1 = ((raw[2 * i] >> 8) + 0.5f) * (1.0f / 16777216.0f);
+      gfloat u2 = (raw[2 * i + 1] >> 8) * (gfloat) (2.0 * G_PI / 16777216.0);
+      gfloat r = sigma * sqrtf (-2.0f * logf (u1));
+
+      values[2 * i] = r * cosf (u2);
+      values[2 * i + 1] = r * sinf (u2);
+    }
+
+    memcpy (dst, values + skip, ncopy * sizeof (gfloat));
+
+    dst += ncopy;
+    n -= ncopy;
+    block += nblocks;
+    skip = 0;
+  }
+}
+
+/**
+ * gst_sfx_rng_uniform:
+ * @rng: a #GstSfxRng
+ * @stream: independent stream of numbers
+ * @frame: frame number within the stream
+ * @offset: index of the first number to generate within the frame
+ * @dst: (out caller-allocates) (array length=n): destination
+ * @n: number of values to generate
+ *
+ * Fills @dst with values uniformly distributed in [0, 1), with the same
+ * addressing guarantees as gst_sfx_rng_normal().
+ */
+void
+gst_sfx_rng_uniform (const GstSfxRng * rng, guint32 stream, guint64 frame,
+    guint32 offset, gfloat * dst, guint n)
+{
+  guint32 raw[RNG_BATCH * 4];
+  gfloat values[RNG_BATCH * 4];
+  const guint32 f0 = (guint32) frame;
+  const guint32 f1 = (guint32) (frame >> 32);
+  const guint32 k0 = rng->key[0];
+  const guint32 k1 = rng->key[1];
+  guint32 block = offset / 4;
+  guint skip = offset % 4;
+
+  while (n > 0) {
+    guint nblocks = MIN (RNG_BATCH, (skip + n + 3) / 4);
+    guint ncopy = MIN (nblocks * 4 - skip, n);
+    guint i;
+
+    for (i = 0; i < nblocks; i++)
+      philox4x32_10 (block + i, f0, f1, stream, k0, k1, &raw[i * 4]);
+
+    for (i = 0; i < nblocks * 4; i++)
+      values[i] = (raw[i] >> 8) * (1.0f / 16777216.0f);
+
+    memcpy (dst, values + skip, ncopy * sizeof (gfloat));
+
+    dst += ncopy;
+    n -= ncopy;
+    block += nblocks;
+    skip = 0;
+  }
+}
@@ -0,0 +1,51 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_SFX_RNG_H__
+#define __GST_SFX_RNG_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstSfxRng:
+ *
+ * Key of a counter-based (Philox4x32-10) random number generator. The
+ * generator has no state besides its key: the numbers returned for a given
+ * stream, frame and offset only depend on the key, so any part of any frame
+ * can be generated independently, in any order and from any thread.
+ */
+typedef struct _GstSfxRng GstSfxRng;
+
+struct _GstSfxRng
+{
+  guint32 key[2];
+};
+
+void gst_sfx_rng_init (GstSfxRng * rng, guint64 seed);
+void gst_sfx_rng_normal (const GstSfxRng * rng, guint32 stream,
+    guint64 frame, guint32 offset, gfloat sigma, gfloat * dst, guint n);
+void gst_sfx_rng_uniform (const GstSfxRng * rng, guint32 stream,
+    guint64 frame, guint32 offset, gfloat * dst, guint n);
+
+G_END_DECLS
+
+#endif /* __GST_SFX_RNG_H__ */
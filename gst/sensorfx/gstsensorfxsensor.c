@@ -0,0 +1,700 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+* SECTION:element-sfxsensor
+*
+* Simulates a sensor in a single pass over each frame. Every pixel is scaled
+* by a fixed per-pixel gain, offset by fixed pattern noise, gets temporal
+* noise added according to the 3D noise model of sfx3dnoise, is replaced if
+* it is a dead or hot pixel, and is finally quantized to the given bit
+* depth. All randomness derives from the seed property, so the same seed
+* and input give the same output, regardless of the number of threads.
+*
+* <refsect2>
+* <title>Example launch line</title>
+* |[
+* gst-launch-1.0 videotestsrc ! video/x-raw,format=GRAY16_LE ! sfxsensor gain-sigma=0.02 sigma-tvh=0.005 dead-fraction=0.0001 bit-depth=12 ! videoconvert ! autovideosink
+* ]|
+* </refsect2>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/video/video.h>
+
+#include "gstsensorfxsensor.h"
+
+/* GstSfxSensor signals and args */
+enum
+{
+  /* FILL ME */
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_SEED,
+  PROP_GAIN_SIGMA,
+  PROP_SIGMA_T,
+  PROP_SIGMA_V,
+  PROP_SIGMA_H,
+  PROP_SIGMA_TV,
+  PROP_SIGMA_TH,
+  PROP_SIGMA_VH,
+  PROP_SIGMA_TVH,
+  PROP_DEAD_FRACTION,
+  PROP_HOT_FRACTION,
+  PROP_BIT_DEPTH,
+  PROP_N_THREADS
+};
+
+#define DEFAULT_PROP_SEED 0
+#define DEFAULT_PROP_GAIN_SIGMA 0.0
+#define DEFAULT_PROP_SIGMA 0.0
+#define DEFAULT_PROP_DEAD_FRACTION 0.0
+#define DEFAULT_PROP_HOT_FRACTION 0.0
+#define DEFAULT_PROP_BIT_DEPTH 16
+#define DEFAULT_PROP_N_THREADS 0
+
+/* columns processed at once, so the per-pixel noise stays in L1 cache */
+#define BLOCK_WIDTH 256
+
+/* random streams of the components besides the 3D noise model */
+enum
+{
+  STREAM_GAIN = GST_SFX_NOISE_STREAM_LAST,
+  STREAM_DEFECTS
+};
+
+/* values of the defect map */
+enum
+{
+  PIXEL_OK,
+  PIXEL_DEAD,
+  PIXEL_HOT
+};
+
+/* the capabilities of the inputs and outputs */
+static GstStaticPadTemplate gst_sfxsensor_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }"))
+    );
+
+static GstStaticPadTemplate gst_sfxsensor_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }"))
+    );
+
+/* GObject vmethod declarations */
+static void gst_sfxsensor_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_sfxsensor_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_sfxsensor_finalize (GObject * object);
+
+/* GstBaseTransform vmethod declarations */
+static gboolean gst_sfxsensor_start (GstBaseTransform * trans);
+static gboolean gst_sfxsensor_stop (GstBaseTransform * trans);
+
+/* GstVideoFilter vmethod declarations */
+static gboolean gst_sfxsensor_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+static GstFlowReturn gst_sfxsensor_transform_frame_ip (GstVideoFilter *
+    filter, GstVideoFrame * frame);
+
+/* GstSfxSensor method declarations */
+static void gst_sfxsensor_reset (GstSfxSensor * filter);
+
+/* setup debug */
+GST_DEBUG_CATEGORY_STATIC (sfxsensor_debug);
+#define GST_CAT_DEFAULT sfxsensor_debug
+
+G_DEFINE_TYPE (GstSfxSensor, gst_sfxsensor, GST_TYPE_VIDEO_FILTER);
+
+
+/************************************************************************/
+/* GObject vmethod implementations                                      */
+/************************************************************************/
+
+static void
+gst_sfxsensor_finalize (GObject * object)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (object);
+
+  GST_DEBUG ("finalize");
+
+  gst_sfxsensor_reset (filter);
+
+  /* chain up to the parent class */
+  G_OBJECT_CLASS (gst_sfxsensor_parent_class)->finalize (object);
+}
+
+static void
+gst_sfxsensor_install_sigma (GObjectClass * obj_class, guint prop_id,
+    const gchar * name, const gchar * blurb)
+{
+  g_object_class_install_property (obj_class, prop_id,
+      g_param_spec_double (name, name, blurb, 0.0, 1.0, DEFAULT_PROP_SIGMA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+}
+
+static void
+gst_sfxsensor_class_init (GstSfxSensorClass * klass)
+{
+  GObjectClass *obj_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *vfilter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (sfxsensor_debug, "sfxsensor", 0, "sfxsensor");
+
+  GST_DEBUG ("class init");
+
+  /* Register GObject vmethods */
+  obj_class->finalize = GST_DEBUG_FUNCPTR (gst_sfxsensor_finalize);
+  obj_class->set_property = GST_DEBUG_FUNCPTR (gst_sfxsensor_set_property);
+  obj_class->get_property = GST_DEBUG_FUNCPTR (gst_sfxsensor_get_property);
+
+  /* Install GObject properties */
+  g_object_class_install_property (obj_class, PROP_SEED,
+      g_param_spec_uint64 ("seed", "Seed",
+          "Seed of all fixed pattern and temporal noise", 0, G_MAXUINT64,
+          DEFAULT_PROP_SEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_GAIN_SIGMA,
+      g_param_spec_double ("gain-sigma", "Gain sigma",
+          "Standard deviation of the fixed per-pixel gain around 1.0", 0.0,
+          1.0, DEFAULT_PROP_GAIN_SIGMA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_T, "sigma-t",
+      "Adds frame to frame noise or bounce (flicker)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_V, "sigma-v",
+      "Adds fixed row noise (horizontal lines)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_H, "sigma-h",
+      "Adds fixed column noise (vertical lines)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_TV, "sigma-tv",
+      "Adds temporal row bounce (random horizontal lines)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_TH, "sigma-th",
+      "Adds temporal column bounce (random vertical lines)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_VH, "sigma-vh",
+      "Adds random time-independent spatial noise (fixed pattern offset)");
+  gst_sfxsensor_install_sigma (obj_class, PROP_SIGMA_TVH, "sigma-tvh",
+      "Adds random spatio-temporal noise");
+  g_object_class_install_property (obj_class, PROP_DEAD_FRACTION,
+      g_param_spec_double ("dead-fraction", "Dead pixel fraction",
+          "Fraction of pixels stuck at zero", 0.0, 1.0,
+          DEFAULT_PROP_DEAD_FRACTION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_HOT_FRACTION,
+      g_param_spec_double ("hot-fraction", "Hot pixel fraction",
+          "Fraction of pixels stuck at the maximum value", 0.0, 1.0,
+          DEFAULT_PROP_HOT_FRACTION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_BIT_DEPTH,
+      g_param_spec_uint ("bit-depth", "Bit depth",
+          "Number of significant bits to quantize to, limited to the bits "
+          "of the video format", 1, 16, DEFAULT_PROP_BIT_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (obj_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to split each frame across (0 = number of "
+          "processors)", 0, G_MAXINT, DEFAULT_PROP_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_sfxsensor_sink_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_sfxsensor_src_template));
+
+  gst_element_class_set_static_metadata (element_class, "Sensor model",
+      "Filter/Effect/Video",
+      "Applies fixed pattern gain and offset, 3D noise, defective pixels "
+      "and quantization to video in a single pass",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  /* Register GstBaseTransform vmethods */
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_sfxsensor_start);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_sfxsensor_stop);
+
+  vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_sfxsensor_set_info);
+  vfilter_class->transform_frame_ip =
+      GST_DEBUG_FUNCPTR (gst_sfxsensor_transform_frame_ip);
+}
+
+static void
+gst_sfxsensor_init (GstSfxSensor * filter)
+{
+  GST_DEBUG_OBJECT (filter, "init class instance");
+
+  filter->seed = DEFAULT_PROP_SEED;
+  filter->gain_sigma = DEFAULT_PROP_GAIN_SIGMA;
+  filter->sigma_t = DEFAULT_PROP_SIGMA;
+  filter->sigma_v = DEFAULT_PROP_SIGMA;
+  filter->sigma_h = DEFAULT_PROP_SIGMA;
+  filter->sigma_tv = DEFAULT_PROP_SIGMA;
+  filter->sigma_th = DEFAULT_PROP_SIGMA;
+  filter->sigma_vh = DEFAULT_PROP_SIGMA;
+  filter->sigma_tvh = DEFAULT_PROP_SIGMA;
+  filter->dead_fraction = DEFAULT_PROP_DEAD_FRACTION;
+  filter->hot_fraction = DEFAULT_PROP_HOT_FRACTION;
+  filter->bit_depth = DEFAULT_PROP_BIT_DEPTH;
+  filter->n_threads = DEFAULT_PROP_N_THREADS;
+
+  filter->fixed_dirty = TRUE;
+
+  gst_sfxsensor_reset (filter);
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
+}
+
+static void
+gst_sfxsensor_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (object);
+
+  GST_DEBUG ("setting property %s", pspec->name);
+
+  GST_OBJECT_LOCK (filter);
+  switch (prop_id) {
+    case PROP_SEED:
+      filter->seed = g_value_get_uint64 (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_GAIN_SIGMA:
+      filter->gain_sigma = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_SIGMA_T:
+      filter->sigma_t = g_value_get_double (value);
+      break;
+    case PROP_SIGMA_V:
+      filter->sigma_v = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_SIGMA_H:
+      filter->sigma_h = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_SIGMA_TV:
+      filter->sigma_tv = g_value_get_double (value);
+      break;
+    case PROP_SIGMA_TH:
+      filter->sigma_th = g_value_get_double (value);
+      break;
+    case PROP_SIGMA_VH:
+      filter->sigma_vh = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_SIGMA_TVH:
+      filter->sigma_tvh = g_value_get_double (value);
+      break;
+    case PROP_DEAD_FRACTION:
+      filter->dead_fraction = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_HOT_FRACTION:
+      filter->hot_fraction = g_value_get_double (value);
+      filter->fixed_dirty = TRUE;
+      break;
+    case PROP_BIT_DEPTH:
+      filter->bit_depth = g_value_get_uint (value);
+      break;
+    case PROP_N_THREADS:
+      filter->n_threads = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (filter);
+}
+
+static void
+gst_sfxsensor_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (object);
+
+  GST_DEBUG ("getting property %s", pspec->name);
+
+  GST_OBJECT_LOCK (filter);
+  switch (prop_id) {
+    case PROP_SEED:
+      g_value_set_uint64 (value, filter->seed);
+      break;
+    case PROP_GAIN_SIGMA:
+      g_value_set_double (value, filter->gain_sigma);
+      break;
+    case PROP_SIGMA_T:
+      g_value_set_double (value, filter->sigma_t);
+      break;
+    case PROP_SIGMA_V:
+      g_value_set_double (value, filter->sigma_v);
+      break;
+    case PROP_SIGMA_H:
+      g_value_set_double (value, filter->sigma_h);
+      break;
+    case PROP_SIGMA_TV:
+      g_value_set_double (value, filter->sigma_tv);
+      break;
+    case PROP_SIGMA_TH:
+      g_value_set_double (value, filter->sigma_th);
+      break;
+    case PROP_SIGMA_VH:
+      g_value_set_double (value, filter->sigma_vh);
+      break;
+    case PROP_SIGMA_TVH:
+      g_value_set_double (value, filter->sigma_tvh);
+      break;
+    case PROP_DEAD_FRACTION:
+      g_value_set_double (value, filter->dead_fraction);
+      break;
+    case PROP_HOT_FRACTION:
+      g_value_set_double (value, filter->hot_fraction);
+      break;
+    case PROP_BIT_DEPTH:
+      g_value_set_uint (value, filter->bit_depth);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, filter->n_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (filter);
+}
+
+/************************************************************************/
+/* GstBaseTransform vmethod implementations                             */
+/************************************************************************/
+
+static gboolean
+gst_sfxsensor_start (GstBaseTransform * trans)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (trans);
+
+  filter->frame_count = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_sfxsensor_stop (GstBaseTransform * trans)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (trans);
+
+  gst_sfxsensor_reset (filter);
+
+  return TRUE;
+}
+
+/************************************************************************/
+/* GstVideoFilter vmethod implementations                               */
+/************************************************************************/
+
+static gboolean
+gst_sfxsensor_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (vfilter);
+  gsize npixels;
+
+  GST_DEBUG_OBJECT (filter,
+      "set_caps: in %" GST_PTR_FORMAT " out %" GST_PTR_FORMAT, incaps, outcaps);
+
+  gst_sfxsensor_reset (filter);
+
+  filter->width = GST_VIDEO_INFO_WIDTH (in_info);
+  filter->height = GST_VIDEO_INFO_HEIGHT (in_info);
+  filter->bytes_per_pixel = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
+  filter->depth = GST_VIDEO_INFO_COMP_DEPTH (in_info, 0);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  filter->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_BE;
+#else
+  filter->swap = GST_VIDEO_INFO_FORMAT (in_info) == GST_VIDEO_FORMAT_GRAY16_LE;
+#endif
+
+  /* all model planes are allocated once per caps */
+  npixels = (gsize) filter->width * filter->height;
+  filter->gain = g_new (gfloat, npixels);
+  filter->offset = g_new (gfloat, npixels);
+  filter->defects = g_new (guint8, npixels);
+  gst_sfx_noise_init (&filter->noise, filter->width, filter->height);
+
+  GST_OBJECT_LOCK (filter);
+  filter->fixed_dirty = TRUE;
+  GST_OBJECT_UNLOCK (filter);
+
+  return TRUE;
+}
+
+/* parameters of a frame, shared by all slices */
+typedef struct
+{
+  GstSfxSensor *filter;
+  GstVideoFrame *frame;
+  guint64 frame_num;
+
+  gfloat gain_sigma;
+  gfloat sigma_vh;
+  gfloat sigma_tvh;
+  gfloat dead_fraction;
+  gfloat hot_fraction;
+
+  gfloat step;
+  gfloat max_code;
+  gfloat max_value;
+} GstSfxSensorParams;
+
+static void
+gst_sfxsensor_fixed_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstSfxSensorParams *params = (GstSfxSensorParams *) user_data;
+  GstSfxSensor *filter = params->filter;
+  const gint width = filter->width;
+  gfloat uniform[BLOCK_WIDTH];
+  gint x0, y, i;
+
+  for (y = y_start; y < y_end; y++) {
+    const guint32 row = (guint32) y * width;
+    gfloat *gain = filter->gain + row;
+    gfloat *offset = filter->offset + row;
+    guint8 *defects = filter->defects + row;
+
+    if (params->gain_sigma > 0.0f) {
+      gst_sfx_rng_normal (&filter->rng, STREAM_GAIN, 0, row,
+          params->gain_sigma, gain, width);
+      for (i = 0; i < width; i++)
+        gain[i] += 1.0f;
+    } else {
+      for (i = 0; i < width; i++)
+        gain[i] = 1.0f;
+    }
+
+    gst_sfx_noise_fixed_row (&filter->noise, &filter->rng, params->sigma_vh,
+        y, offset);
+
+    if (params->dead_fraction > 0.0f || params->hot_fraction > 0.0f) {
+      const gfloat dead = params->dead_fraction;
+      const gfloat dead_or_hot = params->dead_fraction + params->hot_fraction;
+
+      for (x0 = 0; x0 < width; x0 += BLOCK_WIDTH) {
+        const gint n = MIN (BLOCK_WIDTH, width - x0);
+
+        gst_sfx_rng_uniform (&filter->rng, STREAM_DEFECTS, 0, row + x0,
+            uniform, n);
+        for (i = 0; i < n; i++) {
+          defects[x0 + i] = uniform[i] < dead ? PIXEL_DEAD :
+              (uniform[i] < dead_or_hot ? PIXEL_HOT : PIXEL_OK);
+        }
+      }
+    } else {
+      memset (defects, PIXEL_OK, width);
+    }
+  }
+}
+
+/* the fused model for a block of pixels; the format conditions are loop
+ * invariant and the loop body is branch-free, so each variant vectorizes */
+static inline void
+gst_sfxsensor_apply (guint8 * data, gint n, const gfloat * gain,
+    const gfloat * offset, const guint8 * defects, const gfloat * noise,
+    gfloat row_offset, const GstSfxSensorParams * params,
+    gint bytes_per_pixel, gboolean swap)
+{
+  const gfloat inv_step = 1.0f / params->step;
+  const guint step = (guint) params->step;
+  const gfloat max_code = params->max_code;
+  const gfloat max_value = params->max_value;
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    gfloat in, val;
+    guint out;
+
+    if (bytes_per_pixel == 1)
+      in = data[i];
+    else if (swap)
+      in = GUINT16_SWAP_LE_BE (((guint16 *) data)[i]);
+    else
+      in = ((guint16 *) data)[i];
+
+    val = in * gain[i] + offset[i] + row_offset + noise[i];
+    val = defects[i] == PIXEL_DEAD ? 0.0f : val;
+    val = defects[i] == PIXEL_HOT ? max_value : val;
+
+    out = (guint) CLAMP (val * inv_step + 0.5f, 0.0f, max_code) * step;
+
+    if (bytes_per_pixel == 1)
+      data[i] = (guint8) out;
+    else if (swap)
+      ((guint16 *) data)[i] = GUINT16_SWAP_LE_BE ((guint16) out);
+    else
+      ((guint16 *) data)[i] = (guint16) out;
+  }
+}
+
+static void
+gst_sfxsensor_process_lines (gpointer user_data, guint index, gint y_start,
+    gint y_end)
+{
+  GstSfxSensorParams *params = (GstSfxSensorParams *) user_data;
+  GstSfxSensor *filter = params->filter;
+  const gint width = filter->width;
+  const gint bpp = filter->bytes_per_pixel;
+  guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (params->frame, 0);
+  const gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (params->frame, 0);
+  gfloat noise[BLOCK_WIDTH];
+  gint x0, y;
+
+  for (y = y_start; y < y_end; y++) {
+    const guint32 row = (guint32) y * width;
+    const gfloat row_offset = filter->noise.offset_t +
+        filter->noise.row_noise[y];
+    guint8 *line = data + y * stride;
+
+    for (x0 = 0; x0 < width; x0 += BLOCK_WIDTH) {
+      const gint n = MIN (BLOCK_WIDTH, width - x0);
+
+      gst_sfx_noise_temporal_block (&filter->noise, &filter->rng,
+          params->frame_num, params->sigma_tvh, y, x0, noise, n);
+
+      gst_sfxsensor_apply (line + x0 * bpp, n, filter->gain + row + x0,
+          filter->offset + row + x0, filter->defects + row + x0, noise,
+          row_offset, params, bpp, filter->swap);
+    }
+  }
+}
+
+static GstFlowReturn
+gst_sfxsensor_transform_frame_ip (GstVideoFilter * vfilter,
+    GstVideoFrame * frame)
+{
+  GstSfxSensor *filter = GST_SFXSENSOR (vfilter);
+  const gfloat full_scale = (1 << filter->depth) - 1;
+  GstSfxSensorParams params;
+  gfloat sigma_t, sigma_v, sigma_h, sigma_tv, sigma_th;
+  gboolean fixed_dirty;
+  guint64 seed;
+  guint n_threads, bit_depth;
+
+  memset (&params, 0, sizeof (params));
+  params.filter = filter;
+  params.frame = frame;
+  params.frame_num = filter->frame_count++;
+
+  GST_OBJECT_LOCK (filter);
+  seed = filter->seed;
+  params.gain_sigma = filter->gain_sigma;
+  params.sigma_vh = filter->sigma_vh * full_scale;
+  params.sigma_tvh = filter->sigma_tvh * full_scale;
+  params.dead_fraction = filter->dead_fraction;
+  params.hot_fraction = filter->hot_fraction;
+  sigma_t = filter->sigma_t * full_scale;
+  sigma_v = filter->sigma_v * full_scale;
+  sigma_h = filter->sigma_h * full_scale;
+  sigma_tv = filter->sigma_tv * full_scale;
+  sigma_th = filter->sigma_th * full_scale;
+  bit_depth = MIN (filter->bit_depth, (guint) filter->depth);
+  n_threads = filter->n_threads;
+  fixed_dirty = filter->fixed_dirty;
+  filter->fixed_dirty = FALSE;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (filter->slice_pool == NULL || filter->slice_pool_n_threads != n_threads) {
+    gst_slice_pool_free (filter->slice_pool);
+    filter->slice_pool = gst_slice_pool_new (n_threads);
+    filter->slice_pool_n_threads = n_threads;
+    GST_DEBUG_OBJECT (filter, "Using %d threads",
+        gst_slice_pool_get_n_threads (filter->slice_pool));
+  }
+
+  if (fixed_dirty) {
+    GST_DEBUG_OBJECT (filter, "Creating fixed pattern with seed %"
+        G_GUINT64_FORMAT, seed);
+
+    gst_sfx_rng_init (&filter->rng, seed);
+    gst_sfx_noise_begin_fixed (&filter->noise, &filter->rng, sigma_v,
+        sigma_h);
+    gst_slice_pool_run (filter->slice_pool, filter->height,
+        gst_sfxsensor_fixed_lines, &params);
+  }
+
+  gst_sfx_noise_begin_frame (&filter->noise, &filter->rng, params.frame_num,
+      sigma_t, sigma_tv, sigma_th);
+
+  /* quantize by rounding to multiples of the least significant kept bit */
+  params.step = (gfloat) (1 << (filter->depth - bit_depth));
+  params.max_code = (gfloat) ((1 << bit_depth) - 1);
+  params.max_value = full_scale;
+
+  GST_LOG_OBJECT (filter, "Applying sensor model to frame %" G_GUINT64_FORMAT,
+      params.frame_num);
+
+  gst_slice_pool_run (filter->slice_pool, filter->height,
+      gst_sfxsensor_process_lines, &params);
+
+  return GST_FLOW_OK;
+}
+
+/************************************************************************/
+/* GstSfxSensor method implementations                                  */
+/************************************************************************/
+
+static void
+gst_sfxsensor_reset (GstSfxSensor * filter)
+{
+  filter->width = 0;
+  filter->height = 0;
+  filter->bytes_per_pixel = 0;
+  filter->depth = 0;
+  filter->swap = FALSE;
+
+  g_free (filter->gain);
+  filter->gain = NULL;
+  g_free (filter->offset);
+  filter->offset = NULL;
+  g_free (filter->defects);
+  filter->defects = NULL;
+  gst_sfx_noise_clear (&filter->noise);
+
+  gst_slice_pool_free (filter->slice_pool);
+  filter->slice_pool = NULL;
+  filter->slice_pool_n_threads = 0;
+}
@@ -0,0 +1,105 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_SFXSENSOR_H__
+#define __GST_SFXSENSOR_H__
+
+#include <gst/video/gstvideofilter.h>
+
+#include "gstsensorfxnoise.h"
+#include "gstsensorfxrng.h"
+#include "gstslicepool.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SFXSENSOR \
+  (gst_sfxsensor_get_type())
+#define GST_SFXSENSOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SFXSENSOR,GstSfxSensor))
+#define GST_SFXSENSOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_SFXSENSOR,GstSfxSensorClass))
+#define GST_IS_SFXSENSOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SFXSENSOR))
+#define GST_IS_SFXSENSOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_SFXSENSOR))
+
+typedef struct _GstSfxSensor GstSfxSensor;
+typedef struct _GstSfxSensorClass GstSfxSensorClass;
+
+/**
+* GstSfxSensor:
+* @element: the parent element.
+*
+*
+* The opaque GstSfxSensor data structure.
+*/
+struct _GstSfxSensor
+{
+  GstVideoFilter element;
+
+  /* properties */
+  guint64 seed;
+  gdouble gain_sigma;
+  gdouble sigma_t;
+  gdouble sigma_v;
+  gdouble sigma_h;
+  gdouble sigma_tv;
+  gdouble sigma_th;
+  gdouble sigma_vh;
+  gdouble sigma_tvh;
+  gdouble dead_fraction;
+  gdouble hot_fraction;
+  guint bit_depth;
+  guint n_threads;
+
+  /* format */
+  gint width;
+  gint height;
+  gint bytes_per_pixel;
+  gint depth;
+  gboolean swap;
+
+  GstSfxRng rng;
+  guint64 frame_count;
+
+  /* fixed pattern planes, regenerated when their properties change */
+  gboolean fixed_dirty;
+  gfloat *gain;
+  gfloat *offset;
+  guint8 *defects;
+
+  /* 3D noise model, with the temporal noise of the current frame */
+  GstSfxNoise noise;
+
+  /* row slice workers */
+  GstSlicePool *slice_pool;
+  guint slice_pool_n_threads;
+};
+
+struct _GstSfxSensorClass
+{
+  GstVideoFilterClass parent_class;
+};
+
+GType gst_sfxsensor_get_type(void);
+
+G_END_DECLS
+
+#endif /* __GST_SFXSENSOR_H__ */
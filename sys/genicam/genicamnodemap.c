@@ -0,0 +1,314 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "genicamnodemap.h"
+
+/* longest chain of pValue links followed before giving up */
+#define MAX_LINK_DEPTH 8
+
+typedef struct
+{
+  gchar *type;
+  gchar *p_value;
+  guint64 address;
+  gboolean has_address;
+  /* address depends on other nodes, which isn't evaluated */
+  gboolean dynamic;
+  guint length;
+  gboolean big_endian;
+  gint64 command_value;
+  /* values of an Enumeration's entries, by entry name */
+  GHashTable *entries;
+} GenicamNode;
+
+struct _GenicamNodeMap
+{
+  GHashTable *nodes;
+};
+
+typedef struct
+{
+  GenicamNodeMap *map;
+  /* node being parsed and its element depth */
+  GenicamNode *node;
+  gint node_depth;
+  gint depth;
+  /* name of the EnumEntry being parsed */
+  gchar *entry;
+  GString *text;
+} ParseState;
+
+static void
+genicam_node_free (GenicamNode * node)
+{
+  g_free (node->type);
+  g_free (node->p_value);
+  if (node->entries) {
+    g_hash_table_unref (node->entries);
+  }
+  g_free (node);
+}
+
+static void
+genicam_node_set_property (GenicamNode * node, const gchar * property,
+    gchar * value)
+{
+  g_strstrip (value);
+
+  if (g_str_equal (property, "pValue")) {
+    g_free (node->p_value);
+    node->p_value = g_strdup (value);
+  } else if (g_str_equal (property, "Address")) {
+    /* multiple addresses are summed */
+    node->address += g_ascii_strtoull (value, NULL, 0);
+    node->has_address = TRUE;
+  } else if (g_str_equal (property, "pAddress")
+      || g_str_equal (property, "IntSwissKnife")
+      || g_str_equal (property, "pIndex")) {
+    node->dynamic = TRUE;
+  } else if (g_str_equal (property, "Length")) {
+    node->length = (guint) g_ascii_strtoull (value, NULL, 0);
+  } else if (g_str_equal (property, "Endianess")) {
+    node->big_endian = g_str_equal (value, "BigEndian");
+  } else if (g_str_equal (property, "CommandValue")) {
+    node->command_value = g_ascii_strtoll (value, NULL, 0);
+  }
+}
+
+static void
+genicam_node_map_start_element (GMarkupParseContext * context,
+    const gchar * element_name, const gchar ** attribute_names,
+    const gchar ** attribute_values, gpointer user_data, GError ** error)
+{
+  ParseState *state = (ParseState *) user_data;
+  const gchar *name = NULL;
+  guint i;
+
+  state->depth++;
+
+  if (state->node) {
+    if (state->depth == state->node_depth + 1) {
+      g_string_truncate (state->text, 0);
+      if (g_str_equal (element_name, "EnumEntry")) {
+        for (i = 0; attribute_names[i]; ++i) {
+          if (g_str_equal (attribute_names[i], "Name")) {
+            state->entry = g_strdup (attribute_values[i]);
+            break;
+          }
+        }
+      }
+    } else if (state->entry && state->depth == state->node_depth + 2) {
+      g_string_truncate (state->text, 0);
+    }
+    return;
+  }
+
+  /* any named element outside another node is a node */
+  for (i = 0; attribute_names[i]; ++i) {
+    if (g_str_equal (attribute_names[i], "Name")) {
+      name = attribute_values[i];
+      break;
+    }
+  }
+  if (!name) {
+    return;
+  }
+
+  state->node = g_new0 (GenicamNode, 1);
+  state->node->type = g_strdup (element_name);
+  state->node->command_value = 1;
+  state->node_depth = state->depth;
+  g_hash_table_replace (state->map->nodes, g_strdup (name), state->node);
+}
+
+static void
+genicam_node_map_end_element (GMarkupParseContext * context,
+    const gchar * element_name, gpointer user_data, GError ** error)
+{
+  ParseState *state = (ParseState *) user_data;
+
+  if (state->node) {
+    if (state->depth == state->node_depth) {
+      state->node = NULL;
+    } else if (state->depth == state->node_depth + 1 && state->entry) {
+      g_free (state->entry);
+      state->entry = NULL;
+    } else if (state->depth == state->node_depth + 1) {
+      genicam_node_set_property (state->node, element_name, state->text->str);
+    } else if (state->entry && state->depth == state->node_depth + 2
+        && g_str_equal (element_name, "Value")) {
+      GenicamNode *node = state->node;
+      gint64 *value = g_new (gint64, 1);
+
+      *value = g_ascii_strtoll (state->text->str, NULL, 0);
+      if (!node->entries) {
+        node->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, g_free);
+      }
+      g_hash_table_replace (node->entries, g_strdup (state->entry), value);
+    }
+  }
+
+  state->depth--;
+}
+
+static void
+genicam_node_map_text (GMarkupParseContext * context, const gchar * text,
+    gsize text_len, gpointer user_data, GError ** error)
+{
+  ParseState *state = (ParseState *) user_data;
+
+  if (state->node && (state->depth == state->node_depth + 1
+          || (state->entry && state->depth == state->node_depth + 2))) {
+    g_string_append_len (state->text, text, text_len);
+  }
+}
+
+static const GMarkupParser genicam_node_map_parser = {
+  genicam_node_map_start_element,
+  genicam_node_map_end_element,
+  genicam_node_map_text,
+  NULL,
+  NULL
+};
+
+GenicamNodeMap *
+genicam_node_map_new (const gchar * xml, gsize length, GError ** error)
+{
+  GenicamNodeMap *map;
+  GMarkupParseContext *context;
+  ParseState state;
+  const gchar *end;
+  gboolean ok;
+
+  /* XML read from a device is often padded with NULs */
+  end = (const gchar *) memchr (xml, 0, length);
+  if (end) {
+    length = end - xml;
+  }
+
+  /* skip UTF-8 byte order mark */
+  if (length >= 3 && memcmp (xml, "\xef\xbb\xbf", 3) == 0) {
+    xml += 3;
+    length -= 3;
+  }
+
+  map = g_new0 (GenicamNodeMap, 1);
+  map->nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) genicam_node_free);
+
+  memset (&state, 0, sizeof (state));
+  state.map = map;
+  state.text = g_string_new (NULL);
+
+  context = g_markup_parse_context_new (&genicam_node_map_parser,
+      (GMarkupParseFlags) 0, &state, NULL);
+  ok = g_markup_parse_context_parse (context, xml, length, error)
+      && g_markup_parse_context_end_parse (context, error);
+  g_markup_parse_context_free (context);
+  g_string_free (state.text, TRUE);
+  g_free (state.entry);
+
+  if (!ok) {
+    genicam_node_map_free (map);
+    return NULL;
+  }
+
+  return map;
+}
+
+void
+genicam_node_map_free (GenicamNodeMap * map)
+{
+  if (!map) {
+    return;
+  }
+
+  g_hash_table_unref (map->nodes);
+  g_free (map);
+}
+
+/* Follow a feature's pValue links to the register holding its value. Only
+ * plain integer registers at a fixed address are resolved. */
+gboolean
+genicam_node_map_get_register (GenicamNodeMap * map, const gchar * feature,
+    GenicamRegister * reg)
+{
+  GenicamNode *node;
+  gint64 command_value = 1;
+  guint i;
+
+  memset (reg, 0, sizeof (*reg));
+
+  node = (GenicamNode *) g_hash_table_lookup (map->nodes, feature);
+  if (node && g_str_equal (node->type, "Command")) {
+    command_value = node->command_value;
+  }
+
+  for (i = 0; node && node->p_value && i < MAX_LINK_DEPTH; ++i) {
+    node = (GenicamNode *) g_hash_table_lookup (map->nodes, node->p_value);
+  }
+
+  if (!node || node->p_value || !node->has_address || node->dynamic
+      || !g_str_equal (node->type, "IntReg")) {
+    return FALSE;
+  }
+
+  if (node->length != 1 && node->length != 2 && node->length != 4
+      && node->length != 8) {
+    return FALSE;
+  }
+
+  reg->valid = TRUE;
+  reg->address = node->address;
+  reg->length = node->length;
+  reg->big_endian = node->big_endian;
+  reg->command_value = command_value;
+
+  return TRUE;
+}
+
+/* Look up the value of an entry of an Enumeration feature */
+gboolean
+genicam_node_map_get_enum_value (GenicamNodeMap * map, const gchar * feature,
+    const gchar * entry, gint64 * value)
+{
+  GenicamNode *node;
+  gint64 *entry_value;
+
+  node = (GenicamNode *) g_hash_table_lookup (map->nodes, feature);
+  if (!node || !node->entries) {
+    return FALSE;
+  }
+
+  entry_value = (gint64 *) g_hash_table_lookup (node->entries, entry);
+  if (!entry_value) {
+    return FALSE;
+  }
+
+  *value = *entry_value;
+
+  return TRUE;
+}
@@ -0,0 +1,54 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GENICAM_NODE_MAP_H_
+#define _GENICAM_NODE_MAP_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Lightweight reader for GenApi device description XML. It doesn't evaluate
+ * the node graph, it only follows pValue links from a feature to a register
+ * at a fixed address, which covers the standard features of most devices. */
+typedef struct _GenicamNodeMap GenicamNodeMap;
+
+/* a resolved device register */
+typedef struct
+{
+  gboolean valid;
+  guint64 address;
+  guint length;
+  gboolean big_endian;
+  /* value written to execute a Command feature */
+  gint64 command_value;
+} GenicamRegister;
+
+GenicamNodeMap *genicam_node_map_new (const gchar * xml, gsize length,
+    GError ** error);
+void genicam_node_map_free (GenicamNodeMap * map);
+
+gboolean genicam_node_map_get_register (GenicamNodeMap * map,
+    const gchar * feature, GenicamRegister * reg);
+gboolean genicam_node_map_get_enum_value (GenicamNodeMap * map,
+    const gchar * feature, const gchar * entry, gint64 * value);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1985 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Simulated GenTL producer, so genicamsrc can be tested and benchmarked
+ * without a camera. It exposes one interface with one device with one data
+ * stream, which fills announced buffers with a moving gradient.
+ *
+ * The initial camera settings are taken from the environment:
+ *
+ *   GENTLSIM_WIDTH        image width in pixels (640)
+ *   GENTLSIM_HEIGHT       image height in pixels (480)
+ *   GENTLSIM_PIXEL_FORMAT Mono8 or Mono16 (Mono8)
+ *   GENTLSIM_FRAME_RATE   frames per second, 0 to deliver a frame as soon as
+ *                         a buffer is queued (30)
+ *
+ * and can be changed through the remote device registers described by the
+ * device XML while not acquiring. With a frame rate set, frames that find
+ * no queued buffer are lost, their frame IDs skipped, like on a real camera.
+ * Buffer timestamps are in nanoseconds of the monotonic clock. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "GenTL_v1_5.h"
+
+#define SIM_TL_ID "GenTLSim"
+#define SIM_INTERFACE_ID "GenTLSimInterface0"
+#define SIM_DEVICE_ID "GenTLSimDevice0"
+#define SIM_STREAM_ID "GenTLSimStream0"
+#define SIM_VENDOR "gst-plugins-vision"
+#define SIM_MODEL "GenTL simulator"
+#define SIM_VERSION "1.0"
+
+/* remote device registers, 32-bit big endian, see sim_xml */
+#define SIM_REG_PAYLOAD_SIZE 0x10088
+#define SIM_REG_PIXEL_FORMAT 0x30024
+#define SIM_REG_WIDTH 0x30204
+#define SIM_REG_HEIGHT 0x30224
+#define SIM_REG_ACQUISITION_MODE 0x40004
+#define SIM_REG_ACQUISITION_START 0x40024
+#define SIM_REG_ACQUISITION_STOP 0x40044
+#define SIM_REG_ACQUISITION_FRAME_RATE 0x40104
+#define SIM_XML_ADDRESS 0x100000
+
+/* PFNC pixel formats */
+#define SIM_PIXEL_FORMAT_MONO8 0x01080001
+#define SIM_PIXEL_FORMAT_MONO16 0x01100007
+
+#define SIM_DEFAULT_WIDTH 640
+#define SIM_DEFAULT_HEIGHT 480
+#define SIM_DEFAULT_FRAME_RATE 30.0
+
+static const gchar sim_xml[] =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<RegisterDescription ModelName=\"GenTLSim\" VendorName=\"gst-plugins-vision\"\n"
+    "    ToolTip=\"Simulated camera\" StandardNameSpace=\"None\"\n"
+    "    SchemaMajorVersion=\"1\" SchemaMinorVersion=\"1\" SchemaSubMinorVersion=\"0\"\n"
+    "    MajorVersion=\"1\" MinorVersion=\"0\" SubMinorVersion=\"0\"\n"
+    "    ProductGuid=\"6C2F0A4E-3B1D-4E8A-9F41-2D7C5B8E1A03\"\n"
+    "    VersionGuid=\"B94E27D1-58C6-4A0F-8E3B-7F1D2C6A9E54\"\n"
+    "    xmlns=\"http://www.genicam.org/GenApi/Version_1_1\"\n"
+    "    xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+    "    xsi:schemaLocation=\"http://www.genicam.org/GenApi/Version_1_1 http://www.genicam.org/GenApi/GenApiSchema_Version_1_1.xsd\">\n"
+    "  <Category Name=\"Root\" NameSpace=\"Standard\">\n"
+    "    <pFeature>ImageFormatControl</pFeature>\n"
+    "    <pFeature>AcquisitionControl</pFeature>\n"
+    "  </Category>\n"
+    "  <Category Name=\"ImageFormatControl\" NameSpace=\"Standard\">\n"
+    "    <pFeature>Width</pFeature>\n"
+    "    <pFeature>Height</pFeature>\n"
+    "    <pFeature>PixelFormat</pFeature>\n"
+    "    <pFeature>PayloadSize</pFeature>\n"
+    "  </Category>\n"
+    "  <Category Name=\"AcquisitionControl\" NameSpace=\"Standard\">\n"
+    "    <pFeature>AcquisitionMode</pFeature>\n"
+    "    <pFeature>AcquisitionStart</pFeature>\n"
+    "    <pFeature>AcquisitionStop</pFeature>\n"
+    "    <pFeature>AcquisitionFrameRate</pFeature>\n"
+    "  </Category>\n"
+    "  <Integer Name=\"Width\" NameSpace=\"Standard\">\n"
+    "    <pValue>WidthReg</pValue>\n"
+    "    <Min>1</Min>\n"
+    "    <Max>65535</Max>\n"
+    "  </Integer>\n"
+    "  <IntReg Name=\"WidthReg\">\n"
+    "    <Address>0x30204</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RW</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Integer Name=\"Height\" NameSpace=\"Standard\">\n"
+    "    <pValue>HeightReg</pValue>\n"
+    "    <Min>1</Min>\n"
+    "    <Max>65535</Max>\n"
+    "  </Integer>\n"
+    "  <IntReg Name=\"HeightReg\">\n"
+    "    <Address>0x30224</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RW</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Enumeration Name=\"PixelFormat\" NameSpace=\"Standard\">\n"
+    "    <EnumEntry Name=\"Mono8\" NameSpace=\"Standard\">\n"
+    "      <Value>0x01080001</Value>\n"
+    "    </EnumEntry>\n"
+    "    <EnumEntry Name=\"Mono16\" NameSpace=\"Standard\">\n"
+    "      <Value>0x01100007</Value>\n"
+    "    </EnumEntry>\n"
+    "    <pValue>PixelFormatReg</pValue>\n"
+    "  </Enumeration>\n"
+    "  <IntReg Name=\"PixelFormatReg\">\n"
+    "    <Address>0x30024</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RW</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Integer Name=\"PayloadSize\" NameSpace=\"Standard\">\n"
+    "    <pValue>PayloadSizeReg</pValue>\n"
+    "  </Integer>\n"
+    "  <IntReg Name=\"PayloadSizeReg\">\n"
+    "    <Address>0x10088</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RO</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Enumeration Name=\"AcquisitionMode\" NameSpace=\"Standard\">\n"
+    "    <EnumEntry Name=\"Continuous\" NameSpace=\"Standard\">\n"
+    "      <Value>2</Value>\n"
+    "    </EnumEntry>\n"
+    "    <pValue>AcquisitionModeReg</pValue>\n"
+    "  </Enumeration>\n"
+    "  <IntReg Name=\"AcquisitionModeReg\">\n"
+    "    <Address>0x40004</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RW</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Command Name=\"AcquisitionStart\" NameSpace=\"Standard\">\n"
+    "    <pValue>AcquisitionStartReg</pValue>\n"
+    "    <CommandValue>1</CommandValue>\n"
+    "  </Command>\n"
+    "  <IntReg Name=\"AcquisitionStartReg\">\n"
+    "    <Address>0x40024</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>WO</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Command Name=\"AcquisitionStop\" NameSpace=\"Standard\">\n"
+    "    <pValue>AcquisitionStopReg</pValue>\n"
+    "    <CommandValue>1</CommandValue>\n"
+    "  </Command>\n"
+    "  <IntReg Name=\"AcquisitionStopReg\">\n"
+    "    <Address>0x40044</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>WO</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Sign>Unsigned</Sign>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </IntReg>\n"
+    "  <Float Name=\"AcquisitionFrameRate\" NameSpace=\"Standard\">\n"
+    "    <pValue>AcquisitionFrameRateReg</pValue>\n"
+    "    <Min>0</Min>\n"
+    "    <Max>100000</Max>\n"
+    "    <Unit>Hz</Unit>\n"
+    "  </Float>\n"
+    "  <FloatReg Name=\"AcquisitionFrameRateReg\">\n"
+    "    <Address>0x40104</Address>\n"
+    "    <Length>4</Length>\n"
+    "    <AccessMode>RW</AccessMode>\n"
+    "    <pPort>Device</pPort>\n"
+    "    <Endianess>BigEndian</Endianess>\n"
+    "  </FloatReg>\n"
+    "  <Port Name=\"Device\" NameSpace=\"Standard\"/>\n"
+    "</RegisterDescription>\n";
+
+/* the first member of every handle, to validate handles passed in */
+typedef enum
+{
+  SIM_HANDLE_SYSTEM = 0x53494d00,
+  SIM_HANDLE_INTERFACE,
+  SIM_HANDLE_DEVICE,
+  SIM_HANDLE_PORT,
+  SIM_HANDLE_STREAM,
+  SIM_HANDLE_BUFFER,
+  SIM_HANDLE_EVENT
+} SimHandleType;
+
+typedef enum
+{
+  SIM_BUFFER_IDLE,              /* announced, or delivered to the consumer */
+  SIM_BUFFER_QUEUED,            /* in the input pool */
+  SIM_BUFFER_FILLING,           /* being filled by the stream thread */
+  SIM_BUFFER_OUTPUT             /* in the output queue */
+} SimBufferState;
+
+typedef struct _SimSystem SimSystem;
+typedef struct _SimInterface SimInterface;
+typedef struct _SimDevice SimDevice;
+typedef struct _SimPort SimPort;
+typedef struct _SimStream SimStream;
+typedef struct _SimEvent SimEvent;
+typedef struct _SimBuffer SimBuffer;
+
+struct _SimSystem
+{
+  SimHandleType type;
+  SimInterface *iface;
+};
+
+struct _SimInterface
+{
+  SimHandleType type;
+  SimSystem *system;
+  SimDevice *device;
+};
+
+struct _SimPort
+{
+  SimHandleType type;
+  SimDevice *device;
+};
+
+struct _SimEvent
+{
+  SimHandleType type;
+  SimStream *stream;
+};
+
+struct _SimBuffer
+{
+  SimHandleType type;
+  SimStream *stream;
+
+  guint8 *base;
+  gsize size;
+  gpointer user_ptr;
+  gboolean allocated;
+  SimBufferState state;
+
+  /* describe the last frame, set by the stream thread while filling */
+  gboolean new_data;
+  gboolean incomplete;
+  gsize size_filled;
+  guint32 width;
+  guint32 height;
+  guint32 delivered_height;
+  guint32 pixel_format;
+  guint64 frame_id;
+  guint64 timestamp;
+};
+
+struct _SimStream
+{
+  SimHandleType type;
+  SimDevice *device;
+
+  GPtrArray *buffers;
+  GQueue input;
+  GQueue output;
+
+  SimEvent event;
+  gboolean event_registered;
+  gboolean event_killed;
+  guint64 num_fired;
+
+  GThread *thread;
+  gboolean grabbing;
+  gboolean stopping;
+  guint64 num_to_acquire;
+
+  /* frame geometry, fixed while grabbing */
+  guint32 width;
+  guint32 height;
+  guint32 pixel_format;
+
+  guint64 frame_id;
+  guint64 num_delivered;
+  guint64 num_underrun;
+  guint64 num_started;
+};
+
+struct _SimDevice
+{
+  SimHandleType type;
+  SimInterface *iface;
+  SimPort port;
+  SimStream *stream;
+  gchar *url;
+
+  /* protects the registers and everything in the stream */
+  GMutex lock;
+  GCond cond;
+
+  /* registers */
+  guint32 width;
+  guint32 height;
+  guint32 pixel_format;
+  guint32 acquisition_mode;
+  gfloat frame_rate;
+  gboolean acquiring;
+};
+
+typedef struct
+{
+  GC_ERROR code;
+  gchar message[256];
+} SimError;
+
+static GPrivate sim_last_error = G_PRIVATE_INIT (g_free);
+static GMutex sim_lock;
+static guint sim_init_count;
+static SimSystem *sim_system;
+
+/************************************************************************/
+/* helpers                                                              */
+/************************************************************************/
+
+static GC_ERROR sim_error (GC_ERROR code, const gchar * format, ...)
+    G_GNUC_PRINTF (2, 3);
+
+static GC_ERROR
+sim_error (GC_ERROR code, const gchar * format, ...)
+{
+  SimError *error = g_private_get (&sim_last_error);
+  va_list args;
+
+  if (error == NULL) {
+    error = g_new0 (SimError, 1);
+    g_private_set (&sim_last_error, error);
+  }
+
+  error->code = code;
+  va_start (args, format);
+  g_vsnprintf (error->message, sizeof (error->message), format, args);
+  va_end (args);
+
+  return code;
+}
+
+#define SIM_CHECK_INIT() \
+  if (sim_init_count == 0) \
+    return sim_error (GC_ERR_NOT_INITIALIZED, "Library not initialized")
+
+#define SIM_CHECK_HANDLE(handle, handle_type) \
+  if ((handle) == NULL || *(SimHandleType *) (handle) != (handle_type)) \
+    return sim_error (GC_ERR_INVALID_HANDLE, "Invalid handle")
+
+/* Copy an info value following the GenTL conventions: a NULL buffer
+ * queries the size, a too small buffer is an error */
+static GC_ERROR
+sim_info (INFO_DATATYPE datatype, gconstpointer value, gsize value_size,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  if (piSize == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "piSize is NULL");
+
+  if (piType)
+    *piType = datatype;
+
+  if (pBuffer == NULL) {
+    *piSize = value_size;
+    return GC_ERR_SUCCESS;
+  }
+
+  if (*piSize < value_size) {
+    *piSize = value_size;
+    return sim_error (GC_ERR_BUFFER_TOO_SMALL,
+        "Buffer too small, %" G_GSIZE_FORMAT " bytes needed", value_size);
+  }
+
+  memcpy (pBuffer, value, value_size);
+  *piSize = value_size;
+
+  return GC_ERR_SUCCESS;
+}
+
+static GC_ERROR
+sim_info_string (const gchar * value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_STRING, value, strlen (value) + 1, piType,
+      pBuffer, piSize);
+}
+
+static GC_ERROR
+sim_info_int32 (gint32 value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_INT32, &value, sizeof (value), piType,
+      pBuffer, piSize);
+}
+
+static GC_ERROR
+sim_info_uint32 (guint32 value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_UINT32, &value, sizeof (value), piType,
+      pBuffer, piSize);
+}
+
+static GC_ERROR
+sim_info_uint64 (guint64 value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_UINT64, &value, sizeof (value), piType,
+      pBuffer, piSize);
+}
+
+static GC_ERROR
+sim_info_sizet (size_t value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_SIZET, &value, sizeof (value), piType,
+      pBuffer, piSize);
+}
+
+static GC_ERROR
+sim_info_bool8 (gboolean value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  bool8_t b = value ? 1 : 0;
+
+  return sim_info (INFO_DATATYPE_BOOL8, &b, sizeof (b), piType, pBuffer,
+      piSize);
+}
+
+static GC_ERROR
+sim_info_ptr (gpointer value, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_info (INFO_DATATYPE_PTR, &value, sizeof (value), piType, pBuffer,
+      piSize);
+}
+
+static gsize
+sim_bytes_per_pixel (guint32 pixel_format)
+{
+  return pixel_format == SIM_PIXEL_FORMAT_MONO16 ? 2 : 1;
+}
+
+static gsize
+sim_device_payload_size (SimDevice * dev)
+{
+  return (gsize) dev->width * dev->height *
+      sim_bytes_per_pixel (dev->pixel_format);
+}
+
+static guint32
+sim_getenv_uint (const gchar * name, guint32 default_value)
+{
+  const gchar *str = g_getenv (name);
+  guint64 value;
+
+  if (str == NULL)
+    return default_value;
+
+  value = g_ascii_strtoull (str, NULL, 10);
+  if (value == 0 || value > G_MAXUINT16)
+    return default_value;
+
+  return (guint32) value;
+}
+
+/************************************************************************/
+/* stream thread                                                        */
+/************************************************************************/
+
+static void
+sim_buffer_fill (SimBuffer * buffer, SimStream * stream, guint64 frame_id,
+    guint64 timestamp)
+{
+  gsize bpp = sim_bytes_per_pixel (stream->pixel_format);
+  gsize stride = stream->width * bpp;
+  guint32 rows = (guint32) MIN (stream->height, buffer->size / stride);
+  guint32 x, y;
+
+  for (y = 0; y < rows; y++) {
+    if (bpp == 1) {
+      guint8 *row = buffer->base + y * stride;
+      guint8 value = (guint8) (y + frame_id);
+
+      for (x = 0; x < stream->width; x++)
+        row[x] = (guint8) (value + x);
+    } else {
+      guint16 *row = (guint16 *) (buffer->base + y * stride);
+      guint16 value = (guint16) ((y + frame_id) << 4);
+
+      for (x = 0; x < stream->width; x++)
+        row[x] = (guint16) (value + (x << 4));
+    }
+  }
+
+  buffer->new_data = TRUE;
+  buffer->incomplete = rows < stream->height;
+  buffer->size_filled = rows * stride;
+  buffer->width = stream->width;
+  buffer->height = stream->height;
+  buffer->delivered_height = rows;
+  buffer->pixel_format = stream->pixel_format;
+  buffer->frame_id = frame_id;
+  buffer->timestamp = timestamp;
+}
+
+static gpointer
+sim_stream_thread (gpointer data)
+{
+  SimStream *stream = data;
+  SimDevice *dev = stream->device;
+  gint64 next = 0;
+
+  g_mutex_lock (&dev->lock);
+  while (!stream->stopping) {
+    SimBuffer *buffer;
+    gint64 now, period;
+    guint64 frame_id;
+
+    if (!dev->acquiring) {
+      next = 0;
+      g_cond_wait (&dev->cond, &dev->lock);
+      continue;
+    }
+
+    period = dev->frame_rate > 0 ?
+        (gint64) (G_USEC_PER_SEC / dev->frame_rate) : 0;
+    now = g_get_monotonic_time ();
+
+    if (period > 0) {
+      /* (re)start the frame clock instead of bursting to catch up */
+      if (next == 0 || now - next > period)
+        next = now;
+      if (now < next) {
+        g_cond_wait_until (&dev->cond, &dev->lock, next);
+        continue;
+      }
+      next += period;
+    } else if (stream->input.length == 0) {
+      /* free running, the camera waits for the consumer */
+      g_cond_wait (&dev->cond, &dev->lock);
+      continue;
+    }
+
+    frame_id = stream->frame_id++;
+    buffer = g_queue_pop_head (&stream->input);
+    if (buffer == NULL) {
+      /* nowhere to put the frame, it's lost */
+      stream->num_underrun++;
+      continue;
+    }
+
+    buffer->state = SIM_BUFFER_FILLING;
+    stream->num_started++;
+    g_mutex_unlock (&dev->lock);
+
+    sim_buffer_fill (buffer, stream, frame_id, (guint64) now * 1000);
+
+    g_mutex_lock (&dev->lock);
+    buffer->state = SIM_BUFFER_OUTPUT;
+    g_queue_push_tail (&stream->output, buffer);
+    stream->num_delivered++;
+    if (stream->event_registered)
+      stream->num_fired++;
+    g_cond_broadcast (&dev->cond);
+
+    if (stream->num_to_acquire != GENTL_INFINITE &&
+        stream->num_delivered >= stream->num_to_acquire)
+      break;
+  }
+  g_mutex_unlock (&dev->lock);
+
+  return NULL;
+}
+
+/************************************************************************/
+/* module lifetime                                                      */
+/************************************************************************/
+
+static void
+sim_stream_stop (SimStream * stream)
+{
+  SimDevice *dev = stream->device;
+  GThread *thread;
+
+  g_mutex_lock (&dev->lock);
+  stream->stopping = TRUE;
+  thread = stream->thread;
+  stream->thread = NULL;
+  g_cond_broadcast (&dev->cond);
+  g_mutex_unlock (&dev->lock);
+
+  if (thread)
+    g_thread_join (thread);
+
+  g_mutex_lock (&dev->lock);
+  stream->grabbing = FALSE;
+  stream->stopping = FALSE;
+  g_mutex_unlock (&dev->lock);
+}
+
+static void
+sim_buffer_free (SimBuffer * buffer)
+{
+  if (buffer->allocated)
+    g_free (buffer->base);
+  buffer->type = 0;
+  g_free (buffer);
+}
+
+static void
+sim_stream_close (SimStream * stream)
+{
+  SimDevice *dev = stream->device;
+
+  sim_stream_stop (stream);
+
+  g_mutex_lock (&dev->lock);
+  g_queue_clear (&stream->input);
+  g_queue_clear (&stream->output);
+  g_ptr_array_free (stream->buffers, TRUE);
+  dev->stream = NULL;
+  g_mutex_unlock (&dev->lock);
+
+  stream->type = 0;
+  stream->event.type = 0;
+  g_free (stream);
+}
+
+static void
+sim_device_close (SimDevice * dev)
+{
+  if (dev->stream)
+    sim_stream_close (dev->stream);
+
+  dev->iface->device = NULL;
+  g_free (dev->url);
+  g_mutex_clear (&dev->lock);
+  g_cond_clear (&dev->cond);
+  dev->type = 0;
+  dev->port.type = 0;
+  g_free (dev);
+}
+
+static void
+sim_interface_close (SimInterface * iface)
+{
+  if (iface->device)
+    sim_device_close (iface->device);
+
+  iface->system->iface = NULL;
+  iface->type = 0;
+  g_free (iface);
+}
+
+static void
+sim_system_close (SimSystem * system)
+{
+  if (system->iface)
+    sim_interface_close (system->iface);
+
+  sim_system = NULL;
+  system->type = 0;
+  g_free (system);
+}
+
+/************************************************************************/
+/* info                                                                 */
+/************************************************************************/
+
+static GC_ERROR
+sim_tl_info (TL_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  switch (iInfoCmd) {
+    case TL_INFO_ID:
+      return sim_info_string (SIM_TL_ID, piType, pBuffer, piSize);
+    case TL_INFO_VENDOR:
+      return sim_info_string (SIM_VENDOR, piType, pBuffer, piSize);
+    case TL_INFO_MODEL:
+      return sim_info_string (SIM_MODEL, piType, pBuffer, piSize);
+    case TL_INFO_VERSION:
+      return sim_info_string (SIM_VERSION, piType, pBuffer, piSize);
+    case TL_INFO_TLTYPE:
+      return sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+    case TL_INFO_NAME:
+    case TL_INFO_PATHNAME:
+      return sim_info_string ("gentlsim.cti", piType, pBuffer, piSize);
+    case TL_INFO_DISPLAYNAME:
+      return sim_info_string (SIM_MODEL, piType, pBuffer, piSize);
+    case TL_INFO_CHAR_ENCODING:
+      return sim_info_int32 (TL_CHAR_ENCODING_ASCII, piType, pBuffer, piSize);
+    case TL_INFO_GENTL_VER_MAJOR:
+      return sim_info_uint32 (GenTLMajorVersion, piType, pBuffer, piSize);
+    case TL_INFO_GENTL_VER_MINOR:
+      return sim_info_uint32 (GenTLMinorVersion, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
+
+static GC_ERROR
+sim_interface_info (INTERFACE_INFO_CMD iInfoCmd, INFO_DATATYPE * piType,
+    void *pBuffer, size_t * piSize)
+{
+  switch (iInfoCmd) {
+    case INTERFACE_INFO_ID:
+      return sim_info_string (SIM_INTERFACE_ID, piType, pBuffer, piSize);
+    case INTERFACE_INFO_DISPLAYNAME:
+      return sim_info_string (SIM_MODEL " interface", piType, pBuffer, piSize);
+    case INTERFACE_INFO_TLTYPE:
+      return sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
+
+static GC_ERROR
+sim_device_info (SimInterface * iface, DEVICE_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  switch (iInfoCmd) {
+    case DEVICE_INFO_ID:
+      return sim_info_string (SIM_DEVICE_ID, piType, pBuffer, piSize);
+    case DEVICE_INFO_VENDOR:
+      return sim_info_string (SIM_VENDOR, piType, pBuffer, piSize);
+    case DEVICE_INFO_MODEL:
+      return sim_info_string (SIM_MODEL, piType, pBuffer, piSize);
+    case DEVICE_INFO_TLTYPE:
+      return sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+    case DEVICE_INFO_DISPLAYNAME:
+      return sim_info_string (SIM_MODEL " (" SIM_DEVICE_ID ")", piType,
+          pBuffer, piSize);
+    case DEVICE_INFO_ACCESS_STATUS:
+      return sim_info_int32 (iface->device ?
+          DEVICE_ACCESS_STATUS_OPEN_READWRITE : DEVICE_ACCESS_STATUS_READWRITE,
+          piType, pBuffer, piSize);
+    case DEVICE_INFO_USER_DEFINED_NAME:
+      return sim_info_string ("", piType, pBuffer, piSize);
+    case DEVICE_INFO_SERIAL_NUMBER:
+      return sim_info_string ("0", piType, pBuffer, piSize);
+    case DEVICE_INFO_VERSION:
+      return sim_info_string (SIM_VERSION, piType, pBuffer, piSize);
+    case DEVICE_INFO_TIMESTAMP_FREQUENCY:
+      return sim_info_uint64 (1000000000, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
+
+/************************************************************************/
+/* GenTL C API                                                          */
+/************************************************************************/
+
+GC_API
+GCGetInfo (TL_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  return sim_tl_info (iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+GCGetLastError (GC_ERROR * piErrorCode, char *sErrText, size_t * piSize)
+{
+  SimError *error = g_private_get (&sim_last_error);
+
+  if (piErrorCode == NULL)
+    return GC_ERR_INVALID_PARAMETER;
+
+  if (error == NULL) {
+    *piErrorCode = GC_ERR_SUCCESS;
+    return sim_info_string ("No error", NULL, sErrText, piSize);
+  }
+
+  *piErrorCode = error->code;
+  return sim_info_string (error->message, NULL, sErrText, piSize);
+}
+
+GC_API
+GCInitLib (void)
+{
+  g_mutex_lock (&sim_lock);
+  sim_init_count++;
+  g_mutex_unlock (&sim_lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+GCCloseLib (void)
+{
+  SIM_CHECK_INIT ();
+
+  g_mutex_lock (&sim_lock);
+  if (--sim_init_count == 0 && sim_system)
+    sim_system_close (sim_system);
+  g_mutex_unlock (&sim_lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+GCReadPort (PORT_HANDLE hPort, uint64_t iAddress, void *pBuffer,
+    size_t * piSize)
+{
+  SimPort *port = hPort;
+  SimDevice *dev;
+  guint32 value;
+  gsize xml_size = sizeof (sim_xml) - 1;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+  if (pBuffer == NULL || piSize == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "NULL buffer or size");
+
+  dev = port->device;
+
+  if (iAddress >= SIM_XML_ADDRESS &&
+      iAddress + *piSize <= SIM_XML_ADDRESS + xml_size) {
+    memcpy (pBuffer, sim_xml + (iAddress - SIM_XML_ADDRESS), *piSize);
+    return GC_ERR_SUCCESS;
+  }
+
+  if (*piSize != sizeof (value))
+    return sim_error (GC_ERR_INVALID_ADDRESS,
+        "Registers must be read 4 bytes at a time");
+
+  g_mutex_lock (&dev->lock);
+  switch (iAddress) {
+    case SIM_REG_PAYLOAD_SIZE:
+      value = (guint32) sim_device_payload_size (dev);
+      break;
+    case SIM_REG_PIXEL_FORMAT:
+      value = dev->pixel_format;
+      break;
+    case SIM_REG_WIDTH:
+      value = dev->width;
+      break;
+    case SIM_REG_HEIGHT:
+      value = dev->height;
+      break;
+    case SIM_REG_ACQUISITION_MODE:
+      value = dev->acquisition_mode;
+      break;
+    case SIM_REG_ACQUISITION_FRAME_RATE:
+      memcpy (&value, &dev->frame_rate, sizeof (value));
+      break;
+    default:
+      g_mutex_unlock (&dev->lock);
+      return sim_error (GC_ERR_INVALID_ADDRESS,
+          "No readable register at 0x%" G_GINT64_MODIFIER "x", iAddress);
+  }
+  g_mutex_unlock (&dev->lock);
+
+  value = GUINT32_TO_BE (value);
+  memcpy (pBuffer, &value, sizeof (value));
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+GCWritePort (PORT_HANDLE hPort, uint64_t iAddress, const void *pBuffer,
+    size_t * piSize)
+{
+  SimPort *port = hPort;
+  SimDevice *dev;
+  guint32 value;
+  gboolean locked;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+  if (pBuffer == NULL || piSize == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "NULL buffer or size");
+  if (*piSize != sizeof (value))
+    return sim_error (GC_ERR_INVALID_ADDRESS,
+        "Registers must be written 4 bytes at a time");
+
+  dev = port->device;
+  memcpy (&value, pBuffer, sizeof (value));
+  value = GUINT32_FROM_BE (value);
+
+  g_mutex_lock (&dev->lock);
+  /* the payload can't change under a running stream */
+  locked = dev->stream && dev->stream->grabbing;
+
+  switch (iAddress) {
+    case SIM_REG_PIXEL_FORMAT:
+      if (locked)
+        goto locked;
+      if (value != SIM_PIXEL_FORMAT_MONO8 && value != SIM_PIXEL_FORMAT_MONO16)
+        goto invalid_value;
+      dev->pixel_format = value;
+      break;
+    case SIM_REG_WIDTH:
+    case SIM_REG_HEIGHT:
+      if (locked)
+        goto locked;
+      if (value == 0 || value > G_MAXUINT16)
+        goto invalid_value;
+      if (iAddress == SIM_REG_WIDTH)
+        dev->width = value;
+      else
+        dev->height = value;
+      break;
+    case SIM_REG_ACQUISITION_MODE:
+      dev->acquisition_mode = value;
+      break;
+    case SIM_REG_ACQUISITION_START:
+      dev->acquiring = TRUE;
+      break;
+    case SIM_REG_ACQUISITION_STOP:
+      dev->acquiring = FALSE;
+      break;
+    case SIM_REG_ACQUISITION_FRAME_RATE:{
+      gfloat frame_rate;
+
+      memcpy (&frame_rate, &value, sizeof (frame_rate));
+      if (!(frame_rate >= 0))
+        goto invalid_value;
+      dev->frame_rate = frame_rate;
+      break;
+    }
+    default:
+      g_mutex_unlock (&dev->lock);
+      return sim_error (GC_ERR_INVALID_ADDRESS,
+          "No writable register at 0x%" G_GINT64_MODIFIER "x", iAddress);
+  }
+  g_cond_broadcast (&dev->cond);
+  g_mutex_unlock (&dev->lock);
+
+  return GC_ERR_SUCCESS;
+
+locked:
+  g_mutex_unlock (&dev->lock);
+  return sim_error (GC_ERR_ACCESS_DENIED,
+      "Register 0x%" G_GINT64_MODIFIER "x is locked while acquiring",
+      iAddress);
+invalid_value:
+  g_mutex_unlock (&dev->lock);
+  return sim_error (GC_ERR_INVALID_VALUE,
+      "Invalid value %u for register 0x%" G_GINT64_MODIFIER "x", value,
+      iAddress);
+}
+
+GC_API
+GCGetPortURL (PORT_HANDLE hPort, char *sURL, size_t * piSize)
+{
+  SimPort *port = hPort;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+
+  return sim_info_string (port->device->url, NULL, sURL, piSize);
+}
+
+GC_API
+GCGetPortInfo (PORT_HANDLE hPort, PORT_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+
+  switch (iInfoCmd) {
+    case PORT_INFO_ID:
+      return sim_info_string (SIM_DEVICE_ID, piType, pBuffer, piSize);
+    case PORT_INFO_VENDOR:
+      return sim_info_string (SIM_VENDOR, piType, pBuffer, piSize);
+    case PORT_INFO_MODEL:
+      return sim_info_string (SIM_MODEL, piType, pBuffer, piSize);
+    case PORT_INFO_TLTYPE:
+      return sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+    case PORT_INFO_MODULE:
+      return sim_info_string (TLRemoteDeviceModuleName, piType, pBuffer,
+          piSize);
+    case PORT_INFO_LITTLE_ENDIAN:
+      return sim_info_bool8 (FALSE, piType, pBuffer, piSize);
+    case PORT_INFO_BIG_ENDIAN:
+      return sim_info_bool8 (TRUE, piType, pBuffer, piSize);
+    case PORT_INFO_ACCESS_READ:
+    case PORT_INFO_ACCESS_WRITE:
+      return sim_info_bool8 (TRUE, piType, pBuffer, piSize);
+    case PORT_INFO_ACCESS_NA:
+    case PORT_INFO_ACCESS_NI:
+      return sim_info_bool8 (FALSE, piType, pBuffer, piSize);
+    case PORT_INFO_VERSION:
+      return sim_info_string (SIM_VERSION, piType, pBuffer, piSize);
+    case PORT_INFO_PORTNAME:
+      return sim_info_string ("Device", piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
+
+GC_API
+GCGetNumPortURLs (PORT_HANDLE hPort, uint32_t * piNumURLs)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+  if (piNumURLs == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "piNumURLs is NULL");
+
+  *piNumURLs = 1;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+GCGetPortURLInfo (PORT_HANDLE hPort, uint32_t iURLIndex,
+    URL_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  SimPort *port = hPort;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hPort, SIM_HANDLE_PORT);
+  if (iURLIndex != 0)
+    return sim_error (GC_ERR_INVALID_INDEX, "Invalid URL index %u", iURLIndex);
+
+  switch (iInfoCmd) {
+    case URL_INFO_URL:
+      return sim_info_string (port->device->url, piType, pBuffer, piSize);
+    case URL_INFO_SCHEMA_VER_MAJOR:
+      return sim_info_int32 (1, piType, pBuffer, piSize);
+    case URL_INFO_SCHEMA_VER_MINOR:
+      return sim_info_int32 (1, piType, pBuffer, piSize);
+    case URL_INFO_FILE_VER_MAJOR:
+      return sim_info_int32 (1, piType, pBuffer, piSize);
+    case URL_INFO_FILE_VER_MINOR:
+    case URL_INFO_FILE_VER_SUBMINOR:
+      return sim_info_int32 (0, piType, pBuffer, piSize);
+    case URL_INFO_FILE_REGISTER_ADDRESS:
+      return sim_info_uint64 (SIM_XML_ADDRESS, piType, pBuffer, piSize);
+    case URL_INFO_FILE_SIZE:
+      return sim_info_uint64 (sizeof (sim_xml) - 1, piType, pBuffer, piSize);
+    case URL_INFO_SCHEME:
+      return sim_info_int32 (URL_SCHEME_LOCAL, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_NOT_AVAILABLE, "URL info %d not available",
+          iInfoCmd);
+  }
+}
+
+GC_API
+GCRegisterEvent (EVENTSRC_HANDLE hEventSrc, EVENT_TYPE iEventID,
+    EVENT_HANDLE * phEvent)
+{
+  SimStream *stream = hEventSrc;
+  GC_ERROR ret = GC_ERR_SUCCESS;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEventSrc, SIM_HANDLE_STREAM);
+  if (phEvent == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phEvent is NULL");
+  if (iEventID != EVENT_NEW_BUFFER)
+    return sim_error (GC_ERR_NOT_IMPLEMENTED, "Only New Buffer events");
+
+  g_mutex_lock (&stream->device->lock);
+  if (stream->event_registered) {
+    ret = sim_error (GC_ERR_RESOURCE_IN_USE, "Event already registered");
+  } else {
+    stream->event_registered = TRUE;
+    stream->event_killed = FALSE;
+    *phEvent = &stream->event;
+  }
+  g_mutex_unlock (&stream->device->lock);
+
+  return ret;
+}
+
+GC_API
+GCUnregisterEvent (EVENTSRC_HANDLE hEventSrc, EVENT_TYPE iEventID)
+{
+  SimStream *stream = hEventSrc;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEventSrc, SIM_HANDLE_STREAM);
+  if (iEventID != EVENT_NEW_BUFFER)
+    return sim_error (GC_ERR_NOT_IMPLEMENTED, "Only New Buffer events");
+
+  g_mutex_lock (&stream->device->lock);
+  stream->event_registered = FALSE;
+  /* wake up anyone still waiting on the event */
+  stream->event_killed = TRUE;
+  g_cond_broadcast (&stream->device->cond);
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+EventGetData (EVENT_HANDLE hEvent, void *pBuffer, size_t * piSize,
+    uint64_t iTimeout)
+{
+  SimEvent *event = hEvent;
+  SimStream *stream;
+  SimDevice *dev;
+  SimBuffer *buffer;
+  EVENT_NEW_BUFFER_DATA data;
+  gint64 end_time = -1;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEvent, SIM_HANDLE_EVENT);
+  if (pBuffer == NULL || piSize == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "NULL buffer or size");
+  if (*piSize < sizeof (data))
+    return sim_error (GC_ERR_BUFFER_TOO_SMALL, "Buffer too small");
+
+  stream = event->stream;
+  dev = stream->device;
+
+  if (iTimeout != GENTL_INFINITE && iTimeout < G_MAXINT64 / 1000)
+    end_time = g_get_monotonic_time () + (gint64) iTimeout *1000;
+
+  g_mutex_lock (&dev->lock);
+  while (stream->output.length == 0 && !stream->event_killed) {
+    if (end_time < 0)
+      g_cond_wait (&dev->cond, &dev->lock);
+    else if (!g_cond_wait_until (&dev->cond, &dev->lock, end_time))
+      break;
+  }
+
+  if (stream->event_killed) {
+    stream->event_killed = FALSE;
+    g_mutex_unlock (&dev->lock);
+    return sim_error (GC_ERR_ABORT, "Wait aborted");
+  }
+
+  buffer = g_queue_pop_head (&stream->output);
+  if (buffer)
+    buffer->state = SIM_BUFFER_IDLE;
+  g_mutex_unlock (&dev->lock);
+
+  if (buffer == NULL)
+    return sim_error (GC_ERR_TIMEOUT, "No buffer within %" G_GUINT64_FORMAT
+        " ms", (guint64) iTimeout);
+
+  data.BufferHandle = buffer;
+  data.pUserPointer = buffer->user_ptr;
+  memcpy (pBuffer, &data, sizeof (data));
+  *piSize = sizeof (data);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+EventGetDataInfo (EVENT_HANDLE hEvent, const void *pInBuffer, size_t iInSize,
+    EVENT_DATA_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pOutBuffer,
+    size_t * piOutSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEvent, SIM_HANDLE_EVENT);
+
+  return sim_error (GC_ERR_NOT_AVAILABLE,
+      "New Buffer events carry no extra data");
+}
+
+GC_API
+EventGetInfo (EVENT_HANDLE hEvent, EVENT_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  SimEvent *event = hEvent;
+  SimStream *stream;
+  size_t num_in_queue;
+  guint64 num_fired;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEvent, SIM_HANDLE_EVENT);
+
+  stream = event->stream;
+  g_mutex_lock (&stream->device->lock);
+  num_in_queue = stream->output.length;
+  num_fired = stream->num_fired;
+  g_mutex_unlock (&stream->device->lock);
+
+  switch (iInfoCmd) {
+    case EVENT_EVENT_TYPE:
+      return sim_info_int32 (EVENT_NEW_BUFFER, piType, pBuffer, piSize);
+    case EVENT_NUM_IN_QUEUE:
+      return sim_info_sizet (num_in_queue, piType, pBuffer, piSize);
+    case EVENT_NUM_FIRED:
+      return sim_info_uint64 (num_fired, piType, pBuffer, piSize);
+    case EVENT_SIZE_MAX:
+      return sim_info_sizet (sizeof (EVENT_NEW_BUFFER_DATA), piType, pBuffer,
+          piSize);
+    case EVENT_INFO_DATA_SIZE_MAX:
+      return sim_info_sizet (0, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
+
+GC_API
+EventFlush (EVENT_HANDLE hEvent)
+{
+  SimEvent *event = hEvent;
+  SimStream *stream;
+  SimBuffer *buffer;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEvent, SIM_HANDLE_EVENT);
+
+  stream = event->stream;
+  g_mutex_lock (&stream->device->lock);
+  while ((buffer = g_queue_pop_head (&stream->output)))
+    buffer->state = SIM_BUFFER_IDLE;
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+EventKill (EVENT_HANDLE hEvent)
+{
+  SimEvent *event = hEvent;
+  SimStream *stream;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hEvent, SIM_HANDLE_EVENT);
+
+  stream = event->stream;
+  g_mutex_lock (&stream->device->lock);
+  stream->event_killed = TRUE;
+  g_cond_broadcast (&stream->device->cond);
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+TLOpen (TL_HANDLE * phTL)
+{
+  GC_ERROR ret = GC_ERR_SUCCESS;
+
+  SIM_CHECK_INIT ();
+  if (phTL == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phTL is NULL");
+
+  g_mutex_lock (&sim_lock);
+  if (sim_system) {
+    ret = sim_error (GC_ERR_RESOURCE_IN_USE, "System module already open");
+  } else {
+    sim_system = g_new0 (SimSystem, 1);
+    sim_system->type = SIM_HANDLE_SYSTEM;
+    *phTL = sim_system;
+  }
+  g_mutex_unlock (&sim_lock);
+
+  return ret;
+}
+
+GC_API
+TLClose (TL_HANDLE hTL)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+
+  g_mutex_lock (&sim_lock);
+  sim_system_close (hTL);
+  g_mutex_unlock (&sim_lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+TLGetInfo (TL_HANDLE hTL, TL_INFO_CMD iInfoCmd, INFO_DATATYPE * piType,
+    void *pBuffer, size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+
+  return sim_tl_info (iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+TLGetNumInterfaces (TL_HANDLE hTL, uint32_t * piNumIfaces)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+  if (piNumIfaces == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "piNumIfaces is NULL");
+
+  *piNumIfaces = 1;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+TLGetInterfaceID (TL_HANDLE hTL, uint32_t iIndex, char *sID, size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+  if (iIndex != 0)
+    return sim_error (GC_ERR_INVALID_INDEX, "Invalid interface index %u",
+        iIndex);
+
+  return sim_info_string (SIM_INTERFACE_ID, NULL, sID, piSize);
+}
+
+GC_API
+TLGetInterfaceInfo (TL_HANDLE hTL, const char *sIfaceID,
+    INTERFACE_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+  if (g_strcmp0 (sIfaceID, SIM_INTERFACE_ID) != 0)
+    return sim_error (GC_ERR_INVALID_ID, "Unknown interface ID");
+
+  return sim_interface_info (iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+TLOpenInterface (TL_HANDLE hTL, const char *sIfaceID, IF_HANDLE * phIface)
+{
+  SimSystem *system = hTL;
+  SimInterface *iface;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+  if (phIface == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phIface is NULL");
+  if (g_strcmp0 (sIfaceID, SIM_INTERFACE_ID) != 0)
+    return sim_error (GC_ERR_INVALID_ID, "Unknown interface ID");
+  if (system->iface)
+    return sim_error (GC_ERR_RESOURCE_IN_USE, "Interface already open");
+
+  iface = g_new0 (SimInterface, 1);
+  iface->type = SIM_HANDLE_INTERFACE;
+  iface->system = system;
+  system->iface = iface;
+  *phIface = iface;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+TLUpdateInterfaceList (TL_HANDLE hTL, bool8_t * pbChanged, uint64_t iTimeout)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hTL, SIM_HANDLE_SYSTEM);
+
+  if (pbChanged)
+    *pbChanged = 0;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+IFClose (IF_HANDLE hIface)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+
+  sim_interface_close (hIface);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+IFGetInfo (IF_HANDLE hIface, INTERFACE_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+
+  return sim_interface_info (iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+IFGetNumDevices (IF_HANDLE hIface, uint32_t * piNumDevices)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+  if (piNumDevices == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "piNumDevices is NULL");
+
+  *piNumDevices = 1;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+IFGetDeviceID (IF_HANDLE hIface, uint32_t iIndex, char *sIDeviceID,
+    size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+  if (iIndex != 0)
+    return sim_error (GC_ERR_INVALID_INDEX, "Invalid device index %u", iIndex);
+
+  return sim_info_string (SIM_DEVICE_ID, NULL, sIDeviceID, piSize);
+}
+
+GC_API
+IFUpdateDeviceList (IF_HANDLE hIface, bool8_t * pbChanged, uint64_t iTimeout)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+
+  if (pbChanged)
+    *pbChanged = 0;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+IFGetDeviceInfo (IF_HANDLE hIface, const char *sDeviceID,
+    DEVICE_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+  if (g_strcmp0 (sDeviceID, SIM_DEVICE_ID) != 0)
+    return sim_error (GC_ERR_INVALID_ID, "Unknown device ID");
+
+  return sim_device_info (hIface, iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+IFOpenDevice (IF_HANDLE hIface, const char *sDeviceID,
+    DEVICE_ACCESS_FLAGS iOpenFlags, DEV_HANDLE * phDevice)
+{
+  SimInterface *iface = hIface;
+  SimDevice *dev;
+  const gchar *str;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hIface, SIM_HANDLE_INTERFACE);
+  if (phDevice == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phDevice is NULL");
+  if (g_strcmp0 (sDeviceID, SIM_DEVICE_ID) != 0)
+    return sim_error (GC_ERR_INVALID_ID, "Unknown device ID");
+  if (iface->device)
+    return sim_error (GC_ERR_RESOURCE_IN_USE, "Device already open");
+
+  dev = g_new0 (SimDevice, 1);
+  dev->type = SIM_HANDLE_DEVICE;
+  dev->iface = iface;
+  dev->port.type = SIM_HANDLE_PORT;
+  dev->port.device = dev;
+  dev->url = g_strdup_printf ("local:gentlsim.xml;%x;%x?SchemaVersion=1.1.0",
+      SIM_XML_ADDRESS, (guint) (sizeof (sim_xml) - 1));
+  g_mutex_init (&dev->lock);
+  g_cond_init (&dev->cond);
+
+  dev->width = sim_getenv_uint ("GENTLSIM_WIDTH", SIM_DEFAULT_WIDTH);
+  dev->height = sim_getenv_uint ("GENTLSIM_HEIGHT", SIM_DEFAULT_HEIGHT);
+  str = g_getenv ("GENTLSIM_PIXEL_FORMAT");
+  dev->pixel_format = g_strcmp0 (str, "Mono16") == 0 ?
+      SIM_PIXEL_FORMAT_MONO16 : SIM_PIXEL_FORMAT_MONO8;
+  str = g_getenv ("GENTLSIM_FRAME_RATE");
+  dev->frame_rate = str ? (gfloat) g_ascii_strtod (str, NULL) :
+      SIM_DEFAULT_FRAME_RATE;
+  if (!(dev->frame_rate >= 0))
+    dev->frame_rate = SIM_DEFAULT_FRAME_RATE;
+  dev->acquisition_mode = 2;
+
+  iface->device = dev;
+  *phDevice = dev;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DevGetPort (DEV_HANDLE hDevice, PORT_HANDLE * phRemoteDevice)
+{
+  SimDevice *dev = hDevice;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+  if (phRemoteDevice == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phRemoteDevice is NULL");
+
+  *phRemoteDevice = &dev->port;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DevGetNumDataStreams (DEV_HANDLE hDevice, uint32_t * piNumDataStreams)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+  if (piNumDataStreams == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "piNumDataStreams is NULL");
+
+  *piNumDataStreams = 1;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DevGetDataStreamID (DEV_HANDLE hDevice, uint32_t iIndex, char *sDataStreamID,
+    size_t * piSize)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+  if (iIndex != 0)
+    return sim_error (GC_ERR_INVALID_INDEX, "Invalid stream index %u", iIndex);
+
+  return sim_info_string (SIM_STREAM_ID, NULL, sDataStreamID, piSize);
+}
+
+GC_API
+DevOpenDataStream (DEV_HANDLE hDevice, const char *sDataStreamID,
+    DS_HANDLE * phDataStream)
+{
+  SimDevice *dev = hDevice;
+  SimStream *stream;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+  if (phDataStream == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phDataStream is NULL");
+  if (g_strcmp0 (sDataStreamID, SIM_STREAM_ID) != 0)
+    return sim_error (GC_ERR_INVALID_ID, "Unknown stream ID");
+  if (dev->stream)
+    return sim_error (GC_ERR_RESOURCE_IN_USE, "Stream already open");
+
+  stream = g_new0 (SimStream, 1);
+  stream->type = SIM_HANDLE_STREAM;
+  stream->device = dev;
+  stream->buffers = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      sim_buffer_free);
+  g_queue_init (&stream->input);
+  g_queue_init (&stream->output);
+  stream->event.type = SIM_HANDLE_EVENT;
+  stream->event.stream = stream;
+
+  g_mutex_lock (&dev->lock);
+  dev->stream = stream;
+  g_mutex_unlock (&dev->lock);
+
+  *phDataStream = stream;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DevGetInfo (DEV_HANDLE hDevice, DEVICE_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  SimDevice *dev = hDevice;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+
+  return sim_device_info (dev->iface, iInfoCmd, piType, pBuffer, piSize);
+}
+
+GC_API
+DevClose (DEV_HANDLE hDevice)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDevice, SIM_HANDLE_DEVICE);
+
+  sim_device_close (hDevice);
+
+  return GC_ERR_SUCCESS;
+}
+
+static GC_ERROR
+sim_stream_announce (SimStream * stream, guint8 * base, gsize size,
+    gboolean allocated, void *pPrivate, BUFFER_HANDLE * phBuffer)
+{
+  SimBuffer *buffer;
+
+  buffer = g_new0 (SimBuffer, 1);
+  buffer->type = SIM_HANDLE_BUFFER;
+  buffer->stream = stream;
+  buffer->base = base;
+  buffer->size = size;
+  buffer->allocated = allocated;
+  buffer->user_ptr = pPrivate;
+  buffer->state = SIM_BUFFER_IDLE;
+
+  g_mutex_lock (&stream->device->lock);
+  g_ptr_array_add (stream->buffers, buffer);
+  g_mutex_unlock (&stream->device->lock);
+
+  *phBuffer = buffer;
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSAnnounceBuffer (DS_HANDLE hDataStream, void *pBuffer, size_t iSize,
+    void *pPrivate, BUFFER_HANDLE * phBuffer)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  if (pBuffer == NULL || iSize == 0 || phBuffer == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "Invalid buffer");
+
+  return sim_stream_announce (hDataStream, pBuffer, iSize, FALSE, pPrivate,
+      phBuffer);
+}
+
+GC_API
+DSAllocAndAnnounceBuffer (DS_HANDLE hDataStream, size_t iSize,
+    void *pPrivate, BUFFER_HANDLE * phBuffer)
+{
+  guint8 *base;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  if (iSize == 0 || phBuffer == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "Invalid buffer");
+
+  base = g_try_malloc (iSize);
+  if (base == NULL)
+    return sim_error (GC_ERR_OUT_OF_MEMORY, "Failed to allocate %"
+        G_GSIZE_FORMAT " bytes", (gsize) iSize);
+
+  return sim_stream_announce (hDataStream, base, iSize, TRUE, pPrivate,
+      phBuffer);
+}
+
+GC_API
+DSFlushQueue (DS_HANDLE hDataStream, ACQ_QUEUE_TYPE iOperation)
+{
+  SimStream *stream = hDataStream;
+  SimBuffer *buffer;
+  guint i;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+
+  g_mutex_lock (&stream->device->lock);
+  switch (iOperation) {
+    case ACQ_QUEUE_INPUT_TO_OUTPUT:
+      while ((buffer = g_queue_pop_head (&stream->input))) {
+        buffer->new_data = FALSE;
+        buffer->size_filled = 0;
+        buffer->state = SIM_BUFFER_OUTPUT;
+        g_queue_push_tail (&stream->output, buffer);
+      }
+      break;
+    case ACQ_QUEUE_OUTPUT_DISCARD:
+      while ((buffer = g_queue_pop_head (&stream->output)))
+        buffer->state = SIM_BUFFER_IDLE;
+      break;
+    case ACQ_QUEUE_ALL_TO_INPUT:
+      while ((buffer = g_queue_pop_head (&stream->output))) {
+        buffer->state = SIM_BUFFER_QUEUED;
+        g_queue_push_tail (&stream->input, buffer);
+      }
+      break;
+    case ACQ_QUEUE_UNQUEUED_TO_INPUT:
+      for (i = 0; i < stream->buffers->len; i++) {
+        buffer = g_ptr_array_index (stream->buffers, i);
+        if (buffer->state == SIM_BUFFER_IDLE) {
+          buffer->state = SIM_BUFFER_QUEUED;
+          g_queue_push_tail (&stream->input, buffer);
+        }
+      }
+      break;
+    case ACQ_QUEUE_ALL_DISCARD:
+      while ((buffer = g_queue_pop_head (&stream->input)))
+        buffer->state = SIM_BUFFER_IDLE;
+      while ((buffer = g_queue_pop_head (&stream->output)))
+        buffer->state = SIM_BUFFER_IDLE;
+      break;
+    default:
+      g_mutex_unlock (&stream->device->lock);
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown flush operation");
+  }
+  g_cond_broadcast (&stream->device->cond);
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSStartAcquisition (DS_HANDLE hDataStream, ACQ_START_FLAGS iStartFlags,
+    uint64_t iNumToAcquire)
+{
+  SimStream *stream = hDataStream;
+  SimDevice *dev;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+
+  dev = stream->device;
+  g_mutex_lock (&dev->lock);
+  if (stream->grabbing) {
+    g_mutex_unlock (&dev->lock);
+    return sim_error (GC_ERR_RESOURCE_IN_USE, "Acquisition already started");
+  }
+
+  stream->grabbing = TRUE;
+  stream->stopping = FALSE;
+  stream->num_to_acquire = iNumToAcquire;
+  stream->width = dev->width;
+  stream->height = dev->height;
+  stream->pixel_format = dev->pixel_format;
+  stream->frame_id = 0;
+  stream->num_delivered = 0;
+  stream->num_underrun = 0;
+  stream->num_started = 0;
+  stream->thread = g_thread_new ("gentlsim", sim_stream_thread, stream);
+  g_mutex_unlock (&dev->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSStopAcquisition (DS_HANDLE hDataStream, ACQ_STOP_FLAGS iStopFlags)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+
+  sim_stream_stop (hDataStream);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSGetInfo (DS_HANDLE hDataStream, STREAM_INFO_CMD iInfoCmd,
+    INFO_DATATYPE * piType, void *pBuffer, size_t * piSize)
+{
+  SimStream *stream = hDataStream;
+  SimDevice *dev;
+  GC_ERROR ret;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+
+  dev = stream->device;
+  g_mutex_lock (&dev->lock);
+  switch (iInfoCmd) {
+    case STREAM_INFO_ID:
+      ret = sim_info_string (SIM_STREAM_ID, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_DELIVERED:
+      ret = sim_info_uint64 (stream->num_delivered, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_UNDERRUN:
+      ret = sim_info_uint64 (stream->num_underrun, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_ANNOUNCED:
+      ret = sim_info_sizet (stream->buffers->len, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_QUEUED:
+      ret = sim_info_sizet (stream->input.length, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_AWAIT_DELIVERY:
+      ret = sim_info_sizet (stream->output.length, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_STARTED:
+      ret = sim_info_uint64 (stream->num_started, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_PAYLOAD_SIZE:
+      ret = sim_info_sizet (stream->grabbing ?
+          (gsize) stream->width * stream->height *
+          sim_bytes_per_pixel (stream->pixel_format) :
+          sim_device_payload_size (dev), piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_IS_GRABBING:
+      ret = sim_info_bool8 (stream->grabbing, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_DEFINES_PAYLOADSIZE:
+      ret = sim_info_bool8 (TRUE, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_TLTYPE:
+      ret = sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_NUM_CHUNKS_MAX:
+      ret = sim_info_sizet (0, piType, pBuffer, piSize);
+      break;
+    case STREAM_INFO_BUF_ANNOUNCE_MIN:
+    case STREAM_INFO_BUF_ALIGNMENT:
+      ret = sim_info_sizet (1, piType, pBuffer, piSize);
+      break;
+    default:
+      ret = sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+      break;
+  }
+  g_mutex_unlock (&dev->lock);
+
+  return ret;
+}
+
+GC_API
+DSGetBufferID (DS_HANDLE hDataStream, uint32_t iIndex,
+    BUFFER_HANDLE * phBuffer)
+{
+  SimStream *stream = hDataStream;
+  GC_ERROR ret = GC_ERR_SUCCESS;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  if (phBuffer == NULL)
+    return sim_error (GC_ERR_INVALID_PARAMETER, "phBuffer is NULL");
+
+  g_mutex_lock (&stream->device->lock);
+  if (iIndex < stream->buffers->len)
+    *phBuffer = g_ptr_array_index (stream->buffers, iIndex);
+  else
+    ret = sim_error (GC_ERR_INVALID_INDEX, "Invalid buffer index %u", iIndex);
+  g_mutex_unlock (&stream->device->lock);
+
+  return ret;
+}
+
+GC_API
+DSClose (DS_HANDLE hDataStream)
+{
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+
+  sim_stream_close (hDataStream);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSRevokeBuffer (DS_HANDLE hDataStream, BUFFER_HANDLE hBuffer,
+    void **pBuffer, void **pPrivate)
+{
+  SimStream *stream = hDataStream;
+  SimBuffer *buffer = hBuffer;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  SIM_CHECK_HANDLE (hBuffer, SIM_HANDLE_BUFFER);
+
+  g_mutex_lock (&stream->device->lock);
+  if (buffer->state != SIM_BUFFER_IDLE) {
+    g_mutex_unlock (&stream->device->lock);
+    return sim_error (GC_ERR_BUSY, "Buffer is queued");
+  }
+
+  if (pBuffer)
+    *pBuffer = buffer->allocated ? NULL : buffer->base;
+  if (pPrivate)
+    *pPrivate = buffer->user_ptr;
+
+  g_ptr_array_remove_fast (stream->buffers, buffer);
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSQueueBuffer (DS_HANDLE hDataStream, BUFFER_HANDLE hBuffer)
+{
+  SimStream *stream = hDataStream;
+  SimBuffer *buffer = hBuffer;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  SIM_CHECK_HANDLE (hBuffer, SIM_HANDLE_BUFFER);
+
+  g_mutex_lock (&stream->device->lock);
+  if (buffer->state != SIM_BUFFER_IDLE) {
+    g_mutex_unlock (&stream->device->lock);
+    return sim_error (GC_ERR_INVALID_BUFFER, "Buffer is already queued");
+  }
+
+  buffer->state = SIM_BUFFER_QUEUED;
+  buffer->new_data = FALSE;
+  buffer->size_filled = 0;
+  g_queue_push_tail (&stream->input, buffer);
+  g_cond_broadcast (&stream->device->cond);
+  g_mutex_unlock (&stream->device->lock);
+
+  return GC_ERR_SUCCESS;
+}
+
+GC_API
+DSGetBufferInfo (DS_HANDLE hDataStream, BUFFER_HANDLE hBuffer,
+    BUFFER_INFO_CMD iInfoCmd, INFO_DATATYPE * piType, void *pBuffer,
+    size_t * piSize)
+{
+  SimStream *stream = hDataStream;
+  SimBuffer *buffer = hBuffer;
+  SimBuffer info;
+
+  SIM_CHECK_INIT ();
+  SIM_CHECK_HANDLE (hDataStream, SIM_HANDLE_STREAM);
+  SIM_CHECK_HANDLE (hBuffer, SIM_HANDLE_BUFFER);
+
+  g_mutex_lock (&stream->device->lock);
+  info = *buffer;
+  g_mutex_unlock (&stream->device->lock);
+
+  switch (iInfoCmd) {
+    case BUFFER_INFO_BASE:
+      return sim_info_ptr (info.base, piType, pBuffer, piSize);
+    case BUFFER_INFO_SIZE:
+      return sim_info_sizet (info.size, piType, pBuffer, piSize);
+    case BUFFER_INFO_USER_PTR:
+      return sim_info_ptr (info.user_ptr, piType, pBuffer, piSize);
+    case BUFFER_INFO_TIMESTAMP:
+    case BUFFER_INFO_TIMESTAMP_NS:
+      return sim_info_uint64 (info.timestamp, piType, pBuffer, piSize);
+    case BUFFER_INFO_NEW_DATA:
+      return sim_info_bool8 (info.new_data, piType, pBuffer, piSize);
+    case BUFFER_INFO_IS_QUEUED:
+      return sim_info_bool8 (info.state == SIM_BUFFER_QUEUED ||
+          info.state == SIM_BUFFER_OUTPUT, piType, pBuffer, piSize);
+    case BUFFER_INFO_IS_ACQUIRING:
+      return sim_info_bool8 (info.state == SIM_BUFFER_FILLING, piType,
+          pBuffer, piSize);
+    case BUFFER_INFO_IS_INCOMPLETE:
+      return sim_info_bool8 (info.incomplete, piType, pBuffer, piSize);
+    case BUFFER_INFO_TLTYPE:
+      return sim_info_string (TLTypeCustomName, piType, pBuffer, piSize);
+    case BUFFER_INFO_SIZE_FILLED:
+    case BUFFER_INFO_DATA_SIZE:
+      return sim_info_sizet (info.size_filled, piType, pBuffer, piSize);
+    case BUFFER_INFO_WIDTH:
+      return sim_info_sizet (info.width, piType, pBuffer, piSize);
+    case BUFFER_INFO_HEIGHT:
+      return sim_info_sizet (info.height, piType, pBuffer, piSize);
+    case BUFFER_INFO_XOFFSET:
+    case BUFFER_INFO_YOFFSET:
+    case BUFFER_INFO_XPADDING:
+    case BUFFER_INFO_YPADDING:
+    case BUFFER_INFO_IMAGEOFFSET:
+      return sim_info_sizet (0, piType, pBuffer, piSize);
+    case BUFFER_INFO_FRAMEID:
+      return sim_info_uint64 (info.frame_id, piType, pBuffer, piSize);
+    case BUFFER_INFO_IMAGEPRESENT:
+      return sim_info_bool8 (info.new_data, piType, pBuffer, piSize);
+    case BUFFER_INFO_PAYLOADTYPE:
+      return sim_info_sizet (PAYLOAD_TYPE_IMAGE, piType, pBuffer, piSize);
+    case BUFFER_INFO_PIXELFORMAT:
+      return sim_info_uint64 (info.pixel_format, piType, pBuffer, piSize);
+    case BUFFER_INFO_PIXELFORMAT_NAMESPACE:
+      return sim_info_uint64 (PIXELFORMAT_NAMESPACE_PFNC_32BIT, piType,
+          pBuffer, piSize);
+    case BUFFER_INFO_DELIVERED_IMAGEHEIGHT:
+      return sim_info_sizet (info.delivered_height, piType, pBuffer, piSize);
+    case BUFFER_INFO_PIXEL_ENDIANNESS:
+      return sim_info_int32 (G_BYTE_ORDER == G_LITTLE_ENDIAN ?
+          PIXELENDIANNESS_LITTLE : PIXELENDIANNESS_BIG, piType, pBuffer,
+          piSize);
+    case BUFFER_INFO_DATA_LARGER_THAN_BUFFER:
+      return sim_info_bool8 (info.incomplete, piType, pBuffer, piSize);
+    case BUFFER_INFO_CONTAINS_CHUNKDATA:
+      return sim_info_bool8 (FALSE, piType, pBuffer, piSize);
+    default:
+      return sim_error (GC_ERR_INVALID_PARAMETER, "Unknown info command %d",
+          iInfoCmd);
+  }
+}
@@ -0,0 +1,366 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgenicambufferpool.h"
+
+#ifdef G_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (gst_genicam_buffer_pool_debug);
+#define GST_CAT_DEFAULT gst_genicam_buffer_pool_debug
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+G_DEFINE_TYPE_WITH_CODE (GstGenicamBufferPool, gst_genicam_buffer_pool,
+    GST_TYPE_BUFFER_POOL,
+    GST_DEBUG_CATEGORY_INIT (gst_genicam_buffer_pool_debug,
+        "genicambufferpool", 0, "GenTL announced buffer pool"));
+
+static GQuark
+gst_genicam_buffer_handle_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (!quark)
+    quark = g_quark_from_static_string ("GstGenicamBufferHandle");
+
+  return quark;
+}
+
+BUFFER_HANDLE
+gst_genicam_buffer_pool_get_handle (GstBuffer * buffer)
+{
+  return (BUFFER_HANDLE) gst_mini_object_get_qdata (GST_MINI_OBJECT (buffer),
+      gst_genicam_buffer_handle_quark ());
+}
+
+#ifdef MAP_HUGETLB
+typedef struct
+{
+  gpointer data;
+  gsize size;
+} HugepageMapping;
+
+static void
+hugepage_mapping_free (gpointer data)
+{
+  HugepageMapping *mapping = (HugepageMapping *) data;
+
+  munmap (mapping->data, mapping->size);
+  g_free (mapping);
+}
+
+static GstBuffer *
+gst_genicam_buffer_pool_alloc_hugepages (GstGenicamBufferPool * pool,
+    gsize size)
+{
+  HugepageMapping *mapping;
+  gsize map_size;
+  gpointer data;
+
+  map_size = (size + HUGEPAGE_SIZE - 1) & ~((gsize) HUGEPAGE_SIZE - 1);
+  data = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data == MAP_FAILED) {
+    GST_WARNING_OBJECT (pool, "Failed to map %" G_GSIZE_FORMAT
+        " bytes of hugepages, are enough reserved?", map_size);
+    return NULL;
+  }
+
+  mapping = g_new0 (HugepageMapping, 1);
+  mapping->data = data;
+  mapping->size = map_size;
+
+  return gst_buffer_new_wrapped_full ((GstMemoryFlags) 0, data, map_size, 0,
+      size, mapping, hugepage_mapping_free);
+}
+#endif
+
+static gboolean
+gst_genicam_buffer_pool_set_config (GstBufferPool * bpool,
+    GstStructure * config)
+{
+  guint size, min_buffers, max_buffers;
+
+  if (!gst_buffer_pool_config_get_params (config, NULL, &size, &min_buffers,
+          &max_buffers)) {
+    GST_ERROR_OBJECT (bpool, "Invalid pool config");
+    return FALSE;
+  }
+
+  /* every buffer is announced up front, so there can't be more later */
+  if (min_buffers == 0 || min_buffers != max_buffers) {
+    GST_ERROR_OBJECT (bpool, "Pool needs a fixed number of buffers");
+    return FALSE;
+  }
+
+  return
+      GST_BUFFER_POOL_CLASS (gst_genicam_buffer_pool_parent_class)->set_config
+      (bpool, config);
+}
+
+static GstFlowReturn
+gst_genicam_buffer_pool_alloc_buffer (GstBufferPool * bpool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (bpool);
+  GstBuffer *buf = NULL;
+  GstMapInfo minfo;
+  BUFFER_HANDLE handle;
+  GC_ERROR ret;
+
+#ifdef MAP_HUGETLB
+  if (pool->hugepages) {
+    GstStructure *config;
+    guint size;
+
+    config = gst_buffer_pool_get_config (bpool);
+    gst_buffer_pool_config_get_params (config, NULL, &size, NULL, NULL);
+    gst_structure_free (config);
+
+    buf = gst_genicam_buffer_pool_alloc_hugepages (pool, size);
+  }
+#endif
+
+  if (!buf) {
+    GstFlowReturn flow;
+
+    flow =
+        GST_BUFFER_POOL_CLASS (gst_genicam_buffer_pool_parent_class)->
+        alloc_buffer (bpool, &buf, params);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
+  /* system memory doesn't move, so the pointer outlives the mapping */
+  gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
+  ret = GTL_DSAnnounceBuffer (pool->src->hDS, minfo.data, minfo.size, buf,
+      &handle);
+  gst_buffer_unmap (buf, &minfo);
+  if (ret != GC_ERR_SUCCESS) {
+    GST_ERROR_OBJECT (pool, "Failed to announce buffer (%d)", ret);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  gst_mini_object_set_qdata (GST_MINI_OBJECT (buf),
+      gst_genicam_buffer_handle_quark (), handle, NULL);
+
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+/* take all buffers back from the producer and free them */
+static void
+gst_genicam_buffer_pool_revoke (GstGenicamBufferPool * pool)
+{
+  GstGenicamSrc *src = pool->src;
+  guint i;
+
+  g_mutex_lock (&src->buffer_lock);
+  /* if the stream was already closed, the producer forgot them anyway */
+  if (src->hDS) {
+    GTL_DSFlushQueue (src->hDS, ACQ_QUEUE_INPUT_TO_OUTPUT);
+    GTL_DSFlushQueue (src->hDS, ACQ_QUEUE_OUTPUT_DISCARD);
+
+    for (i = 0; i < pool->buffers->len; ++i) {
+      GstBuffer *buf = (GstBuffer *) g_ptr_array_index (pool->buffers, i);
+
+      GTL_DSRevokeBuffer (src->hDS, gst_genicam_buffer_pool_get_handle (buf),
+          NULL, NULL);
+    }
+  }
+  g_mutex_unlock (&src->buffer_lock);
+
+  g_ptr_array_set_size (pool->buffers, 0);
+}
+
+static gboolean
+gst_genicam_buffer_pool_start (GstBufferPool * bpool)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (bpool);
+  GstBufferPoolClass *pclass = GST_BUFFER_POOL_GET_CLASS (bpool);
+  GstStructure *config;
+  guint i, num_buffers;
+  GC_ERROR ret;
+
+  config = gst_buffer_pool_get_config (bpool);
+  gst_buffer_pool_config_get_params (config, NULL, NULL, &num_buffers, NULL);
+  gst_structure_free (config);
+
+  /* the producer owns the buffers until they are filled, so rather than
+   * preallocating into the pool, hand them all over */
+  for (i = 0; i < num_buffers; ++i) {
+    GstBuffer *buf;
+
+    if (pclass->alloc_buffer (bpool, &buf, NULL) != GST_FLOW_OK)
+      goto error;
+    g_ptr_array_add (pool->buffers, buf);
+
+    ret = GTL_DSQueueBuffer (pool->src->hDS,
+        gst_genicam_buffer_pool_get_handle (buf));
+    if (ret != GC_ERR_SUCCESS) {
+      GST_ERROR_OBJECT (pool, "Failed to queue buffer (%d)", ret);
+      goto error;
+    }
+  }
+
+  GST_DEBUG_OBJECT (pool, "Announced %u buffers", num_buffers);
+
+  return TRUE;
+
+error:
+  gst_genicam_buffer_pool_revoke (pool);
+  return FALSE;
+}
+
+static gboolean
+gst_genicam_buffer_pool_stop (GstBufferPool * bpool)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (bpool);
+
+  GST_DEBUG_OBJECT (pool, "Revoking %u buffers", pool->buffers->len);
+
+  gst_genicam_buffer_pool_revoke (pool);
+
+  return
+      GST_BUFFER_POOL_CLASS (gst_genicam_buffer_pool_parent_class)->stop
+      (bpool);
+}
+
+static GstFlowReturn
+gst_genicam_buffer_pool_acquire_buffer (GstBufferPool * bpool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (bpool);
+  GstGenicamSrc *src = pool->src;
+  EVENT_NEW_BUFFER_DATA new_buffer_data;
+  size_t datasize;
+  GC_ERROR ret;
+
+  /* the free buffers are with the producer, wait for one to be filled */
+  datasize = sizeof (new_buffer_data);
+  ret =
+      GTL_EventGetData (src->hNewBufferEvent, &new_buffer_data, &datasize,
+      src->timeout);
+  if (ret == GC_ERR_ABORT) {
+    /* the wait was cancelled with EventKill */
+    return GST_FLOW_FLUSHING;
+  } else if (ret != GC_ERR_SUCCESS || !new_buffer_data.pUserPointer) {
+    GST_DEBUG_OBJECT (pool, "No buffer filled (%d)", ret);
+    return GST_FLOW_ERROR;
+  }
+
+  g_mutex_lock (&src->buffer_lock);
+  src->num_wrapped++;
+  g_mutex_unlock (&src->buffer_lock);
+
+  *buffer = (GstBuffer *) new_buffer_data.pUserPointer;
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_genicam_buffer_pool_release_buffer (GstBufferPool * bpool,
+    GstBuffer * buffer)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (bpool);
+  GstGenicamSrc *src = pool->src;
+  GC_ERROR ret;
+
+  /* if downstream swapped the memory, the announced memory is gone */
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_TAG_MEMORY)) {
+    GST_WARNING_OBJECT (pool, "Buffer memory was replaced, producer loses a "
+        "buffer");
+  } else if (gst_buffer_pool_is_active (bpool)) {
+    g_mutex_lock (&src->buffer_lock);
+    if (src->hDS) {
+      ret = GTL_DSQueueBuffer (src->hDS,
+          gst_genicam_buffer_pool_get_handle (buffer));
+      if (ret != GC_ERR_SUCCESS) {
+        GST_WARNING_OBJECT (pool, "Failed to queue buffer (%d)", ret);
+      }
+    }
+    g_mutex_unlock (&src->buffer_lock);
+  }
+
+  g_mutex_lock (&src->buffer_lock);
+  src->num_wrapped--;
+  g_cond_broadcast (&src->buffer_cond);
+  g_mutex_unlock (&src->buffer_lock);
+}
+
+static void
+gst_genicam_buffer_pool_finalize (GObject * object)
+{
+  GstGenicamBufferPool *pool = GST_GENICAM_BUFFER_POOL (object);
+
+  g_ptr_array_free (pool->buffers, TRUE);
+  gst_object_unref (pool->src);
+
+  G_OBJECT_CLASS (gst_genicam_buffer_pool_parent_class)->finalize (object);
+}
+
+static void
+gst_genicam_buffer_pool_class_init (GstGenicamBufferPoolClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *bufferpool_class = GST_BUFFER_POOL_CLASS (klass);
+
+  gobject_class->finalize = gst_genicam_buffer_pool_finalize;
+
+  bufferpool_class->set_config = gst_genicam_buffer_pool_set_config;
+  bufferpool_class->start = gst_genicam_buffer_pool_start;
+  bufferpool_class->stop = gst_genicam_buffer_pool_stop;
+  bufferpool_class->alloc_buffer = gst_genicam_buffer_pool_alloc_buffer;
+  bufferpool_class->acquire_buffer = gst_genicam_buffer_pool_acquire_buffer;
+  bufferpool_class->release_buffer = gst_genicam_buffer_pool_release_buffer;
+}
+
+static void
+gst_genicam_buffer_pool_init (GstGenicamBufferPool * pool)
+{
+  pool->buffers =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+}
+
+GstBufferPool *
+gst_genicam_buffer_pool_new (GstGenicamSrc * src, gboolean hugepages)
+{
+  GstGenicamBufferPool *pool;
+
+  pool = (GstGenicamBufferPool *) g_object_new (GST_TYPE_GENICAM_BUFFER_POOL,
+      NULL);
+  pool->src = (GstGenicamSrc *) gst_object_ref (src);
+  pool->hugepages = hugepages;
+
+#ifndef MAP_HUGETLB
+  if (hugepages) {
+    GST_WARNING_OBJECT (pool, "Hugepages aren't supported on this platform");
+  }
+#endif
+
+  return GST_BUFFER_POOL (pool);
+}
@@ -0,0 +1,64 @@
+/* GStreamer
+ * Copyright (C) 2019 United States Government, Joshua M. Doe <oss@nvl.army.mil>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_GENICAM_BUFFER_POOL_H_
+#define _GST_GENICAM_BUFFER_POOL_H_
+
+#include <gst/gst.h>
+
+#include "gstgenicamsrc.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_GENICAM_BUFFER_POOL   (gst_genicam_buffer_pool_get_type())
+#define GST_GENICAM_BUFFER_POOL(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_GENICAM_BUFFER_POOL,GstGenicamBufferPool))
+#define GST_IS_GENICAM_BUFFER_POOL(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_GENICAM_BUFFER_POOL))
+
+typedef struct _GstGenicamBufferPool GstGenicamBufferPool;
+typedef struct _GstGenicamBufferPoolClass GstGenicamBufferPoolClass;
+
+/* Pool whose buffers are announced to the data stream of a genicamsrc, so
+ * the producer fills them directly. Activating the pool announces and queues
+ * all buffers, acquiring waits for the next filled one, and releasing queues
+ * it to the producer again. */
+struct _GstGenicamBufferPool
+{
+  GstBufferPool parent;
+
+  GstGenicamSrc *src;
+  gboolean hugepages;
+
+  /* every buffer announced to the producer */
+  GPtrArray *buffers;
+};
+
+struct _GstGenicamBufferPoolClass
+{
+  GstBufferPoolClass parent_class;
+};
+
+GType gst_genicam_buffer_pool_get_type (void);
+
+GstBufferPool *gst_genicam_buffer_pool_new (GstGenicamSrc * src,
+    gboolean hugepages);
+BUFFER_HANDLE gst_genicam_buffer_pool_get_handle (GstBuffer * buffer);
+
+G_END_DECLS
+
+#endif
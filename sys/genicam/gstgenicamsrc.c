@@ -27,15 +27,42 @@
  * gst-launch -v genicamsrc ! videoconvert ! autovideosink
  * ]|
  * Shows video from the default GenICam framegrabber
+ * |[
+ * gst-launch -v genicamsrc cti-path=/usr/lib/genicam/gentlsim.cti ! fakesink
+ * ]|
+ * Captures from the simulated GenTL producer, without any camera
  * </refsect2>
+ *
+ * If cti-path isn't set, the first producer (.cti) found in the directories
+ * listed in GENICAM_GENTL64_PATH (GENICAM_GENTL32_PATH for 32-bit builds) is
+ * used, as set by GenTL producer installers.
+ *
+ * Frames are captured by a dedicated thread into a ring of ring-size frames,
+ * so requeueing buffers to the producer doesn't wait for downstream. When
+ * the ring is full, overflow-policy decides whether the oldest or newest
+ * frame is dropped, or capture waits. The stats property reports the ring
+ * occupancy.
+ *
+ * The device XML is cached in the user cache directory (for example
+ * ~/.cache/gst-plugins-vision/genicam), keyed by device model, firmware
+ * version and schema version, so it is only read from the device once.
+ *
+ * With buffer-mode=pool, capture buffers are allocated by a GstBufferPool
+ * and announced to the producer, instead of being allocated by the producer.
+ * The memory is aligned for DMA, can be backed by hugepages, and stays valid
+ * after the element stops.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <errno.h>
+#include <string.h>
+
 #include <gmodule.h>
 
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
@@ -44,6 +71,7 @@
 #include "unzip.h"
 
 #include "gstgenicamsrc.h"
+#include "gstgenicambufferpool.h"
 
 #ifdef HAVE_ORC
 #include <orc/orc.h>
@@ -72,10 +100,12 @@ static gboolean gst_genicamsrc_unlock_stop (GstBaseSrc * src);
 static GstFlowReturn gst_genicamsrc_create (GstPushSrc * src, GstBuffer ** buf);
 
 static gchar *gst_genicamsrc_get_error_string (GstGenicamSrc * src);
+static void gst_genicamsrc_stop_acquisition_thread (GstGenicamSrc * src);
 
 enum
 {
   PROP_0,
+  PROP_CTI_PATH,
   PROP_INTERFACE_INDEX,
   PROP_INTERFACE_ID,
   PROP_DEVICE_INDEX,
@@ -83,9 +113,16 @@ enum
   PROP_STREAM_INDEX,
   PROP_STREAM_ID,
   PROP_NUM_CAPTURE_BUFFERS,
-  PROP_TIMEOUT
+  PROP_LOW_WATERMARK,
+  PROP_TIMEOUT,
+  PROP_BUFFER_MODE,
+  PROP_HUGEPAGES,
+  PROP_RING_SIZE,
+  PROP_OVERFLOW_POLICY,
+  PROP_STATS
 };
 
+#define DEFAULT_PROP_CTI_PATH ""
 #define DEFAULT_PROP_INTERFACE_INDEX 0
 #define DEFAULT_PROP_INTERFACE_ID ""
 #define DEFAULT_PROP_DEVICE_INDEX 0
@@ -93,7 +130,59 @@ enum
 #define DEFAULT_PROP_STREAM_INDEX 0
 #define DEFAULT_PROP_STREAM_ID ""
 #define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 3
+#define DEFAULT_PROP_LOW_WATERMARK 1
 #define DEFAULT_PROP_TIMEOUT 1000
+#define DEFAULT_PROP_BUFFER_MODE GST_GENICAM_SRC_BUFFER_MODE_PRODUCER
+#define DEFAULT_PROP_HUGEPAGES FALSE
+#define DEFAULT_PROP_RING_SIZE 4
+#define DEFAULT_PROP_OVERFLOW_POLICY GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_OLDEST
+
+/* DMA engines commonly want page aligned targets */
+#define POOL_MIN_ALIGNMENT 4096
+
+#define GST_TYPE_GENICAM_SRC_BUFFER_MODE (gst_genicamsrc_buffer_mode_get_type())
+static GType
+gst_genicamsrc_buffer_mode_get_type (void)
+{
+  static GType genicamsrc_buffer_mode_type = 0;
+  static const GEnumValue genicamsrc_buffer_mode[] = {
+    {GST_GENICAM_SRC_BUFFER_MODE_PRODUCER, "producer",
+        "Producer allocates buffers"},
+    {GST_GENICAM_SRC_BUFFER_MODE_POOL, "pool",
+        "Buffer pool memory is announced to producer"},
+    {0, NULL, NULL},
+  };
+
+  if (!genicamsrc_buffer_mode_type) {
+    genicamsrc_buffer_mode_type =
+        g_enum_register_static ("GstGenicamSrcBufferMode",
+        genicamsrc_buffer_mode);
+  }
+  return genicamsrc_buffer_mode_type;
+}
+
+#define GST_TYPE_GENICAM_SRC_OVERFLOW_POLICY (gst_genicamsrc_overflow_policy_get_type())
+static GType
+gst_genicamsrc_overflow_policy_get_type (void)
+{
+  static GType genicamsrc_overflow_policy_type = 0;
+  static const GEnumValue genicamsrc_overflow_policy[] = {
+    {GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_OLDEST, "drop-oldest",
+        "Drop the oldest frame in the ring"},
+    {GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_NEWEST, "drop-newest",
+        "Drop the frame just captured"},
+    {GST_GENICAM_SRC_OVERFLOW_POLICY_BLOCK, "block",
+        "Wait for space in the ring"},
+    {0, NULL, NULL},
+  };
+
+  if (!genicamsrc_overflow_policy_type) {
+    genicamsrc_overflow_policy_type =
+        g_enum_register_static ("GstGenicamSrcOverflowPolicy",
+        genicamsrc_overflow_policy);
+  }
+  return genicamsrc_overflow_policy_type;
+}
 
 /* pad templates */
 
@@ -162,25 +251,96 @@ PDSGetBufferInfo GTL_DSGetBufferInfo;
 PGCGetNumPortURLs GTL_GCGetNumPortURLs;
 PGCGetPortURLInfo GTL_GCGetPortURLInfo;
 
-#define GTL_BIND(fcn) if (!g_module_symbol (module, G_STRINGIFY(fcn), (gpointer *) & GTL_##fcn)) { \
-  GST_DEBUG_OBJECT(src, "Failed to bind function " G_STRINGIFY(fcn)); goto error; }
+#if GLIB_SIZEOF_VOID_P == 8
+#define GENTL_PATH_ENV "GENICAM_GENTL64_PATH"
+#else
+#define GENTL_PATH_ENV "GENICAM_GENTL32_PATH"
+#endif
+
+/* Find the first producer in the GenTL producer search path, the same way
+ * GenTL consumers are expected to */
+static gchar *
+gst_genicamsrc_find_cti (GstGenicamSrc * src)
+{
+  const gchar *search_path;
+  gchar **dirs;
+  gchar *cti_path = NULL;
+  guint i;
+
+  search_path = g_getenv (GENTL_PATH_ENV);
+  if (!search_path) {
+    GST_DEBUG_OBJECT (src, GENTL_PATH_ENV " is not set");
+    return NULL;
+  }
 
-gboolean
+  dirs = g_strsplit (search_path, G_SEARCHPATH_SEPARATOR_S, -1);
+  for (i = 0; dirs[i] && !cti_path; ++i) {
+    GDir *dir;
+    const gchar *name;
+    gchar *first = NULL;
+
+    if (dirs[i][0] == 0)
+      continue;
+
+    dir = g_dir_open (dirs[i], 0, NULL);
+    if (!dir) {
+      GST_DEBUG_OBJECT (src, "Can't open producer directory '%s'", dirs[i]);
+      continue;
+    }
+
+    /* directory order is arbitrary, so pick the first alphabetically */
+    while ((name = g_dir_read_name (dir))) {
+      gchar *lower = g_ascii_strdown (name, -1);
+
+      if (g_str_has_suffix (lower, ".cti") &&
+          (!first || g_strcmp0 (name, first) < 0)) {
+        g_free (first);
+        first = g_strdup (name);
+      }
+      g_free (lower);
+    }
+    g_dir_close (dir);
+
+    if (first) {
+      cti_path = g_build_filename (dirs[i], first, NULL);
+      g_free (first);
+    }
+  }
+  g_strfreev (dirs);
+
+  return cti_path;
+}
+
+#define GTL_BIND(fcn) if (!g_module_symbol (src->module, G_STRINGIFY(fcn), (gpointer *) & GTL_##fcn)) { \
+  missing = G_STRINGIFY(fcn); goto error; }
+
+static gboolean
 gst_genicamsrc_bind_functions (GstGenicamSrc * src)
 {
-  GModule *module;
-  //const char cti_path[] = "C:\\BitFlow SDK 6.20\\Bin64\\BFGTL.cti";
-  const char cti_path[] =
-      "C:\\Program Files\\Basler\\pylon 5\\Runtime\\x64\\ProducerGEV.cti";
-  gboolean ret = TRUE;
+  gchar *cti_path;
+  const gchar *missing = NULL;
+
+  if (src->cti_path && src->cti_path[0] != 0) {
+    cti_path = g_strdup (src->cti_path);
+  } else {
+    cti_path = gst_genicamsrc_find_cti (src);
+    if (!cti_path) {
+      GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+          ("No GenTL producer found"),
+          ("Set cti-path, or add a directory containing a .cti file to "
+              GENTL_PATH_ENV));
+      return FALSE;
+    }
+  }
 
   GST_DEBUG_OBJECT (src, "Trying to bind functions from '%s'", cti_path);
 
-  module = g_module_open (cti_path, G_MODULE_BIND_LAZY);
-  if (!module) {
+  src->module = g_module_open (cti_path, G_MODULE_BIND_LAZY);
+  if (!src->module) {
     GST_ELEMENT_ERROR (src, LIBRARY, INIT,
         ("GenTL CTI %s could not be opened: %s", cti_path, g_module_error ()),
         (NULL));
+    g_free (cti_path);
     return FALSE;
   }
 
@@ -234,10 +394,15 @@ gst_genicamsrc_bind_functions (GstGenicamSrc * src)
   GTL_BIND (GCGetNumPortURLs);
   GTL_BIND (GCGetPortURLInfo);
 
+  g_free (cti_path);
   return TRUE;
 
 error:
-  GST_ERROR_OBJECT (src, "One or more functions doesn't exist in %s", cti_path);
+  GST_ELEMENT_ERROR (src, LIBRARY, INIT,
+      ("GenTL CTI %s is missing function %s", cti_path, missing), (NULL));
+  g_module_close (src->module);
+  src->module = NULL;
+  g_free (cti_path);
   return FALSE;
 }
 
@@ -277,6 +442,12 @@ gst_genicamsrc_class_init (GstGenicamSrcClass * klass)
   gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_genicamsrc_create);
 
   /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_CTI_PATH,
+      g_param_spec_string ("cti-path", "CTI path",
+          "Path of the GenTL producer (.cti) to use, if empty string the first "
+          "one found in " GENTL_PATH_ENV, DEFAULT_PROP_CTI_PATH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
   g_object_class_install_property (gobject_class, PROP_INTERFACE_INDEX,
       g_param_spec_uint ("interface-index", "Interface index",
           "Interface index number, zero-based, overridden by interface-id",
@@ -318,20 +489,82 @@ gst_genicamsrc_class_init (GstGenicamSrcClass * klass)
           "Number of capture buffers", 1, G_MAXUINT,
           DEFAULT_PROP_NUM_CAPTURE_BUFFERS,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LOW_WATERMARK,
+      g_param_spec_uint ("low-watermark", "Low watermark",
+          "Frames are pushed without copying unless fewer than this many "
+          "capture buffers would be left to the producer, in which case they "
+          "are copied so acquisition never starves", 0, G_MAXUINT,
+          DEFAULT_PROP_LOW_WATERMARK,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
   g_object_class_install_property (G_OBJECT_CLASS (klass),
       PROP_TIMEOUT, g_param_spec_int ("timeout",
           "Timeout (ms)",
           "Timeout in ms (0 to use default)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_BUFFER_MODE,
+      g_param_spec_enum ("buffer-mode", "Buffer mode",
+          "Whether capture buffers are allocated by the producer, or by a "
+          "buffer pool and announced to the producer",
+          GST_TYPE_GENICAM_SRC_BUFFER_MODE, DEFAULT_PROP_BUFFER_MODE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_HUGEPAGES,
+      g_param_spec_boolean ("hugepages", "Hugepages",
+          "Back pool capture buffers with hugepages (Linux only, falls back "
+          "to regular pages if none are reserved)", DEFAULT_PROP_HUGEPAGES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_RING_SIZE,
+      g_param_spec_uint ("ring-size", "Ring size",
+          "Number of captured frames that can wait to be pushed", 1,
+          G_MAXUINT, DEFAULT_PROP_RING_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_OVERFLOW_POLICY,
+      g_param_spec_enum ("overflow-policy", "Overflow policy",
+          "What to do with a captured frame when the ring is full",
+          GST_TYPE_GENICAM_SRC_OVERFLOW_POLICY, DEFAULT_PROP_OVERFLOW_POLICY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Ring occupancy and drop counts", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 
 }
 
+static GstStructure *
+gst_genicamsrc_get_stats (GstGenicamSrc * src)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&src->ring_lock);
+  stats = gst_structure_new ("application/x-genicamsrc-stats",
+      "ring-size", G_TYPE_UINT, src->ring_size,
+      "ring-occupancy", G_TYPE_UINT, src->ring_len,
+      "ring-high-water", G_TYPE_UINT, src->ring_high_water,
+      "ring-overflows", G_TYPE_UINT64, src->ring_overflows,
+      "dropped-frames", G_TYPE_UINT64, src->total_dropped_frames, NULL);
+  g_mutex_unlock (&src->ring_lock);
+
+  return stats;
+}
+
 static void
 gst_genicamsrc_reset (GstGenicamSrc * src)
 {
   src->error_string[0] = 0;
-  src->last_frame_count = 0;
+  src->ring_high_water = 0;
+  src->ring_overflows = 0;
+  src->acq_ret = GST_FLOW_OK;
+  src->last_frame_id = G_MAXUINT64;
+  src->frame_offset = 0;
   src->total_dropped_frames = 0;
+  src->timestamp_frequency = GST_SECOND;
+  src->ts_num_samples = 0;
+  src->ts_next_sample = 0;
+
+  g_hash_table_remove_all (src->buffer_info);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -349,14 +582,38 @@ gst_genicamsrc_init (GstGenicamSrc * src)
   gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
 
   /* initialize member variables */
+  src->cti_path = g_strdup (DEFAULT_PROP_CTI_PATH);
   src->interface_index = DEFAULT_PROP_INTERFACE_INDEX;
   src->interface_id = g_strdup (DEFAULT_PROP_INTERFACE_ID);
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
+  src->low_watermark = DEFAULT_PROP_LOW_WATERMARK;
   src->timeout = DEFAULT_PROP_TIMEOUT;
+  src->buffer_mode = DEFAULT_PROP_BUFFER_MODE;
+  src->hugepages = DEFAULT_PROP_HUGEPAGES;
+  src->pool = NULL;
+  src->ring_size = DEFAULT_PROP_RING_SIZE;
+  src->overflow_policy = DEFAULT_PROP_OVERFLOW_POLICY;
+
+  g_mutex_init (&src->buffer_lock);
+  g_cond_init (&src->buffer_cond);
+  src->num_wrapped = 0;
+  src->closing = NULL;
+
+  src->buffer_info =
+      g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+  g_mutex_init (&src->ring_lock);
+  g_cond_init (&src->ring_cond);
+  src->acq_thread = NULL;
+  src->ring = NULL;
+  src->ring_head = 0;
+  src->ring_len = 0;
+  src->acq_exiting = FALSE;
 
   src->stop_requested = FALSE;
   src->caps = NULL;
 
+  src->module = NULL;
   src->hTL = NULL;
   src->hIF = NULL;
   src->hDEV = NULL;
@@ -374,6 +631,10 @@ gst_genicamsrc_set_property (GObject * object, guint property_id,
   src = GST_GENICAM_SRC (object);
 
   switch (property_id) {
+    case PROP_CTI_PATH:
+      g_free (src->cti_path);
+      src->cti_path = g_strdup (g_value_get_string (value));
+      break;
     case PROP_INTERFACE_INDEX:
       src->interface_index = g_value_get_uint (value);
       break;
@@ -398,6 +659,21 @@ gst_genicamsrc_set_property (GObject * object, guint property_id,
     case PROP_NUM_CAPTURE_BUFFERS:
       src->num_capture_buffers = g_value_get_uint (value);
       break;
+    case PROP_LOW_WATERMARK:
+      src->low_watermark = g_value_get_uint (value);
+      break;
+    case PROP_BUFFER_MODE:
+      src->buffer_mode = g_value_get_enum (value);
+      break;
+    case PROP_HUGEPAGES:
+      src->hugepages = g_value_get_boolean (value);
+      break;
+    case PROP_RING_SIZE:
+      src->ring_size = g_value_get_uint (value);
+      break;
+    case PROP_OVERFLOW_POLICY:
+      src->overflow_policy = g_value_get_enum (value);
+      break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
       break;
@@ -417,6 +693,9 @@ gst_genicamsrc_get_property (GObject * object, guint property_id,
   src = GST_GENICAM_SRC (object);
 
   switch (property_id) {
+    case PROP_CTI_PATH:
+      g_value_set_string (value, src->cti_path);
+      break;
     case PROP_INTERFACE_INDEX:
       g_value_set_uint (value, src->interface_index);
       break;
@@ -438,6 +717,24 @@ gst_genicamsrc_get_property (GObject * object, guint property_id,
     case PROP_NUM_CAPTURE_BUFFERS:
       g_value_set_uint (value, src->num_capture_buffers);
       break;
+    case PROP_LOW_WATERMARK:
+      g_value_set_uint (value, src->low_watermark);
+      break;
+    case PROP_BUFFER_MODE:
+      g_value_set_enum (value, src->buffer_mode);
+      break;
+    case PROP_HUGEPAGES:
+      g_value_set_boolean (value, src->hugepages);
+      break;
+    case PROP_RING_SIZE:
+      g_value_set_uint (value, src->ring_size);
+      break;
+    case PROP_OVERFLOW_POLICY:
+      g_value_set_enum (value, src->overflow_policy);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_genicamsrc_get_stats (src));
+      break;
     case PROP_TIMEOUT:
       g_value_set_int (value, src->timeout);
       break;
@@ -470,6 +767,15 @@ gst_genicamsrc_finalize (GObject * object)
 
   /* clean up object here */
 
+  g_free (src->cti_path);
+  src->cti_path = NULL;
+
+  g_mutex_clear (&src->buffer_lock);
+  g_cond_clear (&src->buffer_cond);
+  g_hash_table_unref (src->buffer_info);
+  g_mutex_clear (&src->ring_lock);
+  g_cond_clear (&src->ring_cond);
+
   if (src->caps) {
     gst_caps_unref (src->caps);
     src->caps = NULL;
@@ -564,6 +870,7 @@ gst_genicam_print_interface_info (GstGenicamSrc * src, uint32_t index)
   char display_name[GTL_MAX_STR_SIZE];
   INFO_DATATYPE datatype;
 
+  str_size = GTL_MAX_STR_SIZE;
   ret = GTL_TLGetInterfaceID (src->hTL, index, iface_id, &str_size);
   if (ret != GC_ERR_SUCCESS) {
     GST_WARNING_OBJECT (src, "Failed to get interface id: %s",
@@ -599,6 +906,7 @@ gst_genicam_print_device_info (GstGenicamSrc * src, uint32_t index)
   gint32 access_status;
   INFO_DATATYPE datatype;
 
+  str_size = GTL_MAX_STR_SIZE;
   ret = GTL_IFGetDeviceID (src->hIF, index, dev_id, &str_size);
   if (ret != GC_ERR_SUCCESS) {
     GST_WARNING_OBJECT (src, "Failed to get device id: %s",
@@ -667,6 +975,360 @@ gst_genicam_print_device_info (GstGenicamSrc * src, uint32_t index)
 //}
 
 
+static GC_ERROR
+gst_genicamsrc_read_register (GstGenicamSrc * src, const GenicamRegister * reg,
+    guint64 * value)
+{
+  guint8 data[8];
+  size_t datasize = reg->length;
+  GC_ERROR ret;
+  guint i;
+
+  if (!reg->valid) {
+    return GC_ERR_NOT_AVAILABLE;
+  }
+
+  ret = GTL_GCReadPort (src->hDevPort, reg->address, data, &datasize);
+  if (ret != GC_ERR_SUCCESS) {
+    return ret;
+  }
+
+  *value = 0;
+  for (i = 0; i < reg->length; ++i) {
+    *value = (*value << 8) |
+        (reg->big_endian ? data[i] : data[reg->length - 1 - i]);
+  }
+
+  return GC_ERR_SUCCESS;
+}
+
+static GC_ERROR
+gst_genicamsrc_write_register (GstGenicamSrc * src,
+    const GenicamRegister * reg, guint64 value)
+{
+  guint8 data[8];
+  size_t datasize = reg->length;
+  guint i;
+
+  if (!reg->valid) {
+    return GC_ERR_NOT_AVAILABLE;
+  }
+
+  for (i = 0; i < reg->length; ++i) {
+    guint8 byte = (value >> (8 * i)) & 0xff;
+
+    if (reg->big_endian) {
+      data[reg->length - 1 - i] = byte;
+    } else {
+      data[i] = byte;
+    }
+  }
+
+  return GTL_GCWritePort (src->hDevPort, reg->address, data, &datasize);
+}
+
+/* bits per pixel of the PFNC formats that map to GRAY8/GRAY16, or 0 */
+static gint
+gst_genicamsrc_pixel_format_to_bpp (guint32 pixel_format)
+{
+  switch (pixel_format) {
+    case 0x01080001:           /* Mono8 */
+      return 8;
+    case 0x01100003:           /* Mono10 */
+      return 10;
+    case 0x01100005:           /* Mono12 */
+      return 12;
+    case 0x01100025:           /* Mono14 */
+      return 14;
+    case 0x01100007:           /* Mono16 */
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+static void
+gst_genicamsrc_resolve_register (GstGenicamSrc * src, GenicamNodeMap * map,
+    const gchar * feature, GenicamRegister * reg, guint64 fallback)
+{
+  if (map && genicam_node_map_get_register (map, feature, reg)) {
+    GST_DEBUG_OBJECT (src, "%s is a %u byte register at 0x%" G_GINT64_MODIFIER
+        "x", feature, reg->length, reg->address);
+    return;
+  }
+
+  memset (reg, 0, sizeof (*reg));
+  if (!fallback) {
+    GST_DEBUG_OBJECT (src, "Couldn't resolve %s", feature);
+    return;
+  }
+
+  /* the addresses used before the device XML was parsed */
+  GST_DEBUG_OBJECT (src, "Couldn't resolve %s, assuming register at 0x%"
+      G_GINT64_MODIFIER "x", feature, fallback);
+  reg->valid = TRUE;
+  reg->address = fallback;
+  reg->length = 4;
+  reg->big_endian = TRUE;
+  reg->command_value = 1;
+}
+
+static void
+gst_genicamsrc_resolve_registers (GstGenicamSrc * src, const gchar * xml,
+    gsize xml_len)
+{
+  GenicamNodeMap *map = NULL;
+  GError *err = NULL;
+
+  if (xml) {
+    map = genicam_node_map_new (xml, xml_len, &err);
+    if (!map) {
+      GST_WARNING_OBJECT (src, "Failed to parse device XML: %s",
+          err->message);
+      g_error_free (err);
+    }
+  }
+
+  gst_genicamsrc_resolve_register (src, map, "Width", &src->reg_width,
+      0x30204);
+  gst_genicamsrc_resolve_register (src, map, "Height", &src->reg_height,
+      0x30224);
+  gst_genicamsrc_resolve_register (src, map, "PixelFormat",
+      &src->reg_pixel_format, 0);
+  gst_genicamsrc_resolve_register (src, map, "PayloadSize",
+      &src->reg_payload_size, 0x10088);
+  gst_genicamsrc_resolve_register (src, map, "AcquisitionMode",
+      &src->reg_acquisition_mode, 0x40004);
+  gst_genicamsrc_resolve_register (src, map, "AcquisitionStart",
+      &src->reg_acquisition_start, 0x40024);
+
+  if (!map || !genicam_node_map_get_enum_value (map, "AcquisitionMode",
+          "Continuous", &src->acquisition_mode_continuous)) {
+    src->acquisition_mode_continuous = 2;
+  }
+
+  genicam_node_map_free (map);
+}
+
+static gchar *
+gst_genicamsrc_get_device_info_string (GstGenicamSrc * src,
+    DEVICE_INFO_CMD cmd)
+{
+  INFO_DATATYPE datatype;
+  size_t size = 0;
+  gchar *str;
+
+  if (GTL_DevGetInfo (src->hDEV, cmd, &datatype, NULL,
+          &size) != GC_ERR_SUCCESS || size == 0) {
+    return g_strdup ("");
+  }
+
+  str = (gchar *) g_malloc0 (size + 1);
+  if (GTL_DevGetInfo (src->hDEV, cmd, &datatype, str,
+          &size) != GC_ERR_SUCCESS) {
+    str[0] = 0;
+  }
+
+  return str;
+}
+
+/* Device XML only changes with the device model, its firmware or the schema
+ * it's written against, so cache it keyed by those. Returns NULL if the
+ * device doesn't identify itself well enough to cache. */
+static gchar *
+gst_genicamsrc_get_xml_cache_path (GstGenicamSrc * src,
+    const gchar * filename, const gchar * schema_version)
+{
+  gchar *vendor, *model, *version, *key, *path = NULL;
+
+  vendor = gst_genicamsrc_get_device_info_string (src, DEVICE_INFO_VENDOR);
+  model = gst_genicamsrc_get_device_info_string (src, DEVICE_INFO_MODEL);
+  version = gst_genicamsrc_get_device_info_string (src, DEVICE_INFO_VERSION);
+
+  if (model[0] != 0) {
+    key = g_strdup_printf ("%s_%s_%s_%s_%s.xml", vendor, model, version,
+        schema_version, filename);
+    g_strcanon (key, G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "-_.", '_');
+    path = g_build_filename (g_get_user_cache_dir (), "gst-plugins-vision",
+        "genicam", key, NULL);
+    g_free (key);
+  }
+
+  g_free (vendor);
+  g_free (model);
+  g_free (version);
+
+  return path;
+}
+
+static gboolean
+gst_genicamsrc_unzip_xml (GstGenicamSrc * src, const gchar * filename,
+    const gchar * zip, gsize zip_len, gchar ** xml, gsize * xml_len)
+{
+  GError *err = NULL;
+  gchar *zipfilepath;
+  unzFile uf = NULL;
+  unz_file_info64 fileinfo;
+  gchar xmlfilename[2048];
+  int ret;
+  gboolean res = FALSE;
+
+  /* unzip only reads from files */
+  zipfilepath = g_build_filename (g_get_tmp_dir (), filename, NULL);
+  if (!g_file_set_contents (zipfilepath, zip, zip_len, &err)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to write zipped XML to %s: %s", zipfilepath, err->message),
+        (NULL));
+    g_error_free (err);
+    goto out;
+  }
+
+  uf = unzOpen64 (zipfilepath);
+  if (!uf) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to open zipped XML %s", zipfilepath), (NULL));
+    goto out;
+  }
+
+  ret =
+      unzGetCurrentFileInfo64 (uf, &fileinfo, xmlfilename,
+      sizeof (xmlfilename), NULL, 0, NULL, 0);
+  if (ret != UNZ_OK) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to query zip file %s", zipfilepath), (NULL));
+    goto out;
+  }
+
+  ret = unzOpenCurrentFile (uf);
+  if (ret != UNZ_OK) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to extract file %s", xmlfilename), (NULL));
+    goto out;
+  }
+
+  *xml_len = (gsize) fileinfo.uncompressed_size;
+  *xml = (gchar *) g_malloc (*xml_len);
+  ret = unzReadCurrentFile (uf, *xml, (unsigned) *xml_len);
+  unzCloseCurrentFile (uf);
+  if (ret != (int) *xml_len) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to extract XML file %s", xmlfilename), (NULL));
+    g_free (*xml);
+    *xml = NULL;
+    goto out;
+  }
+
+  GST_DEBUG_OBJECT (src, "Extracted %s from %s", xmlfilename, filename);
+  res = TRUE;
+
+out:
+  if (uf) {
+    unzClose (uf);
+  }
+  g_remove (zipfilepath);
+  g_free (zipfilepath);
+
+  return res;
+}
+
+/* Get the device XML from a local: URL, from the cache if possible, or else
+ * by reading it from the device and caching it */
+static gboolean
+gst_genicamsrc_read_local_xml (GstGenicamSrc * src, const gchar * url,
+    gchar ** xml, gsize * xml_len)
+{
+  GC_ERROR ret;
+  GError *err = NULL;
+  GMatchInfo *match_info;
+  GRegex *regex;
+  gchar *filename, *addr_str, *len_str, *schema_version;
+  gchar *cache_path = NULL;
+  uint64_t addr;
+  size_t len;
+  gchar *buf = NULL;
+  gboolean res = FALSE;
+
+  regex =
+      g_regex_new
+      ("local:(?:///)?(?<filename>[^;]+);(?<address>[^;]+);(?<length>[^?]+)(?:[?]SchemaVersion=(?<schema>[^&]+))?",
+      (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &err);
+  if (!regex) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to compile URL regex: %s", err->message), (NULL));
+    g_error_free (err);
+    return FALSE;
+  }
+  g_regex_match (regex, url, (GRegexMatchFlags) 0, &match_info);
+  filename = g_match_info_fetch_named (match_info, "filename");
+  addr_str = g_match_info_fetch_named (match_info, "address");
+  len_str = g_match_info_fetch_named (match_info, "length");
+  schema_version = g_match_info_fetch_named (match_info, "schema");
+  g_match_info_free (match_info);
+  g_regex_unref (regex);
+
+  if (!filename || !addr_str || !len_str) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
+        ("Failed to parse local URL"), (NULL));
+    goto out;
+  }
+
+  cache_path =
+      gst_genicamsrc_get_xml_cache_path (src, filename,
+      schema_version ? schema_version : "");
+  if (cache_path && g_file_get_contents (cache_path, xml, xml_len, NULL)) {
+    GST_DEBUG_OBJECT (src, "Using cached device XML %s", cache_path);
+    res = TRUE;
+    goto out;
+  }
+
+  addr = g_ascii_strtoull (addr_str, NULL, 16);
+  len = g_ascii_strtoull (len_str, NULL, 16);
+  buf = (gchar *) g_malloc (len);
+  ret = GTL_GCReadPort (src->hDevPort, addr, buf, &len);
+  if (ret != GC_ERR_SUCCESS) {
+    GST_ELEMENT_ERROR (src, LIBRARY, FAILED,
+        ("Failed to read XML from port: %s",
+            gst_genicamsrc_get_error_string (src)), (NULL));
+    goto out;
+  }
+
+  if (g_str_has_suffix (filename, "zip")) {
+    if (!gst_genicamsrc_unzip_xml (src, filename, buf, len, xml, xml_len)) {
+      goto out;
+    }
+  } else {
+    *xml = buf;
+    *xml_len = len;
+    buf = NULL;
+  }
+
+  if (cache_path) {
+    gchar *dir = g_path_get_dirname (cache_path);
+
+    if (g_mkdir_with_parents (dir, 0755) != 0
+        || !g_file_set_contents (cache_path, *xml, *xml_len, &err)) {
+      GST_WARNING_OBJECT (src, "Failed to cache device XML to %s: %s",
+          cache_path, err ? err->message : g_strerror (errno));
+      g_clear_error (&err);
+    } else {
+      GST_DEBUG_OBJECT (src, "Cached device XML to %s", cache_path);
+    }
+    g_free (dir);
+  }
+
+  res = TRUE;
+
+out:
+  g_free (filename);
+  g_free (addr_str);
+  g_free (len_str);
+  g_free (schema_version);
+  g_free (cache_path);
+  g_free (buf);
+
+  return res;
+}
+
 static size_t
 gst_genicamsrc_get_payload_size (GstGenicamSrc * src)
 {
@@ -687,12 +1349,11 @@ gst_genicamsrc_get_payload_size (GstGenicamSrc * src)
         GTL_DSGetInfo (src->hDS, STREAM_INFO_PAYLOAD_SIZE, &info_datatype,
         &payload_size, &info_size);
   } else {
-    guint32 val = 0;
-    size_t datasize = 4;
-    // TODO: use node map
-    ret = GTL_GCReadPort (src->hDevPort, 0x10088, &val, &datasize);
+    guint64 val = 0;
+
+    ret = gst_genicamsrc_read_register (src, &src->reg_payload_size, &val);
     HANDLE_GTL_ERROR ("Failed to get payload size");
-    payload_size = GUINT32_FROM_BE (val);
+    payload_size = (size_t) val;
 
     //PORT_HANDLE port_handle;
     //ret = GTL_DevGetPort(src->hDEV, &port_handle);
@@ -709,6 +1370,50 @@ error:
   return 0;
 }
 
+static gboolean
+gst_genicamsrc_prepare_pool (GstGenicamSrc * src, size_t payload_size)
+{
+  GC_ERROR ret;
+  INFO_DATATYPE info_datatype;
+  size_t info_size;
+  size_t alignment = 0;
+  GstStructure *config;
+  GstAllocationParams params;
+
+  info_size = sizeof (alignment);
+  ret =
+      GTL_DSGetInfo (src->hDS, STREAM_INFO_BUF_ALIGNMENT, &info_datatype,
+      &alignment, &info_size);
+  if (ret != GC_ERR_SUCCESS || alignment == 0
+      || (alignment & (alignment - 1)) != 0) {
+    alignment = 1;
+  }
+  alignment = MAX (alignment, POOL_MIN_ALIGNMENT);
+
+  gst_allocation_params_init (&params);
+  params.align = alignment - 1;
+
+  src->pool = gst_genicam_buffer_pool_new (src, src->hugepages);
+  config = gst_buffer_pool_get_config (src->pool);
+  gst_buffer_pool_config_set_params (config, NULL, (guint) payload_size,
+      src->num_capture_buffers, src->num_capture_buffers);
+  gst_buffer_pool_config_set_allocator (config, NULL, &params);
+
+  if (!gst_buffer_pool_set_config (src->pool, config)
+      || !gst_buffer_pool_set_active (src->pool, TRUE)) {
+    GST_ERROR_OBJECT (src, "Failed to announce pool buffers: %s",
+        gst_genicamsrc_get_error_string (src));
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (src, "Announced %u pool buffers aligned to %"
+      G_GSIZE_FORMAT " bytes", src->num_capture_buffers, alignment);
+
+  return TRUE;
+}
+
 static gboolean
 gst_genicamsrc_prepare_buffers (GstGenicamSrc * src)
 {
@@ -723,6 +1428,10 @@ gst_genicamsrc_prepare_buffers (GstGenicamSrc * src)
     return FALSE;
   }
 
+  if (src->buffer_mode == GST_GENICAM_SRC_BUFFER_MODE_POOL) {
+    return gst_genicamsrc_prepare_pool (src, payload_size);
+  }
+
   for (i = 0; i < src->num_capture_buffers; ++i) {
     ret = GTL_DSAllocAndAnnounceBuffer (src->hDS, payload_size, NULL, &hBuffer);
     HANDLE_GTL_ERROR ("Failed to alloc and announce buffer");
@@ -738,6 +1447,64 @@ error:
 }
 
 
+struct _GstGenicamProducer
+{
+  GModule *module;
+  TL_HANDLE hTL;
+  IF_HANDLE hIF;
+  DEV_HANDLE hDEV;
+  DS_HANDLE hDS;
+};
+
+/* take the open handles and the module from src, leaving it closed */
+static GstGenicamProducer *
+gst_genicamsrc_take_producer (GstGenicamSrc * src)
+{
+  GstGenicamProducer *producer = g_new0 (GstGenicamProducer, 1);
+
+  producer->module = src->module;
+  producer->hTL = src->hTL;
+  producer->hIF = src->hIF;
+  producer->hDEV = src->hDEV;
+  producer->hDS = src->hDS;
+
+  src->module = NULL;
+  src->hTL = NULL;
+  src->hIF = NULL;
+  src->hDEV = NULL;
+  src->hDS = NULL;
+
+  return producer;
+}
+
+static void
+gst_genicamsrc_close_producer (GstGenicamProducer * producer)
+{
+  if (producer->hDS) {
+    GTL_DSFlushQueue (producer->hDS, ACQ_QUEUE_INPUT_TO_OUTPUT);
+    GTL_DSFlushQueue (producer->hDS, ACQ_QUEUE_OUTPUT_DISCARD);
+    GTL_DSClose (producer->hDS);
+  }
+
+  if (producer->hDEV) {
+    GTL_DevClose (producer->hDEV);
+  }
+
+  if (producer->hIF) {
+    GTL_IFClose (producer->hIF);
+  }
+
+  if (producer->hTL) {
+    GTL_TLClose (producer->hTL);
+  }
+
+  if (producer->module) {
+    GTL_GCCloseLib ();
+    g_module_close (producer->module);
+  }
+
+  g_free (producer);
+}
 
 static gboolean
 gst_genicamsrc_start (GstBaseSrc * bsrc)
@@ -750,10 +1517,28 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  /* the producer library of the previous stream can't be opened again
+   * before it is closed, which waits for downstream to release its frames */
+  g_mutex_lock (&src->buffer_lock);
+  if (src->closing) {
+    gint64 end_time = g_get_monotonic_time () + G_TIME_SPAN_SECOND;
+
+    while (src->closing) {
+      if (!g_cond_wait_until (&src->buffer_cond, &src->buffer_lock, end_time))
+        break;
+    }
+  }
+  if (src->closing) {
+    g_mutex_unlock (&src->buffer_lock);
+    GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+        ("Buffers of the previous stream are still held downstream"),
+        (NULL));
+    return FALSE;
+  }
+  g_mutex_unlock (&src->buffer_lock);
+
   /* bind functions from CTI */
   if (!gst_genicamsrc_bind_functions (src)) {
-    GST_ELEMENT_ERROR (src, LIBRARY, INIT,
-        ("GenTL CTI could not be opened: %s", g_module_error ()), (NULL));
     return FALSE;
   }
 
@@ -827,13 +1612,15 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
     GST_DEBUG_OBJECT (src, "Trying to find device ID at index %d",
         src->device_index);
 
-    GTL_IFGetDeviceID (src->hIF, src->device_index, NULL, &id_size);
+    ret = GTL_IFGetDeviceID (src->hIF, src->device_index, NULL, &id_size);
     HANDLE_GTL_ERROR ("Failed to get device ID at specified index");
     if (src->device_id) {
       g_free (src->device_id);
     }
     src->device_id = (gchar *) g_malloc (id_size);
-    GTL_IFGetDeviceID (src->hIF, src->device_index, src->device_id, &id_size);
+    ret =
+        GTL_IFGetDeviceID (src->hIF, src->device_index, src->device_id,
+        &id_size);
     HANDLE_GTL_ERROR ("Failed to get device ID at specified index");
   }
 
@@ -849,13 +1636,15 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
     GST_DEBUG_OBJECT (src, "Trying to find stream ID at index %d",
         src->stream_index);
 
-    GTL_DevGetDataStreamID (src->hDEV, src->stream_index, NULL, &id_size);
+    ret =
+        GTL_DevGetDataStreamID (src->hDEV, src->stream_index, NULL, &id_size);
     HANDLE_GTL_ERROR ("Failed to get stream ID at specified index");
     if (src->stream_id) {
       g_free (src->stream_id);
     }
     src->stream_id = (gchar *) g_malloc (id_size);
-    GTL_DevGetDataStreamID (src->hDEV, src->stream_index, src->stream_id,
+    ret =
+        GTL_DevGetDataStreamID (src->hDEV, src->stream_index, src->stream_id,
         &id_size);
     HANDLE_GTL_ERROR ("Failed to get stream ID at specified index");
   }
@@ -864,12 +1653,29 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
   ret = GTL_DevOpenDataStream (src->hDEV, src->stream_id, &src->hDS);
   HANDLE_GTL_ERROR ("Failed to open data stream");
 
+  {
+    INFO_DATATYPE datatype;
+    size_t datasize = sizeof (src->timestamp_frequency);
+
+    /* assume nanosecond ticks if the producer doesn't say */
+    ret =
+        GTL_DevGetInfo (src->hDEV, DEVICE_INFO_TIMESTAMP_FREQUENCY, &datatype,
+        &src->timestamp_frequency, &datasize);
+    if (ret != GC_ERR_SUCCESS || src->timestamp_frequency == 0) {
+      src->timestamp_frequency = GST_SECOND;
+    }
+    GST_DEBUG_OBJECT (src, "Device timestamp frequency is %" G_GUINT64_FORMAT
+        " Hz", src->timestamp_frequency);
+  }
+
   {
     uint32_t num_urls = 0;
     char url[2048];
     size_t url_len = sizeof (url);
     INFO_DATATYPE datatype;
     const uint32_t url_index = 0;
+    gchar *xml = NULL;
+    gsize xml_len = 0;
 
     ret = GTL_DevGetPort (src->hDEV, &src->hDevPort);
     HANDLE_GTL_ERROR ("Failed to get port on device");
@@ -879,8 +1685,9 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
     GST_DEBUG_OBJECT (src, "Found %d port URLs", num_urls);
 
     GST_DEBUG_OBJECT (src, "Trying to get URL index %d", url_index);
-    GTL_GCGetPortURLInfo (src->hDevPort, url_index, URL_INFO_URL, &datatype,
-        url, &url_len);
+    ret =
+        GTL_GCGetPortURLInfo (src->hDevPort, url_index, URL_INFO_URL,
+        &datatype, url, &url_len);
     HANDLE_GTL_ERROR ("Failed to get URL");
     GST_DEBUG_OBJECT (src, "Found URL '%s'", url);
 
@@ -890,172 +1697,43 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
           ("file url not supported yet"), (NULL));
       goto error;
     } else if (g_str_has_prefix (url, "local")) {
-      GError *err = NULL;
-      GMatchInfo *matchInfo;
-      GRegex *regex;
-      gchar *filename, *addr_str, *len_str;
-      uint64_t addr;
-      size_t len;
-      gchar *buf;
-
-      regex =
-          g_regex_new
-          ("local:(?:///)?(?<filename>[^;]+);(?<address>[^;]+);(?<length>[^?]+)(?:[?]SchemaVersion=([^&]+))?",
-          (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &err);
-      if (!regex) {
-        goto error;
-      }
-      g_regex_match (regex, url, (GRegexMatchFlags) 0, &matchInfo);
-      filename = g_match_info_fetch_named (matchInfo, "filename");
-      addr_str = g_match_info_fetch_named (matchInfo, "address");
-      len_str = g_match_info_fetch_named (matchInfo, "length");
-      if (!filename || !addr_str || !len_str) {
-        GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-            ("Failed to parse local URL"), (NULL));
+      if (!gst_genicamsrc_read_local_xml (src, url, &xml, &xml_len)) {
         goto error;
       }
-
-      addr = g_ascii_strtoull (addr_str, NULL, 16);
-      len = g_ascii_strtoull (len_str, NULL, 16);
-      buf = (gchar *) g_malloc (len);
-      GTL_GCReadPort (src->hDevPort, addr, buf, &len);
-      HANDLE_GTL_ERROR ("Failed to read XML from port");
-
-      if (g_str_has_suffix (filename, "zip")) {
-        gchar *zipfilepath;
-        unzFile uf;
-        unz_file_info64 fileinfo;
-        gchar xmlfilename[2048];
-        gchar *xml;
-
-        zipfilepath = g_build_filename (g_get_tmp_dir (), filename, NULL);
-        if (!g_file_set_contents (zipfilepath, buf, len, &err)) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to write zipped XML to %s", zipfilepath), (NULL));
-          goto error;
-        }
-        uf = unzOpen64 (zipfilepath);
-        if (!uf) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to open zipped XML %s", zipfilepath), (NULL));
-          goto error;
-        }
-        //ret = unzGetGlobalInfo64(uf, &gi);
-        ret =
-            unzGetCurrentFileInfo64 (uf, &fileinfo, xmlfilename,
-            sizeof (xmlfilename), NULL, 0, NULL, 0);
-        if (ret != UNZ_OK) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to query zip file %s", zipfilepath), (NULL));
-          goto error;
-        }
-
-        ret = unzOpenCurrentFile (uf);
-        if (ret != UNZ_OK) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to extract file %s", xmlfilename), (NULL));
-          goto error;
-        }
-
-        xml = (gchar *) g_malloc (fileinfo.uncompressed_size);
-        if (!xml) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to allocate memory to extract XML file"), (NULL));
-          goto error;
-        }
-
-        ret = unzReadCurrentFile (uf, xml, fileinfo.uncompressed_size);
-        if (ret != fileinfo.uncompressed_size) {
-          GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
-              ("Failed to extract XML file %s", xmlfilename), (NULL));
-          goto error;
-        }
-        unzClose (uf);
-        g_free (zipfilepath);
-
-        zipfilepath = g_build_filename (g_get_tmp_dir (), xmlfilename, NULL);
-        g_file_set_contents (zipfilepath, xml, fileinfo.uncompressed_size,
-            &err);
-        g_free (zipfilepath);
-
-        g_free (xml);
-        //GZlibDecompressor *decompress;
-        //char *unzipped;
-        //gsize outbuf_size, bytes_read, bytes_written;
-        //GInputStream *zippedstream, *unzippedstream;
-        //decompress = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
-
-        ////zippedstream = g_memory_input_stream_new_from_data(buf, len, g_free);
-        ////unzippedstream = g_converter_input_stream_new (zippedstream, G_CONVERTER(decompress));
-        ////g_input_stream_read_all (G_INPUT_STREAM(unzippedstream), 
-        ////    g_converter_output_stream
-        //outbuf_size = 10000000;
-        //unzipped = (gchar*) g_malloc(outbuf_size);
-        //g_converter_convert (G_CONVERTER (decompress), buf, len, unzipped, outbuf_size, G_CONVERTER_NO_FLAGS, &bytes_read, &bytes_written, &err);
-        //GST_DEBUG_OBJECT (src, unzipped);
-      }
-
-      g_free (filename);
-      g_free (addr_str);
-      g_free (len_str);
-      g_free (buf);
     } else if (g_str_has_prefix (url, "http")) {
       GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY,
           ("file url not supported yet"), (NULL));
       goto error;
     }
+
+    gst_genicamsrc_resolve_registers (src, xml, xml_len);
+    g_free (xml);
   }
 
   {
-    // TODO: use Genicam node map for this
-    guint32 val = 0;
-    size_t datasize = 4;
-    ret = GTL_GCReadPort (src->hDevPort, 0x30204, &val, &datasize);
+    guint64 val = 0;
+
+    ret = gst_genicamsrc_read_register (src, &src->reg_width, &val);
     HANDLE_GTL_ERROR ("Failed to get width");
-    width = GUINT32_FROM_BE (val);
-    ret = GTL_GCReadPort (src->hDevPort, 0x30224, &val, &datasize);
+    width = (guint32) val;
+    ret = gst_genicamsrc_read_register (src, &src->reg_height, &val);
     HANDLE_GTL_ERROR ("Failed to get height");
-    height = GUINT32_FROM_BE (val);
+    height = (guint32) val;
 
     bpp = 8;
+    if (src->reg_pixel_format.valid) {
+      ret = gst_genicamsrc_read_register (src, &src->reg_pixel_format, &val);
+      HANDLE_GTL_ERROR ("Failed to get pixel format");
+      bpp = gst_genicamsrc_pixel_format_to_bpp ((guint32) val);
+      if (bpp == 0) {
+        GST_WARNING_OBJECT (src, "Unsupported pixel format 0x%08x, treating "
+            "as 8-bit", (guint32) val);
+        bpp = 8;
+      }
+    }
   }
 
-  if (!gst_genicamsrc_prepare_buffers (src)) {
-    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY, ("Failed to prepare buffers"),
-        (NULL));
-    goto error;
-  }
-
-  {
-    ret =
-        GTL_GCRegisterEvent (src->hDS, EVENT_NEW_BUFFER, &src->hNewBufferEvent);
-    HANDLE_GTL_ERROR ("Failed to register New Buffer event");
-  }
-
-  ret =
-      GTL_DSStartAcquisition (src->hDS, ACQ_START_FLAGS_DEFAULT,
-      GENTL_INFINITE);
-  HANDLE_GTL_ERROR ("Failed to start stream acquisition");
-
-  {
-    // TODO: use Genicam node map for this
-    guint32 val;
-    size_t datasize;
-
-    /* set AcquisitionMode to Continuous */
-    val = GUINT32_TO_BE (2);
-    datasize = sizeof (val);
-    ret = GTL_GCWritePort (src->hDevPort, 0x40004, &val, &datasize);
-    HANDLE_GTL_ERROR ("Failed to start device acquisition");
-
-    /* send AcquisitionStart command */
-    val = GUINT32_TO_BE (1);
-    datasize = sizeof (val);
-    ret = GTL_GCWritePort (src->hDevPort, 0x40024, &val, &datasize);
-    HANDLE_GTL_ERROR ("Failed to start device acquisition");
-  }
-
-  /* create caps */
+  /* create caps, before any buffers are announced or acquisition started */
   if (src->caps) {
     gst_caps_unref (src->caps);
     src->caps = NULL;
@@ -1088,9 +1766,38 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
   } else {
     GST_ELEMENT_ERROR (src, STREAM, WRONG_TYPE,
         ("Unknown or unsupported bit depth (%d).", bpp), (NULL));
-    return FALSE;
+    goto error;
+  }
+
+  if (!gst_genicamsrc_prepare_buffers (src)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, TOO_LAZY, ("Failed to prepare buffers"),
+        (NULL));
+    goto error;
   }
 
+  {
+    ret =
+        GTL_GCRegisterEvent (src->hDS, EVENT_NEW_BUFFER, &src->hNewBufferEvent);
+    HANDLE_GTL_ERROR ("Failed to register New Buffer event");
+  }
+
+  ret =
+      GTL_DSStartAcquisition (src->hDS, ACQ_START_FLAGS_DEFAULT,
+      GENTL_INFINITE);
+  HANDLE_GTL_ERROR ("Failed to start stream acquisition");
+
+  /* set AcquisitionMode to Continuous */
+  ret =
+      gst_genicamsrc_write_register (src, &src->reg_acquisition_mode,
+      src->acquisition_mode_continuous);
+  HANDLE_GTL_ERROR ("Failed to start device acquisition");
+
+  /* send AcquisitionStart command */
+  ret =
+      gst_genicamsrc_write_register (src, &src->reg_acquisition_start,
+      src->reg_acquisition_start.command_value);
+  HANDLE_GTL_ERROR ("Failed to start device acquisition");
+
   src->height = vinfo.height;
   src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
 
@@ -1105,26 +1812,16 @@ gst_genicamsrc_start (GstBaseSrc * bsrc)
 
 error:
   if (src->hDS) {
-    GTL_DSClose (src->hDS);
-    src->hDS = NULL;
-  }
-
-  if (src->hDEV) {
-    GTL_DevClose (src->hDEV);
-    src->hDEV = NULL;
-  }
-
-  if (src->hIF) {
-    GTL_IFClose (src->hIF);
-    src->hIF = NULL;
+    GTL_DSStopAcquisition (src->hDS, ACQ_STOP_FLAGS_DEFAULT);
   }
 
-  if (src->hTL) {
-    GTL_TLClose (src->hTL);
-    src->hTL = NULL;
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
   }
 
-  GTL_GCCloseLib ();
+  gst_genicamsrc_close_producer (gst_genicamsrc_take_producer (src));
 
   return FALSE;
 }
@@ -1133,34 +1830,50 @@ static gboolean
 gst_genicamsrc_stop (GstBaseSrc * bsrc)
 {
   GstGenicamSrc *src = GST_GENICAM_SRC (bsrc);
+  GstGenicamProducer *producer;
+  gboolean pooled = FALSE;
+  gint64 end_time;
 
   GST_DEBUG_OBJECT (src, "stop");
 
+  gst_genicamsrc_stop_acquisition_thread (src);
+
   if (src->hDS) {
     GTL_DSStopAcquisition (src->hDS, ACQ_STOP_FLAGS_DEFAULT);
     // TODO: also command device AcquisitionStop
-    GTL_DSFlushQueue (src->hDS, ACQ_QUEUE_INPUT_TO_OUTPUT);
-    GTL_DSFlushQueue (src->hDS, ACQ_QUEUE_OUTPUT_DISCARD);
-    GTL_DSClose (src->hDS);
-    src->hDS = NULL;
   }
 
-  if (src->hDEV) {
-    GTL_DevClose (src->hDEV);
-    src->hDEV = NULL;
+  /* pool buffers are revoked once the last one is back in the pool, and
+   * their memory outlives the stream */
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+    pooled = TRUE;
   }
 
-  if (src->hIF) {
-    GTL_IFClose (src->hIF);
-    src->hIF = NULL;
+  /* pushed buffers point into producer memory, which is freed when the
+   * stream is closed, so give downstream some time to release them */
+  g_mutex_lock (&src->buffer_lock);
+  end_time = g_get_monotonic_time () + G_TIME_SPAN_SECOND;
+  while (!pooled && src->num_wrapped > 0) {
+    if (!g_cond_wait_until (&src->buffer_cond, &src->buffer_lock, end_time))
+      break;
   }
 
-  if (src->hTL) {
-    GTL_TLClose (src->hTL);
-    src->hTL = NULL;
+  /* if some are still held, the last one released closes the producer */
+  producer = gst_genicamsrc_take_producer (src);
+  if (!pooled && src->num_wrapped > 0 && !src->closing) {
+    GST_WARNING_OBJECT (src, "%u buffers still held downstream, closing "
+        "stream once they are released", src->num_wrapped);
+    src->closing = producer;
+    producer = NULL;
   }
+  g_mutex_unlock (&src->buffer_lock);
 
-  GTL_GCCloseLib ();
+  if (producer) {
+    gst_genicamsrc_close_producer (producer);
+  }
 
   gst_genicamsrc_reset (src);
 
@@ -1224,7 +1937,10 @@ gst_genicamsrc_unlock (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock");
 
+  g_mutex_lock (&src->ring_lock);
   src->stop_requested = TRUE;
+  g_cond_broadcast (&src->ring_cond);
+  g_mutex_unlock (&src->ring_lock);
 
   return TRUE;
 }
@@ -1236,60 +1952,189 @@ gst_genicamsrc_unlock_stop (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock_stop");
 
+  g_mutex_lock (&src->ring_lock);
   src->stop_requested = FALSE;
+  g_mutex_unlock (&src->ring_lock);
 
   return TRUE;
 }
 
+typedef struct
+{
+  GstGenicamSrc *src;
+  BUFFER_HANDLE hBuffer;
+} VideoFrame;
+
+static void
+video_frame_release (void *data)
+{
+  VideoFrame *frame = (VideoFrame *) data;
+  GstGenicamSrc *src = frame->src;
+  GstGenicamProducer *producer = NULL;
+  GC_ERROR ret;
+
+  g_mutex_lock (&src->buffer_lock);
+  /* the stream may have been stopped while downstream held the buffer, in
+   * which case the last one released closes it */
+  if (src->hDS) {
+    ret = GTL_DSQueueBuffer (src->hDS, frame->hBuffer);
+    if (ret != GC_ERR_SUCCESS) {
+      GST_WARNING_OBJECT (src, "Failed to queue buffer (%d)", ret);
+    }
+  }
+  src->num_wrapped--;
+  if (src->num_wrapped == 0) {
+    producer = src->closing;
+  }
+  g_cond_broadcast (&src->buffer_cond);
+  g_mutex_unlock (&src->buffer_lock);
+
+  /* start waits for closing to be cleared before opening the library again */
+  if (producer) {
+    GST_DEBUG_OBJECT (src, "Last buffer released, closing stream");
+    gst_genicamsrc_close_producer (producer);
+
+    g_mutex_lock (&src->buffer_lock);
+    src->closing = NULL;
+    g_cond_broadcast (&src->buffer_cond);
+    g_mutex_unlock (&src->buffer_lock);
+  }
+
+  gst_object_unref (src);
+  g_free (frame);
+}
+
+typedef struct
+{
+  guint8 *base;
+  size_t size;
+  size_t payload_type;
+} BufferInfo;
+
+typedef struct
+{
+  uint64_t frame_id;
+  uint64_t timestamp;
+  bool8_t is_incomplete;
+} FrameInfo;
+
+/* Announced buffers keep their memory and payload type until the stream is
+ * stopped, so only ask the producer once per buffer */
+static BufferInfo *
+gst_genicamsrc_get_buffer_info (GstGenicamSrc * src, BUFFER_HANDLE hBuffer)
+{
+  GC_ERROR ret;
+  INFO_DATATYPE datatype;
+  size_t datasize;
+  BufferInfo *info;
+
+  info = (BufferInfo *) g_hash_table_lookup (src->buffer_info, hBuffer);
+  if (info) {
+    return info;
+  }
+
+  info = g_new0 (BufferInfo, 1);
+
+  datasize = sizeof (info->payload_type);
+  ret =
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_PAYLOADTYPE, &datatype, &info->payload_type, &datasize);
+  HANDLE_GTL_ERROR ("Failed to get payload type");
+
+  datasize = sizeof (info->size);
+  ret =
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_SIZE, &datatype, &info->size, &datasize);
+  HANDLE_GTL_ERROR ("Failed to get buffer size");
+
+  datasize = sizeof (info->base);
+  ret =
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_BASE, &datatype, &info->base, &datasize);
+  HANDLE_GTL_ERROR ("Failed to get buffer pointer");
+
+  g_hash_table_insert (src->buffer_info, hBuffer, info);
+
+  return info;
+
+error:
+  g_free (info);
+  return NULL;
+}
+
 static GstBuffer *
-gst_genicamsrc_get_buffer (GstGenicamSrc * src)
+gst_genicamsrc_get_buffer (GstGenicamSrc * src, FrameInfo * frame)
 {
   GC_ERROR ret;
   EVENT_NEW_BUFFER_DATA new_buffer_data;
   INFO_DATATYPE datatype;
   size_t datasize;
   GstBuffer *buf = NULL;
+  BufferInfo *info;
   size_t payload_type, buffer_size;
-  uint64_t frame_id;
-  bool8_t buffer_is_incomplete, is_acquiring;
   guint8 *data_ptr;
   GstMapInfo minfo;
+  gboolean wrap;
+  guint num_held;
+  GstBuffer *pool_buf = NULL;
+  BUFFER_HANDLE hBuffer;
 
-  datasize = sizeof (new_buffer_data);
-  ret =
-      GTL_EventGetData (src->hNewBufferEvent, &new_buffer_data, &datasize,
-      src->timeout);
-  HANDLE_GTL_ERROR ("Failed to get New Buffer event within timeout period");
+  if (src->pool) {
+    /* the pool waits for the producer to fill one of its buffers */
+    GstFlowReturn flow;
 
-  datasize = sizeof (payload_type);
-  ret =
-      GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
-      BUFFER_INFO_PAYLOADTYPE, &datatype, &payload_type, &datasize);
-  HANDLE_GTL_ERROR ("Failed to get payload type");
+    flow = gst_buffer_pool_acquire_buffer (src->pool, &pool_buf, NULL);
+    if (flow == GST_FLOW_FLUSHING) {
+      goto error;
+    } else if (flow != GST_FLOW_OK) {
+      GST_ELEMENT_ERROR (src, LIBRARY, FAILED,
+          ("Failed to get New Buffer event within timeout period: %s",
+              gst_genicamsrc_get_error_string (src)), (NULL));
+      goto error;
+    }
+    hBuffer = gst_genicam_buffer_pool_get_handle (pool_buf);
+  } else {
+    datasize = sizeof (new_buffer_data);
+    ret =
+        GTL_EventGetData (src->hNewBufferEvent, &new_buffer_data, &datasize,
+        src->timeout);
+    if (ret == GC_ERR_ABORT) {
+      /* the wait was cancelled with EventKill */
+      goto error;
+    }
+    HANDLE_GTL_ERROR ("Failed to get New Buffer event within timeout period");
+    hBuffer = new_buffer_data.BufferHandle;
+  }
 
-  datasize = sizeof (frame_id);
-  ret =
-      GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
-      BUFFER_INFO_FRAMEID, &datatype, &frame_id, &datasize);
-  HANDLE_GTL_ERROR ("Failed to get frame id");
+  info = gst_genicamsrc_get_buffer_info (src, hBuffer);
+  if (!info) {
+    goto error;
+  }
+  payload_type = info->payload_type;
+  buffer_size = info->size;
+  data_ptr = info->base;
 
-  datasize = sizeof (buffer_is_incomplete);
+  /* the only info that changes from frame to frame */
+  datasize = sizeof (frame->frame_id);
   ret =
-      GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
-      BUFFER_INFO_IS_INCOMPLETE, &datatype, &buffer_is_incomplete, &datasize);
-  HANDLE_GTL_ERROR ("Failed to get complete flag");
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_FRAMEID, &datatype, &frame->frame_id, &datasize);
+  HANDLE_GTL_ERROR ("Failed to get frame id");
 
-  datasize = sizeof (buffer_size);
+  /* not every producer timestamps, zero means unknown */
+  datasize = sizeof (frame->timestamp);
   ret =
-      GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
-      BUFFER_INFO_SIZE, &datatype, &buffer_size, &datasize);
-  HANDLE_GTL_ERROR ("Failed to get buffer size");
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_TIMESTAMP, &datatype, &frame->timestamp, &datasize);
+  if (ret != GC_ERR_SUCCESS) {
+    frame->timestamp = 0;
+  }
 
-  datasize = sizeof (data_ptr);
+  datasize = sizeof (frame->is_incomplete);
   ret =
-      GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
-      BUFFER_INFO_BASE, &datatype, &data_ptr, &datasize);
-  HANDLE_GTL_ERROR ("Failed to get buffer pointer");
+      GTL_DSGetBufferInfo (src->hDS, hBuffer,
+      BUFFER_INFO_IS_INCOMPLETE, &datatype, &frame->is_incomplete, &datasize);
+  HANDLE_GTL_ERROR ("Failed to get complete flag");
 
   if (payload_type != PAYLOAD_TYPE_IMAGE) {
     GST_ELEMENT_ERROR (src, STREAM, TOO_LAZY,
@@ -1298,6 +2143,36 @@ gst_genicamsrc_get_buffer (GstGenicamSrc * src)
   }
   // TODO: what if strides aren't same?
 
+  /* push the capture buffer itself, unless that would leave the producer
+   * too few buffers to fill while downstream holds on to ours */
+  g_mutex_lock (&src->buffer_lock);
+  /* pool buffers are counted from the moment they are acquired */
+  num_held = pool_buf ? src->num_wrapped - 1 : src->num_wrapped;
+  wrap = num_held + src->low_watermark < src->num_capture_buffers;
+  if (wrap && !pool_buf) {
+    src->num_wrapped++;
+  }
+  g_mutex_unlock (&src->buffer_lock);
+
+  if (wrap && pool_buf) {
+    gst_buffer_set_size (pool_buf, buffer_size);
+    return pool_buf;
+  } else if (wrap) {
+    VideoFrame *vf = g_new0 (VideoFrame, 1);
+
+    vf->src = (GstGenicamSrc *) gst_object_ref (src);
+    vf->hBuffer = hBuffer;
+    buf =
+        gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_READONLY,
+        (gpointer) data_ptr, buffer_size, 0, buffer_size, vf,
+        (GDestroyNotify) video_frame_release);
+
+    return buf;
+  }
+
+  GST_LOG_OBJECT (src, "%u buffers held downstream, copying frame",
+      src->num_wrapped);
+
   buf = gst_buffer_new_allocate (NULL, buffer_size, NULL);
   if (!buf) {
     GST_ELEMENT_ERROR (src, STREAM, TOO_LAZY,
@@ -1309,8 +2184,13 @@ gst_genicamsrc_get_buffer (GstGenicamSrc * src)
   orc_memcpy (minfo.data, (void *) data_ptr, minfo.size);
   gst_buffer_unmap (buf, &minfo);
 
-  GTL_DSQueueBuffer (src->hDS, new_buffer_data.BufferHandle);
-  HANDLE_GTL_ERROR ("Failed to queue buffer");
+  if (pool_buf) {
+    /* releasing it to the pool queues it to the producer again */
+    gst_buffer_unref (pool_buf);
+  } else {
+    ret = GTL_DSQueueBuffer (src->hDS, hBuffer);
+    HANDLE_GTL_ERROR ("Failed to queue buffer");
+  }
 
   return buf;
 
@@ -1318,71 +2198,301 @@ error:
   if (buf) {
     gst_buffer_unref (buf);
   }
+  if (pool_buf) {
+    gst_buffer_unref (pool_buf);
+  }
   return NULL;
 }
 
+/* Map a device timestamp to the pipeline clock. The device clock drifts
+ * against ours and frames arrive with varying latency, so fit a line through
+ * the most recent pairs of device time and arrival time. */
+static GstClockTime
+gst_genicamsrc_map_timestamp (GstGenicamSrc * src, guint64 ticks,
+    GstClockTime arrival)
+{
+  GstClockTime device_time, delta;
+  guint i, last;
+
+  device_time =
+      gst_util_uint64_scale (ticks, GST_SECOND, src->timestamp_frequency);
+
+  /* start over if the device clock was reset */
+  last = (src->ts_next_sample + GENICAM_TIMESTAMP_WINDOW - 1) %
+      GENICAM_TIMESTAMP_WINDOW;
+  if (src->ts_num_samples > 0 && device_time <= src->ts_samples[2 * last]) {
+    GST_DEBUG_OBJECT (src, "Device timestamp went backwards, resyncing");
+    src->ts_num_samples = 0;
+    src->ts_next_sample = 0;
+  }
+
+  i = src->ts_next_sample;
+  src->ts_samples[2 * i] = device_time;
+  src->ts_samples[2 * i + 1] = arrival;
+  src->ts_next_sample = (i + 1) % GENICAM_TIMESTAMP_WINDOW;
+  src->ts_num_samples = MIN (src->ts_num_samples + 1,
+      GENICAM_TIMESTAMP_WINDOW);
+
+  if (src->ts_num_samples == 1) {
+    /* nothing to fit yet, assume both clocks run at the same rate */
+    src->ts_m_num = 1;
+    src->ts_m_denom = 1;
+    src->ts_b = arrival;
+    src->ts_xbase = device_time;
+  } else {
+#if GST_CHECK_VERSION(1,12,0)
+    GstClockTime temp[2 * GENICAM_TIMESTAMP_WINDOW];
+    GstClockTime m_num, m_denom, b, xbase;
+    gdouble r_squared;
+
+    if (gst_calculate_linear_regression (src->ts_samples, temp,
+            src->ts_num_samples, &m_num, &m_denom, &b, &xbase, &r_squared)) {
+      src->ts_m_num = m_num;
+      src->ts_m_denom = m_denom;
+      src->ts_b = b;
+      src->ts_xbase = xbase;
+    }
+#endif
+  }
+
+  if (device_time >= src->ts_xbase) {
+    return src->ts_b + gst_util_uint64_scale (device_time - src->ts_xbase,
+        src->ts_m_num, src->ts_m_denom);
+  }
+
+  delta = gst_util_uint64_scale (src->ts_xbase - device_time, src->ts_m_num,
+      src->ts_m_denom);
+  return src->ts_b > delta ? src->ts_b - delta : 0;
+}
+
+/* Capture frames into the ring until told to exit, so buffers go back to
+ * the producer no matter how long downstream takes to pull them */
+static gpointer
+gst_genicamsrc_acquisition_thread (gpointer data)
+{
+  GstGenicamSrc *src = GST_GENICAM_SRC (data);
+
+  GST_DEBUG_OBJECT (src, "Acquisition thread started");
+
+  for (;;) {
+    GstBuffer *buf, *dropped = NULL;
+    FrameInfo frame;
+    GstClock *clock;
+    GstGenicamSrcFrame *entry;
+
+    buf = gst_genicamsrc_get_buffer (src, &frame);
+
+    g_mutex_lock (&src->ring_lock);
+    if (!buf || src->acq_exiting) {
+      /* if the wait wasn't cancelled, an error was posted */
+      if (!src->acq_exiting) {
+        src->acq_ret = GST_FLOW_ERROR;
+        g_cond_broadcast (&src->ring_cond);
+      }
+      g_mutex_unlock (&src->ring_lock);
+      if (buf) {
+        gst_buffer_unref (buf);
+      }
+      break;
+    }
+    g_mutex_unlock (&src->ring_lock);
+
+    /* timestamp as close to arrival as possible */
+    clock = gst_element_get_clock (GST_ELEMENT (src));
+    if (clock) {
+      GstClockTime clock_time = gst_clock_get_time (clock);
+
+      gst_object_unref (clock);
+      if (frame.timestamp != 0) {
+        clock_time = gst_genicamsrc_map_timestamp (src, frame.timestamp,
+            clock_time);
+      }
+      GST_BUFFER_TIMESTAMP (buf) =
+          GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
+          clock_time);
+    }
+
+    g_mutex_lock (&src->ring_lock);
+    while (src->ring_len == src->ring_size && !src->acq_exiting &&
+        src->overflow_policy == GST_GENICAM_SRC_OVERFLOW_POLICY_BLOCK) {
+      g_cond_wait (&src->ring_cond, &src->ring_lock);
+    }
+    if (src->acq_exiting) {
+      g_mutex_unlock (&src->ring_lock);
+      gst_buffer_unref (buf);
+      break;
+    }
+
+    if (src->ring_len == src->ring_size) {
+      src->ring_overflows++;
+      if (src->overflow_policy == GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_NEWEST) {
+        g_mutex_unlock (&src->ring_lock);
+        GST_LOG_OBJECT (src, "Ring full, dropping frame %" G_GUINT64_FORMAT,
+            frame.frame_id);
+        gst_buffer_unref (buf);
+        continue;
+      }
+
+      dropped = src->ring[src->ring_head].buf;
+      src->ring_head = (src->ring_head + 1) % src->ring_size;
+      src->ring_len--;
+    }
+
+    entry = &src->ring[(src->ring_head + src->ring_len) % src->ring_size];
+    entry->buf = buf;
+    entry->frame_id = frame.frame_id;
+    entry->is_incomplete = frame.is_incomplete;
+    src->ring_len++;
+    src->ring_high_water = MAX (src->ring_high_water, src->ring_len);
+    g_cond_broadcast (&src->ring_cond);
+    g_mutex_unlock (&src->ring_lock);
+
+    /* dropped frames show up as frame ID gaps in create() */
+    if (dropped) {
+      GST_LOG_OBJECT (src, "Ring full, dropped oldest frame");
+      gst_buffer_unref (dropped);
+    }
+  }
+
+  GST_DEBUG_OBJECT (src, "Acquisition thread stopped");
+
+  return NULL;
+}
+
+static gboolean
+gst_genicamsrc_start_acquisition_thread (GstGenicamSrc * src)
+{
+  GError *err = NULL;
+
+  g_mutex_lock (&src->ring_lock);
+  src->ring = g_new0 (GstGenicamSrcFrame, src->ring_size);
+  src->ring_head = 0;
+  src->ring_len = 0;
+  src->acq_exiting = FALSE;
+  src->acq_ret = GST_FLOW_OK;
+  g_mutex_unlock (&src->ring_lock);
+
+  src->acq_thread = g_thread_try_new ("genicamsrc",
+      gst_genicamsrc_acquisition_thread, src, &err);
+  if (src->acq_thread == NULL) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Failed to create acquisition thread"), ("%s", err->message));
+    g_error_free (err);
+    g_free (src->ring);
+    src->ring = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_genicamsrc_stop_acquisition_thread (GstGenicamSrc * src)
+{
+  guint i;
+
+  if (!src->acq_thread) {
+    return;
+  }
+
+  g_mutex_lock (&src->ring_lock);
+  src->acq_exiting = TRUE;
+  g_cond_broadcast (&src->ring_cond);
+  g_mutex_unlock (&src->ring_lock);
+
+  /* wake the thread if it's waiting for a frame */
+  GTL_EventKill (src->hNewBufferEvent);
+
+  g_thread_join (src->acq_thread);
+  src->acq_thread = NULL;
+
+  /* frames never pulled go back to the producer */
+  for (i = 0; i < src->ring_len; ++i) {
+    gst_buffer_unref (src->ring[(src->ring_head + i) % src->ring_size].buf);
+  }
+  g_free (src->ring);
+  src->ring = NULL;
+  src->ring_head = 0;
+  src->ring_len = 0;
+}
+
 static GstFlowReturn
 gst_genicamsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
   GstGenicamSrc *src = GST_GENICAM_SRC (psrc);
-  guint32 dropped_frames = 0;
-  GstClock *clock;
-  GstClockTime clock_time;
+  guint64 dropped_frames = 0;
+  GstGenicamSrcFrame frame;
+  GstFlowReturn ret;
 
   GST_LOG_OBJECT (src, "create");
 
-  *buf = gst_genicamsrc_get_buffer (src);
-  if (!*buf) {
+  /* capture starts once there's a clock to timestamp with */
+  if (!src->acq_thread && !gst_genicamsrc_start_acquisition_thread (src)) {
     return GST_FLOW_ERROR;
   }
 
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  clock_time = gst_clock_get_time (clock);
-  gst_object_unref (clock);
+  g_mutex_lock (&src->ring_lock);
+  while (src->ring_len == 0 && !src->stop_requested &&
+      src->acq_ret == GST_FLOW_OK) {
+    g_cond_wait (&src->ring_cond, &src->ring_lock);
+  }
+  if (src->stop_requested) {
+    g_mutex_unlock (&src->ring_lock);
+    return GST_FLOW_FLUSHING;
+  }
+  if (src->ring_len == 0) {
+    ret = src->acq_ret;
+    g_mutex_unlock (&src->ring_lock);
+    return ret;
+  }
+  frame = src->ring[src->ring_head];
+  src->ring_head = (src->ring_head + 1) % src->ring_size;
+  src->ring_len--;
+  g_cond_broadcast (&src->ring_cond);
+  g_mutex_unlock (&src->ring_lock);
+
+  *buf = frame.buf;
 
   /* check for dropped frames and disrupted signal */
-  //dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
+  if (src->last_frame_id != G_MAXUINT64) {
+    if (frame.frame_id > src->last_frame_id) {
+      dropped_frames = frame.frame_id - src->last_frame_id - 1;
+    } else {
+      GST_WARNING_OBJECT (src, "Frame ID non-monotonic, device restarted?");
+    }
+  }
+  src->last_frame_id = frame.frame_id;
+
+  /* offsets count every frame the device sent, dropped ones included */
+  src->frame_offset += dropped_frames;
+  GST_BUFFER_OFFSET (*buf) = src->frame_offset;
+  GST_BUFFER_OFFSET_END (*buf) = src->frame_offset + 1;
+  src->frame_offset++;
+
+  if (frame.is_incomplete) {
+    GST_WARNING_OBJECT (src, "Frame %" G_GUINT64_FORMAT " is incomplete",
+        frame.frame_id);
+    GST_BUFFER_FLAG_SET (*buf, GST_BUFFER_FLAG_CORRUPTED);
+  }
+
   if (dropped_frames > 0) {
-    src->total_dropped_frames += dropped_frames;
-    GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-        src->total_dropped_frames);
-  } else if (dropped_frames < 0) {
-    GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
-  }
-  //src->last_frame_count = circ_handle.FrameCount;
-
-  /* create GstBuffer then release circ buffer back to acquisition */
-  //*buf = gst_genicamsrc_create_buffer_from_circ_handle (src, &circ_handle);
-  //ret =
-  //    BiCirStatusSet (src->board, &src->buffer_array, circ_handle, BIAVAILABLE);
-  //if (ret != BI_OK) {
-  //  GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-  //      ("Failed to release buffer: %s", gst_genicamsrc_get_error_string (src,
-  //              ret)), (NULL));
-  //  return GST_FLOW_ERROR;
-  //}
-
-  /* TODO: understand why timestamps for circ_handle are sometimes 0 */
-  //GST_BUFFER_TIMESTAMP (*buf) =
-  //    GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-  //    src->acq_start_time + circ_handle.HiResTimeStamp.totalSec * GST_SECOND);
-  GST_BUFFER_TIMESTAMP (*buf) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      clock_time);
-  //GST_BUFFER_OFFSET (*buf) = circ_handle.FrameCount - 1;
+    GstStructure *info_msg;
 
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
+    g_mutex_lock (&src->ring_lock);
+    src->total_dropped_frames += dropped_frames;
+    g_mutex_unlock (&src->ring_lock);
+    GST_WARNING_OBJECT (src, "Just dropped %" G_GUINT64_FORMAT " frames (%"
+        G_GUINT64_FORMAT " total)", dropped_frames, src->total_dropped_frames);
+
+    info_msg = gst_structure_new ("dropped-frame-info",
+        "num-dropped-frames", G_TYPE_INT, (gint) dropped_frames,
+        "total-dropped-frames", G_TYPE_INT, (gint) src->total_dropped_frames,
+        "timestamp", GST_TYPE_CLOCK_TIME, GST_BUFFER_TIMESTAMP (*buf), NULL);
+    gst_element_post_message (GST_ELEMENT (src),
+        gst_message_new_element (GST_OBJECT (src), info_msg));
   }
 
   return GST_FLOW_OK;
-
-error:
-  return GST_FLOW_ERROR;
 }
 
 gchar *
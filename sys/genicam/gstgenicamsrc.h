@@ -20,13 +20,19 @@
 #ifndef _GST_GENICAM_SRC_H_
 #define _GST_GENICAM_SRC_H_
 
+#include <gmodule.h>
 #include <gst/base/gstpushsrc.h>
 
 #undef __cplusplus
 #include "GenTL_v1_5.h"
 
+#include "genicamnodemap.h"
+
 #define MAX_ERROR_STRING_LEN 256
 
+/* number of recent frames used to map device timestamps to the clock */
+#define GENICAM_TIMESTAMP_WINDOW 32
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_GENICAM_SRC   (gst_genicamsrc_get_type())
@@ -36,13 +42,34 @@ G_BEGIN_DECLS
 #define GST_IS_GENICAM_SRC_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_GENICAM_SRC))
 
 typedef struct _GstGenicamSrc GstGenicamSrc;
+typedef struct _GstGenicamProducer GstGenicamProducer;
 typedef struct _GstGenicamSrcClass GstGenicamSrcClass;
 
+typedef enum {
+    GST_GENICAM_SRC_BUFFER_MODE_PRODUCER,
+    GST_GENICAM_SRC_BUFFER_MODE_POOL
+} GstGenicamSrcBufferModeEnum;
+
+typedef enum {
+    GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_OLDEST,
+    GST_GENICAM_SRC_OVERFLOW_POLICY_DROP_NEWEST,
+    GST_GENICAM_SRC_OVERFLOW_POLICY_BLOCK
+} GstGenicamSrcOverflowPolicyEnum;
+
+/* a captured frame waiting in the ring for create() */
+typedef struct
+{
+  GstBuffer *buf;
+  guint64 frame_id;
+  gboolean is_incomplete;
+} GstGenicamSrcFrame;
+
 struct _GstGenicamSrc
 {
   GstPushSrc base_genicamsrc;
 
   /* camera handle */
+  GModule *module;
   TL_HANDLE hTL;
   IF_HANDLE hIF;
   DEV_HANDLE hDEV;
@@ -51,7 +78,17 @@ struct _GstGenicamSrc
   EVENT_HANDLE hNewBufferEvent;
   char error_string[MAX_ERROR_STRING_LEN];
 
+  /* registers of the standard features, resolved from the device XML */
+  GenicamRegister reg_width;
+  GenicamRegister reg_height;
+  GenicamRegister reg_pixel_format;
+  GenicamRegister reg_payload_size;
+  GenicamRegister reg_acquisition_mode;
+  GenicamRegister reg_acquisition_start;
+  gint64 acquisition_mode_continuous;
+
   /* properties */
+  gchar *cti_path;
   guint interface_index;
   gchar *interface_id;
   guint device_index;
@@ -59,16 +96,59 @@ struct _GstGenicamSrc
   guint stream_index;
   gchar *stream_id;
   guint num_capture_buffers;
+  guint low_watermark;
   gint timeout;
+  GstGenicamSrcBufferModeEnum buffer_mode;
+  gboolean hugepages;
+  guint ring_size;
+  GstGenicamSrcOverflowPolicyEnum overflow_policy;
+
+  /* pool whose memory is announced to the producer, in pool buffer mode */
+  GstBufferPool *pool;
+
+  /* frames pushed without copying, or acquired from the pool, not yet
+   * released downstream */
+  GMutex buffer_lock;
+  GCond buffer_cond;
+  guint num_wrapped;
+  /* producer handles of a stopped stream, closed when the last frame pushed
+   * from producer memory is released */
+  GstGenicamProducer *closing;
+
+  /* buffer info that doesn't change between frames, by buffer handle */
+  GHashTable *buffer_info;
+
+  /* recent (device time, arrival time) pairs, and the line fit to them */
+  guint64 timestamp_frequency;
+  GstClockTime ts_samples[2 * GENICAM_TIMESTAMP_WINDOW];
+  guint ts_num_samples;
+  guint ts_next_sample;
+  GstClockTime ts_m_num;
+  GstClockTime ts_m_denom;
+  GstClockTime ts_b;
+  GstClockTime ts_xbase;
 
   GstClockTime acq_start_time;
-  guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  guint64 last_frame_id;
+  guint64 frame_offset;
+  guint64 total_dropped_frames;
 
   GstCaps *caps;
   gint height;
   gint gst_stride;
 
+  /* acquisition thread and the frames it captured for create(), all under
+   * ring_lock */
+  GThread *acq_thread;
+  GMutex ring_lock;
+  GCond ring_cond;
+  GstGenicamSrcFrame *ring;
+  guint ring_head;
+  guint ring_len;
+  guint ring_high_water;
+  guint64 ring_overflows;
+  gboolean acq_exiting;
+  GstFlowReturn acq_ret;
   gboolean stop_requested;
 };
 
@@ -79,6 +159,13 @@ struct _GstGenicamSrcClass
 
 GType gst_genicamsrc_get_type (void);
 
+/* bound from the producer by genicamsrc, also used by its buffer pool */
+extern PEventGetData GTL_EventGetData;
+extern PDSAnnounceBuffer GTL_DSAnnounceBuffer;
+extern PDSFlushQueue GTL_DSFlushQueue;
+extern PDSRevokeBuffer GTL_DSRevokeBuffer;
+extern PDSQueueBuffer GTL_DSQueueBuffer;
+
 G_END_DECLS
 
 #endif
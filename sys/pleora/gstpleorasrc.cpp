@@ -1685,19 +1685,24 @@ gst_pleorasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
           chunk_size);
       GST_MEMDUMP_OBJECT (src, "Chunk data", chunk_data, chunk_size);
 
-      if (chunk_size < 17) {
-        GST_LOG_OBJECT (src, "Chunk data is too small to contain KLV");
-        continue;
-      }
+      /* walk the packets so any padding after them is excluded */
+      GstKLVReader klv_reader;
+      GstKLVPacket klv_packet;
+      gst_klv_reader_init (&klv_reader, chunk_data, chunk_size);
+      while (gst_klv_reader_next_packet (&klv_reader, &klv_packet));
 
-      if (GST_READ_UINT32_BE (chunk_data) != 0x060E2B34) {
+      if (klv_reader.offset == 0) {
         GST_LOG_OBJECT (src, "Chunk doesn't contain KLV data");
         continue;
       }
 
+      if (gst_klv_reader_get_remaining (&klv_reader) > 0) {
+        GST_LOG_OBJECT (src, "Ignoring %d bytes after KLV data in chunk",
+            (gint) gst_klv_reader_get_remaining (&klv_reader));
+      }
+
       GST_LOG_OBJECT (src, "Adding KLV meta to buffer");
-      /* TODO: do we need to exclude padding that may be present? */
-      gst_buffer_add_klv_meta_from_data (*buf, chunk_data, chunk_size);
+      gst_buffer_add_klv_meta_from_data (*buf, chunk_data, klv_reader.offset);
     }
   }
 #endif // GST_PLUGINS_VISION_ENABLE_KLV